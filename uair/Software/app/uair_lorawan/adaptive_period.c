@@ -0,0 +1,78 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file adaptive_period.c
+ *
+ *
+ */
+
+#include "adaptive_period.h"
+
+static uint16_t adaptive_period_clamp(uint16_t period, const adaptive_period_bounds_t *bounds)
+{
+    if (period < bounds->min_ticks)
+        return bounds->min_ticks;
+    if (period > bounds->max_ticks)
+        return bounds->max_ticks;
+    return period;
+}
+
+int adaptive_period_init(adaptive_period_t *adaptive, uint32_t *storage, const rolling_stats_format_t *format, int32_t stable_deviation)
+{
+    adaptive->stable_deviation = stable_deviation;
+    adaptive->period = 0;
+    adaptive->since_change = 0;
+    return rolling_stats_init(&adaptive->recent, storage, ADAPTIVE_PERIOD_WINDOW_SAMPLES, format);
+}
+
+void adaptive_period_reset(adaptive_period_t *adaptive, uint16_t nominal, const adaptive_period_bounds_t *bounds)
+{
+    adaptive->period = bounds->max_ticks != 0 ? adaptive_period_clamp(nominal, bounds) : nominal;
+    adaptive->since_change = 0;
+}
+
+bool adaptive_period_push(adaptive_period_t *adaptive, int32_t sample, const adaptive_period_bounds_t *bounds)
+{
+    uint16_t period = adaptive->period;
+    int64_t stable;
+    int64_t variance;
+
+    if (bounds->max_ticks == 0)
+        return false;
+
+    rolling_stats_push(&adaptive->recent, sample);
+    if (adaptive->since_change < UINT16_MAX)
+        adaptive->since_change++;
+
+    if (-1 == rolling_stats_variance(&adaptive->recent, ADAPTIVE_PERIOD_SHRINK_MIN_SAMPLES, &variance))
+        return false;
+
+    stable = (int64_t)adaptive->stable_deviation * adaptive->stable_deviation;
+
+    if (variance > 4 * stable && adaptive->since_change >= ADAPTIVE_PERIOD_SHRINK_MIN_SAMPLES)
+        period = adaptive_period_clamp(period / 2, bounds);
+    else if (variance < stable && adaptive->since_change >= ADAPTIVE_PERIOD_WINDOW_SAMPLES)
+        period = adaptive_period_clamp(period * 2, bounds);
+
+    if (period == adaptive->period)
+        return false;
+
+    /* samples taken at the old period no longer tell how the new one does */
+    rolling_stats_clear(&adaptive->recent);
+    adaptive->period = period;
+    adaptive->since_change = 0;
+    return true;
+}
@@ -0,0 +1,71 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file adaptive_period.h
+ *
+ * Sampling period of a sensor that follows how fast its measurement
+ * changes: stretched while the recent samples are stable, shrunk when they
+ * change fast. Periods double or halve so that they stay aligned with the
+ * rest of their group, and are kept within the sampling bounds. Each
+ * change starts over from an empty window.
+ */
+
+#ifndef UAIR_ADAPTIVE_PERIOD_H__
+#define UAIR_ADAPTIVE_PERIOD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rolling_stats.h"
+
+#define ADAPTIVE_PERIOD_WINDOW_SAMPLES 8        /* recent samples whose variance drives the period */
+#define ADAPTIVE_PERIOD_SHRINK_MIN_SAMPLES 4    /* samples since the last period change before shrinking it */
+
+typedef struct
+{
+    uint8_t min_ticks;
+    uint8_t max_ticks;      /* 0 when adaptive sampling is off */
+} adaptive_period_bounds_t;
+
+typedef struct
+{
+    rolling_stats_t recent;
+    int32_t stable_deviation;   /* below it the samples are stable, twice as much is fast changing */
+    uint16_t period;        /* requested period, in ticks */
+    uint16_t since_change;  /* samples since the period last changed */
+} adaptive_period_t;
+
+/*
+ * storage holds ROLLING_STATS_WORDS(ADAPTIVE_PERIOD_WINDOW_SAMPLES, format->bits)
+ * words. Returns -1 if the format does not fit its bits.
+ */
+int adaptive_period_init(adaptive_period_t *adaptive, uint32_t *storage, const rolling_stats_format_t *format, int32_t stable_deviation);
+
+/* Restarts from the nominal period, clamped to the bounds when they are set */
+void adaptive_period_reset(adaptive_period_t *adaptive, uint16_t nominal, const adaptive_period_bounds_t *bounds);
+
+/* Returns true when the sample changed the period. Does nothing while the bounds are off */
+bool adaptive_period_push(adaptive_period_t *adaptive, int32_t sample, const adaptive_period_bounds_t *bounds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#include "adaptive_period.h"
+
+#include <array>
+#include <cstdint>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("Adaptive period", "[app][adaptive period]")
+{
+    static const rolling_stats_format_t format = { -40000, 125000, 1, 18 };
+    std::array<uint32_t, ROLLING_STATS_WORDS(ADAPTIVE_PERIOD_WINDOW_SAMPLES, 18)> storage;
+    adaptive_period_bounds_t bounds = { 2, 32 };
+    adaptive_period_t adaptive;
+
+    // stable below 100, fast changing above 200
+    REQUIRE(adaptive_period_init(&adaptive, storage.data(), &format, 100) == 0);
+    adaptive_period_reset(&adaptive, 8, &bounds);
+    REQUIRE(adaptive.period == 8);
+
+    // pushes samples until the period changes, returns how many it took
+    auto push_until_change = [&](int32_t base, int32_t deviation, int max_samples)
+    {
+        for (int i = 1; i <= max_samples; i++) {
+            int32_t sample = (i % 2) ? base + deviation : base - deviation;
+            if (adaptive_period_push(&adaptive, sample, &bounds))
+                return i;
+        }
+        return 0;
+    };
+
+    SECTION("stable samples double the period up to the longest")
+    {
+        REQUIRE(push_until_change(25000, 0, 100) == ADAPTIVE_PERIOD_WINDOW_SAMPLES);
+        REQUIRE(adaptive.period == 16);
+        REQUIRE(push_until_change(25000, 0, 100) == ADAPTIVE_PERIOD_WINDOW_SAMPLES);
+        REQUIRE(adaptive.period == 32);
+
+        REQUIRE(push_until_change(25000, 50, 100) == 0);
+        REQUIRE(adaptive.period == 32);
+    }
+
+    SECTION("noisy samples halve the period down to the shortest")
+    {
+        REQUIRE(push_until_change(25000, 1000, 100) == ADAPTIVE_PERIOD_SHRINK_MIN_SAMPLES);
+        REQUIRE(adaptive.period == 4);
+        REQUIRE(push_until_change(25000, 1000, 100) == ADAPTIVE_PERIOD_SHRINK_MIN_SAMPLES);
+        REQUIRE(adaptive.period == 2);
+
+        REQUIRE(push_until_change(25000, 1000, 100) == 0);
+        REQUIRE(adaptive.period == 2);
+    }
+
+    SECTION("back and forth")
+    {
+        REQUIRE(push_until_change(25000, 0, 100) != 0);
+        REQUIRE(push_until_change(25000, 0, 100) != 0);
+        REQUIRE(adaptive.period == 32);
+
+        REQUIRE(push_until_change(25000, 1000, 100) == ADAPTIVE_PERIOD_SHRINK_MIN_SAMPLES);
+        REQUIRE(adaptive.period == 16);
+
+        REQUIRE(push_until_change(25000, 0, 100) == ADAPTIVE_PERIOD_WINDOW_SAMPLES);
+        REQUIRE(adaptive.period == 32);
+    }
+
+    SECTION("between stable and fast changing the period stays")
+    {
+        REQUIRE(push_until_change(25000, 150, 100) == 0);
+        REQUIRE(adaptive.period == 8);
+    }
+
+    SECTION("the nominal period is clamped to the bounds")
+    {
+        adaptive_period_reset(&adaptive, 64, &bounds);
+        REQUIRE(adaptive.period == 32);
+        adaptive_period_reset(&adaptive, 1, &bounds);
+        REQUIRE(adaptive.period == 2);
+    }
+
+    SECTION("without bounds the period is fixed")
+    {
+        bounds = { 0, 0 };
+        adaptive_period_reset(&adaptive, 64, &bounds);
+        REQUIRE(adaptive.period == 64);
+
+        REQUIRE(push_until_change(25000, 0, 100) == 0);
+        REQUIRE(push_until_change(25000, 1000, 100) == 0);
+        REQUIRE(adaptive.period == 64);
+    }
+}
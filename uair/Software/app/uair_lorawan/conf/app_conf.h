@@ -26,6 +26,10 @@
 
 #define UAIR_ADVANCED_TRACER_ENABLE 0
 
+/* With the advanced tracer, send APP_* traces as format ids plus raw arguments,
+   decoded on the host with tools/uair_trace_decode and the .tokens dictionary */
+#define UAIR_TOKEN_TRACER_ENABLE 0
+
 /* if ON (=1) it enables the debugger plus 4 dbg pins */
 /* if OFF (=0) the debugger is OFF (lower consumption) */
 #if defined (RELEASE) && (RELEASE==1)
@@ -42,6 +46,11 @@
  */
 #define SENSORS_PAYLOAD_APP_PORT        2
 
+/*!
+ * LoRaWAN application port for the backlog: sensors payloads queued during outages, oldest first
+ */
+#define SENSORS_BACKLOG_APP_PORT        3
+
 /*!
  * Defines the application data transmission duty cycle. 120s, value in [ms].
  */
@@ -79,6 +88,9 @@ typedef enum
 {
   CFG_SEQ_Task_LmHandlerProcess,
   CFG_SEQ_Task_LoRaSendOnTxTimerOrButtonEvent,
+  CFG_SEQ_Task_SensorsI2C,
+  CFG_SEQ_Task_ConfigGC,
+  CFG_SEQ_Task_UplinkQueue,
   CFG_SEQ_Task_NBR
 } CFG_SEQ_Task_Id_t;
 
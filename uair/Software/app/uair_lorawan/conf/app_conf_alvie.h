@@ -37,6 +37,11 @@
  */
 #define SENSORS_PAYLOAD_APP_PORT        2
 
+/*!
+ * LoRaWAN application port for the backlog: sensors payloads queued during outages, oldest first
+ */
+#define SENSORS_BACKLOG_APP_PORT        3
+
 /*!
  * Defines the application data transmission duty cycle. 120s, value in [ms].
  */
@@ -69,6 +74,9 @@ typedef enum
 {
   CFG_SEQ_Task_LmHandlerProcess,
   CFG_SEQ_Task_LoRaSendOnTxTimerOrButtonEvent,
+  CFG_SEQ_Task_SensorsI2C,
+  CFG_SEQ_Task_ConfigGC,
+  CFG_SEQ_Task_UplinkQueue,
   CFG_SEQ_Task_NBR
 } CFG_SEQ_Task_Id_t;
 
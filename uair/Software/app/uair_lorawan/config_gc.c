@@ -0,0 +1,116 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file config_gc.c
+ *
+ *
+ */
+
+#include "config_gc.h"
+#include "controller.h"
+#include "io/UAIR_io_config.h"
+
+#include "app.h"
+#include "stm32_timer.h"
+#include "stm32_seq.h"
+
+#include <stdint.h>
+
+/* Time a single run of the task may keep the sequencer busy */
+#define CONFIG_GC_STEP_BUDGET_MS    50U
+/* Worst case of a page erase, moving an entry is a few flash writes */
+#define CONFIG_GC_ERASE_MS          25U
+#define CONFIG_GC_MOVE_MS           1U
+/* Pause between runs, lets the other tasks through */
+#define CONFIG_GC_STEP_PERIOD_MS    200U
+/* Nothing is started this close to a transmission... */
+#define CONFIG_GC_TX_MARGIN_MS      5000
+/* ...nor until its RX windows (RX2 at 2s, plus the join accept at 6s) are over */
+#define CONFIG_GC_RX_WINDOWS_MS     7000
+
+static UTIL_TIMER_Object_t s_gc_timer;
+
+/* How long to wait before touching the flash, 0 if it can be done now */
+static uint32_t config_gc_radio_delay(void)
+{
+    int32_t next = UAIR_controller_time_to_next_transmission_ms();
+    int32_t since = UAIR_controller_time_since_last_transmission_ms();
+
+    if (next >= 0 && next < CONFIG_GC_TX_MARGIN_MS)
+        return (uint32_t)(next + CONFIG_GC_RX_WINDOWS_MS);
+
+    if (since >= 0 && since < CONFIG_GC_RX_WINDOWS_MS)
+        return (uint32_t)(CONFIG_GC_RX_WINDOWS_MS - since);
+
+    return 0;
+}
+
+static void config_gc_schedule(uint32_t delay_ms)
+{
+    UTIL_TIMER_Stop(&s_gc_timer);
+    UTIL_TIMER_SetPeriod(&s_gc_timer, delay_ms);
+    UTIL_TIMER_Start(&s_gc_timer);
+}
+
+static void config_gc_task(void)
+{
+    uint32_t start = HAL_GetTick();
+    uair_io_context ctx;
+    uair_io_config_gc_state state;
+
+    UAIR_io_init_ctx(&ctx);
+
+    while ((state = UAIR_io_config_gc_pending(&ctx)) != UAIR_IO_CONFIG_GC_DONE) {
+        uint32_t cost = (state == UAIR_IO_CONFIG_GC_ERASE) ? CONFIG_GC_ERASE_MS : CONFIG_GC_MOVE_MS;
+        uint32_t delay = config_gc_radio_delay();
+
+        if (delay > 0) {
+            config_gc_schedule(delay);
+            return;
+        }
+
+        if ((HAL_GetTick() - start) + cost > CONFIG_GC_STEP_BUDGET_MS) {
+            config_gc_schedule(CONFIG_GC_STEP_PERIOD_MS);
+            return;
+        }
+
+        UAIR_io_config_gc_step(&ctx);
+        if (ctx.error != UAIR_IO_CONTEXT_ERROR_NONE) {
+            /* Left for the blocking flush when the space runs out */
+            APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "config compaction stopped, error %d\r\n", ctx.error);
+            return;
+        }
+    }
+}
+
+static void config_gc_timer_event(void *context)
+{
+    UTIL_SEQ_SetTask((1 << CFG_SEQ_Task_ConfigGC), CFG_SEQ_Prio_0);
+}
+
+void UAIR_config_gc_init(void)
+{
+    UTIL_SEQ_RegTask((1 << CFG_SEQ_Task_ConfigGC), UTIL_SEQ_RFU, config_gc_task);
+    UTIL_TIMER_Create(&s_gc_timer, 0xFFFFFFFFU, UTIL_TIMER_ONESHOT, config_gc_timer_event, NULL);
+
+    /* Whatever a previous boot left behind */
+    UAIR_config_gc_request();
+}
+
+void UAIR_config_gc_request(void)
+{
+    UTIL_SEQ_SetTask((1 << CFG_SEQ_Task_ConfigGC), CFG_SEQ_Prio_0);
+}
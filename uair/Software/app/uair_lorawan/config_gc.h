@@ -0,0 +1,46 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file config_gc.h
+ *
+ *
+ */
+
+#ifndef UAIR_CONFIG_GC_H__
+#define UAIR_CONFIG_GC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Registers the config compaction task and schedules a first run
+ *
+ * The config flash area is compacted a few steps at a time, each run staying
+ * within a time budget and kept clear of the LoRa transmissions and RX windows.
+ */
+void UAIR_config_gc_init(void);
+
+/**
+ * @brief Schedules the compaction task, to be called after config writes
+ */
+void UAIR_config_gc_request(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,6 +27,8 @@
 #include "io/UAIR_io_config.h"
 #include "io/UAIR_io_audit.h"
 #include "anomaly_guard.h"
+#include "config_gc.h"
+#include "uplink_queue.h"
 #include "lora_app.h"
 #include "UAIR_BSP_watchdog.h"
 #include "LmHandler.h"
@@ -40,37 +42,47 @@
 //static UTIL_TIMER_Object_t TxTimerTmp;
 static UTIL_TIMER_Object_t TxTimer;
 static uint8_t s_join_attempts = 0;
+static uint32_t s_last_interval_tick;
 
 static void send_type0();
 
 #if (!defined(RELEASE)) || (RELEASE==0)
 
-static void print_bytarr(const uint8_t *bytarr, size_t len, char *pref_msg) {
+static void print_bytarr(const uint8_t *bytarr, size_t len, const char *pref_msg) {
+    UAIR_tracer_writer_t w;
 
-    char tmp[(len*3)+1];
-    for (size_t i = 0; i < len; i++) sprintf(&tmp[i*3], " %02x", bytarr[i]);
-    tmp[(len*3)] = '\0';
-    APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "%s [%s ]\r\n", pref_msg, tmp);
+    if (UAIR_TRACER_Writer_Begin(&w, ADV_TRACER_VLEVEL_M, strlen(pref_msg) + (len * 3) + 6) != 0)
+        return;
+
+    UAIR_TRACER_Writer_Str(&w, pref_msg);
+    UAIR_TRACER_Writer_Str(&w, " [");
+    for (size_t i = 0; i < len; i++) {
+        UAIR_TRACER_Writer_Char(&w, ' ');
+        UAIR_TRACER_Writer_Hex8(&w, bytarr[i]);
+    }
+    UAIR_TRACER_Writer_Str(&w, " ]\r\n");
+    UAIR_TRACER_Writer_End(&w);
 }
 
 
 // size is bytes
 static void print_binary(uint8_t const size, void const * const ptr) {
-    unsigned char *b = (unsigned char*) ptr;
-    unsigned char byte;
+    const unsigned char *b = (const unsigned char*) ptr;
+    UAIR_tracer_writer_t w;
     int i, j;
 
-    APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "payload bin [");
-    //for (i = size-1; i >= 0; i--) {
+    if (UAIR_TRACER_Writer_Begin(&w, ADV_TRACER_VLEVEL_M, 13 + (size * 9) + 4) != 0)
+        return;
+
+    UAIR_TRACER_Writer_Str(&w, "payload bin [");
     for (i = 0; i < size; i++) {
         for (j = 7; j >= 0; j--) {
-        //for (j = 0; j < 8; j++) {
-            byte = (b[i] >> j) & 1;
-            APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "%u", byte);
+            UAIR_TRACER_Writer_Char(&w, ((b[i] >> j) & 1) ? '1' : '0');
         }
-        APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, " ");
+        UAIR_TRACER_Writer_Char(&w, ' ');
     }
-    APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, " ]\r\n");
+    UAIR_TRACER_Writer_Str(&w, " ]\r\n");
+    UAIR_TRACER_Writer_End(&w);
 }
 #endif
 
@@ -197,6 +209,11 @@ static void transmit_event()
     {
         if (BSP_network_enabled())
         {
+            // Intervals go to the backlog until we join, checked at each attempt
+            if ((HAL_GetTick() - s_last_interval_tick) >= UAIR_CONSERVATIVE_TX)
+            {
+                send_type0();
+            }
             perform_join();
         }
     }
@@ -240,6 +257,16 @@ void cmd_healthchk_ack(uint32_t value) {
     return;
 }
 
+/* downlink byte 3 is the shortest sampling period, byte 4 the longest, in ticks. A longest of 0 turns adaptive sampling off */
+void cmd_sampling_bounds(uint32_t value) {
+    uint8_t min_ticks = (uint8_t)(value & 0xFF);
+    uint8_t max_ticks = (uint8_t)((value >> 8) & 0xFF);
+
+    APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "\r\n cmd_sampling_bounds %u..%u ticks\r\n", min_ticks, max_ticks);
+    UAIR_sensors_set_config_param_uint8(UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MIN_TICKS, min_ticks);
+    UAIR_sensors_set_config_param_uint8(UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MAX_TICKS, max_ticks);
+}
+
 
 static void send_type0(void)
 {
@@ -349,10 +376,23 @@ static void send_type0(void)
 #if (!defined(RELEASE)) || (RELEASE==0)
     print_binary(sizeof(UAIR_net_buffer), &UAIR_net_buffer[0]);
     print_bytarr(UAIR_net_buffer, sizeof(UAIR_net_buffer), "payload hex");
+    UAIR_TRACER_DumpStatsOnChange();
 #endif
 
-    if (UAIR_lora_send(UAIR_net_buffer, sizeof(UAIR_net_buffer)))
+    s_last_interval_tick = HAL_GetTick();
+
+    // Behind a backlog, this interval waits its turn
+    if (UAIR_uplink_queue_is_empty() && (LmHandlerJoinStatus() == LORAMAC_HANDLER_SET) &&
+        UAIR_lora_send(UAIR_net_buffer, sizeof(UAIR_net_buffer)))
+    {
         UAIR_sensors_clear_measures();
+        return;
+    }
+
+    if (UAIR_uplink_queue_push(UAIR_net_buffer, sizeof(UAIR_net_buffer)))
+        UAIR_sensors_clear_measures();
+
+    UAIR_uplink_queue_drain();
 }
 
 void UAIR_sensor_event_listener(void *userdata, uint8_t audit_type) {
@@ -372,19 +412,29 @@ void UAIR_sensor_event_listener(void *userdata, uint8_t audit_type) {
 }
 
 void UAIR_controller_start(void) {
-    UAIR_link_commands_t cmd_cbs = {
+    /* kept by the LoRaWAN app for every downlink */
+    static UAIR_link_commands_t cmd_cbs = {
         .cmd_tx_policy = &cmd_tx_policy,
         .cmd_fair_ratio = &cmd_fair_ratio,
         .cmd_factory_reset =  &cmd_factory_reset,
-        .cmd_healthchk_ack = &cmd_healthchk_ack };
+        .cmd_healthchk_ack = &cmd_healthchk_ack,
+        .cmd_sampling_bounds = &cmd_sampling_bounds };
+
+    uair_io_context ctx;
+    UAIR_io_init_ctx(&ctx);
+    UAIR_io_config_init(&ctx);
+    UAIR_io_audit_init(&ctx);
+    UAIR_config_gc_init();
+    UAIR_uplink_queue_init();
+
+    /* the first interval is due one period after boot */
+    s_last_interval_tick = HAL_GetTick();
 
     LoRaWAN_Init(&cmd_cbs);
     UAIR_sensors_init();
 
     // load configuration
     uint8_t value;
-    uair_io_context ctx;
-    UAIR_io_init_ctx(&ctx);
     UAIR_io_config_read_uint8(&ctx, UAIR_IO_CONTEXT_KEY_CONFIG_TX_POLICY, &value);
     APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "config NET_TX : %d FAIR_RATIO %d \r\n", value, 0);
 
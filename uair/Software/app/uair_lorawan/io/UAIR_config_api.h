@@ -14,7 +14,9 @@ extern "C" {
  */
 typedef enum {
     UAIR_CONFIG_ID_TX_POLICY = UAIR_IO_CONTEXT_KEY_CONFIG_TX_POLICY,
-    UAIR_CONFIG_ID_FAIR_RATIO = UAIR_IO_CONTEXT_KEY_CONFIG_FAIR_RATIO
+    UAIR_CONFIG_ID_FAIR_RATIO = UAIR_IO_CONTEXT_KEY_CONFIG_FAIR_RATIO,
+    UAIR_CONFIG_ID_SAMPLING_MIN_TICKS = UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MIN_TICKS,
+    UAIR_CONFIG_ID_SAMPLING_MAX_TICKS = UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MAX_TICKS
 } uair_config_id;
 
 
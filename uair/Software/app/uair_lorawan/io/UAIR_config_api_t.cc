@@ -47,6 +47,10 @@ TEST_CASE("UAIR config API - read / write single", "[BSP][BSP app][BSP config]")
           auto page_count = UAIR_BSP_flash_config_area_get_page_count();
           for (decltype(page_count) page_index = 0; page_index < page_count; page_index++)
                UAIR_BSP_flash_config_area_erase_page(page_index);
+
+          uair_io_context ctx;
+          UAIR_io_init_ctx(&ctx);
+          UAIR_io_config_init(&ctx);
      }
 
      SECTION("read no data")
@@ -206,6 +210,10 @@ TEST_CASE("UAIR config API - read / write multiple", "[BSP][BSP app][BSP config]
           auto page_count = UAIR_BSP_flash_config_area_get_page_count();
           for (decltype(page_count) page_index = 0; page_index < page_count; page_index++)
                UAIR_BSP_flash_config_area_erase_page(page_index);
+
+          uair_io_context ctx;
+          UAIR_io_init_ctx(&ctx);
+          UAIR_io_config_init(&ctx);
      }
 
       SECTION("write (no data)")
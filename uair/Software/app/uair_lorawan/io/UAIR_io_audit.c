@@ -1,30 +1,613 @@
 #include "UAIR_io_audit.h"
+#include "UAIR_io_queue.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "UAIR_BSP_flash.h"
+
+/*
+ * The audit area is a ring of pages, filled in order and erased whole when the ring
+ * wraps around, so every page goes through the same number of erases.
+ *
+ * Each page starts with a header holding the ID of its first record: the head and
+ * the tail are found from the page headers alone, and only the newest page has to be
+ * walked to find where the next record goes. Records follow the header, each one a
+ * record header and the data padded to a doubleword, IDs going up by one.
+ * A record that doesn't check (erased, torn or corrupted) ends its page.
+ *
+ * The uplink queue is a second log built the same way on the last pages of the area,
+ * so that neither log wraps over the records of the other.
+ */
+
+#define AUDIT_PAGE_MAGIC 0x54445541U /* "AUDT" */
+#define QUEUE_PAGE_MAGIC 0x514C5055U /* "UPLQ" */
+#define AUDIT_ID_NONE 0xFFFFFFFFU /* erased flash */
+#define AUDIT_RECORD_FLAG_LIVE (1U << 0)
+
+typedef struct {
+     uint32_t magic;
+     uint32_t first_id;
+} audit_page_header;
+
+typedef struct {
+     uint32_t id;
+     uint8_t size;
+     uint8_t flags; /* left out of the CRC, cleared in place by dispose */
+     uint16_t crc;
+} audit_record_header;
+
+_Static_assert(sizeof(audit_page_header) == sizeof(uint64_t), "the flash writes doublewords");
+_Static_assert(sizeof(audit_record_header) == sizeof(uint64_t), "the flash writes doublewords");
+
+typedef struct {
+     uint32_t magic;
+     flash_page_t first_page; /* pages are numbered from here on */
+     unsigned num_pages;
+     bool is_ready;
+     bool is_empty; /* no page written yet */
+     flash_page_t head_page;
+     flash_page_t tail_page;
+     uint32_t head_first_id;
+     uint16_t tail_offset; /* where the next record goes in the tail page */
+     uint32_t next_id;
+     uint32_t iter_id; /* last record returned by the iterator, 0 if none */
+     flash_address_t iter_address;
+} audit_log;
+
+static audit_log s_audit = { .magic = AUDIT_PAGE_MAGIC };
+static audit_log s_queue = { .magic = QUEUE_PAGE_MAGIC };
+
+static void audit_reset_ctx(uair_io_context* ctx)
+{
+     ctx->flags = UAIR_IO_CONTEXT_FLAG_NONE;
+     ctx->error = UAIR_IO_CONTEXT_ERROR_NONE;
+}
+
+static flash_address_t page_address(const audit_log* log, flash_page_t page)
+{
+     return (flash_address_t)(log->first_page + page) * BSP_FLASH_PAGE_SIZE;
+}
+
+static flash_page_t address_page(const audit_log* log, flash_address_t address)
+{
+     return (flash_page_t)(address / BSP_FLASH_PAGE_SIZE - log->first_page);
+}
+
+static size_t record_total_size(uint8_t size)
+{
+     return sizeof(audit_record_header) + ((size + 7U) & ~7U);
+}
+
+/* CRC-16/CCITT */
+static uint16_t crc16_update(uint16_t crc, const uint8_t* data, size_t len)
+{
+     while (len--)
+     {
+          crc ^= (uint16_t)(*data++) << 8;
+          for (int bit = 0; bit < 8; bit++)
+               crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+     }
+     return crc;
+}
+
+static uint16_t record_crc(const audit_record_header* header, const uint8_t* data)
+{
+     uint8_t prefix[sizeof(header->id) + sizeof(header->size)];
+
+     memcpy(prefix, &header->id, sizeof(header->id));
+     prefix[sizeof(header->id)] = header->size;
+
+     return crc16_update(crc16_update(0xFFFFU, prefix, sizeof(prefix)), data, header->size);
+}
+
+/* 1 if the record at address is expected_id and checks, 0 if the page ends there, -1 on read errors */
+static int record_load(flash_address_t address, uint32_t expected_id, audit_record_header* header, uint8_t* data)
+{
+     flash_address_t page_end = (address / BSP_FLASH_PAGE_SIZE + 1) * BSP_FLASH_PAGE_SIZE;
+
+     header->id = AUDIT_ID_NONE;
+     if (address + sizeof(audit_record_header) > page_end)
+          return 0;
+
+     if (UAIR_BSP_flash_audit_area_read(address, (uint8_t*)header, sizeof(audit_record_header)) != sizeof(audit_record_header))
+          return -1;
+
+     if ((header->id != expected_id) || (header->size == 0) || (address + record_total_size(header->size) > page_end))
+          return 0;
+
+     if (UAIR_BSP_flash_audit_area_read(address + sizeof(audit_record_header), data, header->size) != header->size)
+          return -1;
+
+     return (header->crc == record_crc(header, data)) ? 1 : 0;
+}
+
+static bool audit_recover(audit_log* log, uair_io_context* ctx)
+{
+     unsigned area_pages = UAIR_BSP_flash_audit_area_get_page_count();
+     uint32_t tail_first_id = 0;
+     bool found = false;
+
+     log->first_page = (log == &s_queue) ? (flash_page_t)(area_pages - UAIR_IO_QUEUE_NUM_PAGES) : 0;
+     log->num_pages = (log == &s_queue) ? UAIR_IO_QUEUE_NUM_PAGES : (area_pages - UAIR_IO_QUEUE_NUM_PAGES);
+
+     log->is_ready = false;
+     log->iter_id = 0;
+
+     for (unsigned page = 0; page < log->num_pages; page++)
+     {
+          audit_page_header page_header;
+
+          if (UAIR_BSP_flash_audit_area_read(page_address(log, page), (uint8_t*)&page_header, sizeof(page_header)) != sizeof(page_header))
+          {
+               ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+               return false;
+          }
+
+          if (page_header.magic != log->magic)
+               continue;
+
+          if (!found || (page_header.first_id < log->head_first_id))
+          {
+               log->head_page = page;
+               log->head_first_id = page_header.first_id;
+          }
+          if (!found || (page_header.first_id > tail_first_id))
+          {
+               log->tail_page = page;
+               tail_first_id = page_header.first_id;
+          }
+          found = true;
+     }
+
+     log->is_empty = !found;
+     if (!found)
+     {
+          log->head_page = 0;
+          log->tail_page = 0;
+          log->head_first_id = 1;
+          log->tail_offset = 0;
+          log->next_id = 1;
+          log->is_ready = true;
+          return true;
+     }
+
+     flash_address_t address = page_address(log, log->tail_page) + sizeof(audit_page_header);
+     uint32_t id = tail_first_id;
+     audit_record_header header;
+     uint8_t data[UAIR_IO_AUDIT_MAX_SIZE];
+     int loaded;
+
+     while ((loaded = record_load(address, id, &header, data)) > 0)
+     {
+          address += record_total_size(header.size);
+          id++;
+     }
+
+     if (loaded < 0)
+     {
+          ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+          return false;
+     }
+
+     /* anything but erased flash can't be written over, the next record starts a new page */
+     log->tail_offset = (header.id == AUDIT_ID_NONE) ? (uint16_t)(address - page_address(log, log->tail_page)) : BSP_FLASH_PAGE_SIZE;
+     log->next_id = id;
+     log->is_ready = true;
+     return true;
+}
+
+static bool audit_ready(audit_log* log, uair_io_context* ctx)
+{
+     return log->is_ready || audit_recover(log, ctx);
+}
+
+/* moves the tail to a freshly erased page, dropping the oldest page if the ring is full */
+static bool audit_next_page(audit_log* log, uair_io_context* ctx)
+{
+     flash_page_t page = log->is_empty ? log->tail_page : (flash_page_t)((log->tail_page + 1) % log->num_pages);
+     bool drops_head = !log->is_empty && (page == log->head_page);
+
+     /* whatever it holds is either the oldest records or leftovers of an interrupted rotation */
+     if (UAIR_BSP_flash_audit_area_erase_page(log->first_page + page) != BSP_ERROR_NONE)
+     {
+          ctx->error = UAIR_IO_CONTEXT_ERROR_INTERNAL;
+          log->is_ready = false;
+          return false;
+     }
+
+     log->iter_id = 0;
+
+     if (drops_head)
+     {
+          audit_page_header page_header;
+
+          log->head_page = (flash_page_t)((page + 1) % log->num_pages);
+          if (UAIR_BSP_flash_audit_area_read(page_address(log, log->head_page), (uint8_t*)&page_header, sizeof(page_header)) != sizeof(page_header))
+          {
+               ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+               log->is_ready = false;
+               return false;
+          }
+          log->head_first_id = page_header.first_id;
+     }
+
+     audit_page_header page_header = { log->magic, log->next_id };
+     if (UAIR_BSP_flash_audit_area_write(page_address(log, page), (const uint64_t*)&page_header, 1) != 1)
+     {
+          ctx->error = UAIR_IO_CONTEXT_ERROR_WRITE;
+          log->is_ready = false;
+          return false;
+     }
+
+     if (log->is_empty)
+     {
+          log->head_page = page;
+          log->head_first_id = log->next_id;
+          log->is_empty = false;
+     }
+
+     log->tail_page = page;
+     log->tail_offset = sizeof(audit_page_header);
+     return true;
+}
+
+/* finds a record written and not yet dropped, whether disposed of or not */
+static bool audit_locate(audit_log* log, uair_io_context* ctx, int id, flash_address_t* address, audit_record_header* header, uint8_t* data)
+{
+     if ((id <= 0) || ((uint32_t)id >= log->next_id))
+     {
+          ctx->error = (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_ID;
+          return false;
+     }
+
+     if (log->is_empty || ((uint32_t)id < log->head_first_id))
+     {
+          ctx->error = (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_UNKNOWN_ID;
+          return false;
+     }
+
+     flash_address_t record_address;
+     uint32_t record_id;
+
+     if ((uint32_t)id == log->iter_id)
+     {
+          record_address = log->iter_address;
+          record_id = log->iter_id;
+     }
+     else
+     {
+          /* the newest page whose first record isn't after the one we look for */
+          flash_page_t page = log->tail_page;
+          audit_page_header page_header;
+
+          for (;;)
+          {
+               if (UAIR_BSP_flash_audit_area_read(page_address(log, page), (uint8_t*)&page_header, sizeof(page_header)) != sizeof(page_header))
+               {
+                    ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+                    return false;
+               }
+
+               if ((page_header.magic == log->magic) && (page_header.first_id <= (uint32_t)id))
+                    break;
+
+               if (page == log->head_page)
+               {
+                    ctx->error = (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_UNKNOWN_ID;
+                    return false;
+               }
+               page = (flash_page_t)((page + log->num_pages - 1) % log->num_pages);
+          }
+
+          record_address = page_address(log, page) + sizeof(audit_page_header);
+          record_id = page_header.first_id;
+     }
+
+     for (;;)
+     {
+          int loaded = record_load(record_address, record_id, header, data);
+
+          if (loaded < 0)
+          {
+               ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+               return false;
+          }
+
+          if (loaded == 0)
+          {
+               /* lost with the end of a page that was cut short */
+               ctx->error = (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_UNKNOWN_ID;
+               return false;
+          }
+
+          if (record_id == (uint32_t)id)
+               break;
+
+          record_address += record_total_size(header->size);
+          record_id++;
+     }
+
+     *address = record_address;
+     return true;
+}
+
+/* the first live record from address on, following the ring up to the tail */
+static int audit_find_live(audit_log* log, uair_io_context* ctx, flash_address_t address, uint32_t id)
+{
+     audit_record_header header;
+     uint8_t data[UAIR_IO_AUDIT_MAX_SIZE];
+
+     for (;;)
+     {
+          int loaded = record_load(address, id, &header, data);
+
+          if (loaded < 0)
+          {
+               ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+               return 0;
+          }
+
+          if (loaded > 0)
+          {
+               if (header.flags & AUDIT_RECORD_FLAG_LIVE)
+               {
+                    log->iter_id = id;
+                    log->iter_address = address;
+                    return (int)id;
+               }
+
+               address += record_total_size(header.size);
+               id++;
+               continue;
+          }
+
+          /* end of this page, carry on with the next one */
+          flash_page_t page = address_page(log, address);
+          if (page == log->tail_page)
+               return 0;
+
+          page = (flash_page_t)((page + 1) % log->num_pages);
+
+          audit_page_header page_header;
+          if (UAIR_BSP_flash_audit_area_read(page_address(log, page), (uint8_t*)&page_header, sizeof(page_header)) != sizeof(page_header))
+          {
+               ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+               return 0;
+          }
+
+          if (page_header.magic != log->magic)
+               return 0;
+
+          address = page_address(log, page) + sizeof(audit_page_header);
+          id = page_header.first_id;
+     }
+}
+
+static void log_init(audit_log* log, uair_io_context* ctx)
+{
+     audit_reset_ctx(ctx);
+
+     audit_recover(log, ctx);
+}
+
+static int log_add(audit_log* log, uair_io_context* ctx, const void* data, int size)
+{
+     audit_reset_ctx(ctx);
+
+     if (!data || (size <= 0) || (size > UAIR_IO_AUDIT_MAX_SIZE))
+     {
+          ctx->error = (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_SIZE;
+          return 0;
+     }
+
+     if (!audit_ready(log, ctx)) return 0;
+
+     size_t total_size = record_total_size((uint8_t)size);
+     if (log->is_empty || ((log->tail_offset + total_size) > BSP_FLASH_PAGE_SIZE))
+     {
+          if (!audit_next_page(log, ctx))
+               return 0;
+     }
+
+     uint64_t record[(sizeof(audit_record_header) + UAIR_IO_AUDIT_MAX_SIZE + 7) / sizeof(uint64_t)];
+     audit_record_header header = { log->next_id, (uint8_t)size, 0xFF, 0 };
+
+     header.crc = record_crc(&header, (const uint8_t*)data);
+     memset(record, 0xFF, total_size);
+     memcpy(record, &header, sizeof(header));
+     memcpy((uint8_t*)record + sizeof(header), data, size);
+
+     /* the header goes with the data, a torn write fails the CRC */
+     size_t count = total_size / sizeof(uint64_t);
+     if (UAIR_BSP_flash_audit_area_write(page_address(log, log->tail_page) + log->tail_offset, record, count) != (int)count)
+     {
+          ctx->error = UAIR_IO_CONTEXT_ERROR_WRITE;
+          log->is_ready = false;
+          return 0;
+     }
+
+     log->tail_offset += total_size;
+     return (int)log->next_id++;
+}
+
+static int log_retrieve(audit_log* log, uair_io_context* ctx, int id, void* data)
+{
+     audit_reset_ctx(ctx);
+
+     if (!data || !audit_ready(log, ctx)) return 0;
+
+     flash_address_t address;
+     audit_record_header header;
+     uint8_t record_data[UAIR_IO_AUDIT_MAX_SIZE];
+
+     if (!audit_locate(log, ctx, id, &address, &header, record_data))
+          return 0;
+
+     if (!(header.flags & AUDIT_RECORD_FLAG_LIVE))
+     {
+          ctx->error = (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_UNKNOWN_ID;
+          return 0;
+     }
+
+     memcpy(data, record_data, header.size);
+     return header.size;
+}
+
+static void log_dispose(audit_log* log, uair_io_context* ctx, int id)
+{
+     audit_reset_ctx(ctx);
+
+     if (!audit_ready(log, ctx)) return;
+
+     flash_address_t address;
+     audit_record_header header;
+     uint8_t data[UAIR_IO_AUDIT_MAX_SIZE];
+
+     if (!audit_locate(log, ctx, id, &address, &header, data))
+          return;
+
+     if (!(header.flags & AUDIT_RECORD_FLAG_LIVE))
+          return;
+
+     header.flags &= (uint8_t)~AUDIT_RECORD_FLAG_LIVE;
+     if (UAIR_BSP_flash_audit_area_write(address, (const uint64_t*)&header, 1) != 1)
+     {
+          ctx->error = UAIR_IO_CONTEXT_ERROR_WRITE;
+          log->is_ready = false;
+     }
+}
+
+static int log_iter_begin(audit_log* log, uair_io_context* ctx)
+{
+     audit_reset_ctx(ctx);
+
+     if (!audit_ready(log, ctx) || log->is_empty) return 0;
+
+     return audit_find_live(log, ctx, page_address(log, log->head_page) + sizeof(audit_page_header), log->head_first_id);
+}
+
+static int log_iter_next(audit_log* log, uair_io_context* ctx, int previous_id)
+{
+     audit_reset_ctx(ctx);
+
+     if (!audit_ready(log, ctx)) return 0;
+
+     flash_address_t address;
+     audit_record_header header;
+     uint8_t data[UAIR_IO_AUDIT_MAX_SIZE];
+
+     if (!audit_locate(log, ctx, previous_id, &address, &header, data))
+          return 0;
+
+     return audit_find_live(log, ctx, address + record_total_size(header.size), (uint32_t)previous_id + 1);
+}
+
+void UAIR_io_audit_init(uair_io_context* ctx)
+{
+     if (!ctx) return;
+     log_init(&s_audit, ctx);
+}
 
 int UAIR_io_audit_add(uair_io_context* ctx, const void* data, int size)
 {
      if (!ctx) return 0;
-     return 0;
+     return log_add(&s_audit, ctx, data, size);
 }
 
 int UAIR_io_audit_retrieve(uair_io_context* ctx, int id, void* data)
 {
      if (!ctx) return 0;
-     return 0;
+     return log_retrieve(&s_audit, ctx, id, data);
 }
 
 void UAIR_io_audit_dispose(uair_io_context* ctx, int id)
 {
      if (!ctx) return;
+     log_dispose(&s_audit, ctx, id);
 }
 
 int UAIR_io_audit_iter_begin(uair_io_context* ctx)
 {
      if (!ctx) return 0;
-     return 0;
+     return log_iter_begin(&s_audit, ctx);
 }
 
 int UAIR_io_audit_iter_next(uair_io_context* ctx, int previous_id)
 {
      if (!ctx) return 0;
-     return 0;
-}
\ No newline at end of file
+     return log_iter_next(&s_audit, ctx, previous_id);
+}
+
+void UAIR_io_queue_init(uair_io_context* ctx)
+{
+     if (!ctx) return;
+     log_init(&s_queue, ctx);
+}
+
+int UAIR_io_queue_push(uair_io_context* ctx, const void* data, int size)
+{
+     if (!ctx) return 0;
+     return log_add(&s_queue, ctx, data, size);
+}
+
+int UAIR_io_queue_peek(uair_io_context* ctx)
+{
+     if (!ctx) return 0;
+     return log_iter_begin(&s_queue, ctx);
+}
+
+int UAIR_io_queue_pack(uair_io_context* ctx, uint8_t* frame, int max_size, int* last_id)
+{
+     uint8_t data[UAIR_IO_QUEUE_MAX_SIZE];
+     int frame_size = 1;
+     int count = 0;
+
+     if (!ctx) return 0;
+     if (!frame || !last_id || (max_size <= 0))
+     {
+          audit_reset_ctx(ctx);
+          ctx->error = (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_SIZE;
+          return 0;
+     }
+
+     *last_id = 0;
+
+     /* oldest first, the count has to fit a byte */
+     for (int id = log_iter_begin(&s_queue, ctx); (id != 0) && (count < UINT8_MAX); id = log_iter_next(&s_queue, ctx, id))
+     {
+          int size = log_retrieve(&s_queue, ctx, id, data);
+          if ((size == 0) || (frame_size + 1 + size > max_size))
+               break;
+
+          frame[frame_size++] = (uint8_t)size;
+          memcpy(&frame[frame_size], data, size);
+          frame_size += size;
+          count++;
+          *last_id = id;
+     }
+
+     if (ctx->error != UAIR_IO_CONTEXT_ERROR_NONE)
+     {
+          *last_id = 0;
+          return 0;
+     }
+
+     if (count == 0)
+          return 0;
+
+     frame[0] = (uint8_t)count;
+     return frame_size;
+}
+
+void UAIR_io_queue_dispose(uair_io_context* ctx, int last_id)
+{
+     if (!ctx) return;
+
+     for (int id = log_iter_begin(&s_queue, ctx); (id != 0) && (id <= last_id); id = log_iter_next(&s_queue, ctx, id))
+     {
+          log_dispose(&s_queue, ctx, id);
+          if (ctx->error != UAIR_IO_CONTEXT_ERROR_NONE)
+               return;
+     }
+}
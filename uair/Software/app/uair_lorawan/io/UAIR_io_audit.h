@@ -10,22 +10,79 @@
 extern "C" {
 #endif
 
+/** Largest record that can be added to the audit log */
+#define UAIR_IO_AUDIT_MAX_SIZE 255
+
 /* UAIR io context audit extended errors */
 typedef enum {
     /* Error: the ID provided is invalid */
     UAIR_IO_AUDIT_ERROR_INVALID_ID = UAIR_IO_CONTEXT_ERROR_EXT_BASE + 0,
     /* Error: there's no audit data associated with the ID */
     UAIR_IO_AUDIT_ERROR_UNKNOWN_ID = UAIR_IO_CONTEXT_ERROR_EXT_BASE + 1,
+    /* Error: the record is empty or larger than UAIR_IO_AUDIT_MAX_SIZE */
+    UAIR_IO_AUDIT_ERROR_INVALID_SIZE = UAIR_IO_CONTEXT_ERROR_EXT_BASE + 2,
 } uair_io_context_audit_errors;
 
+/**
+ * Recovers the head and tail of the audit log.
+ *
+ * Only the page headers and the records of the newest page are read. Any other call
+ * does this on first use, so this is only needed at boot or after the audit area was
+ * changed behind this API (e.g. pages erased directly).
+ *
+ * @param ctx the IO context
+ */
+void UAIR_io_audit_init(uair_io_context* ctx);
 
+/**
+ * Appends a record to the audit log.
+ *
+ * The log is circular: once its pages are full, the page holding the oldest records
+ * is erased to make room. The last pages of the audit area hold the uplink queue
+ * (see UAIR_io_queue.h) and are never taken.
+ *
+ * @param ctx the IO context
+ * @param data the record
+ * @param size the size of the record, up to UAIR_IO_AUDIT_MAX_SIZE
+ * @return the ID of the record (a sequence number starting at 1), 0 on error
+ */
 int UAIR_io_audit_add(uair_io_context* ctx, const void* data, int size);
 
+/**
+ * Reads a record from the audit log.
+ *
+ * @param ctx the IO context
+ * @param id the ID of the record
+ * @param data where to copy the record, must hold UAIR_IO_AUDIT_MAX_SIZE bytes
+ * @return the size of the record, 0 on error
+ */
 int UAIR_io_audit_retrieve(uair_io_context* ctx, int id, void* data);
 
+/**
+ * Marks a record as handled, it won't be retrieved or iterated anymore.
+ *
+ * @param ctx the IO context
+ * @param id the ID of the record
+ */
 void UAIR_io_audit_dispose(uair_io_context* ctx, int id);
 
+/**
+ * Returns the oldest record not disposed of.
+ *
+ * @param ctx the IO context
+ * @return the ID of the record, 0 if there's none
+ */
 int UAIR_io_audit_iter_begin(uair_io_context* ctx);
+
+/**
+ * Returns the next record not disposed of.
+ *
+ * Iterating in order is O(1) per record.
+ *
+ * @param ctx the IO context
+ * @param previous_id the ID returned by the previous call
+ * @return the ID of the record, 0 if there's none
+ */
 int UAIR_io_audit_iter_next(uair_io_context* ctx, int previous_id);
 
 #ifdef __cplusplus
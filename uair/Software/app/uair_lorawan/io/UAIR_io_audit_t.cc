@@ -0,0 +1,163 @@
+#include "UAIR_io_audit.h"
+#include "UAIR_io_queue.h"
+
+#include <UAIR_BSP_flash.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("UAIR IO audit", "[BSP][BSP app][BSP IO][BSP audit]")
+{
+	auto area_page_count = UAIR_BSP_flash_audit_area_get_page_count();
+	REQUIRE(area_page_count >= UAIR_IO_QUEUE_NUM_PAGES + 2);
+
+	//the queue keeps the last pages
+	auto page_count = area_page_count - UAIR_IO_QUEUE_NUM_PAGES;
+	INFO("Audit page count: " << page_count);
+
+	for (decltype(area_page_count) page_index = 0; page_index < area_page_count; page_index++)
+		UAIR_BSP_flash_audit_area_erase_page(page_index);
+
+	uair_io_context ctx;
+	UAIR_io_init_ctx(&ctx);
+	UAIR_io_audit_init(&ctx);
+	REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+	std::array<uint8_t, UAIR_IO_AUDIT_MAX_SIZE> data;
+
+	SECTION("empty log")
+	{
+		REQUIRE(UAIR_io_audit_iter_begin(&ctx) == 0);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, 1, data.data()) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_ID);
+
+		REQUIRE(UAIR_io_audit_add(&ctx, data.data(), 0) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_SIZE);
+		REQUIRE(UAIR_io_audit_add(&ctx, data.data(), UAIR_IO_AUDIT_MAX_SIZE + 1) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_SIZE);
+	}
+
+	SECTION("add, retrieve and dispose")
+	{
+		for (int i = 1; i <= 10; i++)
+		{
+			std::vector<uint8_t> record(i, static_cast<uint8_t>(i));
+			REQUIRE(UAIR_io_audit_add(&ctx, record.data(), i) == i);
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		}
+
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, 7, data.data()) == 7);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		for (int i = 0; i < 7; i++)
+			REQUIRE(data[i] == 7);
+
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, 11, data.data()) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_ID);
+
+		UAIR_io_audit_dispose(&ctx, 1);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		UAIR_io_audit_dispose(&ctx, 5);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, 5, data.data()) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_UNKNOWN_ID);
+
+		auto iterate = [&ctx]()
+		{
+			std::vector<int> ids;
+			for (int id = UAIR_io_audit_iter_begin(&ctx); id != 0; id = UAIR_io_audit_iter_next(&ctx, id))
+				ids.push_back(id);
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+			return ids;
+		};
+
+		std::vector<int> expected{ 2, 3, 4, 6, 7, 8, 9, 10 };
+		REQUIRE(iterate() == expected);
+
+		//recovered from flash, IDs carry on
+		UAIR_io_audit_init(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(iterate() == expected);
+
+		uint8_t value = 42;
+		REQUIRE(UAIR_io_audit_add(&ctx, &value, sizeof(value)) == 11);
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, 11, data.data()) == 1);
+		REQUIRE(data[0] == 42);
+	}
+
+	SECTION("oldest pages are dropped when the log wraps around")
+	{
+		//16 bytes per record, a few times around the ring
+		int num_records = static_cast<int>((page_count * BSP_FLASH_PAGE_SIZE / 16) * 3);
+		for (int i = 1; i <= num_records; i++)
+		{
+			uint32_t value = static_cast<uint32_t>(i);
+			REQUIRE(UAIR_io_audit_add(&ctx, &value, sizeof(value)) == i);
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		}
+
+		int oldest = UAIR_io_audit_iter_begin(&ctx);
+		REQUIRE(oldest > 1);
+
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, oldest - 1, data.data()) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_UNKNOWN_ID);
+
+		//all the pages but the one being erased are kept
+		int count = 0;
+		int last = 0;
+		for (int id = oldest; id != 0; id = UAIR_io_audit_iter_next(&ctx, id))
+		{
+			uint32_t value;
+			REQUIRE(UAIR_io_audit_retrieve(&ctx, id, data.data()) == sizeof(value));
+			std::memcpy(&value, data.data(), sizeof(value));
+			REQUIRE(value == static_cast<uint32_t>(id));
+			REQUIRE(id == ((last == 0) ? oldest : (last + 1)));
+			last = id;
+			count++;
+		}
+		REQUIRE(last == num_records);
+		REQUIRE(count >= static_cast<int>((page_count - 1) * ((BSP_FLASH_PAGE_SIZE - 8) / 16)));
+
+		UAIR_io_audit_init(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(UAIR_io_audit_iter_begin(&ctx) == oldest);
+
+		uint32_t value = 0;
+		REQUIRE(UAIR_io_audit_add(&ctx, &value, sizeof(value)) == (num_records + 1));
+	}
+
+	SECTION("torn record ends its page")
+	{
+		uint8_t value = 1;
+		for (int i = 1; i <= 3; i++)
+			REQUIRE(UAIR_io_audit_add(&ctx, &value, sizeof(value)) == i);
+
+		//a record header for ID 4 without its data, after the page header and 3 records
+		uint64_t torn = 0xFFFFFFFF00000004ULL;
+		REQUIRE(UAIR_BSP_flash_audit_area_write(8 + (3 * 16), &torn, 1) == 1);
+
+		UAIR_io_audit_init(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, 4, data.data()) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_ID);
+
+		REQUIRE(UAIR_io_audit_add(&ctx, &value, sizeof(value)) == 4);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		std::vector<int> ids;
+		for (int id = UAIR_io_audit_iter_begin(&ctx); id != 0; id = UAIR_io_audit_iter_next(&ctx, id))
+			ids.push_back(id);
+		REQUIRE(ids == std::vector<int>{ 1, 2, 3, 4 });
+
+		UAIR_io_audit_init(&ctx);
+		REQUIRE(UAIR_io_audit_retrieve(&ctx, 4, data.data()) == 1);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+	}
+}
@@ -1,9 +1,10 @@
 #include "UAIR_io_config.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
-#include <functional>
+#include <iterator>
 #include <limits>
 
 #include "UAIR_BSP_flash.h"
@@ -79,7 +80,45 @@ namespace
           }
      };
 
-     bool pages_iterate(const std::function<bool(const PageHeader& page_header, flash_page_t page_index)>& cb, bool ignore_unused = true)
+     constexpr size_t READ_CHUNK_SIZE = 256; //bytes of a page read from the flash at once
+
+     /**
+      * Reads entry headers through a buffer, instead of one flash read per header.
+      *
+      * The buffer is not invalidated by writes, so it must only be used on pages that
+      * aren't written while reading them.
+      */
+     class EntryReader
+     {
+     public:
+          bool read(flash_address_t address, EntryHeader& header)
+          {
+               if ((address < m_start) || ((address + sizeof(EntryHeader)) > (m_start + m_size)))
+               {
+                    //never read past the end of the page
+                    auto page_end = ((address / BSP_FLASH_PAGE_SIZE) + 1) * BSP_FLASH_PAGE_SIZE;
+                    auto size = std::min<size_t>(READ_CHUNK_SIZE, page_end - address);
+
+                    m_size = 0;
+                    if (UAIR_BSP_flash_config_area_read(address, reinterpret_cast<uint8_t*>(m_buffer), size) != (int)size)
+                         return false;
+
+                    m_start = address;
+                    m_size = size;
+               }
+
+               memcpy(&header, reinterpret_cast<const uint8_t*>(m_buffer) + (address - m_start), sizeof(EntryHeader));
+               return true;
+          }
+
+     private:
+          uint64_t m_buffer[READ_CHUNK_SIZE / sizeof(uint64_t)];
+          flash_address_t m_start = 0;
+          size_t m_size = 0;
+     };
+
+     template<class TCallback>
+     bool pages_iterate(TCallback&& cb, bool ignore_unused = true)
      {
           PageHeader page_header;
 
@@ -98,17 +137,19 @@ namespace
           return true;
      }
 
-     bool entries_iterate(flash_page_t target_page_index, const std::function<bool(const EntryInfo& entry_info)>& cb)
+     template<class TCallback>
+     bool entries_iterate(flash_page_t target_page_index, TCallback&& cb)
      {
           assert((target_page_index >= 0) && (target_page_index < UAIR_BSP_flash_config_area_get_page_count()));
 
           auto page_address = (static_cast<flash_address_t>(target_page_index) * BSP_FLASH_PAGE_SIZE) + sizeof(PageHeader);
           auto page_address_end = page_address + BSP_FLASH_PAGE_SIZE - sizeof(PageHeader);
 
+          EntryReader reader;
           while (page_address < page_address_end)
           {
                EntryHeader header;
-               if (UAIR_BSP_flash_config_area_read(page_address, reinterpret_cast<uint8_t*>(&header), sizeof(EntryHeader)) != sizeof(EntryHeader))
+               if (!reader.read(page_address, header))
                     return false;
 
                if (header.is_unused)
@@ -126,42 +167,177 @@ namespace
           return true;
      }
 
-     bool entries_iterate(const std::function<bool(const EntryInfo& entry_info)>& cb)
+     /**
+      * In-RAM index of the config area, so that finding a key doesn't walk the flash.
+      *
+      * Built with a single scan on first use (or UAIR_io_config_init()) and kept up to
+      * date by every write, remove and flush. Any failed flash operation drops it, so
+      * that it's rebuilt from what actually made it to the flash.
+      */
+     constexpr uint16_t INDEX_NO_ENTRY = 0xFFFF;
+     constexpr size_t INDEX_MAX_PAGES = 4;
+
+     struct PageStats
+     {
+          uint16_t live_size; //bytes used by valid entries
+          uint16_t dead_size; //bytes used by invalidated entries
+          uint16_t end; //offset of the first unused byte, 0 if the page is unused
+     };
+
+     struct
+     {
+          bool is_built = false;
+          size_t num_keys = 0;
+          uint16_t keys[std::numeric_limits<uint8_t>::max() + 1]; //config area address of each valid key
+          PageStats pages[INDEX_MAX_PAGES];
+     } s_index;
+
+     //incremental compaction in progress, see UAIR_io_config_gc_step()
+     struct
+     {
+          bool is_active = false;
+          flash_page_t page_source = 0;
+          flash_page_t page_dest = 0;
+          flash_address_t cursor = 0; //next entry of the source page to look at
+     } s_gc;
+
+     bool index_build(uair_io_context& ctx)
      {
-          pages_iterate([&cb](const PageHeader&, flash_page_t page_index)
+          auto num_pages = UAIR_BSP_flash_config_area_get_page_count();
+          assert((num_pages * BSP_FLASH_PAGE_SIZE) < INDEX_NO_ENTRY);
+
+          s_index.is_built = false;
+          s_gc.is_active = false;
+          if (num_pages > INDEX_MAX_PAGES)
           {
-               if (!entries_iterate(page_index, cb))
-                    return false; //something went wrong
+               ctx.error = UAIR_IO_CONTEXT_ERROR_INTERNAL;
+               return false;
+          }
+
+          s_index.num_keys = 0;
+          std::fill(std::begin(s_index.keys), std::end(s_index.keys), INDEX_NO_ENTRY);
+          std::fill(std::begin(s_index.pages), std::end(s_index.pages), PageStats{ 0, 0, 0 });
 
-               return true; //continue to the next page
+          bool read_ok = true;
+          bool scan_ok = pages_iterate([&read_ok](const PageHeader&, flash_page_t page_index)
+          {
+               auto& page = s_index.pages[page_index];
+               page.end = sizeof(PageHeader);
+
+               read_ok = entries_iterate(page_index, [&page](const EntryInfo& entry_info)
+               {
+                    auto entry_size = EntryHeader::total_size(entry_info.header.type);
+
+                    if (entry_info.header.is_valid)
+                    {
+                         page.live_size += entry_size;
+
+                         //the first one found wins, as it always did
+                         if (s_index.keys[entry_info.header.id] == INDEX_NO_ENTRY)
+                         {
+                              s_index.keys[entry_info.header.id] = static_cast<uint16_t>(entry_info.page_address);
+                              s_index.num_keys++;
+                         }
+                    }
+                    else
+                         page.dead_size += entry_size;
+
+                    page.end = static_cast<uint16_t>((entry_info.page_address % BSP_FLASH_PAGE_SIZE) + entry_size);
+                    return true;
+               });
+
+               return read_ok;
           });
 
+          if (!scan_ok || !read_ok)
+          {
+               ctx.error = UAIR_IO_CONTEXT_ERROR_READ;
+               return false;
+          }
+
+          s_index.is_built = true;
           return true;
      }
 
-     void entries_find_key(uair_io_context& ctx, uair_io_context_keys key_id, EntryType key_type, EntryInfo& target_entry)
+     bool index_ready(uair_io_context& ctx)
      {
-          ctx.flags = UAIR_IO_CONTEXT_FLAG_NONE;
-          ctx.error = UAIR_IO_CONTEXT_ERROR_NONE;
+          return s_index.is_built || index_build(ctx);
+     }
 
-          bool found = false;
-          entries_iterate([&found, &target_entry, &key_id](const EntryInfo& entry_info)
+     //flash may not match the index anymore
+     void index_check(const uair_io_context& ctx)
+     {
+          switch (ctx.error)
           {
-               if (!entry_info.header.is_valid) return true;
-               if (entry_info.header.id != static_cast<uint8_t>(key_id)) return true;
+          case UAIR_IO_CONTEXT_ERROR_WRITE:
+          case UAIR_IO_CONTEXT_ERROR_READ:
+          case UAIR_IO_CONTEXT_ERROR_INTERNAL:
+               s_index.is_built = false;
+               break;
+          default:
+               break;
+          }
+     }
 
-               found = true;
-               target_entry = entry_info;
+     void index_add(uint8_t id, flash_address_t address, size_t entry_size)
+     {
+          auto& page = s_index.pages[address / BSP_FLASH_PAGE_SIZE];
 
-               return false; //stop iteration
-          });
+          if (page.end == 0)
+               page.end = sizeof(PageHeader);
 
-          if (!found)
+          assert(page.end == (address % BSP_FLASH_PAGE_SIZE));
+          assert(s_index.keys[id] == INDEX_NO_ENTRY);
+
+          s_index.keys[id] = static_cast<uint16_t>(address);
+          s_index.num_keys++;
+          page.live_size += entry_size;
+          page.end += entry_size;
+     }
+
+     void index_invalidate(const EntryInfo& entry_info)
+     {
+          auto& page = s_index.pages[entry_info.page_index];
+          auto entry_size = EntryHeader::total_size(entry_info.header.type);
+
+          s_index.keys[entry_info.header.id] = INDEX_NO_ENTRY;
+          s_index.num_keys--;
+          page.live_size -= entry_size;
+          page.dead_size += entry_size;
+     }
+
+     //finds a valid key, whatever its type
+     bool index_lookup(uair_io_context& ctx, uair_io_context_keys key_id, EntryInfo& target_entry)
+     {
+          if (!index_ready(ctx))
+               return false;
+
+          auto address = s_index.keys[static_cast<uint8_t>(key_id)];
+          if (address == INDEX_NO_ENTRY)
           {
                ctx.error = static_cast<uair_io_context_errors>(UAIR_IO_CONFIG_ERROR_INVALID_KEY);
-               return;
+               return false;
+          }
+
+          if (UAIR_BSP_flash_config_area_read(address, reinterpret_cast<uint8_t*>(&target_entry.header), sizeof(EntryHeader)) != sizeof(EntryHeader))
+          {
+               ctx.error = UAIR_IO_CONTEXT_ERROR_READ;
+               return false;
           }
 
+          target_entry.page_index = static_cast<flash_page_t>(address / BSP_FLASH_PAGE_SIZE);
+          target_entry.page_address = address;
+          return true;
+     }
+
+     void entries_find_key(uair_io_context& ctx, uair_io_context_keys key_id, EntryType key_type, EntryInfo& target_entry)
+     {
+          ctx.flags = UAIR_IO_CONTEXT_FLAG_NONE;
+          ctx.error = UAIR_IO_CONTEXT_ERROR_NONE;
+
+          if (!index_lookup(ctx, key_id, target_entry))
+               return;
+
           if (target_entry.header.type != key_type)
           {
                ctx.error = static_cast<uair_io_context_errors>(UAIR_IO_CONFIG_ERROR_KEY_TYPE_MISMATCH);
@@ -353,7 +529,10 @@ namespace
 
           entry_info.header.is_valid = false;
           if (UAIR_BSP_flash_config_area_write(entry_info.page_address, (uint64_t*)&entry_info.header, 1) == 1)
+          {
+               index_invalidate(entry_info);
                return true;
+          }
 
           ctx.error = UAIR_IO_CONTEXT_ERROR_WRITE;
           return false;
@@ -366,25 +545,29 @@ namespace
 
           assert(EntryHeader::total_size(header.type) == (sizeof(EntryHeader) + extra_data_size));
 
+          if (!index_ready(ctx))
+               return false;
+
           struct
           {
                size_t num_free_pages = 0;
-               size_t num_invalidated_entries = 0;
+               size_t invalidated_size = 0;
 
                bool has_page_free = false;
                flash_page_t page_free = 0;
 
-               bool has_last_entry = false;
-               size_t last_entry_size = 0;
-               flash_page_t last_entry_page_index = 0;
-               flash_address_t last_entry_page_address = 0;
+               bool has_page_room = false;
+               flash_page_t page_room = 0;
           } page_info;
 
-          //gather information
+          //gather information (the first page with room wins)
 
-          pages_iterate([&page_info, extra_data_size](const PageHeader& page_header, flash_page_t page_index) mutable
+          auto num_pages = UAIR_BSP_flash_config_area_get_page_count();
+          for (decltype(num_pages) page_index = 0; page_index < num_pages; page_index++)
           {
-               if (page_header.is_unused)
+               const auto& page = s_index.pages[page_index];
+
+               if (page.end == 0)
                {
                     page_info.num_free_pages++;
 
@@ -394,36 +577,19 @@ namespace
                        page_info.page_free = page_index;
                     }
 
-                    return true; //next page
+                    continue; //next page
                }
 
-               entries_iterate(page_index, [&page_info](const EntryInfo& entry_info)
-               {
-                    if (!entry_info.header.is_valid)
-                         page_info.num_invalidated_entries++;
-
-                    page_info.has_last_entry = true;
-                    page_info.last_entry_size = EntryHeader::total_size(entry_info.header.type);
-                    page_info.last_entry_page_index = entry_info.page_index;
-                    page_info.last_entry_page_address = entry_info.page_address;
-
-                    return true;
-               });
-               assert(page_info.has_last_entry); //if the page is in use, it must have something
+               page_info.invalidated_size += page.dead_size;
 
                //if this page still has room, we're done
-               auto page_remaining_space = ((page_info.last_entry_page_index + 1) * BSP_FLASH_PAGE_SIZE) - (page_info.last_entry_page_address + page_info.last_entry_size);
-               if (page_remaining_space >= (sizeof(EntryHeader) + extra_data_size))
+               if ((BSP_FLASH_PAGE_SIZE - page.end) >= (sizeof(EntryHeader) + extra_data_size))
                {
-                    page_info.has_page_free = false;
-                    return false; //found where we can write
+                    page_info.has_page_room = true;
+                    page_info.page_room = page_index;
+                    break; //found where we can write
                }
-
-               //must move on to the next page
-               page_info.has_last_entry = false;
-               return true;
-
-          }, false);
+          }
 
           //helper method to write an entry header
 
@@ -478,9 +644,16 @@ namespace
                return false;
           };
 
-          //if we can write after the last entry we found
-          if (page_info.has_last_entry)
-               return write_entry_data(ctx, page_info.last_entry_page_address + page_info.last_entry_size, header, extra_data, extra_data_size);
+          //if we can write after the last entry of a page
+          if (page_info.has_page_room)
+          {
+               auto address = (static_cast<flash_address_t>(page_info.page_room) * BSP_FLASH_PAGE_SIZE) + s_index.pages[page_info.page_room].end;
+               if (!write_entry_data(ctx, address, header, extra_data, extra_data_size))
+                    return false;
+
+               index_add(header.id, address, sizeof(EntryHeader) + extra_data_size);
+               return true;
+          }
 
           //reaching this point, we have to write to a new page
 
@@ -495,7 +668,7 @@ namespace
           if (page_info.has_page_free && (page_info.num_free_pages == 1))
           {
                //if there's nothing to clean, we run out of space
-               if (page_info.num_invalidated_entries <= 0)
+               if (page_info.invalidated_size <= 0)
                {
                     ctx.error = UAIR_IO_CONTEXT_ERROR_NO_SPACE_AVAILABLE;
                     return false;
@@ -522,43 +695,234 @@ namespace
                }
           }
 
-          return write_entry_data(ctx, (page_info.page_free * BSP_FLASH_PAGE_SIZE) + sizeof(PageHeader), header, extra_data, extra_data_size);
+          auto address = (static_cast<flash_address_t>(page_info.page_free) * BSP_FLASH_PAGE_SIZE) + sizeof(PageHeader);
+          if (!write_entry_data(ctx, address, header, extra_data, extra_data_size))
+               return false;
+
+          index_add(header.id, address, sizeof(EntryHeader) + extra_data_size);
+          return true;
      }
 }
 
-uair_io_config_key_type UAIR_io_config_check_key(uair_io_context* ctx, uair_io_context_keys key)
+namespace
 {
-     if (!ctx) return UAIR_IO_CONFIG_KEY_TYPE_NOT_AVAILABLE;
+     //a page is worth an erase once this much of it is invalidated...
+     constexpr size_t GC_MIN_DEAD_SIZE = BSP_FLASH_PAGE_SIZE / 4;
+     //...or, with no free page left, as soon as anything in it is
+     constexpr size_t GC_LOW_FREE_PAGES = 0;
+
+     //the page with the most invalidated space, -1 if none is worth compacting yet
+     int16_t gc_pick_source(int16_t* page_free)
+     {
+          int16_t page_source = -1;
+          size_t source_dead_size = 0;
+          size_t num_free_pages = 0;
+
+          if (page_free)
+               *page_free = -1;
+
+          auto num_pages = UAIR_BSP_flash_config_area_get_page_count();
+          for (decltype(num_pages) page_index = 0; page_index < num_pages; page_index++)
+          {
+               const auto& page = s_index.pages[page_index];
+
+               if (page.end == 0)
+               {
+                    if (page_free && (*page_free == -1))
+                         *page_free = page_index;
+                    num_free_pages++;
+                    continue;
+               }
+
+               if (page.dead_size > source_dead_size)
+               {
+                    page_source = page_index;
+                    source_dead_size = page.dead_size;
+               }
+          }
 
-     auto key_type = UAIR_IO_CONFIG_KEY_TYPE_NOT_AVAILABLE; //doesn't exist
+          if ((source_dead_size < GC_MIN_DEAD_SIZE) && (num_free_pages > GC_LOW_FREE_PAGES))
+               return -1;
+
+          return page_source;
+     }
 
-     entries_iterate([&key_type, &key](const EntryInfo& entry_info)
+     //a page in use with room for the live entries of the source, -1 if none has
+     int16_t gc_pick_dest(int16_t page_source)
      {
-          if (!entry_info.header.is_valid) return true;
-          if (entry_info.header.id != static_cast<uint8_t>(key)) return true;
+          int16_t page_dest = -1;
+          size_t dest_live_size = std::numeric_limits<size_t>::max();
 
-          switch(entry_info.header.type)
+          auto num_pages = UAIR_BSP_flash_config_area_get_page_count();
+
+          auto source_live_size = s_index.pages[page_source].live_size;
+
+          //same as flush: prefer a page without invalidated entries and the least used
+          for (decltype(num_pages) page_index = 0; page_index < num_pages; page_index++)
           {
-          case ENTRY_TYPE_UINT8:
-               key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT8; break;
-          case ENTRY_TYPE_UINT16:
-               key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT16; break;
-          case ENTRY_TYPE_UINT32:
-               key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT32; break;
-          case ENTRY_TYPE_UINT64:
-               key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT64; break;
-          case ENTRY_TYPE_INT8:
-          case ENTRY_TYPE_INT16:
-          case ENTRY_TYPE_INT32:
-          case ENTRY_TYPE_INT64:
-          case ENTRY_TYPE_BLOB_START:
-          case ENTRY_TYPE_BLOB_MIDDLE:
-          case ENTRY_TYPE_BLOB_END:
-               assert(!"Unsupported type"); break;
+               const auto& page = s_index.pages[page_index];
+
+               if ((page.end == 0) || (page.dead_size > 0) || (static_cast<int16_t>(page_index) == page_source))
+                    continue;
+
+               if (((BSP_FLASH_PAGE_SIZE - page.end) >= source_live_size) && (page.live_size < dest_live_size))
+               {
+                    page_dest = page_index;
+                    dest_live_size = page.live_size;
+               }
           }
+          return page_dest;
+     }
 
-          return false; //stop iteration
-     });
+     //picks the page to compact, and where its live entries go
+     bool gc_begin(uair_io_context& ctx)
+     {
+          int16_t page_dest = -1;
+          int16_t page_free = -1;
+
+          int16_t page_source = gc_pick_source(&page_free);
+          if (page_source == -1)
+               return false; //nothing worth cleaning
+
+          auto source_live_size = s_index.pages[page_source].live_size;
+
+          if (source_live_size > 0)
+               page_dest = gc_pick_dest(page_source);
+
+          if ((source_live_size > 0) && (page_dest == -1))
+          {
+               if (page_free == -1)
+               {
+                    ctx.error = UAIR_IO_CONTEXT_ERROR_FLUSH_NO_FREE_PAGE;
+                    return false;
+               }
+
+               PageHeader page_header;
+               page_header.is_unused = false;
+               page_header.reserved = 0x7FFFFFFFFFFFFFF;
+
+               if (UAIR_BSP_flash_config_area_write(page_free * BSP_FLASH_PAGE_SIZE, (uint64_t*)&page_header, 1) != 1)
+               {
+                    ctx.error = UAIR_IO_CONTEXT_ERROR_WRITE;
+                    return false;
+               }
+
+               s_index.pages[page_free].end = sizeof(PageHeader);
+               page_dest = page_free;
+          }
+
+          s_gc.is_active = true;
+          s_gc.page_source = page_source;
+          s_gc.page_dest = (page_dest == -1) ? page_source : page_dest;
+          s_gc.cursor = (static_cast<flash_address_t>(page_source) * BSP_FLASH_PAGE_SIZE) + sizeof(PageHeader);
+          return true;
+     }
+
+     //moves the next live entry of the source page, returns false once there's none left
+     bool gc_move_entry(uair_io_context& ctx)
+     {
+          auto& source = s_index.pages[s_gc.page_source];
+          auto& dest = s_index.pages[s_gc.page_dest];
+          auto source_end = (static_cast<flash_address_t>(s_gc.page_source) * BSP_FLASH_PAGE_SIZE) + source.end;
+
+          while (s_gc.cursor < source_end)
+          {
+               auto address = s_gc.cursor;
+
+               EntryHeader header;
+               if (UAIR_BSP_flash_config_area_read(address, reinterpret_cast<uint8_t*>(&header), sizeof(EntryHeader)) != sizeof(EntryHeader))
+               {
+                    ctx.error = UAIR_IO_CONTEXT_ERROR_READ;
+                    return false;
+               }
+
+               auto entry_size = EntryHeader::total_size(header.type);
+               s_gc.cursor += entry_size;
+
+               if (!header.is_valid)
+                    continue;
+
+               //a stale copy (the index points elsewhere) is only invalidated
+               bool is_indexed = (s_index.keys[header.id] == address);
+               auto dest_address = (static_cast<flash_address_t>(s_gc.page_dest) * BSP_FLASH_PAGE_SIZE) + dest.end;
+
+               if (is_indexed)
+               {
+                    //writes since gc_begin() may have taken the room
+                    if ((BSP_FLASH_PAGE_SIZE - dest.end) < entry_size)
+                    {
+                         s_gc.is_active = false;
+                         return false;
+                    }
+
+                    if (!entry_copy(ctx, address, dest_address, header))
+                         return false;
+
+                    s_index.keys[header.id] = static_cast<uint16_t>(dest_address);
+                    dest.live_size += entry_size;
+                    dest.end += entry_size;
+               }
+
+               //the source entry must not come back to life if the erase never happens
+               header.is_valid = false;
+               if (UAIR_BSP_flash_config_area_write(address, (uint64_t*)&header, 1) != 1)
+               {
+                    ctx.error = UAIR_IO_CONTEXT_ERROR_WRITE;
+                    return false;
+               }
+
+               source.live_size -= entry_size;
+               source.dead_size += entry_size;
+               return true;
+          }
+
+          return false;
+     }
+}
+
+void UAIR_io_config_init(uair_io_context* ctx)
+{
+     if (!ctx) return;
+
+     ctx->flags = UAIR_IO_CONTEXT_FLAG_NONE;
+     ctx->error = UAIR_IO_CONTEXT_ERROR_NONE;
+
+     index_build(*ctx);
+}
+
+uair_io_config_key_type UAIR_io_config_check_key(uair_io_context* ctx, uair_io_context_keys key)
+{
+     if (!ctx) return UAIR_IO_CONFIG_KEY_TYPE_NOT_AVAILABLE;
+
+     //the lookup errors only mean the key isn't available
+     uair_io_context lookup_ctx;
+     UAIR_io_init_ctx(&lookup_ctx);
+
+     EntryInfo entry_info;
+     if (!index_lookup(lookup_ctx, key, entry_info))
+          return UAIR_IO_CONFIG_KEY_TYPE_NOT_AVAILABLE; //doesn't exist
+
+     auto key_type = UAIR_IO_CONFIG_KEY_TYPE_NOT_AVAILABLE;
+
+     switch(entry_info.header.type)
+     {
+     case ENTRY_TYPE_UINT8:
+          key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT8; break;
+     case ENTRY_TYPE_UINT16:
+          key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT16; break;
+     case ENTRY_TYPE_UINT32:
+          key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT32; break;
+     case ENTRY_TYPE_UINT64:
+          key_type = UAIR_IO_CONFIG_KEY_TYPE_UINT64; break;
+     case ENTRY_TYPE_INT8:
+     case ENTRY_TYPE_INT16:
+     case ENTRY_TYPE_INT32:
+     case ENTRY_TYPE_INT64:
+     case ENTRY_TYPE_BLOB_START:
+     case ENTRY_TYPE_BLOB_MIDDLE:
+     case ENTRY_TYPE_BLOB_END:
+          assert(!"Unsupported type"); break;
+     }
 
      return key_type;
 }
@@ -574,34 +938,25 @@ void UAIR_io_config_stats(uair_io_context* ctx, size_t* num_keys, size_t* used_s
           size_t recyclable_space = 0;
      } info;
 
-     pages_iterate([&info](const PageHeader& page_header, flash_page_t page_index)
+     if (!index_ready(*ctx)) return;
+
+     info.num_keys = s_index.num_keys;
+
+     auto num_pages = UAIR_BSP_flash_config_area_get_page_count();
+     for (decltype(num_pages) page_index = 0; page_index < num_pages; page_index++)
      {
-          if (page_header.is_unused)
+          const auto& page = s_index.pages[page_index];
+
+          if (page.end == 0)
           {
                info.free_space += BSP_FLASH_PAGE_SIZE - sizeof(PageHeader);
-               return true;
+               continue;
           }
 
-          size_t last_page_address = 0;
-          entries_iterate(page_index, [&info, &last_page_address](const EntryInfo& entry_info) mutable
-          {
-               auto entry_size = EntryHeader::total_size(entry_info.header.type);
-
-               if (entry_info.header.is_valid)
-                    info.num_keys++;
-               else
-                    info.recyclable_space += entry_size;
-
-               info.used_space += entry_size;
-               last_page_address = entry_info.page_address + entry_size;
-
-               return true;
-          });
-
-          info.free_space += ((page_index + 1) * BSP_FLASH_PAGE_SIZE) - last_page_address;
-
-          return true;
-     });
+          info.used_space += page.live_size + page.dead_size;
+          info.recyclable_space += page.dead_size;
+          info.free_space += BSP_FLASH_PAGE_SIZE - page.end;
+     }
 
      if (num_keys) *num_keys = info.num_keys;
      if (used_space) *used_space = info.used_space;
@@ -680,10 +1035,10 @@ void UAIR_io_config_write_uint8(uair_io_context* ctx, uair_io_context_keys key,
      header.data.ui8 = in;
 
      bool replaced;
-     if (!entry_replace_or_invalidate(*ctx, header, nullptr, 0, replaced) || replaced)
-          return;
+     if (entry_replace_or_invalidate(*ctx, header, nullptr, 0, replaced) && !replaced)
+          entries_write_entry(*ctx, header, nullptr, 0);
 
-     entries_write_entry(*ctx, header, nullptr, 0);
+     index_check(*ctx);
 }
 
 void UAIR_io_config_write_uint16(uair_io_context* ctx, uair_io_context_keys key, const uint16_t in)
@@ -699,10 +1054,10 @@ void UAIR_io_config_write_uint16(uair_io_context* ctx, uair_io_context_keys key,
      header.data.ui16 = in;
 
      bool replaced;
-     if (!entry_replace_or_invalidate(*ctx, header, nullptr, 0, replaced) || replaced)
-          return;
+     if (entry_replace_or_invalidate(*ctx, header, nullptr, 0, replaced) && !replaced)
+          entries_write_entry(*ctx, header, nullptr, 0);
 
-     entries_write_entry(*ctx, header, nullptr, 0);
+     index_check(*ctx);
 }
 
 void UAIR_io_config_write_uint32(uair_io_context* ctx, uair_io_context_keys key, const uint32_t in)
@@ -718,10 +1073,10 @@ void UAIR_io_config_write_uint32(uair_io_context* ctx, uair_io_context_keys key,
      header.data.ui32 = in;
 
      bool replaced;
-     if (!entry_replace_or_invalidate(*ctx, header, nullptr, 0, replaced) || replaced)
-          return;
+     if (entry_replace_or_invalidate(*ctx, header, nullptr, 0, replaced) && !replaced)
+          entries_write_entry(*ctx, header, nullptr, 0);
 
-     entries_write_entry(*ctx, header, nullptr, 0);
+     index_check(*ctx);
 }
 
 void UAIR_io_config_write_uint64(uair_io_context* ctx, uair_io_context_keys key, const uint64_t in)
@@ -737,10 +1092,10 @@ void UAIR_io_config_write_uint64(uair_io_context* ctx, uair_io_context_keys key,
      header.data.ui32 = 0xFFFFFFFF;
 
      bool replaced;
-     if (!entry_replace_or_invalidate(*ctx, header, &in, sizeof(uint64_t), replaced) || replaced)
-          return;
+     if (entry_replace_or_invalidate(*ctx, header, &in, sizeof(uint64_t), replaced) && !replaced)
+          entries_write_entry(*ctx, header, &in, sizeof(uint64_t));
 
-     entries_write_entry(*ctx, header, &in, sizeof(uint64_t));
+     index_check(*ctx);
 }
 
 void UAIR_io_config_write_blob(uair_io_context* ctx, uair_io_context_keys key, const void* in, size_t in_size)
@@ -775,7 +1130,13 @@ void UAIR_io_config_remove(uair_io_context* ctx, uair_io_context_keys key)
      //invalidate entry
      entry_info.header.is_valid = false;
      if (UAIR_BSP_flash_config_area_write(entry_info.page_address, (uint64_t*)&entry_info.header, 1) != 1)
+     {
           ctx->error = UAIR_IO_CONTEXT_ERROR_WRITE;
+          index_check(*ctx);
+          return;
+     }
+
+     index_invalidate(entry_info);
 }
 
 void UAIR_io_config_flush(uair_io_context* ctx)
@@ -784,6 +1145,9 @@ void UAIR_io_config_flush(uair_io_context* ctx)
      ctx->flags = UAIR_IO_CONTEXT_FLAG_NONE;
      ctx->error = UAIR_IO_CONTEXT_ERROR_NONE;
 
+     //the pages are picked again from scratch
+     s_gc.is_active = false;
+
      //collect some stats
 
      struct
@@ -798,36 +1162,22 @@ void UAIR_io_config_flush(uair_io_context* ctx)
           size_t page_defrag_used_size = std::numeric_limits<size_t>::max();
      } stats;
 
-     pages_iterate([&stats](const PageHeader& page_header, flash_page_t page_index) mutable
+     if (!index_ready(*ctx)) return;
+
+     auto num_pages = UAIR_BSP_flash_config_area_get_page_count();
+     for (decltype(num_pages) page_index = 0; page_index < num_pages; page_index++)
      {
-          if (page_header.is_unused)
+          const auto& page = s_index.pages[page_index];
+
+          if (page.end == 0)
           {
                if (stats.page_free == -1)
                   stats.page_free = page_index;
 
-               return true;
+               continue;
           }
 
-          auto page_address = (static_cast<flash_address_t>(page_index) * BSP_FLASH_PAGE_SIZE) + sizeof(PageHeader);
-          auto page_address_end = page_address + BSP_FLASH_PAGE_SIZE - sizeof(PageHeader);
-
-          size_t size_used = 0, size_deleted = 0;
-          while (page_address < page_address_end)
-          {
-               EntryHeader header;
-               if (UAIR_BSP_flash_config_area_read(page_address, reinterpret_cast<uint8_t*>(&header), sizeof(EntryHeader)) != sizeof(EntryHeader))
-                    return false;
-
-               if (header.is_unused)
-                    break; //no more entries written
-
-               if (!header.is_valid)
-                    size_deleted += EntryHeader::total_size(header.type);
-               else
-                    size_used += EntryHeader::total_size(header.type);
-
-               page_address += EntryHeader::total_size(header.type);
-          }
+          size_t size_used = page.live_size, size_deleted = page.dead_size;
 
           //pick the best one to clean (with the most delete entries)
           if ((size_deleted > 0) && (size_deleted > stats.page_to_clean_delete_size))
@@ -843,10 +1193,7 @@ void UAIR_io_config_flush(uair_io_context* ctx)
                stats.page_defrag = page_index;
                stats.page_defrag_used_size = size_used;
           }
-
-          return true;
-
-     }, false);
+     }
 
      //there's nothing to clean (assume success)
      if (stats.page_to_clean == -1)
@@ -861,14 +1208,18 @@ void UAIR_io_config_flush(uair_io_context* ctx)
           auto dst_begin = (static_cast<flash_address_t>(stats.page_defrag) * BSP_FLASH_PAGE_SIZE) + sizeof(PageHeader) + stats.page_defrag_used_size;
           auto dst_end = (static_cast<flash_address_t>(stats.page_defrag) * BSP_FLASH_PAGE_SIZE) + BSP_FLASH_PAGE_SIZE;
 
+          EntryReader reader;
           while (src_begin < src_end)
           {
                assert(src_begin < src_end);
                assert(dst_begin < dst_end);
 
                EntryHeader header;
-               if (UAIR_BSP_flash_config_area_read(src_begin, reinterpret_cast<uint8_t*>(&header), sizeof(EntryHeader)) != sizeof(EntryHeader))
+               if (!reader.read(src_begin, header))
+               {
+                    s_index.is_built = false;
                     return;
+               }
 
                if (header.is_unused)
                     break; //no more entries to read
@@ -877,7 +1228,13 @@ void UAIR_io_config_flush(uair_io_context* ctx)
                {
                     //copy entry
                     if (!entry_copy(*ctx, src_begin, dst_begin, header))
+                    {
+                         index_check(*ctx);
                          return; //something went wrong
+                    }
+
+                    if (s_index.keys[header.id] == src_begin)
+                         s_index.keys[header.id] = static_cast<uint16_t>(dst_begin);
 
                     dst_begin += EntryHeader::total_size(header.type);
                }
@@ -890,8 +1247,13 @@ void UAIR_io_config_flush(uair_io_context* ctx)
           if (UAIR_BSP_flash_config_area_erase_page(stats.page_to_clean) != BSP_ERROR_NONE)
           {
                ctx->error = UAIR_IO_CONTEXT_ERROR_INTERNAL;
+               index_check(*ctx);
                return;
           }
+
+          s_index.pages[stats.page_defrag].live_size += stats.page_to_clean_used_size;
+          s_index.pages[stats.page_defrag].end = static_cast<uint16_t>(dst_begin - (static_cast<flash_address_t>(stats.page_defrag) * BSP_FLASH_PAGE_SIZE));
+          s_index.pages[stats.page_to_clean] = PageStats{ 0, 0, 0 };
      }
      else
      {
@@ -914,6 +1276,7 @@ void UAIR_io_config_flush(uair_io_context* ctx)
                if (UAIR_BSP_flash_config_area_write(dst_begin, (uint64_t*)&page_header, 1) != 1)
                {
                     ctx->error = UAIR_IO_CONTEXT_ERROR_WRITE;
+                    index_check(*ctx);
                     return;
                }
 
@@ -925,15 +1288,17 @@ void UAIR_io_config_flush(uair_io_context* ctx)
           auto src_begin = (static_cast<flash_address_t>(stats.page_to_clean) * BSP_FLASH_PAGE_SIZE) + sizeof(PageHeader);
           auto src_end = src_begin + BSP_FLASH_PAGE_SIZE - sizeof(PageHeader);
 
+          EntryReader reader;
           while (src_begin < src_end)
           {
                assert(src_begin < src_end);
                assert(dst_begin < dst_end);
 
                EntryHeader header;
-               if (UAIR_BSP_flash_config_area_read(src_begin, reinterpret_cast<uint8_t*>(&header), sizeof(EntryHeader)) != sizeof(EntryHeader))
+               if (!reader.read(src_begin, header))
                {
                     ctx->error = UAIR_IO_CONTEXT_ERROR_READ;
+                    index_check(*ctx);
                     return;
                }
 
@@ -946,7 +1311,13 @@ void UAIR_io_config_flush(uair_io_context* ctx)
                {
                     //copy entry
                     if (!entry_copy(*ctx, src_begin, dst_begin, header))
+                    {
+                         index_check(*ctx);
                          return; //something went wrong
+                    }
+
+                    if (s_index.keys[header.id] == src_begin)
+                         s_index.keys[header.id] = static_cast<uint16_t>(dst_begin);
 
                     dst_begin += EntryHeader::total_size(header.type);
                }
@@ -959,11 +1330,81 @@ void UAIR_io_config_flush(uair_io_context* ctx)
           if (UAIR_BSP_flash_config_area_erase_page(stats.page_to_clean) != BSP_ERROR_NONE)
           {
                ctx->error = UAIR_IO_CONTEXT_ERROR_INTERNAL;
+               index_check(*ctx);
                return;
           }
+
+          s_index.pages[stats.page_free] = PageStats{ static_cast<uint16_t>(stats.page_to_clean_used_size), 0, static_cast<uint16_t>(dst_begin - (static_cast<flash_address_t>(stats.page_free) * BSP_FLASH_PAGE_SIZE)) };
+          s_index.pages[stats.page_to_clean] = PageStats{ 0, 0, 0 };
      }
 
      //all done... to make sure everything is optimal, just try again
      //it should detect there's nothing to clean, and simply leave
      UAIR_io_config_flush(ctx);
 }
+
+uair_io_config_gc_state UAIR_io_config_gc_pending(uair_io_context* ctx)
+{
+     if (!ctx) return UAIR_IO_CONFIG_GC_DONE;
+
+     ctx->flags = UAIR_IO_CONTEXT_FLAG_NONE;
+     ctx->error = UAIR_IO_CONTEXT_ERROR_NONE;
+
+     if (!index_ready(*ctx)) return UAIR_IO_CONFIG_GC_DONE;
+
+     if (s_gc.is_active)
+          return (s_index.pages[s_gc.page_source].live_size > 0) ? UAIR_IO_CONFIG_GC_MOVE : UAIR_IO_CONFIG_GC_ERASE;
+
+     int16_t page_free;
+     auto page_source = gc_pick_source(&page_free);
+     if (page_source == -1)
+          return UAIR_IO_CONFIG_GC_DONE;
+
+     if (s_index.pages[page_source].live_size == 0)
+          return UAIR_IO_CONFIG_GC_ERASE;
+
+     //nowhere to move the live entries, left to the blocking flush
+     if ((page_free == -1) && (gc_pick_dest(page_source) == -1))
+          return UAIR_IO_CONFIG_GC_DONE;
+
+     return UAIR_IO_CONFIG_GC_MOVE;
+}
+
+void UAIR_io_config_gc_step(uair_io_context* ctx)
+{
+     if (!ctx) return;
+
+     ctx->flags = UAIR_IO_CONTEXT_FLAG_NONE;
+     ctx->error = UAIR_IO_CONTEXT_ERROR_NONE;
+
+     if (!index_ready(*ctx)) return;
+
+     if (!s_gc.is_active && !gc_begin(*ctx))
+     {
+          index_check(*ctx);
+          return;
+     }
+
+     if (gc_move_entry(*ctx) || !s_gc.is_active || ctx->error)
+     {
+          if (ctx->error)
+          {
+               s_gc.is_active = false;
+               index_check(*ctx);
+          }
+          return;
+     }
+
+     //nothing live is left in the source page
+     assert(s_index.pages[s_gc.page_source].live_size == 0);
+     s_gc.is_active = false;
+
+     if (UAIR_BSP_flash_config_area_erase_page(s_gc.page_source) != BSP_ERROR_NONE)
+     {
+          ctx->error = UAIR_IO_CONTEXT_ERROR_INTERNAL;
+          index_check(*ctx);
+          return;
+     }
+
+     s_index.pages[s_gc.page_source] = PageStats{ 0, 0, 0 };
+}
@@ -41,10 +41,22 @@ typedef enum {
 /** UAIR io config key identifiers */
 typedef enum {
     UAIR_IO_CONTEXT_KEY_CONFIG_TX_POLICY = 1,
-    UAIR_IO_CONTEXT_KEY_CONFIG_FAIR_RATIO = 2
+    UAIR_IO_CONTEXT_KEY_CONFIG_FAIR_RATIO = 2,
+    UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MIN_TICKS = 3,
+    UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MAX_TICKS = 4
     // ...
 } uair_io_context_keys;
 
+/**
+ * Builds the in-RAM index of the config keys with a single scan of the flash.
+ * 
+ * Any other call builds it on first use, so this is only needed at boot or after the
+ * config area was changed behind this API (e.g. pages erased directly).
+ * 
+ * @param ctx the IO context
+ */
+void UAIR_io_config_init(uair_io_context* ctx);
+
 /**
  * Checks if a key exists and/or returns its type.
  * 
@@ -194,6 +206,40 @@ void UAIR_io_config_write_blob(uair_io_context* ctx, uair_io_context_keys key, c
  */
 void UAIR_io_config_remove(uair_io_context* ctx, uair_io_context_keys key);
 
+/** Next step of the incremental compaction */
+typedef enum {
+    /** Nothing left to compact */
+    UAIR_IO_CONFIG_GC_DONE = 0,
+    /** Moves a live entry out of the page being compacted */
+    UAIR_IO_CONFIG_GC_MOVE = 1,
+    /** Erases the page being compacted (a flash page erase, the long step) */
+    UAIR_IO_CONFIG_GC_ERASE = 2
+} uair_io_config_gc_state;
+
+/**
+ * Returns what the next call to UAIR_io_config_gc_step() would do.
+ * 
+ * To spare the flash, a page is only compacted once a quarter of it is invalidated,
+ * or once there's no free page left. Its live entries must fit in another page, or
+ * in a free one: when none has room, only UAIR_io_config_flush() can reclaim it.
+ * 
+ * @param ctx the IO context
+ * @return the next step, UAIR_IO_CONFIG_GC_DONE if there's not enough invalidated space to reclaim,
+ *         or nowhere to move the live entries
+ */
+uair_io_config_gc_state UAIR_io_config_gc_pending(uair_io_context* ctx);
+
+/**
+ * Runs a single step of the incremental compaction of the config data.
+ * 
+ * Live entries are moved out of the page with the most invalidated space, one per
+ * step (same threshold as UAIR_io_config_gc_pending()), and the page is erased in a step of its own. Reads and writes can happen
+ * between steps. UAIR_io_config_flush() remains the blocking alternative.
+ * 
+ * @param ctx the IO context
+ */
+void UAIR_io_config_gc_step(uair_io_context* ctx);
+
 /**
  * Flushes the config data.
  *
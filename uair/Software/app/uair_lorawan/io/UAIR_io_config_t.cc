@@ -3,6 +3,9 @@
 #include <UAIR_BSP_flash.h>
 
 #include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <random>
 
 #include <catch2/catch.hpp>
@@ -19,6 +22,11 @@ TEST_CASE("UAIR IO config", "[BSP][BSP app][BSP IO][BSP config]")
 	{
 		for (decltype(page_count) page_index = 0; page_index < page_count; page_index++)
 			UAIR_BSP_flash_config_area_erase_page(page_index);
+
+		uair_io_context ctx;
+		UAIR_io_init_ctx(&ctx);
+		UAIR_io_config_init(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
 	}
 
 	SECTION("write uint8")
@@ -384,6 +392,7 @@ TEST_CASE("UAIR IO config", "[BSP][BSP app][BSP IO][BSP config]")
 
 		uair_io_context ctx;
 		UAIR_io_init_ctx(&ctx);
+		UAIR_io_config_init(&ctx);
 
 		UAIR_io_config_write_uint8(&ctx, (uair_io_context_keys)33, 0xD8);
 		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
@@ -448,6 +457,7 @@ TEST_CASE("UAIR IO config", "[BSP][BSP app][BSP IO][BSP config]")
 
 		uair_io_context ctx;
 		UAIR_io_init_ctx(&ctx);
+		UAIR_io_config_init(&ctx);
 
 		//fill everything, except the first page
 		size_t key_i = 0;
@@ -498,4 +508,390 @@ TEST_CASE("UAIR IO config", "[BSP][BSP app][BSP IO][BSP config]")
 		UNSCOPED_INFO("Writting key: " << key_i + 1);
 		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NO_SPACE_AVAILABLE);
 	}
-}
\ No newline at end of file
+}
+
+TEST_CASE("UAIR IO config index", "[BSP][BSP app][BSP IO][BSP config]")
+{
+	auto page_count = UAIR_BSP_flash_config_area_get_page_count();
+
+	for (decltype(page_count) page_index = 0; page_index < page_count; page_index++)
+		UAIR_BSP_flash_config_area_erase_page(page_index);
+
+	uair_io_context ctx;
+	UAIR_io_init_ctx(&ctx);
+	UAIR_io_config_init(&ctx);
+	REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+	//some keys are replaced by a different type, some removed
+	for (int i = 1; i <= 20; i++)
+	{
+		UAIR_io_config_write_uint16(&ctx, (uair_io_context_keys)i, static_cast<uint16_t>(i));
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+	}
+	for (int i = 1; i <= 20; i += 3)
+	{
+		UAIR_io_config_remove(&ctx, (uair_io_context_keys)i);
+		UAIR_io_config_write_uint32(&ctx, (uair_io_context_keys)i, static_cast<uint32_t>(i * 1000));
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+	}
+	for (int i = 2; i <= 20; i += 5)
+	{
+		UAIR_io_config_remove(&ctx, (uair_io_context_keys)i);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+	}
+
+	auto check_keys = [&ctx]()
+	{
+		for (int i = 1; i <= 20; i++)
+		{
+			INFO("Key: " << i);
+			if ((i % 5) == 2)
+				REQUIRE(UAIR_io_config_check_key(&ctx, (uair_io_context_keys)i) == UAIR_IO_CONFIG_KEY_TYPE_NOT_AVAILABLE);
+			else if ((i % 3) == 1)
+			{
+				uint32_t val32;
+				UAIR_io_config_read_uint32(&ctx, (uair_io_context_keys)i, &val32);
+				REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+				REQUIRE(val32 == static_cast<uint32_t>(i * 1000));
+			}
+			else
+			{
+				uint16_t val16;
+				UAIR_io_config_read_uint16(&ctx, (uair_io_context_keys)i, &val16);
+				REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+				REQUIRE(val16 == static_cast<uint16_t>(i));
+			}
+		}
+	};
+
+	size_t num_keys, used_space, free_space, recyclable_space;
+	UAIR_io_config_stats(&ctx, &num_keys, &used_space, &free_space, &recyclable_space);
+	REQUIRE(num_keys == 16);
+	REQUIRE(recyclable_space > 0);
+	check_keys();
+
+	SECTION("rebuilt index matches the one kept up to date")
+	{
+		UAIR_io_config_init(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		size_t new_num_keys, new_used_space, new_free_space, new_recyclable_space;
+		UAIR_io_config_stats(&ctx, &new_num_keys, &new_used_space, &new_free_space, &new_recyclable_space);
+		REQUIRE(new_num_keys == num_keys);
+		REQUIRE(new_used_space == used_space);
+		REQUIRE(new_free_space == free_space);
+		REQUIRE(new_recyclable_space == recyclable_space);
+		check_keys();
+	}
+
+	SECTION("flush keeps the index up to date")
+	{
+		UAIR_io_config_flush(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		size_t new_num_keys, new_recyclable_space;
+		UAIR_io_config_stats(&ctx, &new_num_keys, nullptr, nullptr, &new_recyclable_space);
+		REQUIRE(new_num_keys == num_keys);
+		REQUIRE(new_recyclable_space == 0);
+		check_keys();
+
+		UAIR_io_config_init(&ctx);
+		UAIR_io_config_stats(&ctx, &new_num_keys, nullptr, nullptr, &new_recyclable_space);
+		REQUIRE(new_num_keys == num_keys);
+		REQUIRE(new_recyclable_space == 0);
+		check_keys();
+	}
+
+	//overwrites of a key until compaction is worth an erase
+	auto add_dead_space = [&ctx, &recyclable_space]()
+	{
+		REQUIRE(UAIR_io_config_gc_pending(&ctx) == UAIR_IO_CONFIG_GC_DONE);
+		//writing the same value again is a no-op
+		uint16_t value = 3;
+		while ((UAIR_io_config_gc_pending(&ctx) == UAIR_IO_CONFIG_GC_DONE) || (value != 3))
+		{
+			value = (value == 3) ? 300 : 3;
+			UAIR_io_config_write_uint16(&ctx, (uair_io_context_keys)3, value);
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		}
+		size_t new_recyclable_space;
+		UAIR_io_config_stats(&ctx, nullptr, nullptr, nullptr, &new_recyclable_space);
+		REQUIRE(new_recyclable_space >= (BSP_FLASH_PAGE_SIZE / 4));
+		recyclable_space = new_recyclable_space;
+	};
+
+	SECTION("a single overwrite doesn't schedule an erase")
+	{
+		UAIR_io_config_write_uint16(&ctx, (uair_io_context_keys)3, 300);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(UAIR_io_config_gc_pending(&ctx) == UAIR_IO_CONFIG_GC_DONE);
+
+		size_t new_recyclable_space;
+		UAIR_io_config_stats(&ctx, nullptr, nullptr, nullptr, &new_recyclable_space);
+		REQUIRE(new_recyclable_space > recyclable_space);
+
+		//nothing moved nor erased
+		UAIR_io_config_gc_step(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		size_t step_recyclable_space;
+		UAIR_io_config_stats(&ctx, nullptr, nullptr, nullptr, &step_recyclable_space);
+		REQUIRE(step_recyclable_space == new_recyclable_space);
+
+		uint16_t val16;
+		UAIR_io_config_read_uint16(&ctx, (uair_io_context_keys)3, &val16);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(val16 == 300);
+	}
+
+	SECTION("incremental compaction")
+	{
+		add_dead_space();
+
+		int steps = 0;
+		int erases = 0;
+		uair_io_config_gc_state state;
+		while ((state = UAIR_io_config_gc_pending(&ctx)) != UAIR_IO_CONFIG_GC_DONE)
+		{
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+			REQUIRE(steps++ < 100);
+			if (state == UAIR_IO_CONFIG_GC_ERASE)
+				erases++;
+
+			UAIR_io_config_gc_step(&ctx);
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+			check_keys();
+		}
+
+		//one entry per step, the erase on its own
+		REQUIRE(erases == 1);
+		REQUIRE(steps == (static_cast<int>(num_keys) + erases));
+
+		size_t new_num_keys, new_recyclable_space;
+		UAIR_io_config_stats(&ctx, &new_num_keys, nullptr, nullptr, &new_recyclable_space);
+		REQUIRE(new_num_keys == num_keys);
+		REQUIRE(new_recyclable_space == 0);
+
+		UAIR_io_config_init(&ctx);
+		UAIR_io_config_stats(&ctx, &new_num_keys, nullptr, nullptr, &new_recyclable_space);
+		REQUIRE(new_num_keys == num_keys);
+		REQUIRE(new_recyclable_space == 0);
+		check_keys();
+	}
+
+	SECTION("writes between compaction steps")
+	{
+		add_dead_space();
+
+		UAIR_io_config_gc_step(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		//a key not moved yet, one already moved and a new one
+		UAIR_io_config_write_uint16(&ctx, (uair_io_context_keys)20, 2000);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		UAIR_io_config_write_uint32(&ctx, (uair_io_context_keys)1, 1000);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		UAIR_io_config_write_uint8(&ctx, (uair_io_context_keys)30, 30);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		int steps = 0;
+		while (UAIR_io_config_gc_pending(&ctx) != UAIR_IO_CONFIG_GC_DONE)
+		{
+			REQUIRE(steps++ < 100);
+			UAIR_io_config_gc_step(&ctx);
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		}
+
+		size_t new_num_keys, new_recyclable_space;
+		UAIR_io_config_stats(&ctx, &new_num_keys, nullptr, nullptr, &new_recyclable_space);
+		REQUIRE(new_num_keys == (num_keys + 1));
+		REQUIRE(new_recyclable_space == 0);
+
+		uint16_t val16;
+		UAIR_io_config_read_uint16(&ctx, (uair_io_context_keys)20, &val16);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(val16 == 2000);
+		uint8_t val8;
+		UAIR_io_config_read_uint8(&ctx, (uair_io_context_keys)30, &val8);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(val8 == 30);
+
+		UAIR_io_config_write_uint16(&ctx, (uair_io_context_keys)20, 20);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		check_keys();
+	}
+
+	SECTION("no room to move the live entries")
+	{
+		add_dead_space();
+
+		//whichever entry was moved, its new copy is invalidated in turn
+		UAIR_io_config_gc_step(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		for (int i = 1; i <= 20; i++)
+		{
+			if ((i % 5) == 2)
+				continue;
+			if ((i % 3) == 1)
+			{
+				UAIR_io_config_write_uint32(&ctx, (uair_io_context_keys)i, static_cast<uint32_t>(i * 1000 + 1));
+				UAIR_io_config_write_uint32(&ctx, (uair_io_context_keys)i, static_cast<uint32_t>(i * 1000));
+			}
+			else
+			{
+				UAIR_io_config_write_uint16(&ctx, (uair_io_context_keys)i, static_cast<uint16_t>(i + 1));
+				UAIR_io_config_write_uint16(&ctx, (uair_io_context_keys)i, static_cast<uint16_t>(i));
+			}
+			REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		}
+
+		//rebooted before the compaction completes: both pages in use, neither clean
+		UAIR_io_config_init(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(UAIR_io_config_gc_pending(&ctx) == UAIR_IO_CONFIG_GC_DONE);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		check_keys();
+	}
+}
+
+/*
+ * How keys were found before the RAM index: every page and every header walked
+ * through std::function callbacks, with one flash read per header.
+ */
+namespace
+{
+	bool reference_pages_iterate(const std::function<bool(flash_page_t page_index)>& cb)
+	{
+		auto page_count = UAIR_BSP_flash_config_area_get_page_count();
+		for (decltype(page_count) page_index = 0; page_index < page_count; page_index++)
+		{
+			uint8_t page_header[8];
+			if (UAIR_BSP_flash_config_area_read(page_index * BSP_FLASH_PAGE_SIZE, page_header, sizeof(page_header)) != sizeof(page_header))
+				return false;
+
+			if (page_header[0] & 0x01)
+				continue; //unused
+
+			if (!cb(page_index)) break;
+		}
+		return true;
+	}
+
+	bool reference_entries_iterate(flash_page_t page_index, const std::function<bool(const uint8_t* header)>& cb)
+	{
+		flash_address_t address = (page_index * BSP_FLASH_PAGE_SIZE) + 8;
+		flash_address_t address_end = (page_index + 1) * BSP_FLASH_PAGE_SIZE;
+
+		while (address < address_end)
+		{
+			uint8_t header[8];
+			if (UAIR_BSP_flash_config_area_read(address, header, sizeof(header)) != sizeof(header))
+				return false;
+
+			if (header[0] & 0x01)
+				return true; //unused
+
+			if (!cb(header)) return false;
+
+			uint8_t type = header[0] >> 2;
+			address += ((type == 6) || (type == 7)) ? 16 : 8; //64bit entries carry their data after the header
+		}
+		return true;
+	}
+
+	bool reference_find_uint32(uint8_t key, uint32_t& value)
+	{
+		bool found = false;
+		reference_pages_iterate([&](flash_page_t page_index)
+		{
+			return reference_entries_iterate(page_index, [&](const uint8_t* header)
+			{
+				if (!(header[0] & 0x02) || (header[1] != key)) return true;
+
+				memcpy(&value, header + 4, sizeof(value));
+				found = true;
+				return false;
+			});
+		});
+		return found;
+	}
+
+	template<class TCallback>
+	double ns_per_run(unsigned runs, TCallback&& c)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < runs; i++)
+			c();
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / runs;
+	}
+}
+
+TEST_CASE("UAIR IO config benchmark", "[.][BSP config/Benchmark]")
+{
+	const unsigned num_keys = 100;
+	const unsigned runs = 200;
+
+	auto page_count = UAIR_BSP_flash_config_area_get_page_count();
+	for (decltype(page_count) page_index = 0; page_index < page_count; page_index++)
+		UAIR_BSP_flash_config_area_erase_page(page_index);
+
+	uair_io_context ctx;
+	UAIR_io_init_ctx(&ctx);
+	UAIR_io_config_init(&ctx);
+
+	//half of the keys are superseded once, so that lookups also walk dead entries
+	for (unsigned key = 1; key <= num_keys; key++)
+		UAIR_io_config_write_uint32(&ctx, (uair_io_context_keys)key, key);
+	for (unsigned key = 1; key <= num_keys; key += 2)
+	{
+		UAIR_io_config_remove(&ctx, (uair_io_context_keys)key);
+		UAIR_io_config_write_uint32(&ctx, (uair_io_context_keys)key, key * 2);
+	}
+	REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+	uint32_t checksum = 0;
+
+	double ns_reference = ns_per_run(runs, [&]()
+	{
+		for (unsigned key = 1; key <= num_keys; key++)
+		{
+			uint32_t value = 0;
+			reference_find_uint32(static_cast<uint8_t>(key), value);
+			checksum += value;
+		}
+	}) / num_keys;
+
+	double ns_indexed = ns_per_run(runs, [&]()
+	{
+		for (unsigned key = 1; key <= num_keys; key++)
+		{
+			uint32_t value = 0;
+			UAIR_io_config_read_uint32(&ctx, (uair_io_context_keys)key, &value);
+			checksum -= value;
+		}
+	}) / num_keys;
+
+	//a full scan, as done once at boot
+	double ns_scan_reference = ns_per_run(runs, [&]()
+	{
+		reference_pages_iterate([](flash_page_t page_index)
+		{
+			return reference_entries_iterate(page_index, [](const uint8_t*) { return true; });
+		});
+	});
+
+	double ns_scan = ns_per_run(runs, [&]()
+	{
+		UAIR_io_config_init(&ctx);
+	});
+
+	REQUIRE(checksum == 0);
+
+	WARN( "Lookup, flash scan: " << ns_reference << " ns/key" );
+	WARN( "Lookup, RAM index:  " << ns_indexed << " ns/key" );
+	WARN( "Full scan, per-header reads: " << ns_scan_reference << " ns" );
+	WARN( "Full scan, chunked reads:    " << ns_scan << " ns" );
+
+	CHECK( ns_indexed < ns_reference );
+}
@@ -0,0 +1,82 @@
+#ifndef UAIR_IO_QUEUE_H__
+#define UAIR_IO_QUEUE_H__
+
+#include "UAIR_io_audit.h"
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Pages at the end of the audit area given to the queue, the audit log keeps the others */
+#define UAIR_IO_QUEUE_NUM_PAGES 4
+
+/** Largest payload that can be queued */
+#define UAIR_IO_QUEUE_MAX_SIZE UAIR_IO_AUDIT_MAX_SIZE
+
+/*
+ * The queue is a log of its own, built like the audit log: payloads only ever evict
+ * older payloads, and audit records never do. Errors are the audit ones.
+ *
+ * A packed frame holds the number of payloads, then each payload behind its size:
+ *
+ *   | count | size 1 | payload 1 | ... | size n | payload n |
+ */
+
+/**
+ * Recovers the head and tail of the queue.
+ *
+ * Any other call does this on first use, so this is only needed at boot.
+ *
+ * @param ctx the IO context
+ */
+void UAIR_io_queue_init(uair_io_context* ctx);
+
+/**
+ * Appends a payload to the queue.
+ *
+ * Once the queue is full, the page holding the oldest payloads is erased to make room.
+ *
+ * @param ctx the IO context
+ * @param data the payload
+ * @param size the size of the payload, up to UAIR_IO_QUEUE_MAX_SIZE
+ * @return the ID of the payload, 0 on error
+ */
+int UAIR_io_queue_push(uair_io_context* ctx, const void* data, int size);
+
+/**
+ * Returns the oldest payload not disposed of.
+ *
+ * @param ctx the IO context
+ * @return the ID of the payload, 0 if the queue is empty
+ */
+int UAIR_io_queue_peek(uair_io_context* ctx);
+
+/**
+ * Packs the oldest payloads into a frame, as many as max_size allows.
+ *
+ * @param ctx the IO context
+ * @param frame where to write the frame
+ * @param max_size the size of frame
+ * @param last_id where to store the ID of the last payload packed, 0 if none
+ * @return the size of the frame, 0 if no payload fits
+ */
+int UAIR_io_queue_pack(uair_io_context* ctx, uint8_t* frame, int max_size, int* last_id);
+
+/**
+ * Disposes of the payloads up to last_id, once sent.
+ *
+ * Each payload is cleared in place, a single flash write.
+ *
+ * @param ctx the IO context
+ * @param last_id the ID returned by UAIR_io_queue_pack
+ */
+void UAIR_io_queue_dispose(uair_io_context* ctx, int last_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+#include "UAIR_io_queue.h"
+
+#include <UAIR_BSP_flash.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("UAIR IO queue", "[BSP][BSP app][BSP IO][BSP queue]")
+{
+	auto area_page_count = UAIR_BSP_flash_audit_area_get_page_count();
+	REQUIRE(area_page_count >= UAIR_IO_QUEUE_NUM_PAGES + 2);
+
+	for (decltype(area_page_count) page_index = 0; page_index < area_page_count; page_index++)
+		UAIR_BSP_flash_audit_area_erase_page(page_index);
+
+	uair_io_context ctx;
+	UAIR_io_init_ctx(&ctx);
+	UAIR_io_audit_init(&ctx);
+	REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+	UAIR_io_queue_init(&ctx);
+	REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+	std::array<uint8_t, UAIR_IO_QUEUE_MAX_SIZE> frame;
+	int last_id = -1;
+
+	auto push = [&ctx](int size, uint8_t value)
+	{
+		std::vector<uint8_t> payload(size, value);
+		int id = UAIR_io_queue_push(&ctx, payload.data(), size);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		return id;
+	};
+
+	SECTION("empty queue")
+	{
+		REQUIRE(UAIR_io_queue_peek(&ctx) == 0);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+
+		REQUIRE(UAIR_io_queue_pack(&ctx, frame.data(), frame.size(), &last_id) == 0);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(last_id == 0);
+
+		REQUIRE(UAIR_io_queue_push(&ctx, frame.data(), 0) == 0);
+		REQUIRE(ctx.error == (uair_io_context_errors)UAIR_IO_AUDIT_ERROR_INVALID_SIZE);
+	}
+
+	SECTION("payloads are packed behind their size, oldest first")
+	{
+		REQUIRE(push(3, 1) == 1);
+		REQUIRE(push(5, 2) == 2);
+		REQUIRE(push(7, 3) == 3);
+		REQUIRE(UAIR_io_queue_peek(&ctx) == 1);
+
+		std::vector<uint8_t> expected{ 3, 3, 1, 1, 1, 5, 2, 2, 2, 2, 2, 7, 3, 3, 3, 3, 3, 3, 3 };
+		REQUIRE(UAIR_io_queue_pack(&ctx, frame.data(), frame.size(), &last_id) == static_cast<int>(expected.size()));
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(last_id == 3);
+		REQUIRE(std::vector<uint8_t>(frame.begin(), frame.begin() + expected.size()) == expected);
+
+		//only what fits, the next payload waits
+		REQUIRE(UAIR_io_queue_pack(&ctx, frame.data(), 11, &last_id) == 11);
+		REQUIRE(last_id == 2);
+		REQUIRE(frame[0] == 2);
+
+		REQUIRE(UAIR_io_queue_pack(&ctx, frame.data(), 3, &last_id) == 0);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(last_id == 0);
+	}
+
+	SECTION("sent payloads are disposed of, also across a reboot")
+	{
+		for (int i = 1; i <= 5; i++)
+			REQUIRE(push(i, static_cast<uint8_t>(i)) == i);
+
+		REQUIRE(UAIR_io_queue_pack(&ctx, frame.data(), 1 + 2 + 3, &last_id) == 6);
+		REQUIRE(last_id == 2);
+
+		UAIR_io_queue_dispose(&ctx, last_id);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(UAIR_io_queue_peek(&ctx) == 3);
+
+		UAIR_io_queue_init(&ctx);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(UAIR_io_queue_peek(&ctx) == 3);
+
+		REQUIRE(UAIR_io_queue_pack(&ctx, frame.data(), frame.size(), &last_id) == 1 + 4 + 5 + 6);
+		REQUIRE(last_id == 5);
+		REQUIRE(frame[0] == 3);
+		REQUIRE(frame[1] == 3);
+		REQUIRE(frame[2] == 3);
+
+		//IDs carry on
+		REQUIRE(push(1, 6) == 6);
+
+		UAIR_io_queue_dispose(&ctx, 6);
+		REQUIRE(ctx.error == UAIR_IO_CONTEXT_ERROR_NONE);
+		REQUIRE(UAIR_io_queue_peek(&ctx) == 0);
+
+		UAIR_io_queue_init(&ctx);
+		REQUIRE(UAIR_io_queue_peek(&ctx) == 0);
+		REQUIRE(push(1, 7) == 7);
+	}
+
+	SECTION("the audit log and the queue don't wrap over each other")
+	{
+		uint8_t audit_value = 1;
+		REQUIRE(UAIR_io_audit_add(&ctx, &audit_value, sizeof(audit_value)) == 1);
+		REQUIRE(push(8, 0x5A) == 1);
+
+		//16 bytes per record, a few times around the audit log
+		int num_records = static_cast<int>((area_page_count * BSP_FLASH_PAGE_SIZE / 16) * 3);
+		for (int i = 2; i <= num_records; i++)
+			REQUIRE(UAIR_io_audit_add(&ctx, &audit_value, sizeof(audit_value)) == i);
+		REQUIRE(UAIR_io_audit_iter_begin(&ctx) > 1);
+
+		REQUIRE(UAIR_io_queue_peek(&ctx) == 1);
+		REQUIRE(UAIR_io_queue_pack(&ctx, frame.data(), frame.size(), &last_id) == 1 + 1 + 8);
+		REQUIRE(frame[2] == 0x5A);
+
+		//payloads only evict older payloads
+		int num_payloads = static_cast<int>((UAIR_IO_QUEUE_NUM_PAGES * BSP_FLASH_PAGE_SIZE / 16) * 3);
+		for (int i = 2; i <= num_payloads; i++)
+			REQUIRE(push(8, 0x5A) == i);
+		REQUIRE(UAIR_io_queue_peek(&ctx) > 1);
+
+		int oldest_audit = UAIR_io_audit_iter_begin(&ctx);
+		REQUIRE(UAIR_io_audit_add(&ctx, &audit_value, sizeof(audit_value)) == (num_records + 1));
+		REQUIRE(UAIR_io_audit_iter_begin(&ctx) == oldest_audit);
+
+		UAIR_io_audit_init(&ctx);
+		UAIR_io_queue_init(&ctx);
+		REQUIRE(UAIR_io_audit_iter_begin(&ctx) == oldest_audit);
+		REQUIRE(push(1, 0) == (num_payloads + 1));
+	}
+}
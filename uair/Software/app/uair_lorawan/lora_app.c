@@ -272,6 +272,9 @@ static void OnRxData(LmHandlerAppData_t *appData, LmHandlerRxParams_t *params)
       case 30:
         UAIR_cmd_callbacks->cmd_healthchk_ack(uair_msg);
         break;
+      case 40:
+        UAIR_cmd_callbacks->cmd_sampling_bounds(uair_msg);
+        break;
       case 99:
         UAIR_cmd_callbacks->cmd_factory_reset(uair_msg);
         break;
@@ -287,21 +290,38 @@ uint8_t UAIR_lora_send(uint8_t buf[], uint8_t len) {
   memcpy(&p0, buf, len);
   sensor_processing_dump_payload0(&p0);
 #endif
+  return UAIR_lora_send_port(SENSORS_PAYLOAD_APP_PORT, buf, len, NULL);
+}
+
+uint8_t UAIR_lora_send_port(uint8_t port, uint8_t buf[], uint8_t len, uint32_t *next_tx_ms) {
   UTIL_TIMER_Time_t nextTxIn = 0;
-  AppData.Port = SENSORS_PAYLOAD_APP_PORT;
+  AppData.Port = port;
   AppData.BufferSize = len;
   AppData.Buffer = buf;
 
-  APP_PPRINTF("SENDING REQUEST len %d\r\n", len);
+  APP_PPRINTF("SENDING REQUEST port %d len %d\r\n", port, len);
 
   LmHandlerErrorStatus_t res = LmHandlerSend(&AppData, LORAWAN_DEFAULT_CONFIRMED_MSG_STATE, &nextTxIn, false);
 
   APP_PPRINTF("SENT REQUEST res=%d len %d\r\n", res, len);
 
-#if defined(RELEASE) && (RELEASE==1)
-  (void)res; // Fix me
-#endif
-  return 1;
+  /* The MAC has copied the payload, don't keep pointing at the caller's buffer */
+  AppData.Buffer = AppDataBuffer;
+  AppData.BufferSize = 0;
+
+  if (next_tx_ms != NULL)
+    *next_tx_ms = nextTxIn;
+
+  return res == LORAMAC_HANDLER_SUCCESS;
+}
+
+uint8_t UAIR_lora_max_payload(void) {
+  LoRaMacTxInfo_t txInfo;
+
+  if (LoRaMacQueryTxPossible(0, &txInfo) != LORAMAC_STATUS_OK)
+    return 0;
+
+  return txInfo.MaxPossibleApplicationDataSize;
 }
 
 
@@ -88,6 +88,7 @@ typedef struct UAIR_link_commands_s
   void (*cmd_fair_ratio)(uint32_t command);
   void (*cmd_factory_reset)(uint32_t command);
   void (*cmd_healthchk_ack)(uint32_t command);
+  void (*cmd_sampling_bounds)(uint32_t command);
 } UAIR_link_commands_t;
 
 
@@ -97,7 +98,27 @@ typedef struct UAIR_link_commands_s
   * @return None
   */
 void LoRaWAN_Init(UAIR_link_commands_t *cmd_callbacks);
+/**
+  * @brief  Sends a sensors payload
+  * @param buf payload
+  * @param len payload size
+  * @return 1 if the uplink was accepted by the MAC, 0 otherwise
+  */
 uint8_t UAIR_lora_send(uint8_t buf[], uint8_t len);
+/**
+  * @brief  Sends a payload on a given application port
+  * @param port application port
+  * @param buf payload
+  * @param len payload size
+  * @param next_tx_ms if not NULL, time until the duty cycle allows the next uplink
+  * @return 1 if the uplink was accepted by the MAC, 0 otherwise
+  */
+uint8_t UAIR_lora_send_port(uint8_t port, uint8_t buf[], uint8_t len, uint32_t *next_tx_ms);
+/**
+  * @brief  Largest application payload allowed at the current datarate
+  * @return size in bytes, 0 if nothing can be sent
+  */
+uint8_t UAIR_lora_max_payload(void);
 void UAIR_join_status_callback(bool success);
 
 
@@ -37,6 +37,10 @@ extern "C"
 
   #define CATCH_CONFIG_RUNNER
   #include <catch2/catch.hpp>
+  #include "tests/uAirTestRunner.hpp"
+  #include "models/hw_metrics.h"
+  #include "hlog_trace.h"
+  #include "hlog.h"
 
 #endif
 
@@ -79,8 +83,61 @@ int main(int argc, char* argv[])
 #ifdef UNITTESTS
 
 
-    int r =  Catch::Session().run(argc, argv);
+    Catch::Session session;
+    int jobs = -1;
+    std::string metrics;
+    std::string metrics_live;
+    std::string trace;
+    std::string log;
+
+    // --jobs N runs each test case in its own process, N at a time
+    auto cli = session.cli()
+        | Catch::clara::Opt( jobs, "processes" )
+        ["--jobs"]
+        ( "run test cases in parallel processes (0 for one per core)" )
+        | Catch::clara::Opt( metrics, "filename" )
+        ["--metrics"]
+        ( "write simulator metrics as JSON at exit (- for stdout)" )
+        | Catch::clara::Opt( metrics_live, "filename" )
+        ["--metrics-live"]
+        ( "stream simulator metrics every second (- for stderr)" )
+        | Catch::clara::Opt( trace, "filename" )
+        ["--trace"]
+        ( "write logs to a binary trace, see hlog_decode (not with --jobs)" )
+        | Catch::clara::Opt( log, "levels" )
+        ["--log"]
+        ( "log levels, e.g. warn,SIMCLOCK=debug (debug|warn|error|progress|none)" );
+
+    session.cli(cli);
+
+    int r = session.applyCommandLine(argc, argv);
+
+    if (r!=0)
+        return r;
+
+    if (!log.empty() && hlog_configure(log.c_str())!=0) {
+        fprintf(stderr, "Invalid log levels '%s'\n", log.c_str());
+        return 1;
+    }
+
+    if (!metrics.empty())
+        metrics_enable_summary(metrics.c_str());
+
+    if (!metrics_live.empty())
+        metrics_enable_live(metrics_live.c_str(), 1000);
+
+    if (jobs >= 0 && !session.config().listTests() && !session.config().listTestNamesOnly() &&
+        !session.config().listTags() && !session.config().showHelp())
+    {
+        return uAirRunTestsParallel(session.config(), argc, argv, jobs);
+    }
+
+    if (!trace.empty() && hlog_trace_start(trace.c_str())!=0)
+        return 1;
+
+    r = session.run();
 
+    hlog_trace_stop();
 
     return r;
 
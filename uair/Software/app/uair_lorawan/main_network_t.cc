@@ -1,5 +1,6 @@
 #include "tests/uAirSystemTestFixture.hpp"
 #include "tests/uAirUplinkMessage.hpp"
+#include "tests/uAirFleet.hpp"
 #include <iostream>
 
 TEST_CASE_METHOD(uAirSystemTestFixture, "UAIR system tests - network", "[SYS][SYS/Network]")
@@ -70,6 +71,116 @@ TEST_CASE_METHOD(uAirSystemTestFixture, "UAIR system tests - network", "[SYS][SY
     }
 }
 
+TEST_CASE_METHOD(uAirSystemTestFixture, "UAIR system tests - network virtual time", "[SYS][SYS/Network][SYS/VirtualTime]")
+{
+    onBSPInit([this]
+              {
+                  setOAQ( 35.0, 2.0, 40.0 );
+                  setSoundLevel( 8.0, 2.0, 16.0 );
+              }
+             );
+
+    startApplicationVirtualTime();
+
+    waitFor(std::chrono::seconds(30));
+
+    CHECK( deviceJoined() );
+
+    waitFor(std::chrono::minutes(75+5));
+
+    CHECK( uplinkMessages().size() == 1 );
+}
+
+TEST_CASE_METHOD(uAirSystemTestFixture, "UAIR system tests - snapshot", "[SYS][SYS/Snapshot]")
+{
+    /* Boot and join once, every section runs on a copy of the joined device */
+    auto joined = [this]
+    {
+        onBSPInit([this]
+                  {
+                      setOAQ( 35.0, 2.0, 40.0 );
+                      setSoundLevel( 8.0, 2.0, 16.0 );
+                  }
+                 );
+
+        startApplicationVirtualTime();
+
+        waitFor(std::chrono::seconds(30));
+    };
+
+    SECTION("joined")
+    {
+        if (!forkFromSnapshot("joined", joined))
+            return;
+
+        CHECK( deviceJoined() );
+    }
+
+    SECTION("first uplink")
+    {
+        if (!forkFromSnapshot("joined", joined))
+            return;
+
+        setOAQ( 35.0, 2.0, 40.0 );
+        setSoundLevel( 8.0, 2.0, 16.0 );
+
+        waitFor(std::chrono::minutes(75+5));
+
+        CHECK( uplinkMessages().size() == 1 );
+    }
+}
+
+static void fleet_scenario(uAirTestController &device, unsigned index)
+{
+    // Spread the air quality a bit across the fleet
+    device.onBSPInit([&device, index]
+                     {
+                         device.setOAQ( 30.0 + (index % 10), 2.0 );
+                         device.setSoundLevel( 8.0, 2.0 );
+                     }
+                    );
+}
+
+TEST_CASE("UAIR system tests - fleet", "[SYS][SYS/Fleet]")
+{
+    uAirFleetConfig config;
+
+    config.devices = 4;
+    config.duration = std::chrono::minutes(90);
+    config.boot_spread = std::chrono::minutes(5);
+    config.scenario = fleet_scenario;
+
+    uAirFleet fleet(config);
+
+    CHECK( fleet.run() );
+
+    const uAirFleetReport &report = fleet.report();
+
+    report.dump(std::cout);
+
+    CHECK( report.joined == 4 );
+    CHECK( report.countFrames(JOIN_REQUEST) >= 4 );
+    CHECK( report.countFrames(UNCONFIRMED_UPLINK) == 4 );
+}
+
+TEST_CASE("UAIR system tests - city fleet", "[.][SYS/Fleet/City]")
+{
+    uAirFleetConfig config;
+
+    config.devices = 500;
+    config.duration = std::chrono::hours(6);
+    config.boot_spread = std::chrono::hours(1);
+    config.scenario = fleet_scenario;
+
+    uAirFleet fleet(config);
+
+    CHECK( fleet.run() );
+
+    fleet.report().dump(std::cout);
+
+    CHECK( fleet.report().joined == 500 );
+}
+
 struct hs_error_t
 {
     unsigned cycle;
@@ -0,0 +1,234 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file rolling_stats.c
+ *
+ *
+ */
+
+#include "rolling_stats.h"
+
+int rolling_stats_init(rolling_stats_t *stats, uint32_t *storage, uint16_t capacity, const rolling_stats_format_t *format)
+{
+    if (format->bits == 0 || format->bits > 31 || format->scale <= 0 || format->max < format->min)
+        return -1;
+
+    if ((((int64_t)format->max - format->min) / format->scale) >= ((int64_t)1 << format->bits))
+        return -1;
+
+    stats->storage = storage;
+    stats->format = format;
+    stats->capacity = capacity;
+    rolling_stats_clear(stats);
+    return 0;
+}
+
+void rolling_stats_clear(rolling_stats_t *stats)
+{
+    /* Only the validity bitmap, samples are written before they are read */
+    for (uint16_t i = 0; i < (stats->capacity + 31U) / 32U; i++)
+        stats->storage[i] = 0;
+
+    stats->index = 0;
+    stats->count = 0;
+    stats->valid_count = 0;
+    stats->last_valid_age = UINT16_MAX;
+    stats->extremes_dirty = false;
+    stats->sum = 0;
+    stats->sum_squares = 0;
+    stats->max = ROLLING_STATS_INVALID;
+    stats->min = ROLLING_STATS_INVALID;
+    stats->last_valid = ROLLING_STATS_INVALID;
+}
+
+static uint32_t *rolling_stats_data(const rolling_stats_t *stats)
+{
+    return &stats->storage[(stats->capacity + 31U) / 32U];
+}
+
+static bool rolling_stats_is_valid(const rolling_stats_t *stats, uint16_t index)
+{
+    return (stats->storage[index / 32U] >> (index % 32U)) & 1U;
+}
+
+static void rolling_stats_set_valid(rolling_stats_t *stats, uint16_t index, bool valid)
+{
+    if (valid)
+        stats->storage[index / 32U] |= (1UL << (index % 32U));
+    else
+        stats->storage[index / 32U] &= ~(1UL << (index % 32U));
+}
+
+/* Samples may straddle two words */
+static int32_t rolling_stats_get(const rolling_stats_t *stats, uint16_t index)
+{
+    const uint32_t *data = rolling_stats_data(stats);
+    uint8_t bits = stats->format->bits;
+    uint32_t bit = (uint32_t)index * bits;
+    uint32_t shift = bit % 32U;
+    uint32_t field = data[bit / 32U] >> shift;
+
+    if (shift + bits > 32U)
+        field |= data[(bit / 32U) + 1U] << (32U - shift);
+    field &= (1UL << bits) - 1U;
+
+    return (int32_t)((uint32_t)stats->format->min + (field * (uint32_t)stats->format->scale));
+}
+
+static void rolling_stats_set(rolling_stats_t *stats, uint16_t index, int32_t sample)
+{
+    uint32_t *data = rolling_stats_data(stats);
+    uint8_t bits = stats->format->bits;
+    uint32_t mask = (1UL << bits) - 1U;
+    uint32_t field = ((uint32_t)sample - (uint32_t)stats->format->min) / (uint32_t)stats->format->scale;
+    uint32_t bit = (uint32_t)index * bits;
+    uint32_t shift = bit % 32U;
+
+    data[bit / 32U] = (data[bit / 32U] & ~(mask << shift)) | (field << shift);
+    if (shift + bits > 32U)
+        data[(bit / 32U) + 1U] = (data[(bit / 32U) + 1U] & ~(mask >> (32U - shift))) | (field >> (32U - shift));
+}
+
+static bool rolling_stats_storable(const rolling_stats_t *stats, int32_t sample)
+{
+    const rolling_stats_format_t *format = stats->format;
+
+    return sample >= format->min && sample <= format->max &&
+           (((uint32_t)sample - (uint32_t)format->min) % (uint32_t)format->scale) == 0;
+}
+
+static void rolling_stats_remove(rolling_stats_t *stats, int32_t sample)
+{
+    stats->valid_count--;
+    stats->sum -= sample;
+    stats->sum_squares -= (int64_t)sample * sample;
+
+    if (sample == stats->max || sample == stats->min)
+        stats->extremes_dirty = true;
+}
+
+void rolling_stats_push(rolling_stats_t *stats, int32_t sample)
+{
+    if (stats->count == stats->capacity) {
+        if (rolling_stats_is_valid(stats, stats->index))
+            rolling_stats_remove(stats, rolling_stats_get(stats, stats->index));
+    } else
+        stats->count++;
+
+    if (sample != ROLLING_STATS_INVALID && !rolling_stats_storable(stats, sample))
+        sample = ROLLING_STATS_INVALID;
+
+    rolling_stats_set_valid(stats, stats->index, sample != ROLLING_STATS_INVALID);
+    if (sample != ROLLING_STATS_INVALID)
+        rolling_stats_set(stats, stats->index, sample);
+
+    if (++stats->index == stats->capacity)
+        stats->index = 0;
+
+    if (sample == ROLLING_STATS_INVALID) {
+        if (stats->last_valid_age != UINT16_MAX)
+            stats->last_valid_age++;
+        return;
+    }
+
+    stats->valid_count++;
+    stats->sum += sample;
+    stats->sum_squares += (int64_t)sample * sample;
+    stats->last_valid = sample;
+    stats->last_valid_age = 0;
+
+    /* Rescanned on demand otherwise */
+    if (!stats->extremes_dirty) {
+        if (stats->max == ROLLING_STATS_INVALID || sample > stats->max)
+            stats->max = sample;
+        if (stats->min == ROLLING_STATS_INVALID || sample < stats->min)
+            stats->min = sample;
+    }
+}
+
+int rolling_stats_average(const rolling_stats_t *stats, uint16_t min_valid, int32_t *avg)
+{
+    if (stats->valid_count == 0 || stats->valid_count < min_valid)
+        return -1;
+
+    *avg = stats->sum / (int32_t)stats->valid_count;
+    return 0;
+}
+
+int rolling_stats_variance(const rolling_stats_t *stats, uint16_t min_valid, int64_t *variance)
+{
+    int64_t n = stats->valid_count;
+
+    if (n < 2 || n < min_valid)
+        return -1;
+
+    /* Population variance, in squared sample units */
+    *variance = ((n * stats->sum_squares) - ((int64_t)stats->sum * stats->sum)) / (n * n);
+    return 0;
+}
+
+static void rolling_stats_rescan(rolling_stats_t *stats)
+{
+    stats->max = ROLLING_STATS_INVALID;
+    stats->min = ROLLING_STATS_INVALID;
+
+    for (uint16_t i = 0; i < stats->count; i++) {
+        int32_t sample;
+
+        if (!rolling_stats_is_valid(stats, i))
+            continue;
+
+        sample = rolling_stats_get(stats, i);
+        if (stats->max == ROLLING_STATS_INVALID || sample > stats->max)
+            stats->max = sample;
+        if (stats->min == ROLLING_STATS_INVALID || sample < stats->min)
+            stats->min = sample;
+    }
+    stats->extremes_dirty = false;
+}
+
+int rolling_stats_max(rolling_stats_t *stats, int32_t *max)
+{
+    if (stats->valid_count == 0)
+        return -1;
+
+    if (stats->extremes_dirty)
+        rolling_stats_rescan(stats);
+
+    *max = stats->max;
+    return 0;
+}
+
+int rolling_stats_min(rolling_stats_t *stats, int32_t *min)
+{
+    if (stats->valid_count == 0)
+        return -1;
+
+    if (stats->extremes_dirty)
+        rolling_stats_rescan(stats);
+
+    *min = stats->min;
+    return 0;
+}
+
+int rolling_stats_last_valid(const rolling_stats_t *stats, uint16_t max_age, int32_t *value)
+{
+    if (stats->last_valid_age >= max_age)
+        return -1;
+
+    *value = stats->last_valid;
+    return 0;
+}
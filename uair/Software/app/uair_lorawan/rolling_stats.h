@@ -0,0 +1,101 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file rolling_stats.h
+ *
+ * Statistics over the last N samples of a measurement, updated as each
+ * sample comes in instead of rescanning the window.
+ *
+ * Invalid samples (ROLLING_STATS_INVALID) take a slot in the window but
+ * are left out of every statistic. Sums are kept in 32 bits, so samples
+ * times the window size must fit an int32_t.
+ *
+ * The window is packed: a validity bitmap, then each sample stored as
+ * (sample - min) / scale in the given number of bits. Samples outside
+ * [min, max] or not a multiple of the scale cannot be stored and are
+ * pushed as invalid, everything else is kept exactly.
+ */
+
+#ifndef UAIR_ROLLING_STATS_H__
+#define UAIR_ROLLING_STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ROLLING_STATS_INVALID INT32_MAX
+
+/* Storage, in words, for a window of capacity samples of the given bits */
+#define ROLLING_STATS_WORDS(capacity, bits) \
+    ((((capacity) + 31U) / 32U) + ((((capacity) * (bits)) + 31U) / 32U))
+
+typedef struct
+{
+    int32_t min;
+    int32_t max;
+    int32_t scale;
+    uint8_t bits;           /* At most 31 */
+} rolling_stats_format_t;
+
+typedef struct
+{
+    uint32_t *storage;      /* ROLLING_STATS_WORDS(capacity, bits), provided by the user */
+    const rolling_stats_format_t *format;
+    uint16_t capacity;
+    uint16_t index;         /* Next slot to write, the oldest sample once full */
+    uint16_t count;         /* Samples in the window, valid or not */
+    uint16_t valid_count;
+    uint16_t last_valid_age;    /* Samples pushed since the last valid one */
+    bool extremes_dirty;    /* An extreme left the window, max/min need a rescan */
+    int32_t sum;
+    int64_t sum_squares;
+    int32_t max;
+    int32_t min;
+    int32_t last_valid;
+} rolling_stats_t;
+
+/* Returns -1 if the format does not fit its bits */
+int rolling_stats_init(rolling_stats_t *stats, uint32_t *storage, uint16_t capacity, const rolling_stats_format_t *format);
+void rolling_stats_clear(rolling_stats_t *stats);
+void rolling_stats_push(rolling_stats_t *stats, int32_t sample);
+
+static inline uint16_t rolling_stats_valid_count(const rolling_stats_t *stats)
+{
+    return stats->valid_count;
+}
+
+static inline int32_t rolling_stats_sum(const rolling_stats_t *stats)
+{
+    return stats->sum;
+}
+
+/* These return -1 when there are not enough valid samples, 0 otherwise */
+int rolling_stats_average(const rolling_stats_t *stats, uint16_t min_valid, int32_t *avg);
+int rolling_stats_variance(const rolling_stats_t *stats, uint16_t min_valid, int64_t *variance);
+int rolling_stats_max(rolling_stats_t *stats, int32_t *max);
+int rolling_stats_min(rolling_stats_t *stats, int32_t *min);
+
+/* The newest valid sample, if it is one of the last max_age samples */
+int rolling_stats_last_valid(const rolling_stats_t *stats, uint16_t max_age, int32_t *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,239 @@
+#include "rolling_stats.h"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("Rolling stats", "[app][rolling stats]")
+{
+    static const rolling_stats_format_t format = { -40000, 125000, 1, 18 };
+    std::array<uint32_t, ROLLING_STATS_WORDS(10, 18)> storage;
+    rolling_stats_t stats;
+    int32_t value;
+    int64_t variance;
+
+    REQUIRE(rolling_stats_init(&stats, storage.data(), 10, &format) == 0);
+
+    SECTION("empty window")
+    {
+        REQUIRE(rolling_stats_average(&stats, 0, &value) == -1);
+        REQUIRE(rolling_stats_variance(&stats, 0, &variance) == -1);
+        REQUIRE(rolling_stats_max(&stats, &value) == -1);
+        REQUIRE(rolling_stats_min(&stats, &value) == -1);
+        REQUIRE(rolling_stats_last_valid(&stats, 10, &value) == -1);
+    }
+
+    SECTION("invalid samples are left out")
+    {
+        rolling_stats_push(&stats, 10);
+        rolling_stats_push(&stats, ROLLING_STATS_INVALID);
+        rolling_stats_push(&stats, 20);
+        rolling_stats_push(&stats, ROLLING_STATS_INVALID);
+
+        REQUIRE(rolling_stats_valid_count(&stats) == 2);
+        REQUIRE(rolling_stats_average(&stats, 2, &value) == 0);
+        REQUIRE(value == 15);
+        REQUIRE(rolling_stats_average(&stats, 3, &value) == -1);
+        REQUIRE(rolling_stats_variance(&stats, 0, &variance) == 0);
+        REQUIRE(variance == 25);
+        REQUIRE(rolling_stats_max(&stats, &value) == 0);
+        REQUIRE(value == 20);
+        REQUIRE(rolling_stats_min(&stats, &value) == 0);
+        REQUIRE(value == 10);
+
+        REQUIRE(rolling_stats_last_valid(&stats, 2, &value) == 0);
+        REQUIRE(value == 20);
+        REQUIRE(rolling_stats_last_valid(&stats, 1, &value) == -1);
+    }
+
+    SECTION("extremes leaving the window")
+    {
+        rolling_stats_push(&stats, 100);
+        rolling_stats_push(&stats, -100);
+        for (int i = 0; i < 9; i++)
+            rolling_stats_push(&stats, i);
+
+        REQUIRE(rolling_stats_max(&stats, &value) == 0);
+        REQUIRE(value == 8);
+        REQUIRE(rolling_stats_min(&stats, &value) == 0);
+        REQUIRE(value == -100);
+
+        rolling_stats_push(&stats, ROLLING_STATS_INVALID);
+        REQUIRE(rolling_stats_min(&stats, &value) == 0);
+        REQUIRE(value == 0);
+    }
+
+    SECTION("clear")
+    {
+        rolling_stats_push(&stats, 5);
+        rolling_stats_clear(&stats);
+        REQUIRE(rolling_stats_valid_count(&stats) == 0);
+        REQUIRE(rolling_stats_max(&stats, &value) == -1);
+        rolling_stats_push(&stats, 7);
+        REQUIRE(rolling_stats_max(&stats, &value) == 0);
+        REQUIRE(value == 7);
+    }
+
+    SECTION("matches a full rescan")
+    {
+        std::mt19937 gen(1234);
+        std::uniform_int_distribution<int32_t> dist(-40000, 125000);
+        std::deque<int32_t> window;
+
+        for (int i = 0; i < 1000; i++) {
+            int32_t sample = (gen() % 4) ? dist(gen) : ROLLING_STATS_INVALID;
+
+            rolling_stats_push(&stats, sample);
+            window.push_back(sample);
+            if (window.size() > 10)
+                window.pop_front();
+
+            int64_t n = 0, sum = 0, squares = 0;
+            int32_t max = INT32_MIN, min = INT32_MAX;
+            for (auto s: window) {
+                if (s == ROLLING_STATS_INVALID)
+                    continue;
+                n++;
+                sum += s;
+                squares += (int64_t)s * s;
+                max = std::max(max, s);
+                min = std::min(min, s);
+            }
+
+            REQUIRE(rolling_stats_valid_count(&stats) == n);
+            if (n == 0)
+                continue;
+
+            REQUIRE(rolling_stats_average(&stats, 0, &value) == 0);
+            REQUIRE(value == sum / n);
+            REQUIRE(rolling_stats_max(&stats, &value) == 0);
+            REQUIRE(value == max);
+            REQUIRE(rolling_stats_min(&stats, &value) == 0);
+            REQUIRE(value == min);
+            if (n > 1) {
+                REQUIRE(rolling_stats_variance(&stats, 0, &variance) == 0);
+                REQUIRE(variance == (n * squares - sum * sum) / (n * n));
+            }
+        }
+    }
+}
+
+TEST_CASE("Rolling stats formats", "[app][rolling stats]")
+{
+    std::array<uint32_t, ROLLING_STATS_WORDS(10, 8)> storage;
+    rolling_stats_t stats;
+    int32_t value;
+
+    SECTION("range must fit the bits")
+    {
+        static const rolling_stats_format_t too_narrow = { 0, 256, 1, 8 };
+        static const rolling_stats_format_t scaled = { 0, 2550, 10, 8 };
+
+        REQUIRE(rolling_stats_init(&stats, storage.data(), 10, &too_narrow) == -1);
+        REQUIRE(rolling_stats_init(&stats, storage.data(), 10, &scaled) == 0);
+    }
+
+    SECTION("samples that cannot be stored are invalid")
+    {
+        static const rolling_stats_format_t format = { 100, 200, 10, 8 };
+
+        REQUIRE(rolling_stats_init(&stats, storage.data(), 10, &format) == 0);
+        rolling_stats_push(&stats, 99);
+        rolling_stats_push(&stats, 201);
+        rolling_stats_push(&stats, 105);
+        REQUIRE(rolling_stats_valid_count(&stats) == 0);
+
+        rolling_stats_push(&stats, 110);
+        REQUIRE(rolling_stats_max(&stats, &value) == 0);
+        REQUIRE(value == 110);
+    }
+}
+
+/*
+ * The window sensors.c used before samples were packed: a ring of int32_t,
+ * rescanned for every average.
+ */
+struct reference_window
+{
+    std::vector<int32_t> samples;
+    size_t index = 0;
+
+    explicit reference_window(size_t capacity) : samples(capacity, ROLLING_STATS_INVALID) {}
+
+    void push(int32_t sample)
+    {
+        samples[index] = sample;
+        index = (index + 1) % samples.size();
+    }
+
+    int average(uint16_t min_valid, int32_t *avg) const
+    {
+        int valid = 0;
+        int32_t sum = 0;
+
+        for (auto s: samples) {
+            if (s == ROLLING_STATS_INVALID)
+                continue;
+            valid++;
+            sum += s;
+        }
+        if (valid == 0 || valid < min_valid)
+            return -1;
+        *avg = sum / valid;
+        return 0;
+    }
+};
+
+TEST_CASE("Rolling stats match the unpacked window", "[app][rolling stats]")
+{
+    // The sensors.c formats
+    static const rolling_stats_format_t formats[] = {
+        { 0, 100 * 1000, 1, 17 },
+        { -40 * 1000, 125 * 1000, 1, 18 },
+        { 0, 501, 1, 9 },
+        { 0, 31 * 1000, 1000, 5 },
+        { 1700, 3900, 1, 12 },
+    };
+    const uint16_t capacity = 100;
+    std::mt19937 gen(42);
+
+    for (auto &format: formats) {
+        std::vector<uint32_t> storage(ROLLING_STATS_WORDS(capacity, format.bits));
+        rolling_stats_t stats;
+        reference_window reference(capacity);
+        std::uniform_int_distribution<int32_t> dist(0, (format.max - format.min) / format.scale);
+
+        INFO("Format " << format.min << ".." << format.max);
+        REQUIRE(rolling_stats_init(&stats, storage.data(), capacity, &format) == 0);
+
+        for (int i = 0; i < 5000; i++) {
+            int32_t sample;
+
+            switch (gen() % 8) {
+            case 0:
+                sample = ROLLING_STATS_INVALID;
+                break;
+            case 1:
+                sample = (gen() % 2) ? format.min : format.max;
+                break;
+            default:
+                sample = format.min + (dist(gen) * format.scale);
+                break;
+            }
+
+            rolling_stats_push(&stats, sample);
+            reference.push(sample);
+
+            int32_t expected, value;
+            int expected_ret = reference.average(50, &expected);
+
+            REQUIRE(rolling_stats_average(&stats, 50, &value) == expected_ret);
+            if (expected_ret == 0)
+                REQUIRE(value == expected);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file sensor_schedule.c
+ *
+ *
+ */
+
+#include "sensor_schedule.h"
+
+void sensor_schedule_group(uint8_t *group, unsigned count, sensor_schedule_share_fn share)
+{
+    unsigned sensor, other;
+
+    for (sensor = 0; sensor < count; sensor++)
+        group[sensor] = sensor;
+
+    for (sensor = 0; sensor < count; sensor++) {
+        for (other = sensor + 1; other < count; other++) {
+            if (group[sensor] != group[other] && share(sensor, other)) {
+                uint8_t from = group[sensor] > group[other] ? group[sensor] : group[other];
+                uint8_t to = group[sensor] < group[other] ? group[sensor] : group[other];
+
+                for (unsigned i = 0; i < count; i++) {
+                    if (group[i] == from)
+                        group[i] = to;
+                }
+            }
+        }
+    }
+}
+
+void sensor_schedule_align(const uint8_t *group, const uint16_t *requested, uint16_t *periods, unsigned count)
+{
+    unsigned sensor, other;
+
+    for (sensor = 0; sensor < count; sensor++) {
+        uint16_t base = requested[sensor];
+        uint16_t period;
+
+        for (other = 0; other < count; other++) {
+            if (group[other] == group[sensor] && requested[other] < base)
+                base = requested[other];
+        }
+
+        period = ((requested[sensor] + (base / 2)) / base) * base;
+        periods[sensor] = period < base ? base : period;
+    }
+}
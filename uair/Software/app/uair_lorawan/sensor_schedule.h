@@ -0,0 +1,53 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file sensor_schedule.h
+ *
+ * Alignment of the sampling periods of sensors sharing a powerzone or an
+ * I2C bus, so that they are acquired in the same cycle and each zone is
+ * powered once per acquisition instead of once per sensor.
+ */
+
+#ifndef UAIR_SENSOR_SCHEDULE_H__
+#define UAIR_SENSOR_SCHEDULE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Returns true when sensors a and b share a powerzone or a bus */
+typedef bool (*sensor_schedule_share_fn)(unsigned a, unsigned b);
+
+/*
+ * Groups the sensors transitively: group[i] is the lowest index of the
+ * sensors sharing resources with sensor i, directly or not.
+ */
+void sensor_schedule_group(uint8_t *group, unsigned count, sensor_schedule_share_fn share);
+
+/*
+ * Rounds every requested period to the nearest multiple of the shortest
+ * one in its group, and never below it.
+ */
+void sensor_schedule_align(const uint8_t *group, const uint16_t *requested, uint16_t *periods, unsigned count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
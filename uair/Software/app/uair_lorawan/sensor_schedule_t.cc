@@ -0,0 +1,62 @@
+#include "sensor_schedule.h"
+
+#include <array>
+#include <cstdint>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+// REV2 board: internal temp/hum, external temp/hum, OAQ, microphone
+const int rev2_zone[] = { 0, 2, 2, 1 };
+const int rev2_bus[] = { 0, 2, 2, 1 };
+
+bool rev2_share(unsigned a, unsigned b)
+{
+    return rev2_zone[a] == rev2_zone[b] || rev2_bus[a] == rev2_bus[b];
+}
+
+// A chain: 0 shares with 1, 1 with 2, 3 alone
+bool chain_share(unsigned a, unsigned b)
+{
+    return (a + 1 == b || b + 1 == a) && a < 3 && b < 3;
+}
+
+}
+
+TEST_CASE("Sensor schedule", "[app][sensor schedule]")
+{
+    std::array<uint8_t, 4> group;
+    std::array<uint16_t, 4> periods;
+
+    SECTION("REV2: external temp/hum follows OAQ")
+    {
+        const std::array<uint16_t, 4> requested = { 32, 32, 30, 1 };
+
+        sensor_schedule_group(group.data(), group.size(), rev2_share);
+        CHECK(group == std::array<uint8_t, 4>{ 0, 1, 1, 3 });
+
+        sensor_schedule_align(group.data(), requested.data(), periods.data(), periods.size());
+        CHECK(periods == std::array<uint16_t, 4>{ 32, 30, 30, 1 });
+    }
+
+    SECTION("Sharing is transitive")
+    {
+        const std::array<uint16_t, 4> requested = { 8, 20, 5, 7 };
+
+        sensor_schedule_group(group.data(), group.size(), chain_share);
+        CHECK(group == std::array<uint8_t, 4>{ 0, 0, 0, 3 });
+
+        sensor_schedule_align(group.data(), requested.data(), periods.data(), periods.size());
+        CHECK(periods == std::array<uint16_t, 4>{ 10, 20, 5, 7 });
+    }
+
+    SECTION("Periods round to the nearest multiple, never below the shortest")
+    {
+        const std::array<uint8_t, 4> one_group = { 0, 0, 0, 0 };
+        const std::array<uint16_t, 4> requested = { 4, 5, 6, 14 };
+
+        sensor_schedule_align(one_group.data(), requested.data(), periods.data(), periods.size());
+        CHECK(periods == std::array<uint16_t, 4>{ 4, 4, 8, 16 });
+    }
+}
@@ -22,9 +22,15 @@
 
 #include "sensors.h"
 #include "controller.h"
+#include "rolling_stats.h"
+#include "adaptive_period.h"
+#include "sensor_schedule.h"
+#include "config_gc.h"
+#include "io/UAIR_config_api.h"
 
 #include "app.h"
 #include "stm32_timer.h"
+#include "stm32_seq.h"
 
 #include "UAIR_rtc.h"
 #include "UAIR_tracer.h"
@@ -54,15 +60,11 @@
 #define SAMPLE_VALID_MIN_THRESHOLD 10       /* minimum number of required valid samples to consider
                                                the overall current data of the sensor as valid */
 
-#define INVALID_SAMPLE INT_MAX
+#define INVALID_SAMPLE ROLLING_STATS_INVALID
 
 /* api definitions */
 #define NUM_API_SENSORS SENSOR_ID_RESERVED
 
-enum io_context_keys {
-    dummy = 0
-};
-
 /* internal definitions */
 typedef enum
 {
@@ -102,7 +104,12 @@ typedef struct
     BSP_sensor_state_t (*get_state)(void);
     BSP_error_t (*start_measure)(void);
     BSP_error_t (*read_measure)(void);
-    bool (*enabled_at_tick)(uint32_t tick);
+    /* Optional, fetches the measurement without blocking so read_measure() does not touch the bus */
+    BSP_error_t (*fetch_measure)(BSP_I2C_async_callback_t callback, void *userdata);
+    BSP_powerzone_t (*get_powerzone)(void);
+    BSP_I2C_busnumber_t (*get_bus)(void);
+    uint16_t period;    /* Requested sampling period, in ticks */
+    sensor_measurement_t trend; /* Drives the adaptive period, SENSOR_MEASUREMENT_SIZE to keep it fixed */
 } sensor_interface_t;
 
 typedef struct
@@ -112,11 +119,54 @@ typedef struct
     sensor_validity_t validity;
 } temp_hum_t;
 
+/*
+ * Valid range of each measurement, also how its samples are packed in the
+ * averaging window. Sound is always a whole gain step, times 1000.
+ */
+#define SAMPLE_BITS_HUM     17
+#define SAMPLE_BITS_TEMP    18
+#define SAMPLE_BITS_AQI     9
+#define SAMPLE_BITS_SOUND   5
+#define SAMPLE_BITS_BATTERY 12
+
+static const rolling_stats_format_t s_sample_formats[SENSOR_MEASUREMENT_SIZE] =
+{
+    [SENSOR_MEASUREMENT_HUM_INTERNAL]  = { .min = 0,          .max = 100 * 1000, .scale = 1,    .bits = SAMPLE_BITS_HUM },
+    [SENSOR_MEASUREMENT_TEMP_INTERNAL] = { .min = -40 * 1000, .max = 125 * 1000, .scale = 1,    .bits = SAMPLE_BITS_TEMP },
+    [SENSOR_MEASUREMENT_HUM_EXTERNAL]  = { .min = 0,          .max = 100 * 1000, .scale = 1,    .bits = SAMPLE_BITS_HUM },
+    [SENSOR_MEASUREMENT_TEMP_EXTERNAL] = { .min = -40 * 1000, .max = 125 * 1000, .scale = 1,    .bits = SAMPLE_BITS_TEMP },
+    [SENSOR_MEASUREMENT_AQI]           = { .min = 0,          .max = 501,        .scale = 1,    .bits = SAMPLE_BITS_AQI },
+    [SENSOR_MEASUREMENT_SOUND]         = { .min = 0,          .max = 31 * 1000,  .scale = 1000, .bits = SAMPLE_BITS_SOUND },
+    [SENSOR_MEASUREMENT_BATTERY]       = { .min = 1700,       .max = 3900,       .scale = 1,    .bits = SAMPLE_BITS_BATTERY },
+};
+
+/*
+ * Deviation (standard) of the recent samples below which a measurement is
+ * considered stable. Twice as much is considered fast changing.
+ */
+static const int32_t s_stable_deviation[SENSOR_MEASUREMENT_SIZE] =
+{
+    [SENSOR_MEASUREMENT_HUM_INTERNAL]  = 500,
+    [SENSOR_MEASUREMENT_TEMP_INTERNAL] = 100,
+    [SENSOR_MEASUREMENT_HUM_EXTERNAL]  = 500,
+    [SENSOR_MEASUREMENT_TEMP_EXTERNAL] = 100,
+    [SENSOR_MEASUREMENT_AQI]           = 2,
+    [SENSOR_MEASUREMENT_SOUND]         = 1000,
+    [SENSOR_MEASUREMENT_BATTERY]       = 0,
+};
+
+#define SAMPLE_WORDS(bits) ROLLING_STATS_WORDS(SAMPLE_AVG_ROTATION_THRESHOLD, bits)
+
+static uint32_t s_sample_storage[(2 * SAMPLE_WORDS(SAMPLE_BITS_HUM)) +
+                                 (2 * SAMPLE_WORDS(SAMPLE_BITS_TEMP)) +
+                                 SAMPLE_WORDS(SAMPLE_BITS_AQI) +
+                                 SAMPLE_WORDS(SAMPLE_BITS_SOUND) +
+                                 SAMPLE_WORDS(SAMPLE_BITS_BATTERY)];
+
 /* global vars */
 static struct
 {
-    int32_t rotation_index;
-    int32_t previous_values[SAMPLE_AVG_ROTATION_THRESHOLD];
+    rolling_stats_t window;
     int32_t value_avg;
     int32_t value_max;
     int32_t value_current;
@@ -133,10 +183,22 @@ static BSP_error_t external_temp_hum_read_measure(void);
 static BSP_error_t air_quality_read_measure(void);
 static BSP_error_t microphone_read_measure(void);
 
-static bool internal_temp_hum_enabled_at_tick(uint32_t ticks);
-static bool external_temp_hum_enabled_at_tick(uint32_t ticks);
-static bool air_quality_enabled_at_tick(uint32_t ticks);
-static bool microphone_enabled_at_tick(uint32_t ticks);
+#ifndef OAQ_GEN
+# error OAQ generation not defined!
+#endif
+
+#define INTERNAL_TEMP_HUM_PERIOD_TICKS 32   /* Approx. every 64 seconds */
+#define EXTERNAL_TEMP_HUM_PERIOD_TICKS 32   /* Approx. every 64 seconds */
+#if OAQ_GEN==1
+#define AIR_QUALITY_PERIOD_TICKS 30         /* One minute. TBC. */
+#define AIR_QUALITY_TREND SENSOR_MEASUREMENT_AQI
+#else
+#define AIR_QUALITY_PERIOD_TICKS 1          /* Always */
+#define AIR_QUALITY_TREND SENSOR_MEASUREMENT_SIZE /* OAQ2 requires a fixed cadence */
+#endif
+#define MICROPHONE_PERIOD_TICKS 1
+
+#define SENSOR_TICKS_PER_HOUR ((3600U * 1000U) / TEMP_HUM_SAMPLING_INTERVAL_MS)
 
 static unsigned int microphone_get_measure_delay_us(void);
 static BSP_error_t microphone_start_measurement(void);
@@ -148,28 +210,42 @@ static sensor_interface_t s_sensor_interfaces[] =
         .get_state = BSP_internal_temp_hum_get_sensor_state,
         .start_measure = BSP_internal_temp_hum_start_measure,
         .read_measure = internal_temp_hum_read_measure,
-        .enabled_at_tick = internal_temp_hum_enabled_at_tick,
+        .get_powerzone = BSP_internal_temp_hum_get_powerzone,
+        .get_bus = BSP_internal_temp_hum_get_bus,
+        .period = INTERNAL_TEMP_HUM_PERIOD_TICKS,
+        .trend = SENSOR_MEASUREMENT_TEMP_INTERNAL,
     },
     {
         .get_measure_delay_us = BSP_external_temp_hum_get_measure_delay_us,
         .get_state = BSP_external_temp_hum_get_sensor_state,
         .start_measure = BSP_external_temp_hum_start_measure,
         .read_measure = external_temp_hum_read_measure,
-        .enabled_at_tick = external_temp_hum_enabled_at_tick,
+        .fetch_measure = BSP_external_temp_hum_read_measure_async,
+        .get_powerzone = BSP_external_temp_hum_get_powerzone,
+        .get_bus = BSP_external_temp_hum_get_bus,
+        .period = EXTERNAL_TEMP_HUM_PERIOD_TICKS,
+        .trend = SENSOR_MEASUREMENT_TEMP_EXTERNAL,
     },
     {
         .get_measure_delay_us = BSP_air_quality_get_measure_delay_us,
         .get_state = BSP_air_quality_get_sensor_state,
         .start_measure = BSP_air_quality_start_measurement,
         .read_measure = air_quality_read_measure,
-        .enabled_at_tick = air_quality_enabled_at_tick,
+        .get_powerzone = BSP_air_quality_get_powerzone,
+        .get_bus = BSP_air_quality_get_bus,
+        .period = AIR_QUALITY_PERIOD_TICKS,
+        .trend = AIR_QUALITY_TREND,
     },
     {
         .get_measure_delay_us = microphone_get_measure_delay_us,
         .get_state = BSP_microphone_get_sensor_state,
         .start_measure = microphone_start_measurement,
         .read_measure = microphone_read_measure,
-        .enabled_at_tick = microphone_enabled_at_tick,
+        .fetch_measure = BSP_microphone_read_gain_async,
+        .get_powerzone = BSP_microphone_get_powerzone,
+        .get_bus = BSP_microphone_get_bus,
+        .period = MICROPHONE_PERIOD_TICKS,
+        .trend = SENSOR_MEASUREMENT_SOUND,
     },
 };
 
@@ -194,6 +270,16 @@ static enum
 } s_sensor_status[NUM_HWD_SENSORS];
 
 static int s_sensor_measuring_times[NUM_HWD_SENSORS]; // will hold delays between start measure and readout
+static uint16_t s_sensor_periods[NUM_HWD_SENSORS]; // periods actually used, see sensors_schedule_plan()
+static struct
+{
+    adaptive_period_t adaptive;     // adaptive.period is the requested period
+    uint32_t storage[ROLLING_STATS_WORDS(ADAPTIVE_PERIOD_WINDOW_SAMPLES, SAMPLE_BITS_TEMP)]; // widest format
+} s_sensor_adaptive[NUM_HWD_SENSORS];
+static adaptive_period_bounds_t s_sampling_bounds;
+static bool s_schedule_dirty;
+static bool s_powerzone_batched[UAIR_POWERZONE_MAX + 1];
+static uint32_t s_powerzone_on_time[UAIR_POWERZONE_MAX + 1]; // measured on-time at the start of the hour
 static uint32_t s_total_measure_ticks = 0;
 
 static bool s_battery_triggered = false;
@@ -255,54 +341,25 @@ static void schedule_battery_readout(int delay_to_next_sampling)
 
 static int average_calculation(sensor_measurement_t measurement, int32_t* avg)
 {
-    int i, valid_samples_count = 0;
-    int32_t sum = 0;
+    const rolling_stats_t *window = &s_sensor_data[measurement].window;
 
-    for (i = 0; i < SAMPLE_AVG_ROTATION_THRESHOLD; i++) {
-        if (s_sensor_data[measurement].previous_values[i] == INVALID_SAMPLE)
-            continue;
-
-        valid_samples_count++;
-        sum += s_sensor_data[measurement].previous_values[i];
-    }
-
-    if (valid_samples_count < SAMPLE_AVG_MIN_THRESHOLD) {
+    if (-1 == rolling_stats_average(window, SAMPLE_AVG_MIN_THRESHOLD, avg)) {
         LOG_VERBOSE("not enough valid samples\r\n");
         return -1;
     }
 
-    *avg = sum / valid_samples_count;
-
     LOG_VERBOSE("(average calculation)\r\n%s: #samples=%d sum=%d avg=%f\r\n",
                 sensor_measurement_name(measurement),
-                valid_samples_count,
-                sum,
+                rolling_stats_valid_count(window),
+                rolling_stats_sum(window),
                 (float)*avg);
     return 0;
 }
 
 static int get_valid_sample(sensor_measurement_t measurement, int32_t* value) {
 
-    int i, j;
-
-    if (s_sensor_data[measurement].value_current != INVALID_SAMPLE) {
-        *value = s_sensor_data[measurement].value_current;
-        return 0;
-    }
-
-    // return error if we didn't find a valid value in the last SAMPLE_AVG_MIN_THRESHOLD samples
-    for (i = s_sensor_data[measurement].rotation_index, j = 0; j < SAMPLE_VALID_MIN_THRESHOLD; ++j) {
-
-        if (s_sensor_data[measurement].previous_values[i] != INVALID_SAMPLE) {
-            *value = s_sensor_data[measurement].previous_values[i];
-            return 0;
-        }
-
-        if (++i == SAMPLE_AVG_ROTATION_THRESHOLD)
-            i = 0;
-    }
-
-    return -1;
+    // return error if we didn't find a valid value in the last SAMPLE_VALID_MIN_THRESHOLD samples
+    return rolling_stats_last_valid(&s_sensor_data[measurement].window, SAMPLE_VALID_MIN_THRESHOLD, value);
 }
 
 static int has_valid_sample(sensor_measurement_t measurement) {
@@ -316,65 +373,24 @@ static int validate_sample(sensor_measurement_t measurement, int32_t new_value)
      * Temporary simplistic validations
      * We should consider more elaborated heuristics for the future
      */
-    switch (measurement)
-    {
-    case SENSOR_MEASUREMENT_HUM_INTERNAL:
-        if (new_value >= 0 * 1000 && new_value <= 100 * 1000)
-            return 0;
-        break;
-
-    case SENSOR_MEASUREMENT_TEMP_INTERNAL:
-        if (new_value >= -40 * 1000 && new_value <= 125 * 1000)
-            return 0;
-        break;
-
-    case SENSOR_MEASUREMENT_HUM_EXTERNAL:
-        if (new_value >= 0 && new_value <= 100 * 1000)
-            return 0;
-        break;
-
-    case SENSOR_MEASUREMENT_TEMP_EXTERNAL:
-        if (new_value >= -40 * 1000 && new_value <= 125 * 1000)
-            return 0;
-        break;
-
-    case SENSOR_MEASUREMENT_SOUND:
-        if (new_value >= 0 && new_value <= 31 * 1000)
-            return 0;
-        break;
-
-    case SENSOR_MEASUREMENT_AQI:
-        if (new_value >= 0 && new_value <= 501)
-            return 0;
-        break;
-
-    case SENSOR_MEASUREMENT_BATTERY:
-        if (new_value >= 1700 && new_value <= 3900)
-            return 0;
-        break;
-
-    default:
+    if (measurement >= SENSOR_MEASUREMENT_SIZE)
         return -1;
-    }
+
+    if (new_value >= s_sample_formats[measurement].min && new_value <= s_sample_formats[measurement].max)
+        return 0;
 
     return -1;
 }
 
 static void process_new_value(sensor_measurement_t measurement, int32_t new_value)
 {
-    uint8_t rotation_index;
     int32_t avg;
 
-    rotation_index = s_sensor_data[measurement].rotation_index;
-    if (rotation_index >= SAMPLE_AVG_ROTATION_THRESHOLD)
-        rotation_index = 0;
-
     if (-1 == validate_sample(measurement, new_value))
         new_value = INVALID_SAMPLE;
 
     s_sensor_data[measurement].value_current = new_value;
-    s_sensor_data[measurement].previous_values[rotation_index++] = new_value;
-    s_sensor_data[measurement].rotation_index = rotation_index;
+    rolling_stats_push(&s_sensor_data[measurement].window, new_value);
 
     if (new_value == INVALID_SAMPLE)
         return;
@@ -486,6 +502,183 @@ static BSP_error_t air_quality_read_measure()
     return err;
 }
 
+static bool sensors_share_resources(unsigned a, unsigned b)
+{
+    const sensor_interface_t *ia = &s_sensor_interfaces[a];
+    const sensor_interface_t *ib = &s_sensor_interfaces[b];
+    BSP_powerzone_t zone = ia->get_powerzone();
+    BSP_I2C_busnumber_t bus = ia->get_bus();
+
+    return (zone != UAIR_POWERZONE_NONE && zone == ib->get_powerzone()) ||
+           (bus != BSP_I2C_BUS_NONE && bus == ib->get_bus());
+}
+
+/**
+ * Aligns the sampling periods of sensors sharing a powerzone or an I2C bus,
+ * see sensor_schedule.h.
+ *
+ * Runs again whenever an adaptive period changes, between acquisitions.
+ */
+static void sensors_schedule_plan(void)
+{
+    uint8_t group[HWD_SENSOR_UNIT_SIZE];
+    uint16_t requested[HWD_SENSOR_UNIT_SIZE];
+    uint16_t periods[HWD_SENSOR_UNIT_SIZE];
+
+    for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++)
+        requested[sensor] = s_sensor_adaptive[sensor].adaptive.period;
+
+    sensor_schedule_group(group, HWD_SENSOR_UNIT_SIZE, sensors_share_resources);
+    sensor_schedule_align(group, requested, periods, HWD_SENSOR_UNIT_SIZE);
+
+    for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+        if (periods[sensor] != s_sensor_periods[sensor]) {
+            LOG("%s period %u ticks (requested %u)\r\n", sensor_hwd_unit_name(sensor),
+                periods[sensor], requested[sensor]);
+        }
+        s_sensor_periods[sensor] = periods[sensor];
+    }
+    s_schedule_dirty = false;
+}
+
+/* Sensors without a trend keep their period whatever the bounds */
+static const adaptive_period_bounds_t *sensor_sampling_bounds(hwd_sensor_unit_t sensor)
+{
+    static const adaptive_period_bounds_t fixed = { 0, 0 };
+
+    return s_sensor_interfaces[sensor].trend != SENSOR_MEASUREMENT_SIZE ? &s_sampling_bounds : &fixed;
+}
+
+/*
+ * Adaptive sampling stays off unless both bounds are stored, and form a
+ * valid range. A longest period of 0 turns it off.
+ */
+static void sensors_sampling_bounds_load(void)
+{
+    uint8_t min_ticks;
+    uint8_t max_ticks;
+
+    s_sampling_bounds.min_ticks = 0;
+    s_sampling_bounds.max_ticks = 0;
+
+    if (uair_config_read_uint8(UAIR_CONFIG_ID_SAMPLING_MIN_TICKS, &min_ticks) != UAIR_IO_CONTEXT_ERROR_NONE ||
+        uair_config_read_uint8(UAIR_CONFIG_ID_SAMPLING_MAX_TICKS, &max_ticks) != UAIR_IO_CONTEXT_ERROR_NONE)
+        return;
+
+    if (max_ticks == 0)
+        return;
+
+    if (min_ticks == 0 || max_ticks < min_ticks) {
+        LOG("invalid sampling bounds %u..%u ticks\r\n", min_ticks, max_ticks);
+        return;
+    }
+
+    LOG("adaptive sampling within %u..%u ticks\r\n", min_ticks, max_ticks);
+    s_sampling_bounds.min_ticks = min_ticks;
+    s_sampling_bounds.max_ticks = max_ticks;
+}
+
+/* Restarts every period from its nominal value under the current bounds */
+static void sensors_adaptive_reset(void)
+{
+    for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+        adaptive_period_reset(&s_sensor_adaptive[sensor].adaptive, s_sensor_interfaces[sensor].period,
+                              sensor_sampling_bounds(sensor));
+    }
+    s_schedule_dirty = true;
+}
+
+/* Feeds the new sample to the adaptive period, see adaptive_period.h */
+static void sensor_adapt_period(hwd_sensor_unit_t sensor)
+{
+    sensor_measurement_t trend = s_sensor_interfaces[sensor].trend;
+    uint16_t period = s_sensor_adaptive[sensor].adaptive.period;
+
+    if (trend == SENSOR_MEASUREMENT_SIZE ||
+        !adaptive_period_push(&s_sensor_adaptive[sensor].adaptive, s_sensor_data[trend].value_current, &s_sampling_bounds))
+        return;
+
+    LOG_VERBOSE("%s period %u -> %u ticks\r\n", sensor_hwd_unit_name(sensor),
+                period, s_sensor_adaptive[sensor].adaptive.period);
+    s_schedule_dirty = true;
+}
+
+static bool sensor_enabled_at_tick(hwd_sensor_unit_t sensor, uint32_t ticks)
+{
+    return (ticks % s_sensor_periods[sensor]) == 0;
+}
+
+/*
+ * Holds every zone with a sensor due this tick for the whole acquisition.
+ * This only switches a zone off between acquisitions once no driver holds
+ * its own reference, which the sensor drivers currently keep from init.
+ */
+static void sensors_powerzones_batch_ref(uint32_t ticks)
+{
+    for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+        BSP_powerzone_t zone = s_sensor_interfaces[sensor].get_powerzone();
+
+        if (zone == UAIR_POWERZONE_NONE || s_powerzone_batched[zone] || !sensor_enabled_at_tick(sensor, ticks))
+            continue;
+
+        if (BSP_powerzone_ref(zone) == BSP_ERROR_NONE)
+            s_powerzone_batched[zone] = true;
+        else
+            LOG("cannot power zone %d\r\n", zone);
+    }
+}
+
+static void sensors_powerzones_batch_unref(void)
+{
+    for (BSP_powerzone_t zone = 0; zone <= UAIR_POWERZONE_MAX; zone++) {
+        if (s_powerzone_batched[zone]) {
+            BSP_powerzone_unref(zone);
+            s_powerzone_batched[zone] = false;
+        }
+    }
+}
+
+uint32_t UAIR_sensors_estimate_powerzone_on_time(BSP_powerzone_t zone)
+{
+    uint32_t on_time = 0;
+
+    for (uint32_t tick = 0; tick < SENSOR_TICKS_PER_HOUR; tick++) {
+        unsigned int longest = 0;
+        bool due = false;
+
+        for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+            const sensor_interface_t *intf = &s_sensor_interfaces[sensor];
+
+            if (intf->get_powerzone() != zone || !sensor_enabled_at_tick(sensor, tick) ||
+                intf->get_state() != SENSOR_AVAILABLE)
+                continue;
+
+            due = true;
+            if ((intf->get_measure_delay_us() + 999) / 1000 > longest)
+                longest = (intf->get_measure_delay_us() + 999) / 1000;
+        }
+
+        if (due)
+            on_time += 1 + longest; // Same margin as the measure timer
+    }
+    return on_time;
+}
+
+/* Once an hour of ticks, how long each zone was actually powered against the estimate */
+static void sensors_powerzones_log_on_time(void)
+{
+    if ((s_total_measure_ticks % SENSOR_TICKS_PER_HOUR) != 0)
+        return;
+
+    for (BSP_powerzone_t zone = 0; zone <= UAIR_POWERZONE_MAX; zone++) {
+        uint32_t on_time = BSP_powerzone_get_on_time(zone);
+
+        LOG("powerzone %d: on-time %lu ms over the last hour, estimated %lu\r\n", zone,
+            on_time - s_powerzone_on_time[zone], UAIR_sensors_estimate_powerzone_on_time(zone));
+        s_powerzone_on_time[zone] = on_time;
+    }
+}
+
 /**
  * @return delay or
  * -1 if no delay is applicable
@@ -504,7 +697,7 @@ static int sensor_start_measuring(hwd_sensor_unit_t sensor)
 
     if (internal_sensor_state == SENSOR_AVAILABLE) {
 
-        if (intf->enabled_at_tick(s_total_measure_ticks))
+        if (sensor_enabled_at_tick(sensor, s_total_measure_ticks))
         {
             err = intf->start_measure();
             if (BSP_ERROR_NONE == err) {
@@ -585,160 +778,258 @@ static void sensor_read_and_process(hwd_sensor_unit_t sensor)
     intf->read_measure();
     s_sensor_measuring_times[sensor] = -1;
     s_sensor_status[sensor] = SENSOR_IDLE;
+    sensor_adapt_period(sensor);
 }
 
 #if (! defined(RELEASE)) || (RELEASE==0)
 
+/* Line prefix, as LOG() prints it */
+#define PRINT_SENSORS_PREFIX_LEN (1 + 10 + 11)
+#define PRINT_SENSORS_VALUE_LEN  (12)
+
+static int print_sensors_begin(UAIR_tracer_writer_t *w, uint16_t length)
+{
+    if (UAIR_TRACER_Writer_Begin(w, ADV_TRACER_VLEVEL_M, PRINT_SENSORS_PREFIX_LEN + length) != 0)
+        return -1;
+
+    UAIR_TRACER_Writer_Char(w, '[');
+    UAIR_TRACER_Writer_Dec(w, (int32_t)HAL_GetTick(), 10);
+    UAIR_TRACER_Writer_Str(w, "] SENSORS: ");
+    return 0;
+}
+
+static void print_sensors_value(UAIR_tracer_writer_t *w, unsigned measurement, int32_t value)
+{
+    if (value == INVALID_SAMPLE)
+        UAIR_TRACER_Writer_Str(w, "NaN");
+    else if (measurement == SENSOR_MEASUREMENT_AQI)
+        UAIR_TRACER_Writer_Dec(w, value, 1);
+    else
+        UAIR_TRACER_Writer_Milli(w, value);
+}
+
 static void print_sensors()
 {
-    int i, j;
+    UAIR_tracer_writer_t w;
     uint16_t mseconds;
     uint32_t seconds = UAIR_RTC_GetTime(&mseconds);
 
-    char bufs[3 * SENSOR_MEASUREMENT_SIZE][32];
-    for (i = 0; i < SENSOR_MEASUREMENT_SIZE; i++) {
-
-        j = 3 * i;
-        if (s_sensor_data[i].value_current == INVALID_SAMPLE)
-            strcpy((char*)(bufs + j), "NaN");
-        else {
-            if (i == SENSOR_MEASUREMENT_AQI)
-                snprintf((char*)(bufs + j), 32, "%ld", (long)s_sensor_data[i].value_current);
-            else
-                snprintf((char*)(bufs + j), 32, "%f.02", (float)s_sensor_data[i].value_current / 1000.0);
-        }
-
-        j++;
-        if (s_sensor_data[i].value_avg == INVALID_SAMPLE)
-            strcpy((char*)(bufs + j), "NaN");
-        else {
-            if (i == SENSOR_MEASUREMENT_AQI)
-                snprintf((char*)(bufs + j), 32, "%ld", (long)s_sensor_data[i].value_avg);
-            else
-                snprintf((char*)(bufs + j), 32, "%.02f", (float)s_sensor_data[i].value_avg / 1000.0);
-        }
+    if (print_sensors_begin(&w, 10) == 0) {
+        UAIR_TRACER_Writer_Str(&w, "Summary:\r\n");
+        UAIR_TRACER_Writer_End(&w);
+    }
 
-        j++;
-        if (s_sensor_data[i].value_max == INVALID_SAMPLE)
-            strcpy((char*)(bufs + j), "NaN");
-        else {
-            if (i == SENSOR_MEASUREMENT_AQI)
-                snprintf((char*)(bufs + j), 32, "%ld", (long)s_sensor_data[i].value_max);
-            else
-                snprintf((char*)(bufs + j), 32, "%.02f", (float)s_sensor_data[i].value_max / 1000.0);
-        }
+    if (print_sensors_begin(&w, 10 + 11 + 1 + 3 + 2) == 0) {
+        UAIR_TRACER_Writer_Str(&w, "time (s): ");
+        UAIR_TRACER_Writer_Dec(&w, (int32_t)seconds, 1);
+        UAIR_TRACER_Writer_Char(&w, '.');
+        UAIR_TRACER_Writer_Dec(&w, mseconds, 3);
+        UAIR_TRACER_Writer_Str(&w, "\r\n");
+        UAIR_TRACER_Writer_End(&w);
     }
 
-    LOG("Summary:\r\n");
-    LOG("time (s): %d.%d\r\n", seconds, mseconds);
-    for (unsigned m = 0; m<SENSOR_MEASUREMENT_SIZE; m++) {
-        LOG("%s: current=%s avg=%s max=%s\r\n",
-            sensor_measurement_name(m),
-            bufs[3 * m],
-            bufs[3 * m + 1],
-            bufs[3 * m + 2]);
+    for (unsigned m = 0; m < SENSOR_MEASUREMENT_SIZE; m++) {
+        const char *name = sensor_measurement_name(m);
+
+        if (print_sensors_begin(&w, strlen(name) + 2 + 8 + 5 + 5 + (3 * PRINT_SENSORS_VALUE_LEN) + 2) != 0)
+            continue;
+
+        UAIR_TRACER_Writer_Str(&w, name);
+        UAIR_TRACER_Writer_Str(&w, ": current=");
+        print_sensors_value(&w, m, s_sensor_data[m].value_current);
+        UAIR_TRACER_Writer_Str(&w, " avg=");
+        print_sensors_value(&w, m, s_sensor_data[m].value_avg);
+        UAIR_TRACER_Writer_Str(&w, " max=");
+        print_sensors_value(&w, m, s_sensor_data[m].value_max);
+        UAIR_TRACER_Writer_Str(&w, "\r\n");
+        UAIR_TRACER_Writer_End(&w);
     }
 }
 
 #endif
 
-static void on_measure_timer_event(void __attribute__((unused)) *data)
+static void sensors_acquire_next(void)
 {
     int time_required;
-    unsigned sensor;
+    hwd_sensor_unit_t next_sensor;
 
-#if !defined(RELEASE) || (RELEASE==0)
-    uint32_t ticks = HAL_GetTick();
-    LOG("ticks: %d - measure ticks %d\r\n", ticks, s_total_measure_ticks);
+    next_sensor = next_sensor_to_read(s_time_elapsed, &time_required);
+
+    if (next_sensor == HWD_SENSOR_UNIT_NONE) {
+        // all sensors done.
+#if (!defined RELEASE) && (RELEASE==0)
+        print_sensors();
 #endif
+        sensors_powerzones_batch_unref();
+        sensor_end_measure_callback();
+        s_sensor_measure_state = SENSOR_MEASURE_STATE_IDLE;
+
+        LOG("delay measure in %d ms\r\n", TEMP_HUM_SAMPLING_INTERVAL_MS - s_time_elapsed);
+        // Increase number of ticks.
+        s_total_measure_ticks++;
+        sensors_powerzones_log_on_time();
+
+        // Periods only change between acquisitions
+        if (s_schedule_dirty)
+            sensors_schedule_plan();
+
+        UTIL_TIMER_SetPeriod(&s_measure_timer, TEMP_HUM_SAMPLING_INTERVAL_MS - s_time_elapsed);
+        // Schedule a battery readout if required
+        schedule_battery_readout( TEMP_HUM_SAMPLING_INTERVAL_MS - s_time_elapsed );
+    } else {
+        LOG("next sensor measure in %d ms\r\n", time_required);
+        s_sensor_measure_state = SENSOR_MEASURE_STATE_ACQUIRE;
+        s_time_elapsed += time_required;
+        s_current_sensor = next_sensor;
+        UTIL_TIMER_SetPeriod(&s_measure_timer, 1 + time_required); // give some margin
+    }
 
-    switch (s_sensor_measure_state) {
-    case SENSOR_MEASURE_STATE_IDLE:
-        sensor_start_measure_callback();
-        UAIR_BSP_watchdog_kick();
+    UTIL_TIMER_Start(&s_measure_timer);
+}
 
-        /* Check if any sensor is pending read */
-        for (sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+static void sensor_fetch_done(void __attribute__((unused)) *userdata, BSP_error_t err)
+{
+    if (err == BSP_ERROR_NONE) {
+        sensor_read_and_process(s_current_sensor);
+    } else {
+        LOG("error: cannot fetch %s\r\n", sensor_hwd_unit_name(s_current_sensor));
+        s_sensor_measuring_times[s_current_sensor] = -1;
+        s_sensor_status[s_current_sensor] = SENSOR_IDLE;
+    }
+    sensors_acquire_next();
+}
 
-            sensor_interface_t *intf = &s_sensor_interfaces[sensor];
+/* Returns 0 if the readout continues in the callback, -1 to read synchronously */
+static int sensor_fetch(hwd_sensor_unit_t sensor, BSP_I2C_async_callback_t callback)
+{
+    sensor_interface_t *intf = &s_sensor_interfaces[sensor];
 
-            if (intf->enabled_at_tick(s_total_measure_ticks)) {
-                if (s_sensor_measuring_times[sensor] == 0) {
-                    sensor_read_and_process(sensor);
-                    s_sensor_measuring_times[sensor] = -1;
-                }
-            }
-        }
+    if (intf->fetch_measure == NULL)
+        return -1;
 
-        /* Start all sensors at same time if they are enabled */
-        for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
-            if (s_sensor_interfaces[sensor].enabled_at_tick(s_total_measure_ticks)) {
+    return (intf->fetch_measure(callback, NULL) == BSP_ERROR_NONE) ? 0 : -1;
+}
 
-                LOG("start measure %s\r\n", sensor_hwd_unit_name(sensor));
-                s_sensor_measuring_times[sensor] = sensor_start_measuring(sensor);
+/* Starts the sensors due at this tick and schedules the first readout */
+static void sensors_start_all(void)
+{
+    int time_required;
 
-            }
-        }
+    /* Start all sensors at same time if they are enabled */
+    for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+        if (sensor_enabled_at_tick(sensor, s_total_measure_ticks)) {
 
-        s_time_elapsed = 0;
-        hwd_sensor_unit_t next_sensor = next_sensor_to_read(s_time_elapsed, &time_required);
+            LOG("start measure %s\r\n", sensor_hwd_unit_name(sensor));
+            s_sensor_measuring_times[sensor] = sensor_start_measuring(sensor);
 
-        if (next_sensor == HWD_SENSOR_UNIT_NONE) {
-            LOG("warn: no sensors available!\r\n");
+        }
+    }
 
-            // Increase number of ticks.
-            s_total_measure_ticks++;
+    s_time_elapsed = 0;
+    hwd_sensor_unit_t next_sensor = next_sensor_to_read(s_time_elapsed, &time_required);
 
-            UTIL_TIMER_SetPeriod(&s_measure_timer, TEMP_HUM_SAMPLING_INTERVAL_MS);
-            UTIL_TIMER_Start(&s_measure_timer);
-            break;
-        }
+    if (next_sensor == HWD_SENSOR_UNIT_NONE) {
+        LOG("warn: no sensors available!\r\n");
+        sensors_powerzones_batch_unref();
 
-        s_current_sensor = next_sensor;
+        // Increase number of ticks.
+        s_total_measure_ticks++;
+        sensors_powerzones_log_on_time();
 
-        LOG("next sensor measure in %d ms\r\n", time_required);
+        if (s_schedule_dirty)
+            sensors_schedule_plan();
 
-        UTIL_TIMER_SetPeriod(&s_measure_timer, 1 + time_required); // give some margin
+        UTIL_TIMER_SetPeriod(&s_measure_timer, TEMP_HUM_SAMPLING_INTERVAL_MS);
         UTIL_TIMER_Start(&s_measure_timer);
+        return;
+    }
 
-        s_sensor_measure_state = SENSOR_MEASURE_STATE_ACQUIRE;
-        s_time_elapsed += time_required; // Take note on time used
+    s_current_sensor = next_sensor;
 
-        break;
+    LOG("next sensor measure in %d ms\r\n", time_required);
 
-    case SENSOR_MEASURE_STATE_ACQUIRE:
-        LOG("Read sensor %s\r\n", sensor_hwd_unit_name(s_current_sensor));
-        // Assumption is we have s_current_sensor.
+    UTIL_TIMER_SetPeriod(&s_measure_timer, 1 + time_required); // give some margin
+    UTIL_TIMER_Start(&s_measure_timer);
+
+    s_sensor_measure_state = SENSOR_MEASURE_STATE_ACQUIRE;
+    s_time_elapsed += time_required; // Take note on time used
+}
+
+static void sensor_preread_done(void *userdata, BSP_error_t err);
+
+/*
+ * Reads the sensors sampled over the previous interval (no measure delay).
+ * Returns 0 if the readout continues in sensor_preread_done(), -1 once all are read.
+ */
+static int sensors_preread(void)
+{
+    for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+
+        if (sensor_enabled_at_tick(sensor, s_total_measure_ticks)) {
+            if (s_sensor_measuring_times[sensor] == 0) {
+                s_current_sensor = sensor;
+                if (sensor_fetch(sensor, &sensor_preread_done) == 0)
+                    return 0;
+                sensor_read_and_process(sensor);
+            }
+        }
+    }
+    return -1;
+}
+
+static void sensor_preread_done(void __attribute__((unused)) *userdata, BSP_error_t err)
+{
+    if (err == BSP_ERROR_NONE) {
         sensor_read_and_process(s_current_sensor);
+    } else {
+        LOG("error: cannot fetch %s\r\n", sensor_hwd_unit_name(s_current_sensor));
+        s_sensor_measuring_times[s_current_sensor] = -1;
+        s_sensor_status[s_current_sensor] = SENSOR_IDLE;
+    }
 
-        next_sensor = next_sensor_to_read(s_time_elapsed, &time_required);
+    if (sensors_preread() == 0)
+        return;
 
-        if (next_sensor == HWD_SENSOR_UNIT_NONE) {
-            // all sensors done.
-#if (!defined RELEASE) && (RELEASE==0)
-            print_sensors();
+    sensors_start_all();
+}
+
+static void sensors_i2c_completion_notify(void)
+{
+    UTIL_SEQ_SetTask((1 << CFG_SEQ_Task_SensorsI2C), CFG_SEQ_Prio_0);
+}
+
+static void on_measure_timer_event(void __attribute__((unused)) *data)
+{
+#if !defined(RELEASE) || (RELEASE==0)
+    uint32_t ticks = HAL_GetTick();
+    LOG("ticks: %d - measure ticks %d\r\n", ticks, s_total_measure_ticks);
 #endif
-            sensor_end_measure_callback();
-            s_sensor_measure_state = SENSOR_MEASURE_STATE_IDLE;
 
-            LOG("delay measure in %d ms\r\n", TEMP_HUM_SAMPLING_INTERVAL_MS - s_time_elapsed);
-            // Increase number of ticks.
-            s_total_measure_ticks++;
+    switch (s_sensor_measure_state) {
+    case SENSOR_MEASURE_STATE_IDLE:
+        sensor_start_measure_callback();
+        UAIR_BSP_watchdog_kick();
 
-            UTIL_TIMER_SetPeriod(&s_measure_timer, TEMP_HUM_SAMPLING_INTERVAL_MS - s_time_elapsed);
-            // Schedule a battery readout if required
-            schedule_battery_readout( TEMP_HUM_SAMPLING_INTERVAL_MS - s_time_elapsed );
-        } else {
-            LOG("next sensor measure in %d ms\r\n", time_required);
-            s_sensor_measure_state = SENSOR_MEASURE_STATE_ACQUIRE;
-            s_time_elapsed += time_required;
-            s_current_sensor = next_sensor;
-            UTIL_TIMER_SetPeriod(&s_measure_timer, 1 + time_required); // give some margin
-        }
+        sensors_powerzones_batch_ref(s_total_measure_ticks);
 
-        UTIL_TIMER_Start(&s_measure_timer);
+        /* Check if any sensor is pending read */
+        if (sensors_preread() == 0) {
+            // Continues in sensor_preread_done()
+            break;
+        }
 
+        sensors_start_all();
+        break;
 
+    case SENSOR_MEASURE_STATE_ACQUIRE:
+        LOG("Read sensor %s\r\n", sensor_hwd_unit_name(s_current_sensor));
+        // Assumption is we have s_current_sensor.
+        if (sensor_fetch(s_current_sensor, &sensor_fetch_done) == 0) {
+            // Continues in sensor_fetch_done()
+            break;
+        }
+        sensor_read_and_process(s_current_sensor);
+        sensors_acquire_next();
         break;
     }
 
@@ -835,7 +1126,8 @@ static void battery_enable_timer_event(void __attribute__((unused)) *data)
 
 sensors_op_result_t UAIR_sensors_init(void)
 {
-    int i, j;
+    int i;
+    size_t storage_used = 0;
 
     if (SAMPLE_AVG_ROTATION_THRESHOLD < SAMPLE_AVG_MIN_THRESHOLD) {
         LOG("fatal: SAMPLE_AVG_ROTATION_THRESHOLD < SAMPLE_AVG_MIN_THRESHOLD\r\n");
@@ -843,21 +1135,44 @@ sensors_op_result_t UAIR_sensors_init(void)
     }
 
     for (i = 0; i < SENSOR_MEASUREMENT_SIZE; ++i) {
-        s_sensor_data[i].rotation_index = 0;
+        if (storage_used + SAMPLE_WORDS(s_sample_formats[i].bits) > sizeof(s_sample_storage) / sizeof(s_sample_storage[0]) ||
+            -1 == rolling_stats_init(&s_sensor_data[i].window, &s_sample_storage[storage_used], SAMPLE_AVG_ROTATION_THRESHOLD, &s_sample_formats[i])) {
+            LOG("fatal: bad sample format for %s\r\n", sensor_measurement_name(i));
+            return SENSORS_OP_FAIL;
+        }
+        storage_used += SAMPLE_WORDS(s_sample_formats[i].bits);
+
         s_sensor_data[i].value_avg = INVALID_SAMPLE;
         s_sensor_data[i].value_max = INVALID_SAMPLE;
         s_sensor_data[i].value_current = INVALID_SAMPLE;
-
-        for (j = 0; j < SAMPLE_AVG_ROTATION_THRESHOLD; j++)
-            s_sensor_data[i].previous_values[j] = INVALID_SAMPLE;
     }
 
     for (unsigned sensor = 0; sensor < HWD_SENSOR_UNIT_SIZE; sensor++) {
+        sensor_measurement_t trend = s_sensor_interfaces[sensor].trend;
+
         s_sensor_measuring_times[sensor] = -1;
+        if (trend != SENSOR_MEASUREMENT_SIZE &&
+            -1 == adaptive_period_init(&s_sensor_adaptive[sensor].adaptive, s_sensor_adaptive[sensor].storage,
+                                       &s_sample_formats[trend], s_stable_deviation[trend])) {
+            LOG("fatal: bad trend format for %s\r\n", sensor_hwd_unit_name(sensor));
+            return SENSORS_OP_FAIL;
+        }
+    }
+
+    sensors_sampling_bounds_load();
+    sensors_adaptive_reset();
+    sensors_schedule_plan();
+
+    for (BSP_powerzone_t zone = 0; zone <= UAIR_POWERZONE_MAX; zone++) {
+        s_powerzone_on_time[zone] = BSP_powerzone_get_on_time(zone);
+        LOG("powerzone %d: estimated on-time %lu ms/hour\r\n", zone, UAIR_sensors_estimate_powerzone_on_time(zone));
     }
 
     s_sensor_measure_state = SENSOR_MEASURE_STATE_IDLE;
 
+    UTIL_SEQ_RegTask((1 << CFG_SEQ_Task_SensorsI2C), UTIL_SEQ_RFU, BSP_I2C_process_completions);
+    BSP_I2C_set_completion_notify(&sensors_i2c_completion_notify);
+
     UTIL_TIMER_Create(&s_measure_timer, 0xFFFFFFFFU, UTIL_TIMER_ONESHOT, on_measure_timer_event, NULL);
     UTIL_TIMER_SetPeriod(&s_measure_timer, TEMP_HUM_SAMPLING_INTERVAL_MS);
     UTIL_TIMER_Start(&s_measure_timer);
@@ -880,7 +1195,6 @@ void UAIR_sensors_clear_measures()
 void UAIR_sensors_clear_measures_id(sensor_id_t id)
 {
     sensor_measurement_t measurement;
-    int j;
 
     switch (id)
     {
@@ -917,13 +1231,10 @@ void UAIR_sensors_clear_measures_id(sensor_id_t id)
         return;
     }
 
-    s_sensor_data[measurement].rotation_index = 0;
+    rolling_stats_clear(&s_sensor_data[measurement].window);
     s_sensor_data[measurement].value_avg = INVALID_SAMPLE;
     s_sensor_data[measurement].value_max = INVALID_SAMPLE;
     s_sensor_data[measurement].value_current = INVALID_SAMPLE;
-
-    for (j = 0; j < SAMPLE_AVG_ROTATION_THRESHOLD; j++)
-        s_sensor_data[measurement].previous_values[j] = INVALID_SAMPLE;
 }
 
 sensors_op_result_t UAIR_sensors_read_measure(sensor_id_t id, uint16_t* value)
@@ -1002,7 +1313,22 @@ sensors_op_result_t UAIR_sensors_read_measure(sensor_id_t id, uint16_t* value)
 
 void UAIR_sensors_set_config_param_uint8(config_key_t key, uint8_t value)
 {
-    // TBD
+    switch (key) {
+    case UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MIN_TICKS:
+    case UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MAX_TICKS:
+        if (uair_config_write_uint8((uair_config_id)key, value) != UAIR_IO_CONTEXT_ERROR_NONE) {
+            LOG("cannot store sampling bound %d\r\n", key);
+            return;
+        }
+        UAIR_config_gc_request();
+        sensors_sampling_bounds_load();
+        sensors_adaptive_reset();
+        break;
+
+    default:
+        // TBD
+        break;
+    }
 }
 
 void UAIR_sensors_set_config_param_uint16(config_key_t key, uint16_t value)
@@ -1040,17 +1366,6 @@ void UAIR_sensors_audit_unregister_listener_id(sensor_id_t id)
     s_audit_listeners[id].userdata = NULL;
 }
 
-static bool internal_temp_hum_enabled_at_tick(uint32_t ticks)
-{
-    // Approx. every 64 seconds (32 ticks)
-    return (ticks % 32) == 0;
-}
-
-static bool microphone_enabled_at_tick(uint32_t ticks)
-{
-    return 1;
-}
-
 static BSP_error_t microphone_start_measurement()
 {
     return BSP_ERROR_NONE;
@@ -1074,24 +1389,3 @@ static unsigned int microphone_get_measure_delay_us(void)
     return 0; // Pre-read
 }
 
-
-static bool external_temp_hum_enabled_at_tick(uint32_t ticks)
-{
-    // Approx. every 64 seconds (32 ticks)
-    return (ticks % 32) == 0;
-}
-
-#ifndef OAQ_GEN
-# error OAQ generation not defined!
-#endif
-
-static bool air_quality_enabled_at_tick(uint32_t ticks)
-{
-#if OAQ_GEN==1
-    // Every 30 ticks (one minute). TBC.
-    return (ticks % 30) == 0;
-#else
-    // Always
-    return true;
-#endif
-}
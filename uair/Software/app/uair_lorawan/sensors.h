@@ -24,6 +24,7 @@
 #define SENSORS_H__
 
 #include "UAIR_BSP_air_quality.h"
+#include "io/UAIR_io_config.h"
 
 typedef enum
 {
@@ -46,7 +47,7 @@ typedef enum
     SENSORS_OP_FAIL = 1,
 } sensors_op_result_t;
 
-typedef enum io_context_keys config_key_t;
+typedef uair_io_context_keys config_key_t;
 
 typedef void (*audit_event_cb_t)(void *userdata, uint8_t audit_type);
 
@@ -57,6 +58,18 @@ typedef void (*audit_event_cb_t)(void *userdata, uint8_t audit_type);
  */
 sensors_op_result_t UAIR_sensors_init(void);
 
+/**
+ * @brief Estimated on-time of a powerzone under the sampling schedule
+ *
+ * Assumes the zone is only powered while its sensors are acquired. Drivers
+ * holding their own reference keep it on longer, see
+ * BSP_powerzone_get_on_time() for the measured time.
+ *
+ * @param zone powerzone
+ * @return milliseconds per hour spent acquiring sensors in the zone
+ */
+uint32_t UAIR_sensors_estimate_powerzone_on_time(BSP_powerzone_t zone);
+
 /**
  * @brief Clears all the collected data for all sensors
  */
@@ -80,6 +93,10 @@ sensors_op_result_t UAIR_sensors_read_measure(sensor_id_t id, uint16_t* value);
 /**
  * @brief Set config parameter
  *
+ * The sampling bounds (UAIR_IO_CONTEXT_KEY_CONFIG_SAMPLING_MIN_TICKS/MAX_TICKS)
+ * are stored and enable adaptive sampling once both form a valid range, a
+ * longest period of 0 turns it off. Set from the sampling bounds downlink.
+ *
  * @param key key for the affected parameter
  * @param value new value for the affected parameter
  */
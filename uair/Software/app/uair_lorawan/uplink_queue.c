@@ -0,0 +1,140 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file uplink_queue.c
+ *
+ *
+ */
+
+#include "uplink_queue.h"
+#include "lora_app.h"
+#include "io/UAIR_io_queue.h"
+
+#include "app.h"
+#include "BSP.h"
+#include "stm32_timer.h"
+#include "stm32_seq.h"
+#include "LmHandler.h"
+
+/*
+ * Payloads are pushed to the flash queue and disposed of once sent, so a reset
+ * sends again at most the batch that was in flight.
+ */
+
+/* Spacing between batches when the duty cycle allows sooner, keeps the backlog within fair use */
+#define UPLINK_QUEUE_BATCH_INTERVAL_MS  60000U
+
+static UTIL_TIMER_Object_t s_drain_timer;
+static bool s_has_backlog;
+
+/* Kept off the stack, only used from sequencer tasks */
+static uint8_t s_frame[UAIR_IO_QUEUE_MAX_SIZE];
+
+static bool uplink_queue_has_backlog(void)
+{
+    uair_io_context ctx;
+
+    UAIR_io_init_ctx(&ctx);
+    return (UAIR_io_queue_peek(&ctx) != 0);
+}
+
+static void uplink_queue_schedule(uint32_t delay_ms)
+{
+    UTIL_TIMER_Stop(&s_drain_timer);
+    UTIL_TIMER_SetPeriod(&s_drain_timer, delay_ms);
+    UTIL_TIMER_Start(&s_drain_timer);
+}
+
+static void uplink_queue_drain_task(void)
+{
+    uint32_t next_tx_ms = 0;
+    uair_io_context ctx;
+    int frame_size;
+    int last_id;
+
+    /* Otherwise picked up again at the next transmit event */
+    if (!s_has_backlog || LmHandlerJoinStatus() != LORAMAC_HANDLER_SET || !BSP_network_enabled())
+        return;
+
+    /* oldest first, as many as the largest frame allowed holds */
+    UAIR_io_init_ctx(&ctx);
+    frame_size = UAIR_io_queue_pack(&ctx, s_frame, UAIR_lora_max_payload(), &last_id);
+    if (frame_size == 0) {
+        /* a payload larger than the current datarate allows waits for a better one */
+        if (ctx.error != UAIR_IO_CONTEXT_ERROR_NONE)
+            APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "backlog not read, error %d\r\n", ctx.error);
+        s_has_backlog = uplink_queue_has_backlog();
+        return;
+    }
+
+    APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "backlog: sending %d payloads up to %d, %d bytes\r\n", s_frame[0], last_id, frame_size);
+
+    if (!UAIR_lora_send_port(SENSORS_BACKLOG_APP_PORT, s_frame, (uint8_t)frame_size, &next_tx_ms)) {
+        if (next_tx_ms > 0)
+            uplink_queue_schedule(next_tx_ms);
+        return;
+    }
+
+    /* Not fatal, the batch would be sent again */
+    UAIR_io_queue_dispose(&ctx, last_id);
+    if (ctx.error != UAIR_IO_CONTEXT_ERROR_NONE)
+        APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "backlog not disposed of, error %d\r\n", ctx.error);
+
+    s_has_backlog = uplink_queue_has_backlog();
+    if (s_has_backlog)
+        uplink_queue_schedule((next_tx_ms > UPLINK_QUEUE_BATCH_INTERVAL_MS) ? next_tx_ms : UPLINK_QUEUE_BATCH_INTERVAL_MS);
+}
+
+static void uplink_queue_timer_event(void *context)
+{
+    UAIR_uplink_queue_drain();
+}
+
+void UAIR_uplink_queue_init(void)
+{
+    uair_io_context ctx;
+
+    UAIR_io_init_ctx(&ctx);
+    UAIR_io_queue_init(&ctx);
+    s_has_backlog = uplink_queue_has_backlog();
+
+    UTIL_SEQ_RegTask((1 << CFG_SEQ_Task_UplinkQueue), UTIL_SEQ_RFU, uplink_queue_drain_task);
+    UTIL_TIMER_Create(&s_drain_timer, 0xFFFFFFFFU, UTIL_TIMER_ONESHOT, uplink_queue_timer_event, NULL);
+}
+
+bool UAIR_uplink_queue_push(const uint8_t *payload, uint8_t len)
+{
+    uair_io_context ctx;
+
+    UAIR_io_init_ctx(&ctx);
+    if (UAIR_io_queue_push(&ctx, payload, len) == 0) {
+        APP_LOG(ADV_TRACER_TS_OFF, ADV_TRACER_VLEVEL_M, "payload not queued, error %d\r\n", ctx.error);
+        return false;
+    }
+
+    s_has_backlog = true;
+    return true;
+}
+
+bool UAIR_uplink_queue_is_empty(void)
+{
+    return !s_has_backlog;
+}
+
+void UAIR_uplink_queue_drain(void)
+{
+    UTIL_SEQ_SetTask((1 << CFG_SEQ_Task_UplinkQueue), CFG_SEQ_Prio_0);
+}
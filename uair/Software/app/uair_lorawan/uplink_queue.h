@@ -0,0 +1,65 @@
+/** Copyright © 2022 MAIS
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file uplink_queue.h
+ *
+ *
+ */
+
+#ifndef UAIR_UPLINK_QUEUE_H__
+#define UAIR_UPLINK_QUEUE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Registers the drain task and finds out if a backlog survived the last reset
+ */
+void UAIR_uplink_queue_init(void);
+
+/**
+ * @brief Stores a payload that couldn't be sent, a single flash write
+ *
+ * @param payload encoded payload
+ * @param len payload size
+ * @return true if the payload is stored
+ */
+bool UAIR_uplink_queue_push(const uint8_t *payload, uint8_t len);
+
+/**
+ * @brief Whether payloads are waiting to be sent
+ */
+bool UAIR_uplink_queue_is_empty(void);
+
+/**
+ * @brief Sends the backlog in batches, starting now
+ *
+ * Each uplink packs as many payloads as the current datarate allows, oldest first,
+ * on SENSORS_BACKLOG_APP_PORT: a byte with the number of payloads, then each payload
+ * behind a byte with its size. Batches are spaced by the duty cycle, payloads are
+ * disposed of once their batch is sent.
+ */
+void UAIR_uplink_queue_drain(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
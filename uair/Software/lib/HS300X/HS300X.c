@@ -35,21 +35,21 @@ static HAL_StatusTypeDef HS300X_read_register_contents(HS300X_t *hs, uint16_t *v
 static HAL_StatusTypeDef HS300X_enter_program_mode(HS300X_t *hs)
 {
     int r = HS300X_write_register(hs, 0xA0, 0x0000, false);
-    HAL_Delay(1);
+    HAL_delay_us(1000);
     return r;
 }
 
 static HAL_StatusTypeDef HS300X_leave_program_mode(HS300X_t *hs)
 {
     int r = HS300X_write_register(hs, 0x80, 0x0000, false);
-    HAL_Delay(1);
+    HAL_delay_us(1000);
     return r;
 }
 
 HAL_StatusTypeDef HS300X_read_register(HS300X_t *hs, uint8_t reg, uint16_t *value)
 {
     HS300X_write_register(hs, reg, 0x0000, false);
-    HAL_Delay(1); // 120us
+    HAL_delay_us(1000); // 120us
     HAL_StatusTypeDef ret = HS300X_read_register_contents(hs, value);
     if (ret!=HAL_OK) {
         APP_PRINTF("HS300x: error reading register 0x%02x\r\n", reg);
@@ -91,7 +91,7 @@ static HAL_StatusTypeDef HS300X_write_register(HS300X_t *hs, uint8_t reg, uint16
     if (r == HAL_OK)
     {
         if (wait) {
-            HAL_Delay(14); // 14ms as per datasheet
+            HAL_delay_us(14000); // 14ms as per datasheet
         }
     }
     return r;
@@ -176,17 +176,22 @@ HAL_StatusTypeDef HS300X_probe(HS300X_t *hs,
     return err;
 }
 
-HAL_StatusTypeDef HS300X_start_measurement(HS300X_t *hs)
+static void HS300X_mark_measurement_start(HS300X_t *hs)
 {
-    HAL_StatusTypeDef r = HAL_I2C_Master_Transmit(hs->bus,
-                                                  (uint16_t)(hs->address << 1),
-                                                  NULL, 0, hs->i2c_timeout);
-
 #ifndef HS300X_NO_CHECK_TIMING
     uint16_t msec;
     uint32_t sec = UAIR_RTC_GetTime(&msec);
     hs->meas_start = ((uint64_t)sec * 1000ULL) + (uint64_t)msec;
 #endif
+}
+
+HAL_StatusTypeDef HS300X_start_measurement(HS300X_t *hs)
+{
+    HAL_StatusTypeDef r = HAL_I2C_Master_Transmit(hs->bus,
+                                                  (uint16_t)(hs->address << 1),
+                                                  NULL, 0, hs->i2c_timeout);
+
+    HS300X_mark_measurement_start(hs);
 
     return r;
 }
@@ -213,12 +218,8 @@ static inline uint64_t HS300X_time_for_measurement(const HS300X_accuracy_t acc)
     return time;
 }
 
-HAL_StatusTypeDef HS300X_read_measurement(HS300X_t *hs, int32_t *temp_millicentigrade, int32_t *hum_millipercent, int *stale)
+static HAL_StatusTypeDef HS300X_check_measurement_time(HS300X_t *hs)
 {
-    uint8_t buf[4];
-    uint32_t sens_temp;
-    uint32_t sens_hum;
-
 #ifndef HS300X_NO_CHECK_TIMING
     uint16_t msec;
     uint32_t sec = UAIR_RTC_GetTime(&msec);
@@ -236,30 +237,48 @@ HAL_StatusTypeDef HS300X_read_measurement(HS300X_t *hs, int32_t *temp_millicenti
     }
 
 #endif
+    return HAL_OK;
+}
 
-    HAL_StatusTypeDef r = HAL_I2C_Master_Receive(hs->bus,
-                                                 (uint16_t)(hs->address << 1),
-                                                 buf, sizeof(buf), hs->i2c_timeout);
-    if (r == HAL_OK) {
-        sens_hum = (((uint32_t)buf[0])<<8 ) | (uint32_t)buf[1];
-        sens_temp =(((uint32_t)buf[2])<<8 ) | (uint32_t)buf[3];
-        // Unmask
-        if ((sens_hum & 0xC000) != 0x0000) {
-            *stale = 1;
-        } else {
-            *stale = 0;
-        }
-        sens_hum &= ~(0xC000); // Mask upper 2 bits
-        sens_temp &= ~(0x0003);  // Mask lower 2 bits
+void HS300X_decode_measurement(HS300X_t *hs, int32_t *temp_millicentigrade, int32_t *hum_millipercent, int *stale)
+{
+    const uint8_t *buf = hs->rx_buf;
+    uint32_t sens_temp;
+    uint32_t sens_hum;
 
-        BSP_TRACE("Raw sensor data: hum=0x%04x temp=0x%04x",
-                  sens_hum,
-                  sens_temp);
+    sens_hum = (((uint32_t)buf[0])<<8 ) | (uint32_t)buf[1];
+    sens_temp =(((uint32_t)buf[2])<<8 ) | (uint32_t)buf[3];
+    // Unmask
+    if ((sens_hum & 0xC000) != 0x0000) {
+        *stale = 1;
+    } else {
+        *stale = 0;
+    }
+    sens_hum &= ~(0xC000); // Mask upper 2 bits
+    sens_temp &= ~(0x0003);  // Mask lower 2 bits
+
+    BSP_TRACE("Raw sensor data: hum=0x%04x temp=0x%04x",
+              sens_hum,
+              sens_temp);
+
+    *temp_millicentigrade = (((sens_temp>>2)*165000)/16383) - 40000;
+    *hum_millipercent =  ((sens_hum)*100000)/16383;
+    BSP_TRACE("Calculated %d %d", *temp_millicentigrade, *hum_millipercent);
+}
+
+HAL_StatusTypeDef HS300X_read_measurement(HS300X_t *hs, int32_t *temp_millicentigrade, int32_t *hum_millipercent, int *stale)
+{
+    HAL_StatusTypeDef r = HS300X_check_measurement_time(hs);
 
-        *temp_millicentigrade = (((sens_temp>>2)*165000)/16383) - 40000;
-        *hum_millipercent =  ((sens_hum)*100000)/16383;
-        BSP_TRACE("Calculated %d %d", *temp_millicentigrade, *hum_millipercent);
+    if (r != HAL_OK) {
+        return r;
+    }
 
+    r = HAL_I2C_Master_Receive(hs->bus,
+                               (uint16_t)(hs->address << 1),
+                               hs->rx_buf, sizeof(hs->rx_buf), hs->i2c_timeout);
+    if (r == HAL_OK) {
+        HS300X_decode_measurement(hs, temp_millicentigrade, hum_millipercent, stale);
     } else {
         BSP_TRACE("Cannot receive data from sensor");
     }
@@ -267,6 +286,19 @@ HAL_StatusTypeDef HS300X_read_measurement(HS300X_t *hs, int32_t *temp_millicenti
     return r;
 }
 
+HAL_StatusTypeDef HS300X_read_measurement_async(HS300X_t *hs)
+{
+    HAL_StatusTypeDef r = HS300X_check_measurement_time(hs);
+
+    if (r != HAL_OK) {
+        return r;
+    }
+
+    return HAL_I2C_Master_Receive_IT(hs->bus,
+                                     (uint16_t)(hs->address << 1),
+                                     hs->rx_buf, sizeof(hs->rx_buf));
+}
+
 int HS300X_init(HS300X_t *hs, HAL_I2C_bus_t bus)
 {
     hs->bus = bus;
@@ -48,6 +48,7 @@ struct HS300X {
     HS300X_accuracy_t hum_acc;
     uint64_t meas_start;
 #endif
+    uint8_t rx_buf[4];  /* Filled by HS300X_read_measurement_async() */
 };
 
 typedef struct HS300X HS300X_t;
@@ -61,6 +62,12 @@ HAL_StatusTypeDef HS300X_probe(HS300X_t *hs,
 
 HAL_StatusTypeDef HS300X_start_measurement(HS300X_t *hs);
 HAL_StatusTypeDef HS300X_read_measurement(HS300X_t *hs, int32_t *temp_millicentigrade, int32_t *hum_millipercent, int *stale);
+
+/* Interrupt-driven variant, completion is reported through the HAL I2C callbacks.
+   After it completes, decode the received data with HS300X_decode_measurement() */
+HAL_StatusTypeDef HS300X_read_measurement_async(HS300X_t *hs);
+void HS300X_decode_measurement(HS300X_t *hs, int32_t *temp_millicentigrade, int32_t *hum_millipercent, int *stale);
+
 uint32_t HS300X_get_probed_serial(HS300X_t *hs);
 unsigned HS300X_time_for_measurement_us(const HS300X_accuracy_t temp_acc, const HS300X_accuracy_t hum_acc);
 
@@ -419,6 +419,24 @@ BSP_sensor_state_t BSP_air_quality_get_sensor_state(void)
     return sensor_state;
 }
 
+/**
+ * @brief Get the powerzone the OAQ sensor is powered from
+ * @ingroup UAIR_BSP_SENSOR_AIR_QUALITY
+ */
+BSP_powerzone_t BSP_air_quality_get_powerzone(void)
+{
+    return UAIR_BSP_air_quality_get_powerzone();
+}
+
+/**
+ * @brief Get the I2C bus the OAQ sensor is connected to
+ * @ingroup UAIR_BSP_SENSOR_AIR_QUALITY
+ */
+BSP_I2C_busnumber_t BSP_air_quality_get_bus(void)
+{
+    return UAIR_BSP_air_quality_get_bus();
+}
+
 /**
  * @brief Get OAQ measurement delay
  * @ingroup UAIR_BSP_SENSOR_AIR_QUALITY
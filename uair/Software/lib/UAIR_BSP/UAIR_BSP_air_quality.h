@@ -50,6 +50,7 @@
 
 #include "BSP.h"
 #include "HAL.h"
+#include "UAIR_BSP_i2c.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -77,6 +78,8 @@ BSP_error_t BSP_air_quality_calculate(const float temp_c,
                                       BSP_air_quality_results_t *results);
 unsigned int BSP_air_quality_get_measure_delay_us(void);
 BSP_sensor_state_t BSP_air_quality_get_sensor_state(void);
+BSP_powerzone_t BSP_air_quality_get_powerzone(void);
+BSP_I2C_busnumber_t BSP_air_quality_get_bus(void);
 
 #ifdef __cplusplus
 }
@@ -35,13 +35,48 @@
 RTC_HandleTypeDef UAIR_BSP_rtc;
 LPTIM_HandleTypeDef UAIR_BSP_lptim = {0};
 static volatile bool lptim_running = false;
+static bool lptim_on_lse = false;
 
-BSP_error_t UAIR_BSP_LPTIM_Init(void)
+/*
+ * Asynchronous delays share the LPTIM with the blocking ones. They run one at a
+ * time, in request order, and a blocking delay waits for the one counting to
+ * expire first. So nobody finds the LPTIM busy, but a delay may last longer
+ * than requested while the LPTIM serves another.
+ */
+typedef struct {
+    unsigned us;
+    BSP_delay_callback_t callback;
+    void *userdata;
+} lptim_async_t;
+
+#define LPTIM_ASYNC_QUEUE_SIZE (4U)
+
+static lptim_async_t lptim_async_queue[LPTIM_ASYNC_QUEUE_SIZE];
+static volatile unsigned lptim_async_head = 0;
+static volatile unsigned lptim_async_count = 0;
+static lptim_async_t lptim_async_current = {0};
+static volatile bool lptim_blocking = false;
+
+#define LPTIM_LSE_HZ (32768U)
+#define LPTIM_MAX_PERIOD (0xFFFFU)
+
+/* Delays from this long are counted on LSE, so the core can be stopped while waiting */
+#define LPTIM_STOP_MIN_US (1000U)
+
+/* Longest single count, in microseconds */
+#define LPTIM_LSE_MAX_US (1000000U)
+#define LPTIM_PCLK_MAX_US (50000U)
+
+static BSP_error_t UAIR_BSP_LPTIM_configure(bool lse)
 {
     //LPTIM_InitTypeDef init = {0};
     UAIR_BSP_lptim.Instance = LPTIM1;
     UAIR_BSP_lptim.Init.Clock.Source = LPTIM_CLOCKSOURCE_APBCLOCK_LPOSC;
-    UAIR_BSP_lptim.Init.Clock.Prescaler = LPTIM_PRESCALER_DIV32; // 1.333333us per tick @ 24Mhz, 16us @ 2Mhz
+    if (lse) {
+        UAIR_BSP_lptim.Init.Clock.Prescaler = LPTIM_PRESCALER_DIV1; // 30.5us per tick
+    } else {
+        UAIR_BSP_lptim.Init.Clock.Prescaler = LPTIM_PRESCALER_DIV32; // 1.333333us per tick @ 24Mhz, 16us @ 2Mhz
+    }
     UAIR_BSP_lptim.Init.Trigger.Source = LPTIM_TRIGSOURCE_SOFTWARE;
     UAIR_BSP_lptim.Init.UpdateMode = LPTIM_UPDATE_IMMEDIATE;
     UAIR_BSP_lptim.Init.OutputPolarity = LPTIM_OUTPUTPOLARITY_HIGH;
@@ -50,6 +85,9 @@ BSP_error_t UAIR_BSP_LPTIM_Init(void)
     UAIR_BSP_lptim.Init.Input2Source = LPTIM_INPUT2SOURCE_GPIO;
     UAIR_BSP_lptim.Init.RepetitionCounter = 0;
 
+    // Read by the MSP to select the kernel clock
+    lptim_on_lse = lse;
+
     HAL_StatusTypeDef r = HAL_LPTIM_Init(&UAIR_BSP_lptim);
     if (r!=HAL_OK) {
         BSP_TRACE("LPTIM_Init: HAL error %d", r);
@@ -59,10 +97,58 @@ BSP_error_t UAIR_BSP_LPTIM_Init(void)
     return BSP_ERROR_NONE;
 }
 
+BSP_error_t UAIR_BSP_LPTIM_Init(void)
+{
+    return UAIR_BSP_LPTIM_configure(false);
+}
+
+bool UAIR_BSP_LPTIM_uses_lse(void)
+{
+    return lptim_on_lse;
+}
+
+static BSP_error_t UAIR_BSP_LPTIM_select_clock(bool lse)
+{
+    if (lse == lptim_on_lse)
+        return BSP_ERROR_NONE;
+
+    HAL_LPTIM_DeInit(&UAIR_BSP_lptim);
+    return UAIR_BSP_LPTIM_configure(lse);
+}
+
+static uint32_t UAIR_BSP_LPTIM_us_to_ticks(unsigned us)
+{
+    if (lptim_on_lse) {
+        // Round up, never wait less than requested
+        return (uint32_t)((((uint64_t)us * LPTIM_LSE_HZ) + 999999U) / 1000000U);
+    }
+
+    if (UAIR_HAL_is_lowpower()) {
+        // TBD
+        if (us<200) {
+            us = 200;
+        }
+        us-=52;
+        us>>=4; // div 16
+    } else {
+        if (us<100) {
+            us = 100;
+        }
+        us -= 52;
+        us<<=8;
+        us/=341; // * 256 / 341 <=> / 1.333
+    }
+    return us;
+}
+
 BSP_error_t UAIR_BSP_LPTIM_count(uint32_t period)
 {
     lptim_running = true;
 
+    if (period > LPTIM_MAX_PERIOD) {
+        period = LPTIM_MAX_PERIOD;
+    }
+
     //BSP_TRACE("LPTIM: pre-start state %d", HAL_LPTIM_GetState(&UAIR_BSP_lptim));
     HAL_StatusTypeDef r = HAL_LPTIM_OnePulse_Start_IT(&UAIR_BSP_lptim, period, period/2);
     //BSP_TRACE("LPTIM: start state %d", HAL_LPTIM_GetState(&UAIR_BSP_lptim));
@@ -74,13 +160,19 @@ BSP_error_t UAIR_BSP_LPTIM_count(uint32_t period)
     return BSP_ERROR_PERIPH_FAILURE;
 }
 
-void UAIR_BSP_LPTIM_wait(void)
+/*
+ * STOP1 is only entered if no peripheral currently needs the core clocks,
+ * this is checked on every wakeup since an interrupt may have started one.
+ */
+void UAIR_BSP_LPTIM_wait(bool allow_stop)
 {
     do {
         __disable_irq();
         if (!lptim_running) {
             __enable_irq();
             break;
+        } else if (allow_stop && UAIR_LPM_GetStopMode() == UAIR_LPM_NO_BIT_SET) {
+            UAIR_LPM_EnterStop1Mode();
         } else {
             //__NOP();
             __WFI();
@@ -90,9 +182,52 @@ void UAIR_BSP_LPTIM_wait(void)
     HAL_LPTIM_OnePulse_Stop_IT(&UAIR_BSP_lptim);
 }
 
+/* Starts the oldest queued asynchronous delay, interrupts must be disabled */
+static void UAIR_BSP_LPTIM_async_next(void)
+{
+    while (lptim_async_count > 0 && lptim_async_current.callback == NULL) {
+        lptim_async_t *a = &lptim_async_queue[lptim_async_head];
+        bool lse = (a->us >= LPTIM_STOP_MIN_US);
+        BSP_error_t err;
+
+        lptim_async_current = *a;
+        lptim_async_head = (lptim_async_head + 1) % LPTIM_ASYNC_QUEUE_SIZE;
+        lptim_async_count--;
+
+        err = UAIR_BSP_LPTIM_select_clock(lse);
+
+        if (err == BSP_ERROR_NONE && !lse) {
+            // PCLK is stopped in STOP modes
+            UAIR_LPM_SetStopMode((1 << UAIR_LPM_LTIM), UAIR_LPM_DISABLE);
+        }
+        if (err == BSP_ERROR_NONE) {
+            err = UAIR_BSP_LPTIM_count(UAIR_BSP_LPTIM_us_to_ticks(lptim_async_current.us));
+        }
+        if (err != BSP_ERROR_NONE) {
+            BSP_TRACE("LPTIM: async delay dropped, error %d", err);
+            UAIR_LPM_SetStopMode((1 << UAIR_LPM_LTIM), UAIR_LPM_ENABLE);
+            lptim_async_current.callback = NULL;
+        }
+    }
+}
+
 void HAL_LPTIM_AutoReloadMatchCallback(LPTIM_HandleTypeDef *h)
 {
+    lptim_async_t expired = lptim_async_current;
+
     lptim_running = false;
+
+    if (expired.callback) {
+        lptim_async_current.callback = NULL;
+        HAL_LPTIM_OnePulse_Stop_IT(&UAIR_BSP_lptim);
+        UAIR_LPM_SetStopMode((1 << UAIR_LPM_LTIM), UAIR_LPM_ENABLE);
+
+        // A waiting blocking delay goes first
+        if (!lptim_blocking) {
+            UAIR_BSP_LPTIM_async_next();
+        }
+        expired.callback(expired.userdata);
+    }
 }
 
 void  HAL_LPTIM_UpdateEventCallback(LPTIM_HandleTypeDef *h)
@@ -104,7 +239,8 @@ void  HAL_LPTIM_UpdateEventCallback(LPTIM_HandleTypeDef *h)
  * @brief Delay execution
  *
  * Delay execution for the specified number of microseconds.
- * The system will be held in low-power mode during the delay.
+ * The system will be held in low-power mode during the delay: STOP1 for
+ * delays of 1ms or more if no peripheral prevents it, SLEEP otherwise.
  *
  * @param us Number of microseconds to delay for
  *
@@ -125,34 +261,90 @@ BSP_error_t BSP_delay_us(unsigned us)
 #endif
 }
 
+/**
+ * @brief Call back after a delay
+ *
+ * The callback is invoked from the LPTIM interrupt once the delay expires.
+ * Delays of 1ms or more are counted on LSE and do not prevent STOP2 in the meantime.
+ * Delays are served one at a time: the callback may come late if the LPTIM
+ * is counting another delay, synchronous or not, when this one is requested.
+ *
+ * @param us Number of microseconds to delay for, at most one second
+ * @param callback Function to call when the delay expires
+ * @param userdata Passed to the callback
+ *
+ * @return \ref BSP_ERROR_NONE No error, callback will be invoked.
+ * @return \ref BSP_ERROR_WRONG_PARAM Delay is too long.
+ * @return \ref BSP_ERROR_BUSY Too many asynchronous delays are pending.
+ * @return \ref BSP_ERROR_PERIPH_FAILURE Peripheral (LPTIM) error.
+ */
+BSP_error_t BSP_delay_us_async(unsigned us, BSP_delay_callback_t callback, void *userdata)
+{
+    bool lse = (us >= LPTIM_STOP_MIN_US);
+    BSP_error_t err = BSP_ERROR_NONE;
+
+    if (callback == NULL || us > LPTIM_LSE_MAX_US || (!lse && us > LPTIM_PCLK_MAX_US))
+        return BSP_ERROR_WRONG_PARAM;
+
+    __disable_irq();
+    if (lptim_async_count == LPTIM_ASYNC_QUEUE_SIZE) {
+        err = BSP_ERROR_BUSY;
+    } else {
+        lptim_async_t *a = &lptim_async_queue[(lptim_async_head + lptim_async_count) % LPTIM_ASYNC_QUEUE_SIZE];
+        a->us = us;
+        a->callback = callback;
+        a->userdata = userdata;
+        lptim_async_count++;
+
+        if (!lptim_blocking && lptim_async_current.callback == NULL) {
+            UAIR_BSP_LPTIM_async_next();
+            if (lptim_async_current.callback == NULL) {
+                err = BSP_ERROR_PERIPH_FAILURE;
+            }
+        }
+    }
+    __enable_irq();
 
-// Minimum 100us
+    return err;
+}
 
 BSP_error_t UAIR_BSP_LPTIM_delay(unsigned us)
 {
+    bool allow_stop;
+    unsigned max_us;
     BSP_error_t err;
 
-    if (UAIR_HAL_is_lowpower()) {
-        // TBD
-        if (us<200) {
-            us = 200;
-        }
-        us-=52;
-        us>>=4; // div 16
-    } else {
-        if (us<100) {
-            us = 100;
-        }
-        us -= 52;
-        us<<=8;
-        us/=341; // * 256 / 341 <=> / 1.333
+    // Let the asynchronous delay being counted expire, no other starts meanwhile
+    lptim_blocking = true;
+    if (lptim_async_current.callback != NULL) {
+        UAIR_BSP_LPTIM_wait(lptim_on_lse);
     }
+
+    allow_stop = (us >= LPTIM_STOP_MIN_US) && (UAIR_LPM_GetStopMode() == UAIR_LPM_NO_BIT_SET);
+    max_us = allow_stop ? LPTIM_LSE_MAX_US : LPTIM_PCLK_MAX_US;
+
+    err = UAIR_BSP_LPTIM_select_clock(allow_stop);
+
     //UAIR_BSP_DP_On(DEBUG_PIN1);
-    err = UAIR_BSP_LPTIM_count(us);
-    if (err==BSP_ERROR_NONE) {
-        UAIR_BSP_LPTIM_wait();
-    }
+    // Longer delays are split, the counter is only 16 bits
+    do {
+        unsigned chunk = (us > max_us) ? max_us : us;
+
+        if (err==BSP_ERROR_NONE) {
+            err = UAIR_BSP_LPTIM_count(UAIR_BSP_LPTIM_us_to_ticks(chunk));
+        }
+        if (err==BSP_ERROR_NONE) {
+            UAIR_BSP_LPTIM_wait(allow_stop);
+        }
+        us -= chunk;
+    } while (us > 0 && err==BSP_ERROR_NONE);
     //UAIR_BSP_DP_Off(DEBUG_PIN1);
+
+    __disable_irq();
+    lptim_blocking = false;
+    UAIR_BSP_LPTIM_async_next();
+    __enable_irq();
+
     return err;
 };
 
@@ -33,7 +33,10 @@
 extern "C" {
 #endif
 
+typedef void (*BSP_delay_callback_t)(void *userdata);
+
 BSP_error_t BSP_delay_us(unsigned us);
+BSP_error_t BSP_delay_us_async(unsigned us, BSP_delay_callback_t callback, void *userdata);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,87 @@
+#include <catch2/catch.hpp>
+
+#include "UAIR_BSP_error.h"
+#include "UAIR_BSP.h"
+#include "UAIR_BSP_clk_timer.h"
+#include "UAIR_lpm.h"
+#include "models/hw_pwr.h"
+#include "models/hw_simclock.h"
+#include "tests/uAirModuleTestFixture.hpp"
+
+static volatile int delay_expired;
+
+static void delay_done(void *userdata)
+{
+    delay_expired++;
+}
+
+TEST_CASE_METHOD(uAirModuleTestFixture, "Low-power delays","[BSP][BSP/Delay]")
+{
+    // Nothing else may hold STOP off during the test
+    UAIR_LPM_bm_t held = UAIR_LPM_GetStopMode();
+    UAIR_LPM_SetStopMode(held, UAIR_LPM_ENABLE);
+
+    pwr_engine_reset_stats();
+
+    SECTION("Long delays stop the core")
+    {
+        simclock_time_t start = simclock_now_us();
+
+        CHECK( BSP_delay_us(5000) == BSP_ERROR_NONE );
+        // Model resolution is coarser than LSE
+        CHECK( simclock_now_us() - start >= 4500 );
+        CHECK( pwr_engine_get_entries(PWR_MODE_STOP1) > 0 );
+    }
+
+    SECTION("Short delays only sleep")
+    {
+        CHECK( BSP_delay_us(300) == BSP_ERROR_NONE );
+        CHECK( pwr_engine_get_entries(PWR_MODE_STOP1) == 0 );
+    }
+
+    SECTION("Active peripherals prevent stop")
+    {
+        UAIR_LPM_SetStopMode((1 << UAIR_LPM_APP), UAIR_LPM_DISABLE);
+        CHECK( BSP_delay_us(5000) == BSP_ERROR_NONE );
+        CHECK( pwr_engine_get_entries(PWR_MODE_STOP1) == 0 );
+        UAIR_LPM_SetStopMode((1 << UAIR_LPM_APP), UAIR_LPM_ENABLE);
+    }
+
+    SECTION("Asynchronous delays share the LPTIM with blocking ones")
+    {
+        simclock_time_t start = simclock_now_us();
+        delay_expired = 0;
+
+        CHECK( BSP_delay_us_async(2000, &delay_done, NULL) == BSP_ERROR_NONE );
+        CHECK( BSP_delay_us_async(3000, &delay_done, NULL) == BSP_ERROR_NONE );
+
+        // Never busy, the blocking delay waits for the one being counted
+        CHECK( BSP_delay_us(100) == BSP_ERROR_NONE );
+        CHECK( delay_expired == 1 );
+        CHECK( simclock_now_us() - start >= 1500 );
+
+        // The queued one was started once the LPTIM was free again
+        CHECK( BSP_delay_us(100) == BSP_ERROR_NONE );
+        CHECK( delay_expired == 2 );
+
+        CHECK( BSP_delay_us_async(2000000, &delay_done, NULL) == BSP_ERROR_WRONG_PARAM );
+
+        // Short delays keep the core out of STOP until they expire
+        CHECK( BSP_delay_us_async(500, &delay_done, NULL) == BSP_ERROR_NONE );
+        CHECK( UAIR_LPM_GetStopMode() != UAIR_LPM_NO_BIT_SET );
+        CHECK( BSP_delay_us(100) == BSP_ERROR_NONE );
+        CHECK( delay_expired == 3 );
+        CHECK( UAIR_LPM_GetStopMode() == UAIR_LPM_NO_BIT_SET );
+
+        // One counting and four queued
+        for (int i = 0; i < 5; i++)
+            CHECK( BSP_delay_us_async(1000, &delay_done, NULL) == BSP_ERROR_NONE );
+        CHECK( BSP_delay_us_async(1000, &delay_done, NULL) == BSP_ERROR_BUSY );
+
+        for (int i = 0; i < 5; i++)
+            CHECK( BSP_delay_us(100) == BSP_ERROR_NONE );
+        CHECK( delay_expired == 8 );
+    }
+
+    UAIR_LPM_SetStopMode(held, UAIR_LPM_DISABLE);
+}
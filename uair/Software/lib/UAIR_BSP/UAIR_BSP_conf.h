@@ -52,6 +52,7 @@
 #define DEBUG_USART_DMA_IT_PRIORITY             7U
 #define MICROPHONE_IT_PRIORITY                  8U
 #define MICROPHONE_DMA_IT_PRIORITY              8U
+#define UAIR_BSP_I2C_IT_PRIORITY                6U
 
 
 #define UAIR_BSP_BUTTON_SWx_IT_PRIORITY         15U
@@ -42,9 +42,13 @@ static BSP_hum_accuracy_t sensor_hum_acc = HUM_ACCURACY_HIGH;
 enum {
     HS300X_NOT_INIT,
     HS300X_IDLE,
-    HS300X_MEASURE
+    HS300X_MEASURE,
+    HS300X_FETCHED      /* Measurement read asynchronously, not yet decoded */
 } hs300x_state = HS300X_NOT_INIT;
 
+static BSP_I2C_async_callback_t hs300x_async_callback = NULL;
+static void *hs300x_async_userdata = NULL;
+
 
 static BSP_powerzone_t UAIR_BSP_external_temp_hum_get_powerzone(void);
 static BSP_I2C_busnumber_t UAIR_BSP_external_temp_hum_get_bus(void);
@@ -119,6 +123,7 @@ void UAIR_BSP_external_temp_hum_deinit(void)
 
     sensor_state = SENSOR_OFFLINE;
     hs300x_state = HS300X_NOT_INIT;
+    hs300x_async_callback = NULL;
 
 }
 
@@ -269,6 +274,78 @@ BSP_error_t BSP_external_temp_hum_start_measure(void)
     return ret;
 }
 
+static void UAIR_BSP_external_temp_hum_async_done(void *userdata, BSP_error_t err)
+{
+    BSP_I2C_async_callback_t callback = hs300x_async_callback;
+
+    if (err == BSP_ERROR_NONE) {
+        UAIR_sensor_ok(&external_sensor);
+        hs300x_state = HS300X_FETCHED;
+    } else {
+        BSP_TRACE("Asynchronous transfer to HS300X failed");
+        UAIR_sensor_fault_detected(&external_sensor);
+        hs300x_state = HS300X_IDLE;
+        err = BSP_ERROR_COMPONENT_FAILURE;
+    }
+
+    hs300x_async_callback = NULL;
+    if (callback)
+        callback(hs300x_async_userdata, err);
+}
+
+static BSP_error_t UAIR_BSP_external_temp_hum_async(HAL_StatusTypeDef (*op)(HS300X_t *hs),
+                                                    BSP_I2C_async_callback_t callback,
+                                                    void *userdata)
+{
+    BSP_I2C_busnumber_t busno = UAIR_BSP_external_temp_hum_get_bus();
+    BSP_error_t ret = UAIR_BSP_I2C_async_begin(busno, &UAIR_BSP_external_temp_hum_async_done, NULL);
+
+    if (ret != BSP_ERROR_NONE)
+        return ret;
+
+    hs300x_async_callback = callback;
+    hs300x_async_userdata = userdata;
+
+    switch (op(&hs300x)) {
+    case HAL_OK:
+        break;
+    case HAL_BUSY:
+        UAIR_BSP_I2C_async_cancel(busno);
+        ret = BSP_ERROR_BUSY;
+        break;
+    default:
+        BSP_TRACE("Cannot start asynchronous transfer to HS300X");
+        UAIR_BSP_I2C_async_cancel(busno);
+        UAIR_sensor_fault_detected(&external_sensor);
+        ret = BSP_ERROR_COMPONENT_FAILURE;
+        break;
+    }
+    return ret;
+}
+
+/**
+ * @ingroup UAIR_BSP_SENSOR_EXTERNAL_TEMP
+ * @brief Fetch a temperature/humidity measurement (previously started) without blocking
+ *
+ * Once the callback reports \ref BSP_ERROR_NONE, \ref BSP_external_temp_hum_read_measure
+ * returns the fetched values without accessing the bus.
+ *
+ * @return \ref BSP_ERROR_NONE if the transfer was started
+ * @return \ref BSP_ERROR_NO_INIT if sensor was not successfully initialised
+ * @return \ref BSP_ERROR_BUSY if sensor is not currently measuring or bus is busy
+ * @return \ref BSP_ERROR_COMPONENT_FAILURE if the transfer could not be started, or if
+ * the time interval between start of measure and the readout has not been observed
+ */
+BSP_error_t BSP_external_temp_hum_read_measure_async(BSP_I2C_async_callback_t callback, void *userdata)
+{
+    if (hs300x_state == HS300X_NOT_INIT)
+        return BSP_ERROR_NO_INIT;
+    if (hs300x_state != HS300X_MEASURE)
+        return BSP_ERROR_BUSY;
+
+    return UAIR_BSP_external_temp_hum_async(&HS300X_read_measurement_async, callback, userdata);
+}
+
 /**
  * @ingroup UAIR_BSP_SENSOR_EXTERNAL_TEMP
  * @brief Read temperature/humidity measurement (previously started)
@@ -305,7 +382,9 @@ BSP_error_t BSP_external_temp_hum_read_measure(int32_t *temp, int32_t *hum)
             ret = BSP_ERROR_NO_INIT;
             break;
         }
-        if (HS300X_read_measurement(&hs300x, temp, hum, &stale)!=0) {
+        if (hs300x_state==HS300X_FETCHED) {
+            HS300X_decode_measurement(&hs300x, temp, hum, &stale);
+        } else if (HS300X_read_measurement(&hs300x, temp, hum, &stale)!=0) {
             BSP_TRACE("Error reading sensor measurement");
             UAIR_sensor_fault_detected(&external_sensor);
 
@@ -356,6 +435,24 @@ BSP_sensor_state_t BSP_external_temp_hum_get_sensor_state(void)
     return sensor_state;
 }
 
+/**
+ * @brief Get the powerzone the external temperature/humidity sensor is powered from
+ * @ingroup UAIR_BSP_SENSOR_EXTERNAL_TEMP
+ */
+BSP_powerzone_t BSP_external_temp_hum_get_powerzone(void)
+{
+    return UAIR_BSP_external_temp_hum_get_powerzone();
+}
+
+/**
+ * @brief Get the I2C bus the external temperature/humidity sensor is connected to
+ * @ingroup UAIR_BSP_SENSOR_EXTERNAL_TEMP
+ */
+BSP_I2C_busnumber_t BSP_external_temp_hum_get_bus(void)
+{
+    return UAIR_BSP_external_temp_hum_get_bus();
+}
+
 void UAIR_BSP_external_temp_hum_set_faulty(void)
 {
     sensor_state = SENSOR_FAULTY;
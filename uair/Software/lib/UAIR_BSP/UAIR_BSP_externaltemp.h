@@ -27,6 +27,10 @@
  * - Wait for \ref BSP_external_temp_hum_get_measure_delay_us()
  * - Extract values with \ref BSP_external_temp_hum_read_measure() after measurement completes 
  *
+ * The readout transfer can also be done without blocking with
+ * \ref BSP_external_temp_hum_read_measure_async().
+ * \ref BSP_external_temp_hum_read_measure() then decodes the fetched values.
+ *
  */
 
 /**
@@ -44,6 +48,7 @@
 #define UAIR_BSP_EXTERNALTEMP_H__
 
 #include "BSP.h"
+#include "UAIR_BSP_i2c.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,7 +57,10 @@ extern "C" {
 unsigned int BSP_external_temp_hum_get_measure_delay_us(void);
 BSP_error_t BSP_external_temp_hum_start_measure(void);
 BSP_error_t BSP_external_temp_hum_read_measure(int32_t *temp, int32_t *hum);
+BSP_error_t BSP_external_temp_hum_read_measure_async(BSP_I2C_async_callback_t callback, void *userdata);
 BSP_sensor_state_t BSP_external_temp_hum_get_sensor_state(void);
+BSP_powerzone_t BSP_external_temp_hum_get_powerzone(void);
+BSP_I2C_busnumber_t BSP_external_temp_hum_get_bus(void);
 
 #ifdef __cplusplus
 }
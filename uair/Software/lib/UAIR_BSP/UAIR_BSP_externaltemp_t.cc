@@ -0,0 +1,83 @@
+#include <catch2/catch.hpp>
+
+#include "UAIR_BSP_error.h"
+#include "UAIR_BSP_types.h"
+#include "UAIR_BSP.h"
+#include "UAIR_BSP_externaltemp.h"
+#include "UAIR_BSP_powerzone.h"
+#include "pvt/UAIR_BSP_powerzone_p.h"
+#include "pvt/UAIR_BSP_externaltemp_p.h"
+#include "pvt/UAIR_BSP_i2c_p.h"
+#include "stm32wlxx_hal_i2c_pvt.h"
+#include "stm32wlxx_hal.h"
+#include <unistd.h>
+#include "tests/uAirModuleTestFixture.hpp"
+
+static int async_completions;
+static BSP_error_t async_result;
+
+static void async_done(void *userdata, BSP_error_t err)
+{
+    async_completions++;
+    async_result = err;
+}
+
+/* Transfers take well below 1ms at 100kHz */
+static void wait_async_completion()
+{
+    usleep(1000);
+    BSP_I2C_process_completions();
+}
+
+TEST_CASE_METHOD(uAirModuleTestFixture, "Asynchronous data capture","[BSP][BSP/Sensors][BSP/Sensors/ExternalSensor]")
+{
+    int32_t temp;
+    int32_t hum;
+    I2C_TypeDef *instance;
+
+    UAIR_BSP_powerzone_deinit();
+    ASSERT( UAIR_BSP_powerzone_init() == BSP_ERROR_NONE );
+
+    CHECK( UAIR_BSP_external_temp_hum_init() == BSP_ERROR_NONE );
+    CHECK( BSP_external_temp_hum_get_sensor_state() == SENSOR_AVAILABLE );
+
+    instance = UAIR_BSP_I2C_GetHALHandle(BSP_external_temp_hum_get_bus())->Instance;
+    async_completions = 0;
+
+    // Cannot fetch before the measure is started
+    CHECK( BSP_external_temp_hum_read_measure_async(&async_done, NULL) == BSP_ERROR_BUSY );
+
+    CHECK( BSP_external_temp_hum_start_measure() == BSP_ERROR_NONE );
+
+    // RTC has millisecond resolution
+    usleep(BSP_external_temp_hum_get_measure_delay_us() + 2000);
+
+    CHECK( BSP_external_temp_hum_read_measure_async(&async_done, NULL) == BSP_ERROR_NONE );
+    // Bus is held until the completion is processed
+    CHECK( BSP_external_temp_hum_read_measure_async(&async_done, NULL) == BSP_ERROR_BUSY );
+    wait_async_completion();
+    CHECK( async_completions == 1 );
+    CHECK( async_result == BSP_ERROR_NONE );
+
+    CHECK( BSP_external_temp_hum_read_measure(&temp, &hum) == BSP_ERROR_NONE );
+
+    SECTION("Bus error is reported in the completion")
+    {
+        CHECK( BSP_external_temp_hum_start_measure() == BSP_ERROR_NONE );
+        usleep(BSP_external_temp_hum_get_measure_delay_us() + 2000);
+
+        i2c_set_error_mode( instance, 0x44<<1, I2C_FAIL_POSTTX, HAL_I2C_ERROR_AF );
+
+        CHECK( BSP_external_temp_hum_read_measure_async(&async_done, NULL) == BSP_ERROR_NONE );
+        wait_async_completion();
+        CHECK( async_completions == 2 );
+        CHECK( async_result == BSP_ERROR_COMPONENT_FAILURE );
+
+        i2c_set_error_mode( instance, 0x44<<1, I2C_NORMAL, 0 );
+
+        // Sensor can be started again
+        CHECK( BSP_external_temp_hum_start_measure() == BSP_ERROR_NONE );
+    }
+
+    UAIR_BSP_external_temp_hum_deinit();
+}
@@ -119,6 +119,18 @@ static uint8_t i2c_bus_ref[1+BSP_I2C_MAX_BUS] = {0};
 
 static I2C_HandleTypeDef i2c_buses[1+BSP_I2C_MAX_BUS];
 
+// Asynchronous transfers
+
+static struct {
+    BSP_I2C_async_callback_t callback;
+    void *userdata;
+    volatile bool in_flight;
+    volatile bool done;
+    volatile BSP_error_t err;
+} i2c_async[1+BSP_I2C_MAX_BUS];
+
+static BSP_I2C_completion_notify_t i2c_completion_notify = NULL;
+
 
 #if 0
 static BSP_error_t UAIR_BSP_I2C_InitAll()
@@ -646,6 +658,7 @@ BSP_error_t UAIR_BSP_I2C_Bus_Unref(BSP_I2C_busnumber_t busno)
         HAL_I2C_bus_t handle = UAIR_BSP_I2C_GetHALHandle(busno);
         BSP_TRACE("De-initializing bus %d", busno);
         UAIR_BSP_I2C_Bus_DeInit(handle);
+        UAIR_BSP_I2C_async_cancel(busno);
     }
     if (i2c_bus_ref[busno]>0) {
 
@@ -653,3 +666,146 @@ BSP_error_t UAIR_BSP_I2C_Bus_Unref(BSP_I2C_busnumber_t busno)
     }
     return err;
 }
+
+/* STOP2 would halt the controllers, only SLEEP while transfers are in flight */
+static void UAIR_BSP_I2C_async_update_lpm(void)
+{
+    bool in_flight = false;
+    unsigned i;
+
+    for (i=0; i<=BSP_I2C_MAX_BUS; i++) {
+        if (i2c_async[i].in_flight)
+            in_flight = true;
+    }
+    UAIR_LPM_SetStopMode((1 << UAIR_LPM_I2C_SENSORS), in_flight ? UAIR_LPM_DISABLE : UAIR_LPM_ENABLE);
+}
+
+BSP_error_t UAIR_BSP_I2C_async_begin(BSP_I2C_busnumber_t busno, BSP_I2C_async_callback_t callback, void *userdata)
+{
+    BSP_error_t err = BSP_ERROR_NONE;
+
+    __disable_irq();
+    if (i2c_async[busno].in_flight || i2c_async[busno].done) {
+        err = BSP_ERROR_BUSY;
+    } else {
+        i2c_async[busno].callback = callback;
+        i2c_async[busno].userdata = userdata;
+        i2c_async[busno].err = BSP_ERROR_NONE;
+        i2c_async[busno].in_flight = true;
+        UAIR_BSP_I2C_async_update_lpm();
+    }
+    __enable_irq();
+
+    return err;
+}
+
+void UAIR_BSP_I2C_async_cancel(BSP_I2C_busnumber_t busno)
+{
+    __disable_irq();
+    i2c_async[busno].in_flight = false;
+    i2c_async[busno].done = false;
+    i2c_async[busno].callback = NULL;
+    UAIR_BSP_I2C_async_update_lpm();
+    __enable_irq();
+}
+
+static void UAIR_BSP_I2C_async_complete(I2C_HandleTypeDef *hi2c, BSP_error_t err)
+{
+    BSP_I2C_busnumber_t busno = (BSP_I2C_busnumber_t)(hi2c - &i2c_buses[0]);
+
+    if (busno < BSP_I2C_BUS0 || busno > BSP_I2C_MAX_BUS || !i2c_async[busno].in_flight)
+        return;
+
+    i2c_async[busno].err = err;
+    i2c_async[busno].in_flight = false;
+    i2c_async[busno].done = true;
+    UAIR_BSP_I2C_async_update_lpm();
+
+    if (i2c_completion_notify)
+        i2c_completion_notify();
+}
+
+void BSP_I2C_set_completion_notify(BSP_I2C_completion_notify_t notify)
+{
+    i2c_completion_notify = notify;
+}
+
+/**
+ * @brief Run the callbacks of completed asynchronous transfers
+ */
+void BSP_I2C_process_completions(void)
+{
+    unsigned i;
+
+    for (i=0; i<=BSP_I2C_MAX_BUS; i++) {
+        BSP_I2C_async_callback_t callback = NULL;
+        void *userdata = NULL;
+        BSP_error_t err = BSP_ERROR_NONE;
+
+        __disable_irq();
+        if (i2c_async[i].done) {
+            callback = i2c_async[i].callback;
+            userdata = i2c_async[i].userdata;
+            err = i2c_async[i].err;
+            i2c_async[i].callback = NULL;
+            i2c_async[i].done = false;
+        }
+        __enable_irq();
+
+        // The callback may start the next transfer on this bus
+        if (callback)
+            callback(userdata, err);
+    }
+}
+
+static HAL_I2C_bus_t UAIR_BSP_I2C_GetHALHandleByInstance(I2C_TypeDef *instance)
+{
+    unsigned i;
+
+    for (i=0; i<=BSP_I2C_MAX_BUS; i++) {
+        if (i2c_buses[i].Instance == instance)
+            return &i2c_buses[i];
+    }
+    return NULL;
+}
+
+void UAIR_BSP_I2C_EV_IRQHandler(I2C_TypeDef *instance)
+{
+    HAL_I2C_bus_t bus = UAIR_BSP_I2C_GetHALHandleByInstance(instance);
+
+    if (bus)
+        HAL_I2C_EV_IRQHandler(bus);
+}
+
+void UAIR_BSP_I2C_ER_IRQHandler(I2C_TypeDef *instance)
+{
+    HAL_I2C_bus_t bus = UAIR_BSP_I2C_GetHALHandleByInstance(instance);
+
+    if (bus)
+        HAL_I2C_ER_IRQHandler(bus);
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    UAIR_BSP_I2C_async_complete(hi2c, BSP_ERROR_NONE);
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    UAIR_BSP_I2C_async_complete(hi2c, BSP_ERROR_NONE);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    UAIR_BSP_I2C_async_complete(hi2c, BSP_ERROR_NONE);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    UAIR_BSP_I2C_async_complete(hi2c, BSP_ERROR_NONE);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    UAIR_BSP_I2C_async_complete(hi2c, BSP_ERROR_BUS_FAILURE);
+}
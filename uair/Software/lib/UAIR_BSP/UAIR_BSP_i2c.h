@@ -48,6 +48,23 @@ typedef enum {
     BSP_I2C_RECOVER_FATAL_ERROR          /* Fatal error, no recovery possible */
 } BSP_I2C_recover_action_t;
 
+/**
+ * @brief Completion of an asynchronous (interrupt driven) transfer
+ *
+ * Called from \ref BSP_I2C_process_completions, never from interrupt context.
+ */
+typedef void (*BSP_I2C_async_callback_t)(void *userdata, BSP_error_t err);
+
+/**
+ * @brief Called from interrupt context when completions are pending
+ *
+ * Usually schedules a sequencer task which calls \ref BSP_I2C_process_completions.
+ */
+typedef void (*BSP_I2C_completion_notify_t)(void);
+
+void BSP_I2C_set_completion_notify(BSP_I2C_completion_notify_t notify);
+void BSP_I2C_process_completions(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -331,3 +331,21 @@ BSP_sensor_state_t BSP_internal_temp_hum_get_sensor_state(void)
     return sensor_state;
 }
 
+/**
+ * @brief Get the powerzone the internal temperature/humidity sensor is powered from
+ * @ingroup UAIR_BSP_SENSOR_INTERNAL_TEMP
+ */
+BSP_powerzone_t BSP_internal_temp_hum_get_powerzone(void)
+{
+    return UAIR_BSP_internal_temp_hum_get_powerzone();
+}
+
+/**
+ * @brief Get the I2C bus the internal temperature/humidity sensor is connected to
+ * @ingroup UAIR_BSP_SENSOR_INTERNAL_TEMP
+ */
+BSP_I2C_busnumber_t BSP_internal_temp_hum_get_bus(void)
+{
+    return UAIR_BSP_internal_temp_hum_get_bus();
+}
+
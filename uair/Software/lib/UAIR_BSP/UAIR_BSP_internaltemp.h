@@ -45,6 +45,8 @@
 
 #include "UAIR_BSP_types.h"
 #include "UAIR_BSP_error.h"
+#include "UAIR_BSP_powerzone.h"
+#include "UAIR_BSP_i2c.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -53,6 +55,8 @@ extern "C" {
 unsigned int BSP_internal_temp_hum_get_measure_delay_us(void);
 BSP_error_t BSP_internal_temp_hum_start_measure(void);
 BSP_sensor_state_t BSP_internal_temp_hum_get_sensor_state(void);
+BSP_powerzone_t BSP_internal_temp_hum_get_powerzone(void);
+BSP_I2C_busnumber_t BSP_internal_temp_hum_get_bus(void);
 BSP_error_t BSP_internal_temp_hum_read_measure(int32_t *temp, int32_t *hum);
 
 #ifdef __cplusplus
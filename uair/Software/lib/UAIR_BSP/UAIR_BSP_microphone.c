@@ -55,6 +55,11 @@ SPI_HandleTypeDef UAIR_BSP_microphone_spi = {0};
 
 static VM3011_t vm3011;
 
+static uint8_t vm3011_fetched_gain;
+static bool vm3011_gain_fetched = false;
+static BSP_I2C_async_callback_t vm3011_async_callback = NULL;
+static void *vm3011_async_userdata = NULL;
+
 static BSP_powerzone_t UAIR_BSP_microphone_get_powerzone(void);
 static BSP_I2C_busnumber_t UAIR_BSP_microphone_get_bus(void);
 static void UAIR_BSP_microphone_set_faulty(void);
@@ -193,6 +198,12 @@ BSP_error_t UAIR_BSP_microphone_init(void)
 
 BSP_error_t BSP_microphone_read_gain(uint8_t *gain)
 {
+    if (vm3011_gain_fetched) {
+        vm3011_gain_fetched = false;
+        *gain = vm3011_fetched_gain;
+        return BSP_ERROR_NONE;
+    }
+
     VM3011_op_result_t r = VM3011_Read_Threshold(&vm3011, gain);
 
     if (r==VM3011_OP_SUCCESS)
@@ -206,6 +217,68 @@ BSP_error_t BSP_microphone_read_gain(uint8_t *gain)
     return BSP_ERROR_COMPONENT_FAILURE;
 }
 
+static void UAIR_BSP_microphone_read_gain_done(void *userdata, BSP_error_t err)
+{
+    BSP_I2C_async_callback_t callback = vm3011_async_callback;
+
+    if (err == BSP_ERROR_NONE) {
+        UAIR_sensor_ok(&microphone_sensor);
+        vm3011_gain_fetched = true;
+    } else {
+        UAIR_sensor_fault_detected(&microphone_sensor);
+        err = BSP_ERROR_COMPONENT_FAILURE;
+    }
+
+    vm3011_async_callback = NULL;
+    if (callback)
+        callback(vm3011_async_userdata, err);
+}
+
+/**
+ * @brief Fetch microphone gain without blocking
+ * @ingroup UAIR_BSP_SENSOR_MICROPHONE
+ *
+ * Once the callback reports \ref BSP_ERROR_NONE, \ref BSP_microphone_read_gain
+ * returns the fetched gain without accessing the bus.
+ *
+ * @return \ref BSP_ERROR_NONE if the transfer was started.
+ * @return \ref BSP_ERROR_NO_INIT if the microphone is not available.
+ * @return \ref BSP_ERROR_BUSY if the bus is busy.
+ * @return \ref BSP_ERROR_COMPONENT_FAILURE if the transfer could not be started.
+ */
+BSP_error_t BSP_microphone_read_gain_async(BSP_I2C_async_callback_t callback, void *userdata)
+{
+    BSP_I2C_busnumber_t busno = UAIR_BSP_microphone_get_bus();
+    BSP_error_t err;
+
+    if (sensor_state != SENSOR_AVAILABLE)
+        return BSP_ERROR_NO_INIT;
+
+    err = UAIR_BSP_I2C_async_begin(busno, &UAIR_BSP_microphone_read_gain_done, NULL);
+
+    if (err != BSP_ERROR_NONE)
+        return err;
+
+    vm3011_gain_fetched = false;
+    vm3011_async_callback = callback;
+    vm3011_async_userdata = userdata;
+
+    switch (VM3011_Read_Threshold_async(&vm3011, &vm3011_fetched_gain)) {
+    case VM3011_OP_SUCCESS:
+        break;
+    case VM3011_OP_HAL_BUSY:
+        UAIR_BSP_I2C_async_cancel(busno);
+        err = BSP_ERROR_BUSY;
+        break;
+    default:
+        UAIR_BSP_I2C_async_cancel(busno);
+        UAIR_sensor_fault_detected(&microphone_sensor);
+        err = BSP_ERROR_COMPONENT_FAILURE;
+        break;
+    }
+    return err;
+}
+
 static void UAIR_BSP_microphone_set_faulty(void)
 {
     UAIR_BSP_microphone_deinit();
@@ -220,9 +293,29 @@ void UAIR_BSP_microphone_deinit()
     }
 
     sensor_state = SENSOR_OFFLINE;
+    vm3011_gain_fetched = false;
+    vm3011_async_callback = NULL;
 }
 
 BSP_sensor_state_t BSP_microphone_get_sensor_state(void)
 {
     return sensor_state;
 }
+
+/**
+ * @brief Get the powerzone the microphone is powered from
+ * @ingroup UAIR_BSP_SENSOR_MICROPHONE
+ */
+BSP_powerzone_t BSP_microphone_get_powerzone(void)
+{
+    return UAIR_BSP_microphone_get_powerzone();
+}
+
+/**
+ * @brief Get the I2C bus the microphone is connected to
+ * @ingroup UAIR_BSP_SENSOR_MICROPHONE
+ */
+BSP_I2C_busnumber_t BSP_microphone_get_bus(void)
+{
+    return UAIR_BSP_microphone_get_bus();
+}
@@ -53,6 +53,8 @@
 
 #include "UAIR_BSP_types.h"
 #include "UAIR_BSP_error.h"
+#include "UAIR_BSP_powerzone.h"
+#include "UAIR_BSP_i2c.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -61,7 +63,10 @@ extern "C" {
 #define MICROPHONE_MAX_GAIN (31U)
 
 BSP_error_t BSP_microphone_read_gain(uint8_t *gain);
+BSP_error_t BSP_microphone_read_gain_async(BSP_I2C_async_callback_t callback, void *userdata);
 BSP_sensor_state_t BSP_microphone_get_sensor_state(void);
+BSP_powerzone_t BSP_microphone_get_powerzone(void);
+BSP_I2C_busnumber_t BSP_microphone_get_bus(void);
 
 #ifdef __cplusplus
 }
@@ -80,6 +80,8 @@ typedef struct {
     void *userdata;
     bool operational;
     uint8_t count;
+    uint32_t on_since;  /* HAL_GetTick() when the first reference was taken */
+    uint32_t on_time;   /* ms powered by references, up to the last release */
 } powerzone_data_t;
 
 static powerzone_data_t powerzone_data[UAIR_POWERZONE_MAX+1] = {0};
@@ -138,6 +140,7 @@ BSP_error_t UAIR_BSP_powerzone_init(void)
 
             powerzone_data[i].operational = false;
             powerzone_data[i].count = 0;
+            powerzone_data[i].on_time = 0;
 
             BSP_TRACE("Init powerzone %d", i);
             if (powerzone_config[i].init) {
@@ -223,6 +226,7 @@ BSP_error_t BSP_powerzone_ref(BSP_powerzone_t powerzone)
             if (powerzone_data[powerzone].count == 0)
             {
                 UAIR_BSP_powerzone_enable_internal(powerzone);
+                powerzone_data[powerzone].on_since = HAL_GetTick();
             }
             if (powerzone_data[powerzone].count == 255)
             {
@@ -299,6 +303,7 @@ BSP_error_t BSP_powerzone_unref(BSP_powerzone_t powerzone)
             if (powerzone_data[powerzone].count == 0)
             {
                 UAIR_BSP_powerzone_disable_internal(powerzone);
+                powerzone_data[powerzone].on_time += HAL_GetTick() - powerzone_data[powerzone].on_since;
             }
             err = BSP_ERROR_NONE;
         }
@@ -306,6 +311,17 @@ BSP_error_t BSP_powerzone_unref(BSP_powerzone_t powerzone)
     return err;
 }
 
+uint32_t BSP_powerzone_get_on_time(BSP_powerzone_t powerzone)
+{
+    uint32_t on_time = powerzone_data[powerzone].on_time;
+
+    if (powerzone_data[powerzone].count != 0)
+    {
+        on_time += HAL_GetTick() - powerzone_data[powerzone].on_since;
+    }
+    return on_time;
+}
+
 static BSP_I2C_busnumber_t UAIR_BSP_powerzone_get_i2c_bus(BSP_powerzone_t zone)
 {
     BSP_I2C_busnumber_t busno = BSP_I2C_BUS_NONE;
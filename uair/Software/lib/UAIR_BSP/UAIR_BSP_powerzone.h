@@ -105,6 +105,19 @@ BSP_error_t BSP_powerzone_ref(BSP_powerzone_t powerzone);
  */
 BSP_error_t BSP_powerzone_unref(BSP_powerzone_t powerzone);
 
+/**
+ * @brief Time a powerzone has been powered
+ * @ingroup UAIR_BSP_POWERZONE
+ *
+ *
+ * Counts the time between the first reference and the last release, whoever
+ * holds them, including the current one if the powerzone is on. Wraps
+ * around after about 49 days, callers are expected to take differences.
+ *
+ * \return milliseconds powered since the powerzones were initialized
+ */
+uint32_t BSP_powerzone_get_on_time(BSP_powerzone_t powerzone);
+
 /**
  * @brief Attach a callback to a powerzone
  * @ingroup UAIR_BSP_POWERZONE
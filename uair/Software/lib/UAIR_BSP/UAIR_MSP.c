@@ -23,6 +23,7 @@
 
 #include "UAIR_BSP.h"
 #include "pvt/UAIR_BSP_microphone_p.h"
+#include "pvt/UAIR_BSP_clk_timer_p.h"
 
 static void msp_error_handler(void);
 
@@ -190,6 +191,11 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef *i2cHandle)
         gpio_init_structure.Alternate = EXT_SENSOR_I2C1_SCL_SDA_AF;
         HAL_GPIO_Init(EXT_SENSOR_I2C1_SDA_GPIO_PORT, &gpio_init_structure);
 
+        HAL_NVIC_SetPriority(I2C1_EV_IRQn, UAIR_BSP_I2C_IT_PRIORITY, 0);
+        HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+        HAL_NVIC_SetPriority(I2C1_ER_IRQn, UAIR_BSP_I2C_IT_PRIORITY, 0);
+        HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
+
     } else if (i2cHandle->Instance == EXT_SENSOR_I2C2)
     {
         RCC_PeriphCLKInitStruct.PeriphClockSelection = EXT_SENSOR_I2C2_PERIPH_CLK;
@@ -210,6 +216,11 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef *i2cHandle)
         gpio_init_structure.Alternate = EXT_SENSOR_I2C2_SCL_SDA_AF;
         HAL_GPIO_Init(EXT_SENSOR_I2C2_SDA_GPIO_PORT, &gpio_init_structure);
 
+        HAL_NVIC_SetPriority(I2C2_EV_IRQn, UAIR_BSP_I2C_IT_PRIORITY, 0);
+        HAL_NVIC_EnableIRQ(I2C2_EV_IRQn);
+        HAL_NVIC_SetPriority(I2C2_ER_IRQn, UAIR_BSP_I2C_IT_PRIORITY, 0);
+        HAL_NVIC_EnableIRQ(I2C2_ER_IRQn);
+
     } else if (i2cHandle->Instance == EXT_SENSOR_I2C3)
     {
         RCC_PeriphCLKInitStruct.PeriphClockSelection = EXT_SENSOR_I2C3_PERIPH_CLK;
@@ -231,6 +242,11 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef *i2cHandle)
         gpio_init_structure.Pin = EXT_SENSOR_I2C3_SDA_PIN;
         gpio_init_structure.Alternate = EXT_SENSOR_I2C3_SCL_SDA_AF;
         HAL_GPIO_Init(EXT_SENSOR_I2C3_SDA_GPIO_PORT, &gpio_init_structure);
+
+        HAL_NVIC_SetPriority(I2C3_EV_IRQn, UAIR_BSP_I2C_IT_PRIORITY, 0);
+        HAL_NVIC_EnableIRQ(I2C3_EV_IRQn);
+        HAL_NVIC_SetPriority(I2C3_ER_IRQn, UAIR_BSP_I2C_IT_PRIORITY, 0);
+        HAL_NVIC_EnableIRQ(I2C3_ER_IRQn);
     }
     else
     {
@@ -242,6 +258,8 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef *i2cHandle)
 {
     if (i2cHandle->Instance == EXT_SENSOR_I2C3)
     {
+        HAL_NVIC_DisableIRQ(I2C3_EV_IRQn);
+        HAL_NVIC_DisableIRQ(I2C3_ER_IRQn);
         EXT_SENSOR_I2C3_FORCE_RESET();
         EXT_SENSOR_I2C3_RELEASE_RESET();
 
@@ -249,6 +267,8 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef *i2cHandle)
         HAL_GPIO_DeInit(EXT_SENSOR_I2C3_SDA_GPIO_PORT, EXT_SENSOR_I2C3_SDA_PIN);
     } else if (i2cHandle->Instance == EXT_SENSOR_I2C1)
     {
+        HAL_NVIC_DisableIRQ(I2C1_EV_IRQn);
+        HAL_NVIC_DisableIRQ(I2C1_ER_IRQn);
         EXT_SENSOR_I2C1_FORCE_RESET();
         EXT_SENSOR_I2C1_RELEASE_RESET();
 
@@ -256,6 +276,8 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef *i2cHandle)
         HAL_GPIO_DeInit(EXT_SENSOR_I2C1_SDA_GPIO_PORT, EXT_SENSOR_I2C1_SDA_PIN);
     } else if (i2cHandle->Instance == EXT_SENSOR_I2C2)
     {
+        HAL_NVIC_DisableIRQ(I2C2_EV_IRQn);
+        HAL_NVIC_DisableIRQ(I2C2_ER_IRQn);
         EXT_SENSOR_I2C2_FORCE_RESET();
         EXT_SENSOR_I2C2_RELEASE_RESET();
 
@@ -634,8 +656,12 @@ void HAL_LPTIM_MspInit(LPTIM_HandleTypeDef *hlptim)
         // TBD.
         //BSP_TRACE("LPTIM init");
         PeriphClkInitStruct.PeriphClockSelection = RCC_PERIPHCLK_LPTIM1;
-        PeriphClkInitStruct.Lptim1ClockSelection = RCC_LPTIM1CLKSOURCE_PCLK1;
-        //PeriphClkInitStruct.Lptim1ClockSelection = RCC_LPTIM1CLKSOURCE_LSE;
+        // LSE keeps counting in STOP modes, PCLK gives finer resolution
+        if (UAIR_BSP_LPTIM_uses_lse()) {
+            PeriphClkInitStruct.Lptim1ClockSelection = RCC_LPTIM1CLKSOURCE_LSE;
+        } else {
+            PeriphClkInitStruct.Lptim1ClockSelection = RCC_LPTIM1CLKSOURCE_PCLK1;
+        }
 
         if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInitStruct) != HAL_OK)
         {
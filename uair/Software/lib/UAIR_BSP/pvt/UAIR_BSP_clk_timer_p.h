@@ -2,6 +2,7 @@
 #define UAIR_BSP_CLK_TIMER_P_H__
 
 #include "UAIR_BSP_error.h"
+#include <stdbool.h>
 
 extern RTC_HandleTypeDef UAIR_BSP_rtc;
 extern IWDG_HandleTypeDef UAIR_BSP_iwdg;
@@ -14,7 +15,8 @@ BSP_error_t UAIR_BSP_LPTIM_Init(void);
 #define RTC_PREDIV_A ((1 << (15 - RTC_N_PREDIV_S)) - 1)
 
 BSP_error_t UAIR_BSP_LPTIM_count(uint32_t period);
-void UAIR_BSP_LPTIM_wait(void);
+void UAIR_BSP_LPTIM_wait(bool allow_stop);
 BSP_error_t UAIR_BSP_LPTIM_delay(unsigned us);
+bool UAIR_BSP_LPTIM_uses_lse(void);
 
 #endif
@@ -64,6 +64,13 @@ BSP_error_t UAIR_BSP_I2C_read_sda_scl(BSP_I2C_busnumber_t busno, int *sda, int *
 BSP_I2C_recover_action_t UAIR_BSP_I2C_analyse_and_recover_error(BSP_I2C_busnumber_t busno);
 BSP_error_t UAIR_BSP_I2C_manual_bus_release(BSP_I2C_busnumber_t busno);
 
+/* One asynchronous transfer per bus. Begin before starting the HAL _IT call, cancel if it fails to start. */
+BSP_error_t UAIR_BSP_I2C_async_begin(BSP_I2C_busnumber_t busno, BSP_I2C_async_callback_t callback, void *userdata);
+void UAIR_BSP_I2C_async_cancel(BSP_I2C_busnumber_t busno);
+
+void UAIR_BSP_I2C_EV_IRQHandler(I2C_TypeDef *instance);
+void UAIR_BSP_I2C_ER_IRQHandler(I2C_TypeDef *instance);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,6 +18,7 @@
 
 #include "UAIR_BSP.h"
 #include "stm32wlxx_it.h"
+#include "pvt/UAIR_BSP_i2c_p.h"
 
 extern SUBGHZ_HandleTypeDef hsubghz;
 extern UART_HandleTypeDef UAIR_BSP_debug_usart;
@@ -189,6 +190,36 @@ void LPTIM1_IRQHandler(void)
     HAL_LPTIM_IRQHandler(&UAIR_BSP_lptim);
 }
 
+void I2C1_EV_IRQHandler(void)
+{
+    UAIR_BSP_I2C_EV_IRQHandler(I2C1);
+}
+
+void I2C1_ER_IRQHandler(void)
+{
+    UAIR_BSP_I2C_ER_IRQHandler(I2C1);
+}
+
+void I2C2_EV_IRQHandler(void)
+{
+    UAIR_BSP_I2C_EV_IRQHandler(I2C2);
+}
+
+void I2C2_ER_IRQHandler(void)
+{
+    UAIR_BSP_I2C_ER_IRQHandler(I2C2);
+}
+
+void I2C3_EV_IRQHandler(void)
+{
+    UAIR_BSP_I2C_EV_IRQHandler(I2C3);
+}
+
+void I2C3_ER_IRQHandler(void)
+{
+    UAIR_BSP_I2C_ER_IRQHandler(I2C3);
+}
+
 extern void Default_Handler(void);
 
 #ifdef HAVE_LTO
@@ -202,11 +202,12 @@ void UAIR_LPM_EnterLowPower(void)
   UAIR_LPM_EXIT_CRITICAL_SECTION();
 }
 
-/*
- STOP1 is required if we are to use SPI/I2S and DMA
+/**
+ * @brief  Enter STOP1 mode, regardless of the Stop Mode state
+ * @note   Unlike STOP2, all peripherals keep their register contents.
+ *         The caller is expected to have checked \ref UAIR_LPM_GetStopMode
  */
-#if 0
-static void UAIR_LPM_EnterStop1(void)
+void UAIR_LPM_EnterStop1Mode(void)
 {
   UAIR_LPM_ENTER_CRITICAL_SECTION();
 
@@ -220,5 +221,4 @@ static void UAIR_LPM_EnterStop1(void)
   UAIR_LPM_PostStopModeHook();
 
   UAIR_LPM_EXIT_CRITICAL_SECTION();
-}
-#endif
\ No newline at end of file
+}
\ No newline at end of file
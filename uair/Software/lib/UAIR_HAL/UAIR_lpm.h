@@ -102,6 +102,7 @@ void UAIR_LPM_SetStopMode(UAIR_LPM_bm_t lpm_id_bm, UAIR_LPM_State_t state);
 UAIR_LPM_bm_t UAIR_LPM_GetStopMode(void);
 
 void UAIR_LPM_EnterLowPower(void);
+void UAIR_LPM_EnterStop1Mode(void);
 
 #ifdef __cplusplus
 }
@@ -31,6 +31,10 @@
 
 #define RtcHandle UAIR_BSP_rtc
 
+#ifdef HOSTMODE
+extern void rtc_poll_wait(void);
+#endif
+
 /**
   * @brief Minimum timeout delay of Alarm in ticks
   */
@@ -296,7 +300,11 @@ void UAIR_RTC_DelayMs(uint32_t delay)
   /* Wait delay ms */
   while (((GetTimerTicks() - timeout)) < delayTicks)
   {
+#ifdef HOSTMODE
+    rtc_poll_wait();
+#else
     __NOP();
+#endif
   }
 }
 
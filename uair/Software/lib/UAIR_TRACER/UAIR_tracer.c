@@ -1 +1,208 @@
+#include "UAIR_tracer.h"
+
 int tracer_enabled = 0;
+
+#if defined (UAIR_ADVANCED_TRACER_ENABLE) && (UAIR_ADVANCED_TRACER_ENABLE == 1) && \
+    defined (UAIR_TOKEN_TRACER_ENABLE) && (UAIR_TOKEN_TRACER_ENABLE == 1)
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/* Start of the format section, provided by the linker */
+extern const char __start_uair_trace_fmt[];
+
+ADV_TRACER_Status_t UAIR_TRACER_TOKEN_Send(uint32_t VerboseLevel, uint32_t TimeStampState, uint32_t Wait, const char *strFormat, ...)
+{
+    uint8_t frame[UAIR_TRACER_TOKEN_MAX_FRAME];
+    /* The linker script asserts the section fits the 16-bit ids */
+    ptrdiff_t offset = strFormat - __start_uair_trace_fmt;
+    uint8_t flags = 0;
+    int size = -1;
+    va_list args;
+
+    /* Cheaper than building a frame that is given up */
+    if (ADV_TRACER_GetVerboseLevel() < VerboseLevel)
+        return ADV_TRACER_GIVEUP;
+
+    if (TimeStampState != ADV_TRACER_TS_OFF)
+        flags |= UAIR_TRACER_TOKEN_FLAG_TS;
+
+    if (offset >= 0 && offset <= (ptrdiff_t)UAIR_TRACER_TOKEN_MAX_ID) {
+        va_start(args, strFormat);
+        size = UAIR_TRACER_TOKEN_Encode(frame, sizeof(frame), flags, (uint16_t)offset,
+                                         (flags & UAIR_TRACER_TOKEN_FLAG_TS) ? HAL_GetTick() : 0, strFormat, args);
+        va_end(args);
+    }
+
+    if (size < 0) {
+        /* Too long for a frame, or a conversion the decoder does not know: send it as text */
+        int len;
+        va_start(args, strFormat);
+        len = ADV_TRACER_VSNPRINTF((char*)frame, ADV_TRACER_TMP_BUF_SIZE, strFormat, args);
+        va_end(args);
+        if (len < 0)
+            return ADV_TRACER_INVALID_PARAM;
+        if (len >= (int)ADV_TRACER_TMP_BUF_SIZE)
+            len = ADV_TRACER_TMP_BUF_SIZE - 1;
+        return Wait ? ADV_TRACER_COND_Send_Wait(VerboseLevel, ADV_TRACER_T_REG_OFF, TimeStampState, frame, (uint16_t)len)
+                    : ADV_TRACER_COND_Send(VerboseLevel, ADV_TRACER_T_REG_OFF, TimeStampState, frame, (uint16_t)len);
+    }
+
+    return Wait ? ADV_TRACER_COND_Send_Wait(VerboseLevel, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, frame, (uint16_t)size)
+                : ADV_TRACER_COND_Send(VerboseLevel, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, frame, (uint16_t)size);
+}
+
+#endif
+
+int UAIR_TRACER_Writer_Begin(UAIR_tracer_writer_t *w, uint32_t VerboseLevel, uint16_t max_length)
+{
+    w->used = 0;
+    w->length = max_length;
+    w->active = 0;
+
+#if defined (UAIR_ADVANCED_TRACER_ENABLE) && (UAIR_ADVANCED_TRACER_ENABLE == 1)
+    if (ADV_TRACER_COND_ZCSend_Allocation(VerboseLevel, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, max_length,
+                                          &w->fifo, &w->fifo_size, &w->start) != ADV_TRACER_OK)
+        return -1;
+    w->active = 1;
+#elif defined (UAIR_TINY_TRACER_ENABLE) && (UAIR_TINY_TRACER_ENABLE == 1)
+    (void)VerboseLevel;
+    if (!tracer_enabled)
+        return -1;
+    w->fifo = NULL;
+    w->active = 1;
+#else
+    (void)VerboseLevel;
+    return -1;
+#endif
+    return 0;
+}
+
+#if defined (UAIR_TINY_TRACER_ENABLE) && (UAIR_TINY_TRACER_ENABLE == 1) && \
+    !(defined (UAIR_ADVANCED_TRACER_ENABLE) && (UAIR_ADVANCED_TRACER_ENABLE == 1))
+static void writer_flush(UAIR_tracer_writer_t *w)
+{
+    if (w->used) {
+        w->chunk[w->used] = '\0';
+        tiny_printf("%s", w->chunk);
+        w->used = 0;
+    }
+}
+#endif
+
+void UAIR_TRACER_Writer_Char(UAIR_tracer_writer_t *w, char c)
+{
+    if (!w->active)
+        return;
+
+#if defined (UAIR_ADVANCED_TRACER_ENABLE) && (UAIR_ADVANCED_TRACER_ENABLE == 1)
+    if (w->used < w->length) {
+        w->fifo[(w->start + w->used) % w->fifo_size] = (uint8_t)c;
+        w->used++;
+    }
+#elif defined (UAIR_TINY_TRACER_ENABLE) && (UAIR_TINY_TRACER_ENABLE == 1)
+    w->chunk[w->used++] = c;
+    if (w->used == UAIR_TRACER_WRITER_CHUNK)
+        writer_flush(w);
+#else
+    (void)c;
+#endif
+}
+
+void UAIR_TRACER_Writer_Str(UAIR_tracer_writer_t *w, const char *s)
+{
+    while (*s)
+        UAIR_TRACER_Writer_Char(w, *s++);
+}
+
+void UAIR_TRACER_Writer_Hex8(UAIR_tracer_writer_t *w, uint8_t value)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    UAIR_TRACER_Writer_Char(w, hex[value >> 4]);
+    UAIR_TRACER_Writer_Char(w, hex[value & 0xF]);
+}
+
+void UAIR_TRACER_Writer_Dec(UAIR_tracer_writer_t *w, int32_t value, unsigned width)
+{
+    char digits[10];
+    unsigned n = 0;
+    uint32_t v = (uint32_t)value;
+
+    if (value < 0) {
+        UAIR_TRACER_Writer_Char(w, '-');
+        v = 0U - v;
+    }
+    do {
+        digits[n++] = (char)('0' + (v % 10U));
+        v /= 10U;
+    } while (v && n < sizeof(digits));
+
+    while (width > n) {
+        UAIR_TRACER_Writer_Char(w, '0');
+        width--;
+    }
+    while (n)
+        UAIR_TRACER_Writer_Char(w, digits[--n]);
+}
+
+void UAIR_TRACER_Writer_Milli(UAIR_tracer_writer_t *w, int32_t value)
+{
+    /* Rounded to hundredths, as "%.2f" would */
+    int32_t centi = (value >= 0) ? (value + 5) / 10 : (value - 5) / 10;
+
+    if (centi < 0) {
+        UAIR_TRACER_Writer_Char(w, '-');
+        centi = -centi;
+    }
+    UAIR_TRACER_Writer_Dec(w, centi / 100, 1);
+    UAIR_TRACER_Writer_Char(w, '.');
+    UAIR_TRACER_Writer_Dec(w, centi % 100, 2);
+}
+
+void UAIR_TRACER_Writer_End(UAIR_tracer_writer_t *w)
+{
+    if (!w->active)
+        return;
+    w->active = 0;
+
+#if defined (UAIR_ADVANCED_TRACER_ENABLE) && (UAIR_ADVANCED_TRACER_ENABLE == 1)
+    ADV_TRACER_ZCSend_Trim(w->start, w->length, w->used);
+    ADV_TRACER_COND_ZCSend_Finalize();
+#elif defined (UAIR_TINY_TRACER_ENABLE) && (UAIR_TINY_TRACER_ENABLE == 1)
+    writer_flush(w);
+#endif
+}
+
+void UAIR_TRACER_DumpStats(void)
+{
+#if defined (UAIR_ADVANCED_TRACER_ENABLE) && (UAIR_ADVANCED_TRACER_ENABLE == 1) && defined(ADV_TRACER_STATISTICS)
+    ADV_TRACER_Stats_t stats;
+
+    ADV_TRACER_GetStats(&stats);
+
+    APP_PPRINTF("Tracer fifo: high water %u/%u, %lu writes (%lu bytes), %lu drops (%lu bytes), %lu waits (%lu ms)\r\n",
+                stats.HighWater, (unsigned)ADV_TRACER_FIFO_SIZE,
+                (unsigned long)stats.Writes, (unsigned long)stats.WrittenBytes,
+                (unsigned long)stats.Drops, (unsigned long)stats.DroppedBytes,
+                (unsigned long)stats.Waits, (unsigned long)stats.WaitTicks);
+#endif
+}
+
+void UAIR_TRACER_DumpStatsOnChange(void)
+{
+#if defined (UAIR_ADVANCED_TRACER_ENABLE) && (UAIR_ADVANCED_TRACER_ENABLE == 1) && defined(ADV_TRACER_STATISTICS)
+    static uint32_t last_drops = 0;
+    static uint32_t last_waits = 0;
+    ADV_TRACER_Stats_t stats;
+
+    ADV_TRACER_GetStats(&stats);
+
+    if ((stats.Drops == last_drops) && (stats.Waits == last_waits))
+        return;
+
+    last_drops = stats.Drops;
+    last_waits = stats.Waits;
+    UAIR_TRACER_DumpStats();
+#endif
+}
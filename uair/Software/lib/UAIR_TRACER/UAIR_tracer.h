@@ -32,6 +32,7 @@ extern "C" {
 #include "stm32_adv_usart.h"
 #include "tiny_printf.h"
 #include "app_conf.h"
+#include "UAIR_tracer_token.h"
 
 extern int tracer_enabled;
 
@@ -45,11 +46,29 @@ extern int tracer_enabled;
 #define TRACER_RESUME()                   do{ {vcom_Resume();}} while(0);
 #define TRACER_DEINIT()                   do{ {ADV_TRACER_DeInit();}} while(0);
 
-#define APP_PPRINTF(...)                do{ } while( ADV_TRACER_OK != ADV_TRACER_COND_FSend(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, __VA_ARGS__) ) //Polling Mode
+#if defined (UAIR_TOKEN_TRACER_ENABLE) && (UAIR_TOKEN_TRACER_ENABLE == 1)
+
+/* Formats stay in flash, only their id and the raw arguments are traced (see UAIR_tracer_token.h) */
+#define UAIR_TRACER_TOKEN(FMT)          __extension__ ({ static const char uair_trace_fmt[] __attribute__((section(UAIR_TRACER_TOKEN_SECTION))) = FMT; uair_trace_fmt; })
+
+ADV_TRACER_Status_t UAIR_TRACER_TOKEN_Send(uint32_t VerboseLevel, uint32_t TimeStampState, uint32_t Wait, const char *strFormat, ...);
+
+#define APP_PPRINTF(FMT, ...)           do{ {UAIR_TRACER_TOKEN_Send(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_TS_OFF, 1, UAIR_TRACER_TOKEN(FMT), ##__VA_ARGS__);}} while(0); //Polling Mode
+#define APP_TPRINTF(FMT, ...)           do{ {UAIR_TRACER_TOKEN_Send(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_TS_ON, 0, UAIR_TRACER_TOKEN(FMT), ##__VA_ARGS__);}} while(0); //with timestamp
+#define APP_PRINTF(FMT, ...)            do{ {UAIR_TRACER_TOKEN_Send(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_TS_OFF, 0, UAIR_TRACER_TOKEN(FMT), ##__VA_ARGS__);}} while(0);
+#define APP_LOG(TS,VL,FMT, ...)         do{ {UAIR_TRACER_TOKEN_Send(VL, TS, 0, UAIR_TRACER_TOKEN(FMT), ##__VA_ARGS__);}} while(0);
+
+#else
+
+#define APP_PPRINTF(...)                do{ {ADV_TRACER_COND_FSend_Wait(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, __VA_ARGS__);}} while(0); //Polling Mode
 #define APP_TPRINTF(...)                do{ {ADV_TRACER_COND_FSend(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_ON, __VA_ARGS__);}} while(0); //with timestamp
 #define APP_PRINTF(...)                 do{ {ADV_TRACER_COND_FSend(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, __VA_ARGS__);}} while(0);
-#define LIB_PRINTF(...)                 do{ } while( ADV_TRACER_OK != ADV_TRACER_COND_FSend(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, __VA_ARGS__) ) //Polling Mode
 #define APP_LOG(TS,VL,...)              do{ {ADV_TRACER_COND_FSend(VL, ADV_TRACER_T_REG_OFF, TS, __VA_ARGS__);}} while(0);
+
+#endif
+
+/* Libraries may trace formats built at runtime, always as text */
+#define LIB_PRINTF(...)                 do{ {ADV_TRACER_COND_FSend_Wait(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF, __VA_ARGS__);}} while(0); //Polling Mode
 #define LIB_LOG(TS,VL,...)              do{ {ADV_TRACER_COND_FSend(VL, ADV_TRACER_T_REG_OFF, TS, __VA_ARGS__);}} while(0);
 ;
 
@@ -87,6 +106,39 @@ extern int tracer_enabled;
 
 #endif
 
+/*
+ * Zero-copy trace writer. Text is written straight into the ADV_TRACER
+ * fifo, without a format string or a stack buffer; the tiny tracer gets it
+ * in small chunks. Begin reserves max_length bytes, End gives back what
+ * was not used.
+ */
+#define UAIR_TRACER_WRITER_CHUNK (32)
+
+typedef struct {
+    uint8_t *fifo;
+    uint16_t fifo_size;
+    uint16_t start;
+    uint16_t length;
+    uint16_t used;
+    uint8_t active;
+    char chunk[UAIR_TRACER_WRITER_CHUNK + 1];
+} UAIR_tracer_writer_t;
+
+int UAIR_TRACER_Writer_Begin(UAIR_tracer_writer_t *w, uint32_t VerboseLevel, uint16_t max_length);
+void UAIR_TRACER_Writer_Char(UAIR_tracer_writer_t *w, char c);
+void UAIR_TRACER_Writer_Str(UAIR_tracer_writer_t *w, const char *s);
+void UAIR_TRACER_Writer_Hex8(UAIR_tracer_writer_t *w, uint8_t value);
+/* Zero padded up to width digits */
+void UAIR_TRACER_Writer_Dec(UAIR_tracer_writer_t *w, int32_t value, unsigned width);
+/* A value in thousandths, with two decimals */
+void UAIR_TRACER_Writer_Milli(UAIR_tracer_writer_t *w, int32_t value);
+void UAIR_TRACER_Writer_End(UAIR_tracer_writer_t *w);
+
+/* Prints the ADV_TRACER fifo health counters */
+void UAIR_TRACER_DumpStats(void);
+/* Same, only once traces were dropped or waited for room since the last call */
+void UAIR_TRACER_DumpStatsOnChange(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,192 @@
+#include "UAIR_tracer_token.h"
+
+#include <stddef.h>
+#include <string.h>
+
+typedef enum {
+    TOKEN_ARG_NONE,
+    TOKEN_ARG_INT,
+    TOKEN_ARG_LONG,
+    TOKEN_ARG_LLONG,
+    TOKEN_ARG_SIZE,
+    TOKEN_ARG_DOUBLE,
+    TOKEN_ARG_STRING,
+    TOKEN_ARG_POINTER,
+    TOKEN_ARG_UNSUPPORTED
+} token_arg_t;
+
+/* Skips to the end of the next conversion in fmt and classifies its argument */
+static const char *token_next_arg(const char *fmt, token_arg_t *arg, unsigned *stars)
+{
+    token_arg_t integer = TOKEN_ARG_INT;
+
+    while (*fmt && *fmt != '%')
+        fmt++;
+    if (*fmt == '\0')
+        return NULL;
+    fmt++;
+
+    *stars = 0;
+
+    if (*fmt == '%') {
+        *arg = TOKEN_ARG_NONE;
+        return fmt + 1;
+    }
+
+    while (*fmt == '-' || *fmt == '+' || *fmt == ' ' || *fmt == '#' || *fmt == '0')
+        fmt++;
+    while ((*fmt >= '0' && *fmt <= '9') || *fmt == '.' || *fmt == '*') {
+        if (*fmt == '*')
+            (*stars)++;
+        fmt++;
+    }
+
+    switch (*fmt) {
+    case 'h':
+        fmt++;
+        if (*fmt == 'h')
+            fmt++;
+        break;
+    case 'l':
+        fmt++;
+        integer = TOKEN_ARG_LONG;
+        if (*fmt == 'l') {
+            fmt++;
+            integer = TOKEN_ARG_LLONG;
+        }
+        break;
+    case 'j':
+        fmt++;
+        integer = TOKEN_ARG_LLONG;
+        break;
+    case 'z':
+    case 't':
+        fmt++;
+        integer = TOKEN_ARG_SIZE;
+        break;
+    default:
+        break;
+    }
+
+    switch (*fmt) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        *arg = integer;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+        *arg = TOKEN_ARG_DOUBLE;
+        break;
+    case 's':
+        *arg = (integer == TOKEN_ARG_INT) ? TOKEN_ARG_STRING : TOKEN_ARG_UNSUPPORTED;
+        break;
+    case 'p':
+        *arg = TOKEN_ARG_POINTER;
+        break;
+    default:
+        *arg = TOKEN_ARG_UNSUPPORTED;
+        break;
+    }
+
+    return *fmt ? fmt + 1 : fmt;
+}
+
+static uint8_t *token_put(uint8_t *p, const uint8_t *end, uint64_t value, unsigned size)
+{
+    if (p == NULL || (end - p) < (ptrdiff_t)size)
+        return NULL;
+
+    while (size--) {
+        *p++ = (uint8_t)value;
+        value >>= 8;
+    }
+    return p;
+}
+
+/* Encodes the arguments after the frame header. Returns NULL if they do not fit, or cannot be encoded. */
+static uint8_t *token_encode(uint8_t *p, const uint8_t *end, const char *fmt, va_list args)
+{
+    token_arg_t arg;
+    unsigned stars;
+
+    while ((fmt = token_next_arg(fmt, &arg, &stars)) != NULL) {
+        while (stars--)
+            p = token_put(p, end, (uint32_t)va_arg(args, int), 4);
+
+        switch (arg) {
+        case TOKEN_ARG_NONE:
+            break;
+        case TOKEN_ARG_INT:
+            p = token_put(p, end, (uint32_t)va_arg(args, int), 4);
+            break;
+        case TOKEN_ARG_LONG:
+            p = token_put(p, end, (uint64_t)va_arg(args, long), sizeof(long));
+            break;
+        case TOKEN_ARG_LLONG:
+            p = token_put(p, end, (uint64_t)va_arg(args, long long), 8);
+            break;
+        case TOKEN_ARG_SIZE:
+            p = token_put(p, end, (uint64_t)va_arg(args, size_t), sizeof(size_t));
+            break;
+        case TOKEN_ARG_POINTER:
+            p = token_put(p, end, (uint64_t)(uintptr_t)va_arg(args, void*), sizeof(void*));
+            break;
+        case TOKEN_ARG_DOUBLE:
+            {
+                double d = va_arg(args, double);
+                uint64_t bits;
+                memcpy(&bits, &d, sizeof(bits));
+                p = token_put(p, end, bits, 8);
+            }
+            break;
+        case TOKEN_ARG_STRING:
+            {
+                const char *s = va_arg(args, const char*);
+                size_t len;
+                /* As printf renders it */
+                if (s == NULL)
+                    s = "(null)";
+                len = strlen(s);
+                if (len > 255)
+                    len = 255;
+                p = token_put(p, end, len, 1);
+                if (p == NULL || (size_t)(end - p) < len)
+                    return NULL;
+                memcpy(p, s, len);
+                p += len;
+            }
+            break;
+        default:
+            return NULL;
+        }
+        if (p == NULL)
+            return NULL;
+    }
+    return p;
+}
+
+int UAIR_TRACER_TOKEN_Encode(uint8_t *frame, size_t size, uint8_t flags, uint16_t id, uint32_t tick, const char *fmt, va_list args)
+{
+    const uint8_t *end = &frame[size];
+    uint8_t *p;
+
+    if (size < 5)
+        return -1;
+
+    if (sizeof(long) == 8 || sizeof(void*) == 8)
+        flags |= UAIR_TRACER_TOKEN_FLAG_WIDE;
+
+    frame[0] = UAIR_TRACER_TOKEN_MARK;
+    frame[2] = flags;
+    frame[3] = (uint8_t)id;
+    frame[4] = (uint8_t)(id >> 8);
+    p = &frame[5];
+
+    if (flags & UAIR_TRACER_TOKEN_FLAG_TS)
+        p = token_put(p, end, tick, 4);
+
+    p = token_encode(p, end, fmt, args);
+    if (p == NULL || (p - &frame[2]) > 255)
+        return -1;
+
+    frame[1] = (uint8_t)(p - &frame[2]);
+    return (int)(p - frame);
+}
@@ -0,0 +1,78 @@
+/** Copyright © 2021 The Things Industries B.V.
+ *  Copyright © 2021 MAIS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file UAIR_tracer_token.h
+ *
+ * @copyright Copyright (c) 2021 The Things Industries B.V., (c) 2021 MAIS Project
+ *
+ * Tokenized trace frames, shared by the firmware and the host decoder.
+ *
+ * With UAIR_TOKEN_TRACER_ENABLE, APP_* trace formats are placed in the
+ * "uair_trace_fmt" section and the offset of a format in that section is
+ * its 16-bit id. The section is dumped from the ELF (objcopy) into the
+ * host dictionary. Instead of text, the ADV_TRACER FIFO gets one frame
+ * per message, interleaved with any plain text still traced:
+ *
+ *   UAIR_TRACER_TOKEN_MARK, uint8 length (of what follows),
+ *   uint8 flags, uint16 id, [uint32 HAL tick], arguments
+ *
+ * All values are little endian. Arguments are 4 bytes for int sized
+ * conversions, 8 for "ll"/"j" and for doubles, sizeof(long) or
+ * sizeof(void*) for "l"/"z"/"t"/"p" (see UAIR_TRACER_TOKEN_FLAG_WIDE),
+ * and a uint8 length followed by the bytes for strings (a NULL string is
+ * sent as "(null)", like printf prints it).
+ */
+
+#ifndef UAIR_TRACER_TOKEN_H__
+#define UAIR_TRACER_TOKEN_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UAIR_TRACER_TOKEN_MARK       (0x00U)    /*!< Never part of traced text */
+#define UAIR_TRACER_TOKEN_MAX_FRAME  (255U + 2U)
+
+#define UAIR_TRACER_TOKEN_FLAG_TS    (0x01U)    /*!< A timestamp follows the id */
+#define UAIR_TRACER_TOKEN_FLAG_WIDE  (0x02U)    /*!< long, size_t and pointers are 8 bytes */
+
+#define UAIR_TRACER_TOKEN_SECTION    "uair_trace_fmt"
+#define UAIR_TRACER_TOKEN_MAX_ID     (0xFFFFU)  /*!< Formats past this offset are traced as text */
+
+/**
+ * @brief Encodes a trace frame, from the mark to the last argument
+ *
+ * @param frame where to write the frame
+ * @param size size of frame, UAIR_TRACER_TOKEN_MAX_FRAME is the most a frame can take
+ * @param flags UAIR_TRACER_TOKEN_FLAG_TS or 0, UAIR_TRACER_TOKEN_FLAG_WIDE is added as needed
+ * @param id offset of fmt in the format section
+ * @param tick timestamp, only with UAIR_TRACER_TOKEN_FLAG_TS
+ * @param fmt printf format
+ * @param args arguments of fmt
+ * @return the size of the frame, -1 if the arguments don't fit or a conversion can't be encoded
+ */
+int UAIR_TRACER_TOKEN_Encode(uint8_t *frame, size_t size, uint8_t flags, uint16_t id, uint32_t tick, const char *fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /** UAIR_TRACER_TOKEN_H__ **/
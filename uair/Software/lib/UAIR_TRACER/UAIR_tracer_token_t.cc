@@ -0,0 +1,146 @@
+#include <catch2/catch.hpp>
+
+#include "UAIR_tracer_token.h"
+#include "tools/uair_trace_render.h"
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/* Formats are placed in the dictionary as the linker places them in the section */
+struct token_dictionary
+{
+    std::string data;
+
+    uint16_t add(const char *fmt, size_t offset = 0)
+    {
+        if (offset < data.size())
+            offset = data.size();
+        data.resize(offset);
+        data.append(fmt, strlen(fmt) + 1);
+        return (uint16_t)offset;
+    }
+};
+
+static int token_encode(uint8_t *frame, uint8_t flags, uint16_t id, uint32_t tick, const char *fmt, ...)
+{
+    va_list args;
+    int size;
+
+    va_start(args, fmt);
+    size = UAIR_TRACER_TOKEN_Encode(frame, UAIR_TRACER_TOKEN_MAX_FRAME, flags, id, tick, fmt, args);
+    va_end(args);
+    return size;
+}
+
+static std::string token_render(const token_dictionary &dict, const uint8_t *frame, unsigned len)
+{
+    char *text = NULL;
+    size_t text_size = 0;
+    FILE *out = open_memstream(&text, &text_size);
+    REQUIRE(out != NULL);
+
+    uair_trace_render_frame(dict.data.c_str(), dict.data.size(), frame, len, out);
+    fclose(out);
+
+    std::string rendered(text, text_size);
+    free(text);
+    return rendered;
+}
+
+/* Encodes, decodes and compares with what printf prints */
+#define TOKEN_ROUND_TRIP(FMT, ...) \
+    do { \
+        token_dictionary dict; \
+        uint8_t frame[UAIR_TRACER_TOKEN_MAX_FRAME]; \
+        char expected[512]; \
+        uint16_t id = dict.add("padding"); \
+        id = dict.add(FMT); \
+        snprintf(expected, sizeof(expected), FMT, ##__VA_ARGS__); \
+        int size = token_encode(frame, 0, id, 0, FMT, ##__VA_ARGS__); \
+        REQUIRE(size > 0); \
+        CHECK(frame[0] == UAIR_TRACER_TOKEN_MARK); \
+        CHECK(frame[1] == size - 2); \
+        CHECK(token_render(dict, &frame[2], frame[1]) == expected); \
+    } while (0)
+
+TEST_CASE("Tokenized traces decode as printf formats them","[lib][lib/Tracer]")
+{
+    SECTION("Argument widths")
+    {
+        TOKEN_ROUND_TRIP("%d %i %u %x %X %o %c %%", -5, 7, 4000000000U, 0xbeef, 0xBEEF, 8, 'q');
+        TOKEN_ROUND_TRIP("%hd %hhu %ld %lu %lld %llu", (short)-2, (unsigned char)250, -3L, 5UL, -9LL, 18446744073709551615ULL);
+        TOKEN_ROUND_TRIP("%jd %zu %td %p", (intmax_t)-7, (size_t)9, (ptrdiff_t)-1, (void*)0x1234);
+        TOKEN_ROUND_TRIP("%.2f %e %g %08.3f", 3.14159, 1e-3, 2.5, -1.5);
+        TOKEN_ROUND_TRIP("%*d|%-*d|%.*f|%+05d", 5, 42, 4, 7, 2, 1.23456, 3);
+    }
+
+    SECTION("Strings")
+    {
+        const char *none = NULL;
+
+        TOKEN_ROUND_TRIP("%s, %.2s, %5s, %-4s|", "hello", "abc", "xy", "z");
+        TOKEN_ROUND_TRIP("'%s' '%s'", "", none);
+
+        // Up to what a frame holds, then the caller falls back to text
+        token_dictionary dict;
+        uint8_t frame[UAIR_TRACER_TOKEN_MAX_FRAME];
+        std::string text(UAIR_TRACER_TOKEN_MAX_FRAME, 'a');
+        uint16_t id = dict.add("%s");
+
+        text.resize(UAIR_TRACER_TOKEN_MAX_FRAME - 2 - 3 - 1);
+        REQUIRE(token_encode(frame, 0, id, 0, "%s", text.c_str()) == UAIR_TRACER_TOKEN_MAX_FRAME);
+        CHECK(token_render(dict, &frame[2], frame[1]) == text);
+
+        text.push_back('a');
+        CHECK(token_encode(frame, 0, id, 0, "%s", text.c_str()) == -1);
+    }
+
+    SECTION("Conversions that can't be encoded")
+    {
+        uint8_t frame[UAIR_TRACER_TOKEN_MAX_FRAME];
+
+        CHECK(token_encode(frame, 0, 0, 0, "%ls", L"wide") == -1);
+        CHECK(token_encode(frame, 0, 0, 0, "%n", (int*)NULL) == -1);
+    }
+
+    SECTION("Timestamp")
+    {
+        token_dictionary dict;
+        uint8_t frame[UAIR_TRACER_TOKEN_MAX_FRAME];
+        uint16_t id = dict.add("at %u");
+
+        int size = token_encode(frame, UAIR_TRACER_TOKEN_FLAG_TS, id, 12345, "at %u", 6U);
+        REQUIRE(size == 2 + 3 + 4 + 4);
+        CHECK(token_render(dict, &frame[2], frame[1]) == "12s345:at 6");
+    }
+
+    SECTION("Section limit")
+    {
+        token_dictionary dict;
+        uint8_t frame[UAIR_TRACER_TOKEN_MAX_FRAME];
+
+        STATIC_REQUIRE(UAIR_TRACER_TOKEN_MAX_ID == UINT16_MAX);
+
+        // The last format that gets an id
+        uint16_t id = dict.add("last %d", UAIR_TRACER_TOKEN_MAX_ID - 7);
+        REQUIRE(dict.data.size() == (size_t)UAIR_TRACER_TOKEN_MAX_ID + 1);
+
+        int size = token_encode(frame, 0, id, 0, "last %d", -1);
+        REQUIRE(size > 0);
+        CHECK(frame[3] == 0xF8);
+        CHECK(frame[4] == 0xFF);
+        CHECK(token_render(dict, &frame[2], frame[1]) == "last -1");
+
+        // A dictionary that doesn't match the firmware
+        dict.data.resize(0x100);
+        CHECK(token_render(dict, &frame[2], frame[1]) == "<unknown trace id 65528>\r\n");
+
+        // Arguments cut short
+        dict.add("last %d", UAIR_TRACER_TOKEN_MAX_ID - 7);
+        CHECK(token_render(dict, &frame[2], frame[1] - 1) == "last <short trace frame>\r\n");
+    }
+}
@@ -88,6 +88,16 @@ typedef enum {
  *  @{
  */
 
+/**
+ *  @brief  ADV_TRACER_Trimmed.
+ *  end of a zero-copy allocation given back after later writes were queued,
+ *  the transfer skips it.
+ */
+typedef struct {
+  uint16_t Pos;                                          /*!<first byte given back.                     */
+  uint16_t Len;                                          /*!<bytes given back, 0 when the slot is free. */
+} ADV_TRACER_Trimmed;
+
 /**
  *  @brief  ADV_TRACER_Context.
  *  this structure contains all the data to handle the trace context.
@@ -113,6 +123,11 @@ typedef struct {
   uint16_t TraceWrPtr;                                   /*!<write pointer the trace system.            */
   uint16_t TraceSentSize;                                /*!<size of the latest transfer.               */
   uint16_t TraceLock;                                    /*!<lock counter of the trace system.          */
+  ADV_TRACER_Trimmed Trimmed[ADV_TRACER_TRIM_SLOTS];     /*!<trimmed ends the transfer skips.           */
+#if defined(ADV_TRACER_STATISTICS)
+  uint16_t TraceQueued;                                  /*!<bytes allocated and not yet sent.          */
+  ADV_TRACER_Stats_t Stats;                              /*!<fifo health counters.                      */
+#endif
 } ADV_TRACER_Context;
 
 /**
@@ -150,7 +165,14 @@ static uint8_t sztmp[ADV_TRACER_TMP_BUF_SIZE];
  */
 static void TRACE_TxCpltCallback(void *Ptr);
 static int16_t TRACE_AllocateBufer(uint16_t Size, uint16_t *Pos);
+static int16_t TRACE_TryAllocateBufer(uint16_t Size, uint16_t *Pos);
+static int16_t TRACE_WaitAllocateBufer(uint16_t Size, uint16_t *Pos);
+#if defined(ADV_TRACER_CONDITIONNAL)
+static ADV_TRACER_Status_t TRACE_COND_Send(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const uint8_t *pData, uint16_t Length, uint8_t Wait);
+#endif
 static ADV_TRACER_Status_t TRACE_Send(void);
+static void TRACE_SkipTrimmed(void);
+static uint16_t TRACE_ClampToTrimmed(uint16_t Size);
 
 static void TRACE_Lock(void);
 static void TRACE_UnLock(void);
@@ -285,6 +307,47 @@ ADV_TRACER_Status_t ADV_TRACER_COND_FSend(uint32_t VerboseLevel, uint32_t Region
   return ADV_TRACER_Send(buf, buff_size);
 #endif
 }
+
+ADV_TRACER_Status_t ADV_TRACER_COND_FSend_Wait(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const char *strFormat, ...)
+{
+  va_list vaArgs;
+  uint8_t buf[ADV_TRACER_TMP_BUF_SIZE+ADV_TRACER_TMP_MAX_TIMESTMAP_SIZE];
+  uint16_t buff_size = 0u;
+  int len;
+
+  /* check verbose level */
+  if (!( ADV_TRACER_Ctx.CurrentVerboseLevel >= VerboseLevel))
+  {
+    return ADV_TRACER_GIVEUP;
+  }
+
+  if(( Region & ADV_TRACER_Ctx.RegionMask) != Region)
+  {
+    return ADV_TRACER_REGIONMASKED;
+  }
+
+  if((ADV_TRACER_Ctx.timestamp_func != NULL) && (TimeStampState != 0u))
+  {
+    ADV_TRACER_Ctx.timestamp_func(buf,&buff_size);
+  }
+
+  /* format once, the retries only copy */
+  va_start( vaArgs, strFormat);
+  len = ADV_TRACER_VSNPRINTF((char *)(buf + buff_size), ADV_TRACER_TMP_BUF_SIZE, strFormat, vaArgs);
+  va_end(vaArgs);
+
+  if (len < 0)
+  {
+    return ADV_TRACER_INVALID_PARAM;
+  }
+  if (len >= (int)ADV_TRACER_TMP_BUF_SIZE)
+  {
+    len = ADV_TRACER_TMP_BUF_SIZE - 1;
+  }
+  buff_size += (uint16_t)len;
+
+  return TRACE_COND_Send(VerboseLevel, Region, 0u, buf, buff_size, 1u);
+}
 #endif
 
 ADV_TRACER_Status_t ADV_TRACER_FSend(const char *strFormat, ...)
@@ -422,8 +485,73 @@ ADV_TRACER_Status_t ADV_TRACER_ZCSend_Finalize(void)
     return TRACE_Send();
 }
 
+ADV_TRACER_Status_t ADV_TRACER_ZCSend_Trim(uint16_t WritePos, uint16_t Length, uint16_t Used)
+{
+  if (Used >= Length)
+  {
+    return ADV_TRACER_OK;
+  }
+
+  ADV_TRACER_ENTER_CRITICAL_SECTION();
+
+  /* nothing was allocated after this write, the fifo can take the room back */
+  if (ADV_TRACER_Ctx.TraceWrPtr == (uint16_t)((WritePos + Length) % ADV_TRACER_FIFO_SIZE))
+  {
+    ADV_TRACER_Ctx.TraceWrPtr = (uint16_t)((WritePos + Used) % ADV_TRACER_FIFO_SIZE);
+#if defined(ADV_TRACER_STATISTICS)
+    ADV_TRACER_Ctx.TraceQueued -= (uint16_t)(Length - Used);
+    ADV_TRACER_Ctx.Stats.WrittenBytes -= (uint32_t)(Length - Used);
+#endif
+  }
+  else
+  {
+    uint16_t slot = 0u;
+
+    /* later writes are queued behind, the transfer skips the unused end */
+    while ((slot < ADV_TRACER_TRIM_SLOTS) && (ADV_TRACER_Ctx.Trimmed[slot].Len != 0u))
+    {
+      slot++;
+    }
+
+    if (slot < ADV_TRACER_TRIM_SLOTS)
+    {
+      ADV_TRACER_Ctx.Trimmed[slot].Pos = (uint16_t)((WritePos + Used) % ADV_TRACER_FIFO_SIZE);
+      ADV_TRACER_Ctx.Trimmed[slot].Len = (uint16_t)(Length - Used);
+#if defined(ADV_TRACER_STATISTICS)
+      ADV_TRACER_Ctx.Stats.WrittenBytes -= (uint32_t)(Length - Used);
+#endif
+    }
+    else
+    {
+      /* no slot left, sent as spaces */
+      for (uint16_t idx = Used; idx < Length; idx++)
+      {
+        ADV_TRACER_Buffer[(WritePos + idx) % ADV_TRACER_FIFO_SIZE] = (uint8_t)' ';
+      }
+    }
+  }
+
+  ADV_TRACER_EXIT_CRITICAL_SECTION();
+
+  return ADV_TRACER_OK;
+}
+
 #if defined(ADV_TRACER_CONDITIONNAL)
 ADV_TRACER_Status_t ADV_TRACER_COND_Send(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const uint8_t *pData, uint16_t Length)
+{
+  return TRACE_COND_Send(VerboseLevel, Region, TimeStampState, pData, Length, 0u);
+}
+
+ADV_TRACER_Status_t ADV_TRACER_COND_Send_Wait(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const uint8_t *pData, uint16_t Length)
+{
+  return TRACE_COND_Send(VerboseLevel, Region, TimeStampState, pData, Length, 1u);
+}
+
+/**
+  * @brief conditional Send, optionally waiting for room in the fifo
+  * @retval Status based on @ref ADV_TRACER_Status_t
+  */
+static ADV_TRACER_Status_t TRACE_COND_Send(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const uint8_t *pData, uint16_t Length, uint8_t Wait)
 {
   ADV_TRACER_Status_t ret;
   uint16_t writepos;
@@ -450,7 +578,8 @@ ADV_TRACER_Status_t ADV_TRACER_COND_Send(uint32_t VerboseLevel, uint32_t Region,
   TRACE_Lock();
 
   /* if allocation is ok, write data into the buffer */
-  if (TRACE_AllocateBufer(Length + timestamp_size, &writepos) != -1)
+  if (((Wait != 0u) ? TRACE_WaitAllocateBufer(Length + timestamp_size, &writepos)
+                    : TRACE_AllocateBufer(Length + timestamp_size, &writepos)) != -1)
   {
 #if defined(ADV_TRACER_OVERRUN)
     ADV_TRACER_ENTER_CRITICAL_SECTION();
@@ -587,6 +716,22 @@ void ADV_TRACER_ResetRegion(uint32_t Region)
 }
 #endif
 
+#if defined(ADV_TRACER_STATISTICS)
+void ADV_TRACER_GetStats(ADV_TRACER_Stats_t *Stats)
+{
+  ADV_TRACER_ENTER_CRITICAL_SECTION();
+  *Stats = ADV_TRACER_Ctx.Stats;
+  ADV_TRACER_EXIT_CRITICAL_SECTION();
+}
+
+void ADV_TRACER_ResetStats(void)
+{
+  ADV_TRACER_ENTER_CRITICAL_SECTION();
+  (void)ADV_TRACER_MEMSET8(&ADV_TRACER_Ctx.Stats, 0x0, sizeof(ADV_TRACER_Stats_t));
+  ADV_TRACER_EXIT_CRITICAL_SECTION();
+}
+#endif
+
 __WEAK void ADV_TRACER_PreSendHook (void)
 {
 }
@@ -595,6 +740,10 @@ __WEAK void ADV_TRACER_PostSendHook (void)
 {
 }
 
+__WEAK void ADV_TRACER_WaitHook (void)
+{
+}
+
 /**
  * @}
  */
@@ -631,21 +780,31 @@ static ADV_TRACER_Status_t TRACE_Send(void)
 	}
 #endif
 
+    TRACE_SkipTrimmed();
+
     if (ADV_TRACER_Ctx.TraceRdPtr != ADV_TRACER_Ctx.TraceWrPtr)
     {
 #ifdef ADV_TRACER_UNCHUNK_MODE
    	  if(TRACE_UNCHUNK_DETECTED == ADV_TRACER_Ctx.unchunk_status)
    	  {
         ADV_TRACER_Ctx.TraceSentSize = (uint16_t)(ADV_TRACER_Ctx.unchunk_enabled - ADV_TRACER_Ctx.TraceRdPtr);
-        ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_TRANSFER;
-        ADV_TRACER_Ctx.unchunk_enabled = 0;
+        /* up to a trimmed end first, the unchunk transfer starts behind it */
+        if (TRACE_ClampToTrimmed(ADV_TRACER_Ctx.TraceSentSize) != ADV_TRACER_Ctx.TraceSentSize)
+        {
+          ADV_TRACER_Ctx.TraceSentSize = TRACE_ClampToTrimmed(ADV_TRACER_Ctx.TraceSentSize);
+        }
+        else
+        {
+          ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_TRANSFER;
+          ADV_TRACER_Ctx.unchunk_enabled = 0;
 
-        ADV_TRACER_DEBUG("\nTRACE_TxCpltCallback::unchunk start(%d,%d)\n",ADV_TRACER_Ctx.unchunk_enabled, ADV_TRACER_Ctx.TraceRdPtr);
+          ADV_TRACER_DEBUG("\nTRACE_TxCpltCallback::unchunk start(%d,%d)\n",ADV_TRACER_Ctx.unchunk_enabled, ADV_TRACER_Ctx.TraceRdPtr);
 
-        if (0u == ADV_TRACER_Ctx.TraceSentSize)
-        {
-          ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_NONE;
-          ADV_TRACER_Ctx.TraceRdPtr = 0;
+          if (0u == ADV_TRACER_Ctx.TraceSentSize)
+          {
+            ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_NONE;
+            ADV_TRACER_Ctx.TraceRdPtr = 0;
+          }
         }
    	  }
 
@@ -661,6 +820,7 @@ static ADV_TRACER_Status_t TRACE_Send(void)
         	ADV_TRACER_Ctx.TraceSentSize = ADV_TRACER_FIFO_SIZE - ADV_TRACER_Ctx.TraceRdPtr;
 
         }
+        ADV_TRACER_Ctx.TraceSentSize = TRACE_ClampToTrimmed(ADV_TRACER_Ctx.TraceSentSize);
 #ifdef ADV_TRACER_UNCHUNK_MODE
       }
 #endif
@@ -704,6 +864,10 @@ static void TRACE_TxCpltCallback(void *Ptr)
   }
 #endif
 
+#if defined(ADV_TRACER_STATISTICS)
+  ADV_TRACER_Ctx.TraceQueued -= ADV_TRACER_Ctx.TraceSentSize;
+#endif
+
 #if defined(ADV_TRACER_UNCHUNK_MODE)
   if(TRACE_UNCHUNK_TRANSFER == ADV_TRACER_Ctx.unchunk_status)
   {
@@ -719,6 +883,8 @@ static void TRACE_TxCpltCallback(void *Ptr)
   ADV_TRACER_Ctx.TraceRdPtr = (ADV_TRACER_Ctx.TraceRdPtr + ADV_TRACER_Ctx.TraceSentSize) % ADV_TRACER_FIFO_SIZE;
 #endif
 
+  TRACE_SkipTrimmed();
+
 #if defined(ADV_TRACER_OVERRUN)
 	if(ADV_TRACER_Ctx.OverRunStatus == TRACE_OVERRUN_INDICATION )
 	{
@@ -739,16 +905,24 @@ static void TRACE_TxCpltCallback(void *Ptr)
     if(TRACE_UNCHUNK_DETECTED == ADV_TRACER_Ctx.unchunk_status)
     {
    		ADV_TRACER_Ctx.TraceSentSize = ADV_TRACER_Ctx.unchunk_enabled - ADV_TRACER_Ctx.TraceRdPtr;
-   		ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_TRANSFER;
-   		ADV_TRACER_Ctx.unchunk_enabled = 0;
-
-    	ADV_TRACER_DEBUG("\nTRACE_TxCpltCallback::unchunk start(%d,%d)\n",ADV_TRACER_Ctx.unchunk_enabled, ADV_TRACER_Ctx.TraceRdPtr);
-
-    	if (0u == ADV_TRACER_Ctx.TraceSentSize)
-      {
-        ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_NONE;
-        ADV_TRACER_Ctx.TraceRdPtr = 0;
-      }
+   		/* up to a trimmed end first, the unchunk transfer starts behind it */
+   		if (TRACE_ClampToTrimmed(ADV_TRACER_Ctx.TraceSentSize) != ADV_TRACER_Ctx.TraceSentSize)
+   		{
+   			ADV_TRACER_Ctx.TraceSentSize = TRACE_ClampToTrimmed(ADV_TRACER_Ctx.TraceSentSize);
+   		}
+   		else
+   		{
+   			ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_TRANSFER;
+   			ADV_TRACER_Ctx.unchunk_enabled = 0;
+
+   			ADV_TRACER_DEBUG("\nTRACE_TxCpltCallback::unchunk start(%d,%d)\n",ADV_TRACER_Ctx.unchunk_enabled, ADV_TRACER_Ctx.TraceRdPtr);
+
+   			if (0u == ADV_TRACER_Ctx.TraceSentSize)
+   			{
+   				ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_NONE;
+   				ADV_TRACER_Ctx.TraceRdPtr = 0;
+   			}
+   		}
     }
 
     if(TRACE_UNCHUNK_NONE == ADV_TRACER_Ctx.unchunk_status)
@@ -762,6 +936,7 @@ static void TRACE_TxCpltCallback(void *Ptr)
       {
         ADV_TRACER_Ctx.TraceSentSize = ADV_TRACER_FIFO_SIZE - ADV_TRACER_Ctx.TraceRdPtr;
       }
+      ADV_TRACER_Ctx.TraceSentSize = TRACE_ClampToTrimmed(ADV_TRACER_Ctx.TraceSentSize);
 #ifdef ADV_TRACER_UNCHUNK_MODE
     }
 #endif
@@ -777,6 +952,68 @@ static void TRACE_TxCpltCallback(void *Ptr)
   }
 }
 
+/**
+  * @brief  move the read pointer past the trimmed ends it reached
+  * @note   called in critical section
+  * @retval none
+  */
+static void TRACE_SkipTrimmed(void)
+{
+  uint16_t slot = 0u;
+
+  while (slot < ADV_TRACER_TRIM_SLOTS)
+  {
+#if defined(ADV_TRACER_UNCHUNK_MODE)
+    if ((TRACE_UNCHUNK_DETECTED == ADV_TRACER_Ctx.unchunk_status) && (ADV_TRACER_Ctx.TraceRdPtr == ADV_TRACER_Ctx.unchunk_enabled))
+    {
+      /* nothing left before the end of the fifo, go on from the start */
+      ADV_TRACER_Ctx.unchunk_status = TRACE_UNCHUNK_NONE;
+      ADV_TRACER_Ctx.unchunk_enabled = 0;
+      ADV_TRACER_Ctx.TraceRdPtr = 0;
+      slot = 0u;
+      continue;
+    }
+#endif
+    if ((ADV_TRACER_Ctx.Trimmed[slot].Len != 0u) && (ADV_TRACER_Ctx.Trimmed[slot].Pos == ADV_TRACER_Ctx.TraceRdPtr))
+    {
+      ADV_TRACER_Ctx.TraceRdPtr = (uint16_t)((ADV_TRACER_Ctx.TraceRdPtr + ADV_TRACER_Ctx.Trimmed[slot].Len) % ADV_TRACER_FIFO_SIZE);
+#if defined(ADV_TRACER_STATISTICS)
+      ADV_TRACER_Ctx.TraceQueued -= ADV_TRACER_Ctx.Trimmed[slot].Len;
+#endif
+      ADV_TRACER_Ctx.Trimmed[slot].Len = 0u;
+      slot = 0u;
+    }
+    else
+    {
+      slot++;
+    }
+  }
+}
+
+/**
+  * @brief  shorten a transfer so that it stops at the next trimmed end
+  * @note   called in critical section, after TRACE_SkipTrimmed
+  * @param  Size of the transfer from the read pointer
+  * @retval size to send
+  */
+static uint16_t TRACE_ClampToTrimmed(uint16_t Size)
+{
+  for (uint16_t slot = 0u; slot < ADV_TRACER_TRIM_SLOTS; slot++)
+  {
+    if (ADV_TRACER_Ctx.Trimmed[slot].Len != 0u)
+    {
+      uint16_t distance = (uint16_t)((ADV_TRACER_Ctx.Trimmed[slot].Pos + ADV_TRACER_FIFO_SIZE - ADV_TRACER_Ctx.TraceRdPtr) % ADV_TRACER_FIFO_SIZE);
+
+      if (distance < Size)
+      {
+        Size = distance;
+      }
+    }
+  }
+
+  return Size;
+}
+
 /**
   * @brief  allocate space inside the buffer to push data
   * @param  Size to allocate within fifo
@@ -784,6 +1021,75 @@ static void TRACE_TxCpltCallback(void *Ptr)
   * @retval write position inside the buffer is -1 no space available.
   */
 static int16_t TRACE_AllocateBufer(uint16_t Size, uint16_t *Pos)
+{
+  int16_t ret = TRACE_TryAllocateBufer(Size, Pos);
+
+#if defined(ADV_TRACER_STATISTICS)
+  if (ret == -1)
+  {
+    ADV_TRACER_ENTER_CRITICAL_SECTION();
+    ADV_TRACER_Ctx.Stats.Drops++;
+    ADV_TRACER_Ctx.Stats.DroppedBytes += Size;
+    ADV_TRACER_EXIT_CRITICAL_SECTION();
+  }
+#endif
+
+  return ret;
+}
+
+/**
+  * @brief  allocate space inside the buffer, waiting for the transfer to make room
+  * @note   called with the trace locked, the lock is released while waiting so
+  *         that the transfer goes on
+  * @param  Size to allocate within fifo
+  * @param  Pos position within the fifo
+  * @retval write position inside the buffer is -1 no space available.
+  */
+static int16_t TRACE_WaitAllocateBufer(uint16_t Size, uint16_t *Pos)
+{
+  uint32_t start;
+
+  /* may never fit in unchunk mode, give up as before */
+  if (Size > (ADV_TRACER_FIFO_SIZE / 2u))
+  {
+    return TRACE_AllocateBufer(Size, Pos);
+  }
+
+  if (TRACE_TryAllocateBufer(Size, Pos) != -1)
+  {
+    return 0;
+  }
+
+  start = ADV_TRACER_GET_TICK();
+
+  do
+  {
+    TRACE_UnLock();
+    ADV_TRACER_WaitHook();
+    /* restart the transfer, in case it stopped while the fifo was locked */
+    (void)TRACE_Send();
+    TRACE_Lock();
+  } while (TRACE_TryAllocateBufer(Size, Pos) == -1);
+
+#if defined(ADV_TRACER_STATISTICS)
+  ADV_TRACER_ENTER_CRITICAL_SECTION();
+  ADV_TRACER_Ctx.Stats.Waits++;
+  ADV_TRACER_Ctx.Stats.WaitTicks += ADV_TRACER_GET_TICK() - start;
+  ADV_TRACER_EXIT_CRITICAL_SECTION();
+#else
+  (void)start;
+#endif
+
+  return 0;
+}
+
+/**
+  * @brief  allocate space inside the buffer to push data, without waiting or counting drops
+  * @param  Size to allocate within fifo
+  * @param  Pos position within the fifo
+  * @retval write position inside the buffer is -1 no space available.
+  */
+static int16_t TRACE_TryAllocateBufer(uint16_t Size, uint16_t *Pos)
 {
   uint16_t freesize;
   int16_t ret = -1;
@@ -842,6 +1148,17 @@ static int16_t TRACE_AllocateBufer(uint16_t Size, uint16_t *Pos)
     ADV_TRACER_Ctx.TraceWrPtr = (ADV_TRACER_Ctx.TraceWrPtr + Size) % ADV_TRACER_FIFO_SIZE;
     ret = 0;
 
+#if defined(ADV_TRACER_STATISTICS)
+    /* counted apart, the pointers alone can't tell a full fifo from an empty one */
+    ADV_TRACER_Ctx.TraceQueued += Size;
+    ADV_TRACER_Ctx.Stats.Writes++;
+    ADV_TRACER_Ctx.Stats.WrittenBytes += Size;
+    if (ADV_TRACER_Ctx.TraceQueued > ADV_TRACER_Ctx.Stats.HighWater)
+    {
+      ADV_TRACER_Ctx.Stats.HighWater = ADV_TRACER_Ctx.TraceQueued;
+    }
+#endif
+
 #ifdef ADV_TRACER_UNCHUNK_MODE
     ADV_TRACER_DEBUG("\n--TRACE_AllocateBufer(%d-%d-%d::%d-%d)--\n",freesize - Size, Size, ADV_TRACER_Ctx.unchunk_enabled, ADV_TRACER_Ctx.TraceRdPtr, ADV_TRACER_Ctx.TraceWrPtr);
 #else
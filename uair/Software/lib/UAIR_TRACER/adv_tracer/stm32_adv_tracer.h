@@ -73,6 +73,21 @@ typedef struct {
   ADV_TRACER_Status_t  (* Send)(uint8_t *pdata, uint16_t size);                               /*!< Media to send data.        */
 }ADV_TRACER_Driver_s;
 
+#if defined(ADV_TRACER_STATISTICS)
+/**
+ * @brief FIFO health counters, to size the FIFO and find where tracing stalls
+ */
+typedef struct {
+  uint32_t Writes;                /*!< Writes queued in the fifo.                        */
+  uint32_t WrittenBytes;          /*!< Bytes queued in the fifo.                         */
+  uint32_t Drops;                 /*!< Writes given up because the fifo was full.        */
+  uint32_t DroppedBytes;          /*!< Bytes of the writes given up.                     */
+  uint32_t Waits;                 /*!< Waiting writes that found the fifo full.          */
+  uint32_t WaitTicks;             /*!< Time spent waiting for room, in ticks.            */
+  uint16_t HighWater;             /*!< Most bytes queued at once.                        */
+} ADV_TRACER_Stats_t;
+#endif
+
 /**
  *  @}
  */
@@ -147,6 +162,18 @@ ADV_TRACER_Status_t ADV_TRACER_ZCSend_Allocation(uint16_t Length, uint8_t **pDat
  * @retval Status based on @ref ADV_TRACER_Status_t
  */
 ADV_TRACER_Status_t ADV_TRACER_ZCSend_Finalize(void);
+
+/**
+ * @brief ZCSend_Trim give back the end of a zero-copy allocation that was not written
+ * @note  call before ZCSend_Finalize. If another write was queued after the
+ *        allocation, the transfer skips the unused end, or sends it as spaces
+ *        once ADV_TRACER_TRIM_SLOTS ends are waiting to be skipped.
+ * @param WritePos write position returned by the allocation
+ * @param Length allocated length
+ * @param Used bytes written
+ * @retval Status based on @ref ADV_TRACER_Status_t
+ */
+ADV_TRACER_Status_t ADV_TRACER_ZCSend_Trim(uint16_t WritePos, uint16_t Length, uint16_t Used);
 /**
  * @brief  Trace send started hook
  * @retval None
@@ -162,6 +189,11 @@ void ADV_TRACER_PreSendHook(void);
  */
 void ADV_TRACER_PostSendHook(void);
 
+/**
+ * @brief  Trace wait hook function, called on each try while waiting for room in the fifo
+ */
+void ADV_TRACER_WaitHook(void);
+
 #if defined(ADV_TRACER_OVERRUN)
 /**
  * @brief Register a function used to add overrun info inside the trace
@@ -212,6 +244,28 @@ ADV_TRACER_Status_t ADV_TRACER_COND_ZCSend_Finalize(void);
  */
 ADV_TRACER_Status_t ADV_TRACER_COND_Send(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const uint8_t *pdata, uint16_t length);
 
+/**
+ * @brief conditional FSend, waiting for room in the fifo instead of giving up
+ * @note  the string is formatted once, not on every retry
+ * @param VerboseLevel verbose level of the trace
+ * @param Region region of the trace
+ * @param TimeStampState 0 no time stamp insertion, 1 time stamp inserted inside the trace data
+ * @param strFormat formatted string
+ * @retval Status based on @ref ADV_TRACER_Status_t
+ */
+ADV_TRACER_Status_t ADV_TRACER_COND_FSend_Wait(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const char *strFormat, ...);
+
+/**
+ * @brief conditional Send, waiting for room in the fifo instead of giving up
+ * @param VerboseLevel verbose level of the trace
+ * @param Region region of the trace
+ * @param TimeStampState 0 no time stamp insertion, 1 time stamp inserted inside the trace data
+ * @param *pdata pointer to Data
+ * @param length length of data buffer ro be sent
+ * @retval Status based on @ref ADV_TRACER_Status_t
+ */
+ADV_TRACER_Status_t ADV_TRACER_COND_Send_Wait(uint32_t VerboseLevel, uint32_t Region, uint32_t TimeStampState, const uint8_t *pdata, uint16_t length);
+
 /**
  * @brief Register a function used to add timestamp inside the trace
  * @param cb pointer of function to return timestamp information
@@ -253,6 +307,21 @@ void ADV_TRACER_ResetRegion(uint32_t Region);
 
 #endif
 
+#if defined(ADV_TRACER_STATISTICS)
+/**
+ * @brief  Get a copy of the fifo health counters
+ * @param  Stats filled with the counters
+ * @retval None
+ */
+void ADV_TRACER_GetStats(ADV_TRACER_Stats_t *Stats);
+
+/**
+ * @brief  Clear the fifo health counters
+ * @retval None
+ */
+void ADV_TRACER_ResetStats(void);
+#endif
+
 /**
   * @}
   */
@@ -39,6 +39,11 @@ extern "C" {
 // #define ADV_TRACER_SUPPORT_TINY_PRINTF /** Uncomment to get smaller printf code size **/
 #define ADV_TRACER_CONDITIONNAL                                                      /*!< not used */
 #define ADV_TRACER_UNCHUNK_MODE                                                      /*!< not used */
+#if (!defined(RELEASE)) || (RELEASE==0)
+#define ADV_TRACER_STATISTICS                                                        /*!< fifo health counters */
+#endif
+#define ADV_TRACER_TRIM_SLOTS                  (4U)                                  /*!< trimmed ends waiting to be skipped */
+#define ADV_TRACER_GET_TICK()                  HAL_GetTick()                         /*!< time base of the wait counters */
 #define ADV_TRACER_DEBUG(...)                                                        /*!< not used */
 #define ADV_TRACER_INIT_CRITICAL_SECTION( )    UTILS_INIT_CRITICAL_SECTION()         /*!< init the critical section in trace feature */
 #define ADV_TRACER_ENTER_CRITICAL_SECTION( )   UTILS_ENTER_CRITICAL_SECTION()        /*!< enter the critical section in trace feature */
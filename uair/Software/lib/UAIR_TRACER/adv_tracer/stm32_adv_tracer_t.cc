@@ -0,0 +1,270 @@
+#include <catch2/catch.hpp>
+
+#include "stm32_adv_tracer.h"
+#include "app_conf.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* The UART driver takes over once the advanced tracer is enabled */
+#if !defined(UAIR_ADVANCED_TRACER_ENABLE) || (UAIR_ADVANCED_TRACER_ENABLE == 0)
+
+/* A DMA that only completes when told to */
+struct fake_trace_dma
+{
+    void (*tx_cplt)(void *);
+    uint8_t *pending;
+    uint16_t pending_size;
+    std::string sent;
+    unsigned transfers;
+    bool complete_on_wait;
+    unsigned waits;
+
+    /* Completes the transfer in flight, the tracer may start the next one */
+    bool complete()
+    {
+        if (pending == NULL)
+            return false;
+        sent.append((const char *)pending, pending_size);
+        pending = NULL;
+        tx_cplt(NULL);
+        return true;
+    }
+
+    void drain()
+    {
+        while (complete())
+            ;
+    }
+};
+
+static fake_trace_dma dma;
+
+static ADV_TRACER_Status_t fake_trace_init(void (*cb)(void *))
+{
+    dma = fake_trace_dma();
+    dma.tx_cplt = cb;
+    return ADV_TRACER_OK;
+}
+
+static ADV_TRACER_Status_t fake_trace_deinit(void)
+{
+    return ADV_TRACER_OK;
+}
+
+static ADV_TRACER_Status_t fake_trace_start_rx(void (*)(uint8_t *, uint16_t, uint8_t))
+{
+    return ADV_TRACER_OK;
+}
+
+static ADV_TRACER_Status_t fake_trace_send(uint8_t *data, uint16_t size)
+{
+    REQUIRE(dma.pending == NULL);
+    REQUIRE(size > 0);
+    dma.pending = data;
+    dma.pending_size = size;
+    dma.transfers++;
+    return ADV_TRACER_OK;
+}
+
+extern "C" const ADV_TRACER_Driver_s UTIL_TraceDriver =
+{
+    fake_trace_init,
+    fake_trace_deinit,
+    fake_trace_start_rx,
+    fake_trace_send,
+};
+
+extern "C" void ADV_TRACER_WaitHook(void)
+{
+    dma.waits++;
+    if (dma.complete_on_wait)
+        dma.complete();
+}
+
+static ADV_TRACER_Status_t trace_send(const std::string &data)
+{
+    return ADV_TRACER_Send((const uint8_t *)data.data(), (uint16_t)data.size());
+}
+
+/* Zero-copy write of text into a larger allocation, that is trimmed later */
+static uint16_t trace_zc_write(uint16_t length, const std::string &text)
+{
+    uint8_t *fifo;
+    uint16_t fifo_size;
+    uint16_t pos;
+
+    REQUIRE(ADV_TRACER_ZCSend_Allocation(length, &fifo, &fifo_size, &pos) == ADV_TRACER_OK);
+    for (size_t i = 0; i < text.size(); i++)
+        fifo[(pos + i) % fifo_size] = (uint8_t)text[i];
+    return pos;
+}
+
+#if defined(ADV_TRACER_STATISTICS)
+static ADV_TRACER_Stats_t trace_stats()
+{
+    ADV_TRACER_Stats_t stats;
+    ADV_TRACER_GetStats(&stats);
+    return stats;
+}
+#endif
+
+TEST_CASE("Advanced tracer fifo","[lib][lib/Tracer]")
+{
+    REQUIRE(ADV_TRACER_Init() == ADV_TRACER_OK);
+    ADV_TRACER_SetVerboseLevel(ADV_TRACER_VLEVEL_H);
+
+    SECTION("Writes queue behind the transfer in flight")
+    {
+        REQUIRE(trace_send("abc") == ADV_TRACER_OK);
+        REQUIRE(trace_send("defg") == ADV_TRACER_OK);
+        CHECK(dma.transfers == 1);
+
+        dma.drain();
+        CHECK(dma.sent == "abcdefg");
+        CHECK(dma.transfers == 2);
+
+#if defined(ADV_TRACER_STATISTICS)
+        // Sent bytes are no longer queued
+        REQUIRE(trace_send("hi") == ADV_TRACER_OK);
+        dma.drain();
+
+        ADV_TRACER_Stats_t stats = trace_stats();
+        CHECK(stats.Writes == 3);
+        CHECK(stats.WrittenBytes == 9);
+        CHECK(stats.HighWater == 7);
+        CHECK(stats.Drops == 0);
+        CHECK(stats.Waits == 0);
+#endif
+    }
+
+    SECTION("No room, the trace is dropped")
+    {
+        std::string big(300, 'a');
+
+        REQUIRE(trace_send(big) == ADV_TRACER_OK);
+        CHECK(trace_send(big) == ADV_TRACER_MEM_FULL);
+
+        dma.drain();
+        CHECK(dma.sent == big);
+
+#if defined(ADV_TRACER_STATISTICS)
+        ADV_TRACER_Stats_t stats = trace_stats();
+        CHECK(stats.Writes == 1);
+        CHECK(stats.Drops == 1);
+        CHECK(stats.DroppedBytes == 300);
+        CHECK(stats.HighWater == 300);
+
+        ADV_TRACER_ResetStats();
+        CHECK(trace_stats().Drops == 0);
+#endif
+    }
+
+    SECTION("No room, the writer waits for the transfer")
+    {
+        std::string a(200, 'a'), b(200, 'b'), c(200, 'c');
+
+        REQUIRE(trace_send(a) == ADV_TRACER_OK);
+        REQUIRE(trace_send(b) == ADV_TRACER_OK);
+
+        // Each try completes a transfer, room is made at the start of the fifo
+        dma.complete_on_wait = true;
+        REQUIRE(ADV_TRACER_COND_Send_Wait(ADV_TRACER_VLEVEL_ALWAYS, ADV_TRACER_T_REG_OFF, ADV_TRACER_TS_OFF,
+                                          (const uint8_t *)c.data(), (uint16_t)c.size()) == ADV_TRACER_OK);
+        CHECK(dma.waits == 2);
+
+        dma.drain();
+        CHECK(dma.sent == a + b + c);
+
+#if defined(ADV_TRACER_STATISTICS)
+        ADV_TRACER_Stats_t stats = trace_stats();
+        CHECK(stats.Writes == 3);
+        CHECK(stats.Waits == 1);
+        CHECK(stats.Drops == 0);
+        CHECK(stats.HighWater == 400);
+#endif
+    }
+
+    SECTION("The unused end of a zero-copy write is not sent")
+    {
+        // Nothing allocated after, the fifo takes it back
+        uint16_t pos = trace_zc_write(20, "hello");
+        REQUIRE(ADV_TRACER_ZCSend_Trim(pos, 20, 5) == ADV_TRACER_OK);
+        REQUIRE(ADV_TRACER_ZCSend_Finalize() == ADV_TRACER_OK);
+        REQUIRE(trace_send("!") == ADV_TRACER_OK);
+
+        dma.drain();
+        CHECK(dma.sent == "hello!");
+
+        // A write queued behind, the transfer skips the end
+        dma.sent.clear();
+        pos = trace_zc_write(20, "hello");
+        REQUIRE(trace_send("world") == ADV_TRACER_OK);
+        REQUIRE(ADV_TRACER_ZCSend_Trim(pos, 20, 5) == ADV_TRACER_OK);
+        REQUIRE(ADV_TRACER_ZCSend_Finalize() == ADV_TRACER_OK);
+
+        dma.drain();
+        CHECK(dma.sent == "helloworld");
+
+#if defined(ADV_TRACER_STATISTICS)
+        // Skipped bytes are no longer queued either
+        ADV_TRACER_Stats_t stats = trace_stats();
+        CHECK(stats.WrittenBytes == 16);
+        CHECK(stats.HighWater == 25);
+
+        REQUIRE(trace_send(std::string(300, 'x')) == ADV_TRACER_OK);
+        CHECK(trace_stats().HighWater == 300);
+        dma.drain();
+#endif
+    }
+
+    SECTION("Too many ends to skip, the last ones are sent as spaces")
+    {
+        REQUIRE(trace_send("start") == ADV_TRACER_OK);
+
+        for (unsigned i = 0; i < ADV_TRACER_TRIM_SLOTS + 1; i++) {
+            uint16_t pos = trace_zc_write(4, std::string(1, (char)('A' + i)));
+            REQUIRE(trace_send("-") == ADV_TRACER_OK);
+            REQUIRE(ADV_TRACER_ZCSend_Trim(pos, 4, 1) == ADV_TRACER_OK);
+            REQUIRE(ADV_TRACER_ZCSend_Finalize() == ADV_TRACER_OK);
+        }
+
+        dma.drain();
+        CHECK(dma.sent == "startA-B-C-D-E   -");
+
+        // The slots are free again
+        dma.sent.clear();
+        uint16_t pos = trace_zc_write(4, "F");
+        REQUIRE(trace_send("-") == ADV_TRACER_OK);
+        REQUIRE(ADV_TRACER_ZCSend_Trim(pos, 4, 1) == ADV_TRACER_OK);
+        REQUIRE(ADV_TRACER_ZCSend_Finalize() == ADV_TRACER_OK);
+
+        dma.drain();
+        CHECK(dma.sent == "F-");
+    }
+
+    SECTION("An end trimmed before the fifo wraps")
+    {
+        std::string a(400, 'a'), b(80, 'b');
+
+        REQUIRE(trace_send(a) == ADV_TRACER_OK);
+        dma.drain();
+        dma.sent.clear();
+
+        // The next write doesn't fit behind it and goes to the start of the fifo
+        uint16_t pos = trace_zc_write(100, "tail");
+        CHECK(pos == 400);
+        REQUIRE(trace_send(b) == ADV_TRACER_OK);
+        REQUIRE(ADV_TRACER_ZCSend_Trim(pos, 100, 4) == ADV_TRACER_OK);
+        REQUIRE(ADV_TRACER_ZCSend_Finalize() == ADV_TRACER_OK);
+
+        dma.drain();
+        CHECK(dma.sent == "tail" + b);
+    }
+
+    REQUIRE(dma.pending == NULL);
+    REQUIRE(ADV_TRACER_DeInit() == ADV_TRACER_OK);
+}
+
+#endif
@@ -0,0 +1,105 @@
+/** Copyright © 2021 MAIS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file uair_trace_decode.c
+ *
+ * Host decoder for tokenized traces (see UAIR_tracer_token.h).
+ *
+ *   cc -I.. -o uair_trace_decode uair_trace_decode.c uair_trace_render.c
+ *   uair_trace_decode app.tokens [capture]
+ *
+ * app.tokens is the dictionary written next to the ELF at build time. The
+ * capture (stdin by default, so a serial port can be piped in) is copied to
+ * stdout with every frame rendered back into text.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "UAIR_tracer_token.h"
+#include "uair_trace_render.h"
+
+static char *dictionary;
+static size_t dictionary_size;
+
+static int load_dictionary(const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    long size;
+
+    if (NULL == f) {
+        perror(filename);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    /* Terminated, in case the last format is cut */
+    dictionary = calloc(1, size + 1);
+    if (NULL == dictionary || fread(dictionary, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: cannot read dictionary\n", filename);
+        fclose(f);
+        return -1;
+    }
+    dictionary_size = size;
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    uint8_t frame[UAIR_TRACER_TOKEN_MAX_FRAME];
+    int c;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s dictionary [capture]\n", argv[0]);
+        return 1;
+    }
+
+    if (load_dictionary(argv[1]) != 0)
+        return 1;
+
+    if (argc == 3) {
+        in = fopen(argv[2], "rb");
+        if (NULL == in) {
+            perror(argv[2]);
+            return 1;
+        }
+    }
+
+    while ((c = fgetc(in)) != EOF) {
+        if (c != UAIR_TRACER_TOKEN_MARK) {
+            putchar(c);
+            continue;
+        }
+
+        int len = fgetc(in);
+        if (len == EOF || fread(frame, 1, len, in) != (size_t)len) {
+            fprintf(stdout, "<truncated trace frame>\r\n");
+            break;
+        }
+        uair_trace_render_frame(dictionary, dictionary_size, frame, len, stdout);
+        fflush(stdout);
+    }
+
+    if (in != stdin)
+        fclose(in);
+
+    return 0;
+}
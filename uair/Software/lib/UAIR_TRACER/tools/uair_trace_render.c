@@ -0,0 +1,213 @@
+/** Copyright © 2021 MAIS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file uair_trace_render.c
+ *
+ * Renders tokenized trace frames (see UAIR_tracer_token.h) back into text.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "uair_trace_render.h"
+#include "UAIR_tracer_token.h"
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    int wide;
+} frame_reader_t;
+
+static int get(frame_reader_t *r, unsigned size, uint64_t *value)
+{
+    *value = 0;
+    if ((size_t)(r->end - r->p) < size)
+        return -1;
+    for (unsigned i = 0; i < size; i++)
+        *value |= (uint64_t)r->p[i] << (8 * i);
+    r->p += size;
+    return 0;
+}
+
+static int64_t sign_extend(uint64_t value, unsigned size)
+{
+    if (size < 8 && (value & (1ULL << (8 * size - 1))))
+        value |= ~0ULL << (8 * size);
+    return (int64_t)value;
+}
+
+/* Renders one conversion, starting at the '%'. Returns the end of the conversion, or NULL on a short frame. */
+static const char *render_conversion(const char *fmt, frame_reader_t *r, FILE *out)
+{
+    char spec[32];
+    size_t n = 0;
+    int stars[2] = { 0, 0 };
+    unsigned nstars = 0;
+    unsigned size = 4;
+    uint64_t v;
+
+    spec[n++] = *fmt++;
+
+    if (*fmt == '%') {
+        fputc('%', out);
+        return fmt + 1;
+    }
+
+    while (*fmt && strchr("-+ #0123456789.*", *fmt) && n < sizeof(spec) - 4) {
+        if (*fmt == '*') {
+            if (nstars == 2 || get(r, 4, &v) != 0)
+                return NULL;
+            stars[nstars++] = (int)sign_extend(v, 4);
+        }
+        spec[n++] = *fmt++;
+    }
+
+    /* Lengths are dropped from the spec, values are printed as long long */
+    switch (*fmt) {
+    case 'h':
+        fmt++;
+        if (*fmt == 'h')
+            fmt++;
+        break;
+    case 'l':
+        fmt++;
+        size = r->wide ? 8 : 4;
+        if (*fmt == 'l') {
+            fmt++;
+            size = 8;
+        }
+        break;
+    case 'j':
+        fmt++;
+        size = 8;
+        break;
+    case 'z':
+    case 't':
+        fmt++;
+        size = r->wide ? 8 : 4;
+        break;
+    default:
+        break;
+    }
+
+    char conv = *fmt;
+    if (conv)
+        fmt++;
+
+#define PRINT(value) \
+    (nstars == 0 ? fprintf(out, spec, value) : \
+     nstars == 1 ? fprintf(out, spec, stars[0], value) : \
+                   fprintf(out, spec, stars[0], stars[1], value))
+
+    switch (conv) {
+    case 'd': case 'i':
+        if (get(r, size, &v) != 0)
+            return NULL;
+        strcpy(&spec[n], "lld");
+        PRINT((long long)sign_extend(v, size));
+        break;
+    case 'u': case 'x': case 'X': case 'o':
+        if (get(r, size, &v) != 0)
+            return NULL;
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+        spec[n++] = conv;
+        spec[n] = '\0';
+        PRINT((unsigned long long)v);
+        break;
+    case 'c':
+        if (get(r, size, &v) != 0)
+            return NULL;
+        strcpy(&spec[n], "c");
+        PRINT((int)v);
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+        {
+            double d;
+            if (get(r, 8, &v) != 0)
+                return NULL;
+            memcpy(&d, &v, sizeof(d));
+            spec[n++] = conv;
+            spec[n] = '\0';
+            PRINT(d);
+        }
+        break;
+    case 'p':
+        if (get(r, r->wide ? 8 : 4, &v) != 0)
+            return NULL;
+        fprintf(out, "0x%llx", (unsigned long long)v);
+        break;
+    case 's':
+        {
+            char s[256];
+            uint64_t len;
+            if (get(r, 1, &len) != 0 || (size_t)(r->end - r->p) < len)
+                return NULL;
+            memcpy(s, r->p, len);
+            s[len] = '\0';
+            r->p += len;
+            strcpy(&spec[n], "s");
+            PRINT(s);
+        }
+        break;
+    default:
+        /* Not encoded by the firmware */
+        fprintf(out, "%.*s%c", (int)n, spec, conv);
+        break;
+    }
+#undef PRINT
+
+    return fmt;
+}
+
+void uair_trace_render_frame(const char *dictionary, size_t dictionary_size, const uint8_t *frame, unsigned len, FILE *out)
+{
+    frame_reader_t r = { frame, frame + len, 0 };
+    uint64_t flags, id, ts;
+
+    if (get(&r, 1, &flags) != 0 || get(&r, 2, &id) != 0) {
+        fprintf(out, "<short trace frame>\r\n");
+        return;
+    }
+    r.wide = (flags & UAIR_TRACER_TOKEN_FLAG_WIDE) != 0;
+
+    if (flags & UAIR_TRACER_TOKEN_FLAG_TS) {
+        if (get(&r, 4, &ts) != 0) {
+            fprintf(out, "<short trace frame>\r\n");
+            return;
+        }
+        fprintf(out, "%llus%03llu:", (unsigned long long)(ts / 1000), (unsigned long long)(ts % 1000));
+    }
+
+    if (id >= dictionary_size) {
+        fprintf(out, "<unknown trace id %llu>\r\n", (unsigned long long)id);
+        return;
+    }
+
+    const char *fmt = &dictionary[id];
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            fputc(*fmt++, out);
+            continue;
+        }
+        fmt = render_conversion(fmt, &r, out);
+        if (NULL == fmt) {
+            fprintf(out, "<short trace frame>\r\n");
+            return;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+/** Copyright © 2021 MAIS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file uair_trace_render.h
+ *
+ * Host side of the tokenized traces, shared by uair_trace_decode and the tests.
+ */
+
+#ifndef UAIR_TRACE_RENDER_H__
+#define UAIR_TRACE_RENDER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Writes a frame as text, "<...>" markers on short frames and unknown ids
+ *
+ * @param dictionary the format section, dumped from the ELF
+ * @param dictionary_size size of dictionary, which is followed by a '\0'
+ * @param frame what follows the mark and the length
+ * @param len the length
+ * @param out where to write the text
+ */
+void uair_trace_render_frame(const char *dictionary, size_t dictionary_size, const uint8_t *frame, unsigned len, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
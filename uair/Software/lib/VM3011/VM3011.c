@@ -81,3 +81,8 @@ VM3011_op_result_t VM3011_Read_Threshold(VM3011_t *vm, uint8_t *threshold)
 {
     return vm3011_read_register(vm, VM3011_REG_WOS_PGA_GAIN, threshold);
 }
+
+VM3011_op_result_t VM3011_Read_Threshold_async(VM3011_t *vm, uint8_t *threshold)
+{
+    return vm3011_read_register_async(vm, VM3011_REG_WOS_PGA_GAIN, threshold);
+}
@@ -80,6 +80,8 @@ typedef enum
 VM3011_op_result_t VM3011_Init(VM3011_t *vm, HAL_I2C_bus_t bus);
 VM3011_op_result_t VM3011_Probe(VM3011_t *vm);
 VM3011_op_result_t VM3011_Read_Threshold(VM3011_t *vm, uint8_t *threshold);
+/* threshold is written when the HAL I2C read completes */
+VM3011_op_result_t VM3011_Read_Threshold_async(VM3011_t *vm, uint8_t *threshold);
 
 #ifdef __cplusplus
 }
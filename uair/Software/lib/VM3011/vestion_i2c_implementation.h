@@ -65,6 +65,27 @@ static inline VM3011_op_result_t vm3011_read_register(VM3011_t * vm,uint8_t reg,
     }
 }
 
+static inline VM3011_op_result_t vm3011_read_register_async(VM3011_t * vm,uint8_t reg, uint8_t *dest)
+{
+    HAL_StatusTypeDef r;
+
+    r = HAL_I2C_Mem_Read_IT(vm->bus,
+                            (vm->address<<1),
+                            reg,
+                            I2C_MEMADD_SIZE_8BIT,
+                            dest,
+                            1);
+
+    if (r == HAL_OK)
+    {
+        return VM3011_OP_SUCCESS;
+    }
+    else
+    {
+        return (r==HAL_BUSY ? VM3011_OP_HAL_BUSY: VM3011_OP_HAL_ERROR);
+    }
+}
+
 static inline VM3011_op_result_t vm3011_write_register_readout_mask(VM3011_t *vm, const uint8_t reg, const uint8_t val, const uint8_t mask)
 {
     VM3011_op_result_t r;
@@ -125,9 +125,9 @@ static ZMOD4510_op_result_t ZMOD4510_Reset(ZMOD4510_t *zmod)
     if (zmod->reset_gpio) {
         BSP_TRACE("Resetting ZMOD");
         HAL_GPIO_set(zmod->reset_gpio,0);
-        HAL_Delay(40);
+        HAL_delay_us(40000);
         HAL_GPIO_set(zmod->reset_gpio,1);
-        HAL_Delay(400);
+        HAL_delay_us(400000);
         zmod->initialised = false;
         //zmod->sequencer_running = false;
     }
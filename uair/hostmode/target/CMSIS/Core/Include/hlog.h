@@ -19,16 +19,71 @@ typedef enum {
 typedef const char *log_zone_t;
 
 extern void do_log(log_zone_t zone, log_level_t level, const char *fun, const char *filename, int line, const char *fmt, ...);
+extern void metrics_log(log_zone_t zone);
 
+/* Lowest level compiled in. Calls below it are removed, arguments included. */
+#ifndef HLOG_MIN_LEVEL
+#define HLOG_MIN_LEVEL LEVEL_DEBUG
+#endif
+
+/*
+ * Per-zone gate, checked inline before any argument is evaluated. Each call
+ * site looks its zone up once and keeps the pointer.
+ */
+typedef struct {
+    const char *name;
+    int level;          /* Lowest level that reaches do_log() */
+} hlog_zone_t;
+
+extern hlog_zone_t *hlog_zone_get(log_zone_t zone);
+/* Set the gate and do_log() filtering together */
+extern void hlog_zone_set_level(log_zone_t zone, log_level_t level);
+extern void hlog_set_level(log_level_t level);
+/*
+ * Applies a comma-separated list of "level" (all zones) and "ZONE=level"
+ * items, in order. Levels are debug, warn, error, progress or none.
+ * Returns -1 on a malformed item.
+ */
+extern int hlog_configure(const char *spec);
+
+/*
+ * Binary trace sink (hlog_trace.h). While active, calls with a literal
+ * format are captured unformatted instead of going through do_log().
+ */
+extern int hlog_trace_active;
+extern void hlog_trace(log_zone_t zone, log_level_t level, const char *fun, const char *filename, int line, const char *fmt, ...);
+
+#ifdef __FILE_NAME__
+#define __FILENAME__ __FILE_NAME__
+#else
 #define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
+#endif
 
 #define LOGSTREAM stdout
 
-#define HERROR(zone, x...) do_log( zone, LEVEL_ERROR, __FUNCTION__, __FILENAME__, __LINE__, x)
+#define HLOG_AT(zone, lvl, fmt, x...) do { \
+        if ((lvl) >= HLOG_MIN_LEVEL) { \
+            static hlog_zone_t *hlog_site_zone; \
+            hlog_zone_t *hlog_z = __atomic_load_n(&hlog_site_zone, __ATOMIC_RELAXED); \
+            if (__builtin_expect(hlog_z == NULL, 0)) { \
+                hlog_z = hlog_zone_get(zone); \
+                __atomic_store_n(&hlog_site_zone, hlog_z, __ATOMIC_RELAXED); \
+            } \
+            if ((lvl) >= __atomic_load_n(&hlog_z->level, __ATOMIC_RELAXED)) { \
+                metrics_log(zone); \
+                if (__builtin_constant_p(fmt) && __atomic_load_n(&hlog_trace_active, __ATOMIC_RELAXED)) \
+                    hlog_trace( zone, lvl, __FUNCTION__, __FILENAME__, __LINE__, fmt, ##x); \
+                else \
+                    do_log( zone, lvl, __FUNCTION__, __FILENAME__, __LINE__, fmt, ##x); \
+            } \
+        } \
+    } while (0)
+
+#define HERROR(zone, x...) HLOG_AT(zone, LEVEL_ERROR, x)
 
-#define HWARN(zone, x...) do_log( zone, LEVEL_WARN, __FUNCTION__, __FILENAME__, __LINE__, x)
+#define HWARN(zone, x...) HLOG_AT(zone, LEVEL_WARN, x)
 
-#define HLOG(zone, x...) do_log( zone, LEVEL_DEBUG, __FUNCTION__, __FILENAME__, __LINE__, x)
+#define HLOG(zone, x...) HLOG_AT(zone, LEVEL_DEBUG, x)
 
 
 #define INTERRUPT_LOG(x...) /* HLOG(x) */
@@ -49,6 +104,7 @@ void set_host_log_file(FILE *f);
 #define DECLARE_LOG_TAG(x) \
     CONSTRUCTOR(x, 101) { \
     zone_register( #x ) ; \
+    hlog_zone_get( #x ) ; \
     }
 
 #ifdef __cplusplus
@@ -0,0 +1,289 @@
+#ifndef CRING_HPP__
+#define CRING_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Bounded lock-free ring queues.
+//
+// CRingSPSC: one producer thread, one consumer thread.
+// CRingMPSC: any number of producer threads, one consumer thread.
+//
+// Enqueue/dequeue are a few atomic operations. Blocking dequeue is optional:
+// consumers that use it park on a condition variable, and producers only
+// touch the mutex when somebody is actually waiting.
+
+#define CRING_CACHELINE (64)
+#define CRING_SPIN_COUNT (16)
+
+// Slow path for blocking consumers
+class CRingWaiter
+{
+public:
+    void notify()
+    {
+        // Pairs with the increment in wait(): either we see the waiter, or it sees our data.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cond.notify_all();
+        }
+    }
+
+    template<class Predicate>
+    void wait(Predicate ready)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        m_cond.wait(lock, ready);
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    template<class Predicate>
+    bool wait_for(unsigned timeout_ms, Predicate ready)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        bool r = m_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        return r;
+    }
+
+private:
+    std::atomic<unsigned> m_waiters{0};
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+};
+
+template <class T, size_t N>
+class CRingSPSC
+{
+    static_assert((N & (N - 1)) == 0, "Ring size must be a power of 2");
+
+public:
+    bool try_enqueue(const T &t)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == N)
+            return false;
+        m_slots[tail & (N - 1)] = t;
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_waiter.notify();
+        return true;
+    }
+
+    // Enqueue up to count elements, returns how many were queued.
+    size_t enqueue_bulk(const T *t, size_t count)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t space = N - (tail - m_head.load(std::memory_order_acquire));
+        if (count > space)
+            count = space;
+        for (size_t i = 0; i < count; i++) {
+            m_slots[(tail + i) & (N - 1)] = t[i];
+        }
+        if (count) {
+            m_tail.store(tail + count, std::memory_order_release);
+            m_waiter.notify();
+        }
+        return count;
+    }
+
+    // Waits (yielding) while the ring is full.
+    void enqueue(const T &t)
+    {
+        while (!try_enqueue(t)) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool try_dequeue(T &t)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        t = std::move(m_slots[head & (N - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Dequeue up to max elements, returns how many were dequeued.
+    size_t dequeue_bulk(T *t, size_t max)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t avail = m_tail.load(std::memory_order_acquire) - head;
+        if (max > avail)
+            max = avail;
+        for (size_t i = 0; i < max; i++) {
+            t[i] = std::move(m_slots[(head + i) & (N - 1)]);
+        }
+        m_head.store(head + max, std::memory_order_release);
+        return max;
+    }
+
+    T dequeue()
+    {
+        T t;
+        unsigned spins = 0;
+        while (!try_dequeue(t)) {
+            // Give the producer a chance before parking
+            if (spins++ < CRING_SPIN_COUNT) {
+                std::this_thread::yield();
+            } else {
+                m_waiter.wait([this] { return !empty(); });
+            }
+        }
+        return t;
+    }
+
+    bool timed_dequeue(unsigned timeout_ms, T &t)
+    {
+        if (try_dequeue(t))
+            return true;
+        m_waiter.wait_for(timeout_ms, [this] { return !empty(); });
+        return try_dequeue(t);
+    }
+
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(CRING_CACHELINE) std::atomic<size_t> m_head{0};
+    alignas(CRING_CACHELINE) std::atomic<size_t> m_tail{0};
+    alignas(CRING_CACHELINE) T m_slots[N];
+    CRingWaiter m_waiter;
+};
+
+// Per-slot sequence numbers let producers claim slots with a single CAS.
+template <class T, size_t N>
+class CRingMPSC
+{
+    static_assert((N & (N - 1)) == 0, "Ring size must be a power of 2");
+
+public:
+    CRingMPSC()
+    {
+        for (size_t i = 0; i < N; i++) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_enqueue(const T &t)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        cell *c;
+        for (;;) {
+            c = &m_cells[pos & (N - 1)];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false; // Full
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = t;
+        c->seq.store(pos + 1, std::memory_order_release);
+        m_waiter.notify();
+        return true;
+    }
+
+    size_t enqueue_bulk(const T *t, size_t count)
+    {
+        size_t i;
+        for (i = 0; i < count; i++) {
+            if (!try_enqueue(t[i]))
+                break;
+        }
+        return i;
+    }
+
+    void enqueue(const T &t)
+    {
+        while (!try_enqueue(t)) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool try_dequeue(T &t)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        cell *c = &m_cells[pos & (N - 1)];
+        if (c->seq.load(std::memory_order_acquire) != pos + 1)
+            return false;
+        t = std::move(c->data);
+        c->seq.store(pos + N, std::memory_order_release);
+        m_head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t dequeue_bulk(T *t, size_t max)
+    {
+        size_t i;
+        for (i = 0; i < max; i++) {
+            if (!try_dequeue(t[i]))
+                break;
+        }
+        return i;
+    }
+
+    T dequeue()
+    {
+        T t;
+        unsigned spins = 0;
+        while (!try_dequeue(t)) {
+            // Give the producer a chance before parking
+            if (spins++ < CRING_SPIN_COUNT) {
+                std::this_thread::yield();
+            } else {
+                m_waiter.wait([this] { return !empty(); });
+            }
+        }
+        return t;
+    }
+
+    bool timed_dequeue(unsigned timeout_ms, T &t)
+    {
+        if (try_dequeue(t))
+            return true;
+        m_waiter.wait_for(timeout_ms, [this] { return !empty(); });
+        return try_dequeue(t);
+    }
+
+    // Only meaningful as a hint outside the consumer thread
+    bool empty() const
+    {
+        size_t pos = m_head.load(std::memory_order_acquire);
+        return m_cells[pos & (N - 1)].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    alignas(CRING_CACHELINE) std::atomic<size_t> m_head{0};
+    alignas(CRING_CACHELINE) std::atomic<size_t> m_tail{0};
+    alignas(CRING_CACHELINE) cell m_cells[N];
+    CRingWaiter m_waiter;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifdef UNITTESTS
+
+#include <catch2/catch.hpp>
+#include "cring.hpp"
+#include "cqueue.hpp"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Ring queue SPSC basic operation","[SIM][SIM/Queue]")
+{
+    CRingSPSC<int, 8> q;
+    int v;
+
+    CHECK( q.empty() );
+    CHECK( !q.try_dequeue(v) );
+
+    SECTION("FIFO order across wraparound")
+    {
+        for (int round=0; round<5; round++) {
+            for (int i=0; i<6; i++) {
+                REQUIRE( q.try_enqueue(round*10 + i) );
+            }
+            for (int i=0; i<6; i++) {
+                REQUIRE( q.try_dequeue(v) );
+                CHECK( v == round*10 + i );
+            }
+        }
+        CHECK( q.empty() );
+    }
+
+    SECTION("Full ring refuses elements")
+    {
+        for (int i=0; i<8; i++) {
+            REQUIRE( q.try_enqueue(i) );
+        }
+        CHECK( !q.try_enqueue(8) );
+        CHECK( q.size() == 8 );
+    }
+
+    SECTION("Bulk enqueue/dequeue")
+    {
+        const int in[10] = { 0,1,2,3,4,5,6,7,8,9 };
+        int out[10] = { 0 };
+
+        CHECK( q.enqueue_bulk(in, 10) == 8 );
+        CHECK( q.dequeue_bulk(out, 3) == 3 );
+        CHECK( q.enqueue_bulk(&in[8], 2) == 2 );
+        CHECK( q.dequeue_bulk(&out[3], 10) == 7 );
+        for (int i=0; i<10; i++) {
+            CHECK( out[i] == i );
+        }
+    }
+}
+
+TEST_CASE("Ring queue MPSC with concurrent producers","[SIM][SIM/Queue]")
+{
+    CRingMPSC<unsigned, 64> q;
+    const unsigned producers = 4;
+    const unsigned per_producer = 20000;
+    std::vector<std::thread> threads;
+    std::vector<unsigned> last(producers, 0);
+    uint64_t sum = 0;
+
+    for (unsigned p=0; p<producers; p++) {
+        threads.emplace_back([&q, p]() {
+            for (unsigned i=1; i<=per_producer; i++) {
+                q.enqueue( (p<<24) | i );
+            }
+        });
+    }
+
+    for (unsigned n=0; n<producers*per_producer; n++) {
+        unsigned v = q.dequeue();
+        unsigned p = v>>24;
+        unsigned i = v & 0xFFFFFF;
+        // Each producer's elements arrive in order
+        REQUIRE( i == last[p] + 1 );
+        last[p] = i;
+        sum += i;
+    }
+
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    CHECK( q.empty() );
+    CHECK( sum == (uint64_t)producers * per_producer * (per_producer+1) / 2 );
+}
+
+TEST_CASE("Ring queue timed dequeue","[SIM][SIM/Queue]")
+{
+    CRingMPSC<int, 4> q;
+    int v = -1;
+
+    CHECK( !q.timed_dequeue(10, v) );
+
+    std::thread producer([&q]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        q.enqueue(42);
+    });
+
+    CHECK( q.timed_dequeue(1000, v) );
+    CHECK( v == 42 );
+
+    producer.join();
+}
+
+template<class Q>
+static double queue_throughput(Q &q, unsigned count)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&q, count]() {
+        for (unsigned i=0; i<count; i++) {
+            q.enqueue(i);
+        }
+    });
+
+    for (unsigned i=0; i<count; i++) {
+        q.dequeue();
+    }
+    producer.join();
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / count;
+}
+
+TEST_CASE("Ring queue benchmark","[.][SIM/Queue/Benchmark]")
+{
+    const unsigned count = 2000000;
+
+    CQueue<unsigned> cqueue;
+    CRingSPSC<unsigned, 1024> spsc;
+    CRingMPSC<unsigned, 1024> mpsc;
+
+    double ns_cqueue = queue_throughput(cqueue, count);
+    double ns_spsc = queue_throughput(spsc, count);
+    double ns_mpsc = queue_throughput(mpsc, count);
+
+    WARN( "CQueue:    " << ns_cqueue << " ns/element" );
+    WARN( "CRingSPSC: " << ns_spsc << " ns/element" );
+    WARN( "CRingMPSC: " << ns_mpsc << " ns/element" );
+
+    CHECK( ns_spsc < ns_cqueue );
+}
+
+#endif
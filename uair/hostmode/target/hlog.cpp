@@ -0,0 +1,109 @@
+#include "hlog.h"
+#include <mutex>
+#include <cstdlib>
+#include <string>
+#include <strings.h>
+
+// Zone gates for the HLOG macros. Filled in by DECLARE_LOG_TAG constructors,
+// which run before C++ static initialisation, so only constant-initialised
+// state here.
+
+#define HLOG_MAX_ZONES (256)
+
+static std::mutex zones_mutex;
+static hlog_zone_t zones[HLOG_MAX_ZONES];
+static unsigned zone_count = 0;
+static int default_level = LEVEL_DEBUG;
+
+// Used when the table is full: never muted
+static hlog_zone_t overflow_zone = { "", LEVEL_DEBUG };
+
+static hlog_zone_t *hlog_zone_find(log_zone_t zone)
+{
+    for (unsigned i=0; i<zone_count; i++) {
+        if (strcmp(zones[i].name, zone)==0)
+            return &zones[i];
+    }
+    return NULL;
+}
+
+hlog_zone_t *hlog_zone_get(log_zone_t zone)
+{
+    std::lock_guard<std::mutex> lock(zones_mutex);
+
+    hlog_zone_t *z = hlog_zone_find(zone);
+
+    if (NULL == z) {
+        if (zone_count == HLOG_MAX_ZONES)
+            return &overflow_zone;
+        z = &zones[zone_count++];
+        z->name = zone;
+        z->level = default_level;
+    }
+    return z;
+}
+
+void hlog_zone_set_level(log_zone_t zone, log_level_t level)
+{
+    hlog_zone_t *z = hlog_zone_get(zone);
+
+    __atomic_store_n(&z->level, (int)level, __ATOMIC_RELAXED);
+
+    set_zone_log_level(zone, level);
+}
+
+void hlog_set_level(log_level_t level)
+{
+    {
+        std::lock_guard<std::mutex> lock(zones_mutex);
+
+        default_level = level;
+        for (unsigned i=0; i<zone_count; i++) {
+            __atomic_store_n(&zones[i].level, (int)level, __ATOMIC_RELAXED);
+        }
+    }
+    set_log_level(level);
+}
+
+static int hlog_parse_level(const char *name, log_level_t *level)
+{
+    static const char *names[] = { "debug", "warn", "error", "progress", "none" };
+
+    for (unsigned i=0; i<sizeof(names)/sizeof(names[0]); i++) {
+        if (strcasecmp(name, names[i])==0) {
+            *level = (log_level_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int hlog_configure(const char *spec)
+{
+    std::string s(spec);
+    size_t start = 0;
+
+    while (start <= s.size()) {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos)
+            end = s.size();
+
+        std::string item = s.substr(start, end - start);
+        size_t eq = item.find('=');
+        log_level_t level;
+
+        if (eq == std::string::npos) {
+            if (hlog_parse_level(item.c_str(), &level)!=0)
+                return -1;
+            hlog_set_level(level);
+        } else {
+            std::string zone = item.substr(0, eq);
+            if (zone.empty() || hlog_parse_level(item.c_str() + eq + 1, &level)!=0)
+                return -1;
+            // Zone names are kept by pointer, like the DECLARE_LOG_TAG literals
+            hlog_zone_set_level(strdup(zone.c_str()), level);
+        }
+        start = end + 1;
+    }
+    return 0;
+}
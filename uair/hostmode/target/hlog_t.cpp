@@ -0,0 +1,51 @@
+#ifdef UNITTESTS
+
+#include <catch2/catch.hpp>
+#include "hlog.h"
+
+DECLARE_LOG_TAG(HLOGTEST)
+#define TAG "HLOGTEST"
+
+static int hlog_test_count(int &calls)
+{
+    return ++calls;
+}
+
+TEST_CASE("Muted log zones skip their arguments","[SIM][SIM/Log]")
+{
+    hlog_zone_t *z = hlog_zone_get(TAG);
+    int saved = z->level;
+    int calls = 0;
+
+    SECTION("Zone level")
+    {
+        hlog_zone_set_level(TAG, LEVEL_NONE);
+        HERROR(TAG, "Call %d", hlog_test_count(calls));
+        CHECK( calls == 0 );
+
+        hlog_zone_set_level(TAG, LEVEL_WARN);
+        HLOG(TAG, "Call %d", hlog_test_count(calls));
+        CHECK( calls == 0 );
+        HWARN(TAG, "Call %d", hlog_test_count(calls));
+        CHECK( calls == 1 );
+    }
+
+    SECTION("Configuration string")
+    {
+        REQUIRE( hlog_configure(TAG "=none") == 0 );
+        HERROR(TAG, "Call %d", hlog_test_count(calls));
+        CHECK( calls == 0 );
+
+        REQUIRE( hlog_configure(TAG "=error") == 0 );
+        HERROR(TAG, "Call %d", hlog_test_count(calls));
+        CHECK( calls == 1 );
+
+        CHECK( hlog_configure(TAG "=loud") == -1 );
+        CHECK( hlog_configure("=debug") == -1 );
+        CHECK( hlog_configure("") == -1 );
+    }
+
+    hlog_zone_set_level(TAG, (log_level_t)saved);
+}
+
+#endif
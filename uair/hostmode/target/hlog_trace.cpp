@@ -0,0 +1,353 @@
+#include "hlog.h"
+#include "hlog_trace.h"
+#include "cring.hpp"
+#include "models/hw_simclock.h"
+#include "models/hw_snapshot.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+DECLARE_LOG_TAG(HLOG)
+#define TAG "HLOG"
+
+#define HLOG_TRACE_RING_SIZE (512)
+
+// Fallback formatting, when a record cannot be captured
+#define HLOG_TRACE_LINE_MAX (512)
+
+int hlog_trace_active = 0;
+
+struct hlog_trace_record
+{
+    uint64_t time_us;
+    const char *zone;
+    const char *fmt;
+    const char *func;
+    const char *file;
+    uint32_t line;
+    uint8_t level;
+    uint8_t nargs;
+    uint16_t strings_len;
+    uint64_t args[HLOG_TRACE_MAX_ARGS];
+    char strings[HLOG_TRACE_STRING_SPACE];
+};
+
+struct hlog_trace_ring
+{
+    CRingSPSC<hlog_trace_record, HLOG_TRACE_RING_SIZE> ring;
+    uint32_t index;
+    std::atomic<bool> in_use{false};
+};
+
+// A ring per logging thread, reused once its thread exits and it is drained
+struct hlog_trace_thread
+{
+    hlog_trace_ring *ring{nullptr};
+    bool busy{false};   // A signal handler logging on top of this thread's log call
+
+    ~hlog_trace_thread()
+    {
+        if (ring)
+            ring->in_use = false;
+    }
+};
+
+static std::mutex rings_mutex;
+static std::vector<hlog_trace_ring*> rings;
+
+static thread_local hlog_trace_thread this_thread;
+
+static FILE *trace_file = NULL;
+static std::thread writer_thread;
+static std::mutex writer_mutex;
+static std::condition_variable writer_cond;
+static bool writer_exit = false;
+static std::unordered_map<const char*, uint32_t> string_ids;
+
+static std::atomic<uint64_t> fallbacks(0);
+
+static hlog_trace_ring *hlog_trace_get_ring()
+{
+    std::lock_guard<std::mutex> lock(rings_mutex);
+
+    for (auto r: rings) {
+        if (!r->in_use && r->ring.empty()) {
+            r->in_use = true;
+            return r;
+        }
+    }
+
+    hlog_trace_ring *r = new hlog_trace_ring();
+    r->index = rings.size();
+    r->in_use = true;
+    rings.push_back(r);
+    return r;
+}
+
+static bool hlog_trace_capture(hlog_trace_record &r, const char *fmt, va_list ap)
+{
+    hlog_conversion_t c;
+    const char *p = fmt;
+
+    r.nargs = 0;
+    r.strings_len = 0;
+
+    while ((p = hlog_next_conversion(p, &c)) != NULL) {
+        if (c.arg == HLOG_ARG_NONE)
+            continue;
+        if (c.arg == HLOG_ARG_UNSUPPORTED)
+            return false;
+        if (r.nargs + c.stars + 1 > HLOG_TRACE_MAX_ARGS)
+            return false;
+
+        for (unsigned i=0; i<c.stars; i++)
+            r.args[r.nargs++] = (uint64_t)(int64_t)va_arg(ap, int);
+
+        uint64_t &slot = r.args[r.nargs++];
+
+        switch (c.arg) {
+        case HLOG_ARG_INT:
+            slot = (uint64_t)(int64_t)va_arg(ap, int);
+            break;
+        case HLOG_ARG_LONG:
+            slot = (uint64_t)va_arg(ap, long);
+            break;
+        case HLOG_ARG_LLONG:
+            slot = (uint64_t)va_arg(ap, long long);
+            break;
+        case HLOG_ARG_SIZE:
+            slot = (uint64_t)va_arg(ap, size_t);
+            break;
+        case HLOG_ARG_INTMAX:
+            slot = (uint64_t)va_arg(ap, intmax_t);
+            break;
+        case HLOG_ARG_PTRDIFF:
+            slot = (uint64_t)va_arg(ap, ptrdiff_t);
+            break;
+        case HLOG_ARG_DOUBLE:
+        case HLOG_ARG_LDOUBLE:
+            {
+                double d = (c.arg == HLOG_ARG_DOUBLE) ? va_arg(ap, double) : (double)va_arg(ap, long double);
+                memcpy(&slot, &d, sizeof(d));
+            }
+            break;
+        case HLOG_ARG_POINTER:
+            slot = (uint64_t)(uintptr_t)va_arg(ap, void*);
+            break;
+        case HLOG_ARG_STRING:
+            {
+                const char *s = va_arg(ap, const char*);
+                if (s == NULL)
+                    s = "(null)";
+                size_t len = strlen(s) + 1;
+                if (r.strings_len + len > HLOG_TRACE_STRING_SPACE)
+                    return false;
+                memcpy(&r.strings[r.strings_len], s, len);
+                slot = r.strings_len;
+                r.strings_len += len;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+void hlog_trace(log_zone_t zone, log_level_t level, const char *fun, const char *filename, int line, const char *fmt, ...)
+{
+    hlog_trace_thread &t = this_thread;
+    va_list ap;
+
+    if (!t.busy) {
+        t.busy = true;
+
+        if (NULL == t.ring)
+            t.ring = hlog_trace_get_ring();
+
+        hlog_trace_record r;
+        r.time_us = simclock_now_us();
+        r.zone = zone;
+        r.fmt = fmt;
+        r.func = fun;
+        r.file = filename;
+        r.line = line;
+        r.level = level;
+
+        va_start(ap, fmt);
+        bool captured = hlog_trace_capture(r, fmt, ap);
+        va_end(ap);
+
+        if (captured && t.ring->ring.try_enqueue(r)) {
+            t.busy = false;
+            return;
+        }
+        t.busy = false;
+    }
+
+    // Ring full, nested call or unsupported format: log it the old way
+    char text[HLOG_TRACE_LINE_MAX];
+
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+
+    fallbacks++;
+
+    do_log(zone, level, fun, filename, line, "%s", text);
+}
+
+template<typename T>
+static void hlog_trace_put(const T &v)
+{
+    fwrite(&v, sizeof(v), 1, trace_file);
+}
+
+static uint32_t hlog_trace_string(const char *s)
+{
+    auto it = string_ids.find(s);
+    if (it != string_ids.end())
+        return it->second;
+
+    uint32_t id = string_ids.size();
+    uint16_t len = strlen(s);
+
+    string_ids[s] = id;
+
+    hlog_trace_put<uint8_t>(HLOG_TRACE_STRING);
+    hlog_trace_put<uint32_t>(id);
+    hlog_trace_put<uint16_t>(len);
+    fwrite(s, 1, len, trace_file);
+
+    return id;
+}
+
+static void hlog_trace_write(const hlog_trace_ring *ring, const hlog_trace_record &r)
+{
+    uint32_t zone = hlog_trace_string(r.zone);
+    uint32_t fmt = hlog_trace_string(r.fmt);
+    uint32_t func = hlog_trace_string(r.func);
+    uint32_t file = hlog_trace_string(r.file);
+
+    hlog_trace_put<uint8_t>(HLOG_TRACE_LOG);
+    hlog_trace_put<uint64_t>(r.time_us);
+    hlog_trace_put<uint32_t>(ring->index);
+    hlog_trace_put<uint8_t>(r.level);
+    hlog_trace_put<uint32_t>(zone);
+    hlog_trace_put<uint32_t>(fmt);
+    hlog_trace_put<uint32_t>(func);
+    hlog_trace_put<uint32_t>(file);
+    hlog_trace_put<uint32_t>(r.line);
+    hlog_trace_put<uint8_t>(r.nargs);
+    hlog_trace_put<uint16_t>(r.strings_len);
+    fwrite(r.args, sizeof(r.args[0]), r.nargs, trace_file);
+    fwrite(r.strings, 1, r.strings_len, trace_file);
+}
+
+static bool hlog_trace_drain()
+{
+    std::vector<hlog_trace_ring*> current;
+    hlog_trace_record r;
+    bool any = false;
+
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        current = rings;
+    }
+
+    for (auto ring: current) {
+        while (ring->ring.try_dequeue(r)) {
+            hlog_trace_write(ring, r);
+            any = true;
+        }
+    }
+    return any;
+}
+
+static void hlog_trace_writer()
+{
+    std::unique_lock<std::mutex> lock(writer_mutex);
+
+    while (!writer_exit) {
+        lock.unlock();
+        bool any = hlog_trace_drain();
+        lock.lock();
+
+        if (!any) {
+            fflush(trace_file);
+            writer_cond.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+    lock.unlock();
+
+    hlog_trace_drain();
+    fflush(trace_file);
+}
+
+static int hlog_trace_writer_stop(void)
+{
+    if (!writer_thread.joinable())
+        return 0;
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        writer_exit = true;
+        writer_cond.notify_all();
+    }
+    writer_thread.join();
+    return 1;
+}
+
+static void hlog_trace_writer_start(void)
+{
+    writer_exit = false;
+    writer_thread = std::thread(hlog_trace_writer);
+}
+
+int hlog_trace_start(const char *filename)
+{
+    if (NULL != trace_file)
+        hlog_trace_stop();
+
+    trace_file = fopen(filename, "wb");
+    if (NULL == trace_file) {
+        HERROR(TAG, "Cannot open trace file %s", filename);
+        return -1;
+    }
+
+    fwrite(HLOG_TRACE_MAGIC, 1, strlen(HLOG_TRACE_MAGIC), trace_file);
+    hlog_trace_put<uint32_t>(HLOG_TRACE_VERSION);
+
+    string_ids.clear();
+    fallbacks = 0;
+
+    hlog_trace_writer_start();
+    snapshot_register_thread(&hlog_trace_writer_stop, &hlog_trace_writer_start);
+
+    __atomic_store_n(&hlog_trace_active, 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void hlog_trace_stop(void)
+{
+    if (NULL == trace_file)
+        return;
+
+    __atomic_store_n(&hlog_trace_active, 0, __ATOMIC_RELEASE);
+
+    hlog_trace_writer_stop();
+
+    fclose(trace_file);
+    trace_file = NULL;
+
+    if (fallbacks)
+        HWARN(TAG, "%" PRIu64 " log lines were formatted synchronously", fallbacks.load());
+}
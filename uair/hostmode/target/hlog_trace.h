@@ -0,0 +1,177 @@
+#ifndef HLOG_TRACE_H__
+#define HLOG_TRACE_H__
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * Binary log trace.
+ *
+ * Instead of formatting, HLOG calls store the format pointer, the raw
+ * arguments and the simulated time in a per-thread ring. A background
+ * writer drains the rings into a trace file, where each string (zone,
+ * format, function, file) is written once and then referred to by id.
+ * tools/hlog_decode renders the trace as text after the run.
+ *
+ * File layout (host byte order):
+ *   "UAIRHLOG" uint32 version
+ *   records, each starting with a uint8 type:
+ *     HLOG_TRACE_STRING  uint32 id, uint16 len, bytes
+ *     HLOG_TRACE_LOG     uint64 time_us, uint32 thread, uint8 level,
+ *                        uint32 zone, fmt, func, file, uint32 line,
+ *                        uint8 nargs, uint16 strings_len,
+ *                        uint64 args[nargs], strings
+ *
+ * String arguments are copied into the record. Their argument slot holds
+ * the offset of the string within the record strings.
+ */
+
+#define HLOG_TRACE_MAGIC "UAIRHLOG"
+#define HLOG_TRACE_VERSION (1U)
+
+#define HLOG_TRACE_STRING (1U)
+#define HLOG_TRACE_LOG (2U)
+
+#define HLOG_TRACE_MAX_ARGS (12)
+#define HLOG_TRACE_STRING_SPACE (128)
+
+typedef enum {
+    HLOG_ARG_NONE,      /* "%%" */
+    HLOG_ARG_INT,
+    HLOG_ARG_LONG,
+    HLOG_ARG_LLONG,
+    HLOG_ARG_SIZE,
+    HLOG_ARG_INTMAX,
+    HLOG_ARG_PTRDIFF,
+    HLOG_ARG_DOUBLE,
+    HLOG_ARG_LDOUBLE,
+    HLOG_ARG_STRING,
+    HLOG_ARG_POINTER,
+    HLOG_ARG_UNSUPPORTED
+} hlog_arg_t;
+
+typedef struct {
+    const char *start;  /* The '%' */
+    size_t len;         /* Whole conversion, up to the conversion character */
+    unsigned stars;     /* '*' width/precision, each an int argument before the value */
+    hlog_arg_t arg;
+} hlog_conversion_t;
+
+/* Finds the next conversion in fmt. Returns NULL when there is none left. */
+static inline const char *hlog_next_conversion(const char *fmt, hlog_conversion_t *c)
+{
+    while (*fmt && *fmt != '%')
+        fmt++;
+
+    if (*fmt == '\0')
+        return NULL;
+
+    const char *p = fmt + 1;
+
+    c->start = fmt;
+    c->stars = 0;
+
+    if (*p == '%') {
+        c->arg = HLOG_ARG_NONE;
+        c->len = 2;
+        return p + 1;
+    }
+
+    while (*p && (*p=='-' || *p=='+' || *p==' ' || *p=='#' || *p=='0' || *p=='\''))
+        p++;
+    if (*p == '*') {
+        c->stars++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            c->stars++;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+
+    hlog_arg_t integer = HLOG_ARG_INT;
+    int long_double = 0;
+
+    switch (*p) {
+    case 'h':
+        p++;
+        if (*p == 'h')
+            p++;
+        break;
+    case 'l':
+        p++;
+        integer = HLOG_ARG_LONG;
+        if (*p == 'l') {
+            p++;
+            integer = HLOG_ARG_LLONG;
+        }
+        break;
+    case 'q':
+        p++;
+        integer = HLOG_ARG_LLONG;
+        break;
+    case 'z':
+        p++;
+        integer = HLOG_ARG_SIZE;
+        break;
+    case 'j':
+        p++;
+        integer = HLOG_ARG_INTMAX;
+        break;
+    case 't':
+        p++;
+        integer = HLOG_ARG_PTRDIFF;
+        break;
+    case 'L':
+        p++;
+        long_double = 1;
+        break;
+    default:
+        break;
+    }
+
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        c->arg = integer;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        c->arg = long_double ? HLOG_ARG_LDOUBLE : HLOG_ARG_DOUBLE;
+        break;
+    case 's':
+        /* "%ls" wide strings are not captured */
+        c->arg = (integer == HLOG_ARG_INT) ? HLOG_ARG_STRING : HLOG_ARG_UNSUPPORTED;
+        break;
+    case 'p':
+        c->arg = HLOG_ARG_POINTER;
+        break;
+    default:
+        c->arg = HLOG_ARG_UNSUPPORTED;
+        break;
+    }
+
+    if (*p)
+        p++;
+
+    c->len = p - fmt;
+
+    return p;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int hlog_trace_start(const char *filename);
+void hlog_trace_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+#include "hlog_trace.h"
+#include "hlog_trace_decode.hpp"
+#include <cstring>
+#include <unordered_map>
+
+template<typename T>
+static bool get(FILE *f, T &v)
+{
+    return fread(&v, sizeof(v), 1, f) == 1;
+}
+
+std::string hlog_trace_render(const std::string &fmt, const uint64_t *args, unsigned nargs, const char *argstrings, unsigned strings_len)
+{
+    std::string out;
+    hlog_conversion_t c;
+    const char *p = fmt.c_str();
+    const char *literal = p;
+    unsigned a = 0;
+    char spec[64];
+    char buf[512];
+
+    while ((p = hlog_next_conversion(p, &c)) != NULL) {
+        out.append(literal, c.start - literal);
+        literal = p;
+
+        if (c.arg == HLOG_ARG_NONE) {
+            out += '%';
+            continue;
+        }
+        if (c.arg == HLOG_ARG_UNSUPPORTED || c.len >= sizeof(spec) || a + c.stars + 1 > nargs) {
+            out.append(c.start, c.len);
+            continue;
+        }
+
+        memcpy(spec, c.start, c.len);
+        spec[c.len] = '\0';
+
+        int star[2] = { 0, 0 };
+        for (unsigned i=0; i<c.stars; i++)
+            star[i] = (int)(int64_t)args[a++];
+
+        uint64_t v = args[a++];
+        double d;
+
+// Width and precision stars come before the value
+#define FORMAT(value) \
+        (c.stars == 0 ? snprintf(buf, sizeof(buf), spec, value) : \
+         c.stars == 1 ? snprintf(buf, sizeof(buf), spec, star[0], value) : \
+                        snprintf(buf, sizeof(buf), spec, star[0], star[1], value))
+
+        switch (c.arg) {
+        case HLOG_ARG_INT:
+            FORMAT((int)(int64_t)v);
+            break;
+        case HLOG_ARG_LONG:
+            FORMAT((long)v);
+            break;
+        case HLOG_ARG_LLONG:
+            FORMAT((long long)v);
+            break;
+        case HLOG_ARG_SIZE:
+            FORMAT((size_t)v);
+            break;
+        case HLOG_ARG_INTMAX:
+            FORMAT((intmax_t)v);
+            break;
+        case HLOG_ARG_PTRDIFF:
+            FORMAT((ptrdiff_t)v);
+            break;
+        case HLOG_ARG_DOUBLE:
+            memcpy(&d, &v, sizeof(d));
+            FORMAT(d);
+            break;
+        case HLOG_ARG_LDOUBLE:
+            memcpy(&d, &v, sizeof(d));
+            FORMAT((long double)d);
+            break;
+        case HLOG_ARG_POINTER:
+            FORMAT((void*)(uintptr_t)v);
+            break;
+        case HLOG_ARG_STRING:
+            FORMAT(v < strings_len ? &argstrings[v] : "(bad string)");
+            break;
+        default:
+            buf[0] = '\0';
+            break;
+        }
+#undef FORMAT
+        out += buf;
+    }
+    out += literal;
+    return out;
+}
+
+hlog_trace_decode_result_t hlog_trace_decode(FILE *f, const std::function<void(const hlog_trace_line &)> &emit)
+{
+    std::unordered_map<uint32_t, std::string> strings;
+    char magic[sizeof(HLOG_TRACE_MAGIC) - 1];
+    uint32_t version;
+    uint8_t type;
+
+    auto lookup = [&strings](uint32_t id) -> const std::string & {
+        static const std::string unknown = "?";
+        auto it = strings.find(id);
+        return it == strings.end() ? unknown : it->second;
+    };
+
+    if (fread(magic, sizeof(magic), 1, f)!=1 || memcmp(magic, HLOG_TRACE_MAGIC, sizeof(magic))!=0 ||
+        !get(f, version) || version != HLOG_TRACE_VERSION)
+        return HLOG_TRACE_DECODE_BAD_HEADER;
+
+    while (get(f, type)) {
+        if (type == HLOG_TRACE_STRING) {
+            uint32_t id;
+            uint16_t len;
+            std::string s;
+
+            if (!get(f, id) || !get(f, len))
+                return HLOG_TRACE_DECODE_TRUNCATED;
+            s.resize(len);
+            if (len && fread(&s[0], len, 1, f)!=1)
+                return HLOG_TRACE_DECODE_TRUNCATED;
+            strings[id] = s;
+        } else if (type == HLOG_TRACE_LOG) {
+            hlog_trace_line l;
+            uint32_t zone, fmt, func, file;
+            uint8_t nargs;
+            uint16_t strings_len;
+            uint64_t args[HLOG_TRACE_MAX_ARGS];
+            char argstrings[HLOG_TRACE_STRING_SPACE];
+
+            if (!get(f, l.time_us) || !get(f, l.thread) || !get(f, l.level) ||
+                !get(f, zone) || !get(f, fmt) || !get(f, func) || !get(f, file) || !get(f, l.line) ||
+                !get(f, nargs) || !get(f, strings_len) ||
+                nargs > HLOG_TRACE_MAX_ARGS || strings_len > HLOG_TRACE_STRING_SPACE ||
+                (nargs && fread(args, sizeof(args[0]), nargs, f)!=nargs) ||
+                (strings_len && fread(argstrings, strings_len, 1, f)!=1))
+                return HLOG_TRACE_DECODE_TRUNCATED;
+
+            l.zone = lookup(zone);
+            l.func = lookup(func);
+            l.file = lookup(file);
+            l.text = hlog_trace_render(lookup(fmt), args, nargs, argstrings, strings_len);
+            emit(l);
+        } else {
+            return HLOG_TRACE_DECODE_UNKNOWN_RECORD;
+        }
+    }
+
+    return HLOG_TRACE_DECODE_OK;
+}
@@ -0,0 +1,38 @@
+#ifndef HLOG_TRACE_DECODE_HPP__
+#define HLOG_TRACE_DECODE_HPP__
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+/*
+ * Binary log trace reader (see hlog_trace.h), shared by tools/hlog_decode
+ * and the tests.
+ */
+
+struct hlog_trace_line
+{
+    uint64_t time_us;
+    uint32_t thread;
+    uint8_t level;
+    uint32_t line;
+    std::string zone;
+    std::string func;
+    std::string file;
+    std::string text;   // The format rendered with the captured arguments
+};
+
+typedef enum {
+    HLOG_TRACE_DECODE_OK,
+    HLOG_TRACE_DECODE_BAD_HEADER,       // Not a trace, or another version
+    HLOG_TRACE_DECODE_TRUNCATED,        // Lines up to the cut were emitted
+    HLOG_TRACE_DECODE_UNKNOWN_RECORD
+} hlog_trace_decode_result_t;
+
+// Strings not defined by the trace (yet) render as "?"
+hlog_trace_decode_result_t hlog_trace_decode(FILE *f, const std::function<void(const hlog_trace_line &)> &emit);
+
+std::string hlog_trace_render(const std::string &fmt, const uint64_t *args, unsigned nargs, const char *argstrings, unsigned strings_len);
+
+#endif
@@ -0,0 +1,201 @@
+#ifdef UNITTESTS
+
+#include <catch2/catch.hpp>
+#include "hlog.h"
+#include "hlog_trace.h"
+#include "hlog_trace_decode.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+DECLARE_LOG_TAG(HLOGTRACETEST)
+#define TAG "HLOGTRACETEST"
+
+static std::string hlog_trace_test_file()
+{
+    char path[] = "/tmp/hlog_trace_t.XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE( fd >= 0 );
+    close(fd);
+    return path;
+}
+
+static std::string hlog_trace_test_read(const std::string &path)
+{
+    std::string data;
+    FILE *f = fopen(path.c_str(), "rb");
+    REQUIRE( f != NULL );
+
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.append(buf, n);
+    fclose(f);
+    return data;
+}
+
+static hlog_trace_decode_result_t hlog_trace_test_decode(const std::string &data, std::vector<hlog_trace_line> &lines)
+{
+    FILE *f = fmemopen((void*)data.data(), data.size(), "rb");
+    REQUIRE( f != NULL );
+
+    lines.clear();
+    hlog_trace_decode_result_t result = hlog_trace_decode(f, [&lines](const hlog_trace_line &l) {
+        lines.push_back(l);
+    });
+    fclose(f);
+    return result;
+}
+
+template<typename T>
+static void hlog_trace_test_put(std::string &data, const T &v)
+{
+    data.append((const char*)&v, sizeof(v));
+}
+
+static void hlog_trace_test_string(std::string &data, uint32_t id, const char *s)
+{
+    hlog_trace_test_put<uint8_t>(data, HLOG_TRACE_STRING);
+    hlog_trace_test_put<uint32_t>(data, id);
+    hlog_trace_test_put<uint16_t>(data, strlen(s));
+    data.append(s);
+}
+
+static void hlog_trace_test_log(std::string &data, uint32_t zone, uint32_t fmt, uint64_t arg)
+{
+    hlog_trace_test_put<uint8_t>(data, HLOG_TRACE_LOG);
+    hlog_trace_test_put<uint64_t>(data, 1000000);
+    hlog_trace_test_put<uint32_t>(data, 0);
+    hlog_trace_test_put<uint8_t>(data, LEVEL_WARN);
+    hlog_trace_test_put<uint32_t>(data, zone);
+    hlog_trace_test_put<uint32_t>(data, fmt);
+    hlog_trace_test_put<uint32_t>(data, zone);
+    hlog_trace_test_put<uint32_t>(data, zone);
+    hlog_trace_test_put<uint32_t>(data, 42);
+    hlog_trace_test_put<uint8_t>(data, 1);
+    hlog_trace_test_put<uint16_t>(data, 0);
+    hlog_trace_test_put<uint64_t>(data, arg);
+}
+
+TEST_CASE("Log traces decode as they were logged","[SIM][SIM/Log]")
+{
+    hlog_zone_t *z = hlog_zone_get(TAG);
+    int saved = z->level;
+    std::vector<hlog_trace_line> lines;
+
+    hlog_zone_set_level(TAG, LEVEL_DEBUG);
+
+    SECTION("Capture, file and decode")
+    {
+        std::string path = hlog_trace_test_file();
+        const char *none = NULL;
+
+        REQUIRE( hlog_trace_start(path.c_str()) == 0 );
+        HLOG(TAG, "Integers %d %u %ld %lld %zu %02x %c", -1, 2U, -3L, -4LL, (size_t)5, 0xab, 'z');
+        HLOG(TAG, "Strings '%s' '%s' %5.2f %*d %.*s %%", "abc", none, 3.14159, 4, 7, 2, "xyz");
+        for (int i=0; i<3; i++)
+            HWARN(TAG, "Repeat %d", i);
+        hlog_trace_stop();
+
+        std::string data = hlog_trace_test_read(path);
+        unlink(path.c_str());
+
+        // Header first, then each string once
+        REQUIRE( data.compare(0, strlen(HLOG_TRACE_MAGIC), HLOG_TRACE_MAGIC) == 0 );
+        uint32_t version;
+        memcpy(&version, &data[strlen(HLOG_TRACE_MAGIC)], sizeof(version));
+        CHECK( version == HLOG_TRACE_VERSION );
+
+        size_t first = data.find("Repeat %d");
+        REQUIRE( first != std::string::npos );
+        CHECK( data.find("Repeat %d", first + 1) == std::string::npos );
+        first = data.find(TAG);
+        REQUIRE( first != std::string::npos );
+        CHECK( data.find(TAG, first + 1) == std::string::npos );
+
+        REQUIRE( hlog_trace_test_decode(data, lines) == HLOG_TRACE_DECODE_OK );
+        REQUIRE( lines.size() == 5 );
+
+        CHECK( lines[0].text == "Integers -1 2 -3 -4 5 ab z" );
+        CHECK( lines[1].text == "Strings 'abc' '(null)'  3.14    7 xy %" );
+        for (int i=0; i<3; i++) {
+            CHECK( lines[2 + i].text == "Repeat " + std::to_string(i) );
+            CHECK( lines[2 + i].level == LEVEL_WARN );
+        }
+
+        CHECK( lines[0].zone == TAG );
+        CHECK( lines[0].file == "hlog_trace_t.cpp" );
+        CHECK( lines[0].level == LEVEL_DEBUG );
+        CHECK( lines[1].line == lines[0].line + 1 );
+        CHECK( lines[0].thread == lines[4].thread );
+
+        SECTION("Truncated file")
+        {
+            std::vector<hlog_trace_line> all = lines;
+
+            // Cut in the middle of the last record, then of the first one
+            CHECK( hlog_trace_test_decode(data.substr(0, data.size() - 1), lines) == HLOG_TRACE_DECODE_TRUNCATED );
+            REQUIRE( lines.size() == all.size() - 1 );
+            CHECK( lines.back().text == all[all.size() - 2].text );
+
+            CHECK( hlog_trace_test_decode(data.substr(0, data.find("Integers") + 3), lines) == HLOG_TRACE_DECODE_TRUNCATED );
+            CHECK( lines.empty() );
+
+            // A cut header is not a trace
+            CHECK( hlog_trace_test_decode(data.substr(0, strlen(HLOG_TRACE_MAGIC) + 2), lines) == HLOG_TRACE_DECODE_BAD_HEADER );
+        }
+
+        SECTION("Version mismatch")
+        {
+            uint32_t other = HLOG_TRACE_VERSION + 1;
+            memcpy(&data[strlen(HLOG_TRACE_MAGIC)], &other, sizeof(other));
+
+            CHECK( hlog_trace_test_decode(data, lines) == HLOG_TRACE_DECODE_BAD_HEADER );
+            CHECK( lines.empty() );
+
+            data[0] = 'X';
+            CHECK( hlog_trace_test_decode(data, lines) == HLOG_TRACE_DECODE_BAD_HEADER );
+        }
+
+        SECTION("Unknown record")
+        {
+            data.push_back((char)0x7f);
+
+            CHECK( hlog_trace_test_decode(data, lines) == HLOG_TRACE_DECODE_UNKNOWN_RECORD );
+            CHECK( lines.size() == 5 );
+        }
+    }
+
+    SECTION("String table records")
+    {
+        std::string data(HLOG_TRACE_MAGIC);
+        hlog_trace_test_put<uint32_t>(data, HLOG_TRACE_VERSION);
+
+        hlog_trace_test_string(data, 0, "ZONE");
+        hlog_trace_test_string(data, 1, "First %d");
+        hlog_trace_test_log(data, 0, 1, 1);
+
+        // Not defined yet, then redefined
+        hlog_trace_test_log(data, 2, 1, 2);
+        hlog_trace_test_string(data, 1, "Second %d");
+        hlog_trace_test_log(data, 0, 1, 3);
+
+        REQUIRE( hlog_trace_test_decode(data, lines) == HLOG_TRACE_DECODE_OK );
+        REQUIRE( lines.size() == 3 );
+
+        CHECK( lines[0].zone == "ZONE" );
+        CHECK( lines[0].text == "First 1" );
+        CHECK( lines[0].line == 42 );
+        CHECK( lines[0].time_us == 1000000 );
+        CHECK( lines[1].zone == "?" );
+        CHECK( lines[1].text == "First 2" );
+        CHECK( lines[2].text == "Second 3" );
+    }
+
+    hlog_zone_set_level(TAG, (log_level_t)saved);
+}
+
+#endif
@@ -1,19 +1,22 @@
 #include "console_uart.h"
 #include <thread>
-#include "cqueue.hpp"
+#include "cring.hpp"
 #include <termios.h>
 #include <atomic>
 #include <cstring>
 #include <unistd.h>
 #include "models/hw_interrupts.h"
 #include "models/hw_dma.h"
+#include "models/hw_snapshot.h"
 #include "stm32wlxx_ll_dmamux.h"
 
 static struct termios g_startup_termios;
 std::thread g_uart_thread;
 
-static CQueue<int> g_control_queue;
-static CQueue<uint8_t> g_data_queue;
+#define UART_READ_CHUNK (64)
+
+static CRingMPSC<int, 16> g_control_queue;
+static CRingSPSC<uint8_t, 4096> g_data_queue;
 
 std::atomic<bool> g_enabled;
 
@@ -47,7 +50,7 @@ void console_uart_deinit()
 
 static void uart_thread_runner(int dmaline)
 {
-    uint8_t thischar;
+    uint8_t chunk[UART_READ_CHUNK];
     struct timeval tv;
     fd_set rfs;
 
@@ -73,9 +76,21 @@ static void uart_thread_runner(int dmaline)
                 }
                 break;
             default:
-                if (read(0, &thischar, 1) == 1) {
-                    g_data_queue.enqueue(thischar);
-                    dma_notify(dmaline);    
+                {
+                    // Take whatever is available in one go
+                    ssize_t len = read(0, chunk, sizeof(chunk));
+                    size_t queued = 0;
+                    while ((len > 0) && (queued < (size_t)len)) {
+                        size_t n = g_data_queue.enqueue_bulk(&chunk[queued], len - queued);
+                        if (n==0) {
+                            std::this_thread::yield();
+                        }
+                        queued += n;
+                    }
+                    // The DMA model transfers one byte per request
+                    for (ssize_t i=0; i<len; i++) {
+                        dma_notify(dmaline);
+                    }
                 }
                 break;
             }
@@ -89,11 +104,27 @@ int console_uart_get_char()
     return g_data_queue.dequeue();
 }
 
+static int uart_thread_stop(void)
+{
+    if (!g_uart_thread.joinable())
+        return 0;
+    g_control_queue.enqueue(-1);
+    g_uart_thread.join();
+    return 1;
+}
+
+static void uart_thread_start(void)
+{
+    g_uart_thread = std::thread( &uart_thread_runner, LL_DMAMUX_REQ_USART2_RX );
+    g_control_queue.enqueue(1);
+}
+
 int console_uart_start_dma()
 {
     if (!g_uart_thread.joinable()) {
         console_uart_init();
         g_uart_thread = std::thread( &uart_thread_runner, LL_DMAMUX_REQ_USART2_RX );
+        snapshot_register_thread(&uart_thread_stop, &uart_thread_start);
     }
     g_control_queue.enqueue(1);
     return 0;
@@ -193,7 +193,7 @@ static bool hs300x_can_configure(struct hs300x_model *m)
         return false;
     }
 
-    gettimeofday(&now, NULL);
+    simclock_gettimeofday(&now);
 
     timeval_subtract (&delta, &m->powerup_time, &now);
 
@@ -216,7 +216,7 @@ void hs300x_powerup(struct hs300x_model *m)
 {
     HWARN(TAG, "Powered up");
     m->powered = true;
-    gettimeofday(&m->powerup_time, NULL);
+    simclock_gettimeofday(&m->powerup_time);
 }
 
 void hs300x_set_temperature(struct hs300x_model *m, float temp_c)
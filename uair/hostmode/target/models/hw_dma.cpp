@@ -1,6 +1,7 @@
 #include "hw_dma.h"
 #include "hw_interrupts.h"
-#include "cqueue.hpp"
+#include "hw_snapshot.h"
+#include "cring.hpp"
 #include <unordered_map>
 #include <thread>
 #include "stm32wlxx_hal_dma.h"
@@ -10,7 +11,7 @@ DECLARE_LOG_TAG(DMA_ENGINE)
 #define TAG "DMA_ENGINE"
 
 
-CQueue<int> g_dma_request;
+CRingMPSC<int, 1024> g_dma_request;
 std::thread g_dmathread;
 
 typedef struct {
@@ -115,6 +116,20 @@ void dma_thread()
 }
 
 
+static int dma_thread_stop(void)
+{
+    if (!g_dmathread.joinable())
+        return 0;
+    g_dma_request.enqueue(-1);
+    g_dmathread.join();
+    return 1;
+}
+
+static void dma_thread_start(void)
+{
+    g_dmathread = std::thread(dma_thread);
+}
+
 int dma_channel_start(DMA_Channel_TypeDef *handle, size_t source, size_t dest, unsigned len)
 {
     handle->Source = source;
@@ -123,7 +138,8 @@ int dma_channel_start(DMA_Channel_TypeDef *handle, size_t source, size_t dest, u
     handle->Offset = 0;
 
     if (!g_dmathread.joinable()) {
-        g_dmathread = std::thread(dma_thread);
+        dma_thread_start();
+        snapshot_register_thread(&dma_thread_stop, &dma_thread_start);
     }
     return 0;
 }
@@ -1,5 +1,5 @@
 #include "hw_interrupts.h"
-#include "cqueue.hpp"
+#include "cring.hpp"
 #include <thread>
 #include <atomic>
 #include <unistd.h>
@@ -8,11 +8,20 @@
 #include <pthread.h>
 #include <signal.h>
 #include <cassert>
-#include <atomic>
+#include <map>
+#include <climits>
+#include <condition_variable>
 #include "hlog.h"
+#include "hw_simclock.h"
+#include "hw_snapshot.h"
+
+DECLARE_LOG_TAG(INTERRUPTS)
+#define TAG "INTERRUPTS"
 
-static CQueue<int> interrupt_queue;
-static CQueue<int> pending_queue;
+#define MAX_INTERRUPT_LINES (128)
+
+static CRingMPSC<int, 256> interrupt_queue;  // Any thread -> interrupt thread
+static CRingSPSC<int, 256> pending_queue;    // Interrupt thread -> CPU
 
 static std::thread interrupt_thread;
 static pthread_t main_thread_id;
@@ -21,8 +30,114 @@ static std::recursive_mutex intmutex;
 
 static std::atomic<bool> interrupts_enabled;
 
+// Interrupts raised but not yet serviced by the CPU.
+static std::atomic<int> in_flight(0);
+
+/*
+ * Deterministic mode: no interrupt thread and no signals. Raised lines are
+ * kept ordered by priority (then by raise order) and the CPU thread services
+ * them synchronously when it re-enables interrupts, polls the RTC or sleeps.
+ */
+static bool deterministic = false;
+static std::mutex det_mutex;
+static std::condition_variable det_cond;
+static std::multimap<int, int> det_pending;  // priority -> line
+static int priorities[MAX_INTERRUPT_LINES];
+static std::atomic<int> running_priority(INT_MAX); // Thread mode
+
 extern "C" void interrupt(int signal);
 
+static void (*line_handler)(int line) = NULL;
+
+static void interrupts_service(int line)
+{
+    if (line_handler != NULL)
+        line_handler(line);
+    else
+        interrupt(line);
+}
+
+// Pending line able to preempt whatever is running
+static bool interrupts_det_has_pending()
+{
+    std::lock_guard<std::mutex> lock(det_mutex);
+    return !det_pending.empty() && det_pending.begin()->first < running_priority;
+}
+
+extern "C" void interrupts_dispatch(void)
+{
+    if (!deterministic)
+        return;
+
+    while (interrupts_enabled) {
+        int line;
+        int priority;
+        {
+            std::lock_guard<std::mutex> lock(det_mutex);
+            if (det_pending.empty())
+                break;
+            auto it = det_pending.begin();
+            // As in the NVIC, only a higher priority line preempts the running handler
+            if (it->first >= running_priority)
+                break;
+            priority = it->first;
+            line = it->second;
+            det_pending.erase(it);
+            in_flight--;
+        }
+        INTERRUPT_LOG("Dispatching %d", line);
+
+        int saved = running_priority;
+        running_priority = priority;
+        interrupts_service(line);
+        running_priority = saved;
+    }
+}
+
+extern "C" void interrupts_wait(void)
+{
+    // Keep running the clock on this thread until something is raised.
+    while (!interrupts_det_has_pending()) {
+        // Idle with nothing pending: a safe point to freeze the device
+        snapshot_cpu_idle_point();
+
+        if (simclock_cpu_skip_to_next_event())
+            continue;
+
+        // Nothing scheduled: another thread (DMA, test) will raise. Wake up
+        // periodically anyway so that the main loop can be stopped.
+        std::unique_lock<std::mutex> lock(det_mutex);
+        det_cond.wait_for(lock, std::chrono::milliseconds(10),
+                          []{ return !det_pending.empty() && det_pending.begin()->first < running_priority; });
+    }
+    interrupts_dispatch();
+}
+
+extern "C" void interrupts_set_deterministic(int enable)
+{
+    if (interrupt_thread.joinable() && (enable != 0)) {
+        HERROR(TAG, "Cannot change interrupt mode while running");
+        abort();
+    }
+    deterministic = enable != 0;
+}
+
+extern "C" int interrupts_is_deterministic(void)
+{
+    return deterministic ? 1 : 0;
+}
+
+extern "C" void interrupts_set_handler(void (*handler)(int line))
+{
+    line_handler = handler;
+}
+
+extern "C" void interrupt_set_priority(int line, int priority)
+{
+    if (line >= 0 && line < MAX_INTERRUPT_LINES)
+        priorities[line] = priority;
+}
+
 extern "C" void __disable_irq_impl()
 {
     std::unique_lock<std::recursive_mutex> lock(intmutex);
@@ -38,7 +153,9 @@ extern "C" void __enable_irq_impl()
 
     if (!old)
     {
-        if (!pending_queue.empty())
+        if (deterministic)
+            interrupts_dispatch();
+        else if (!pending_queue.empty())
             pthread_kill(pthread_self(), SIGUSR1);
     }
 
@@ -55,7 +172,9 @@ extern "C" void __set_PRIMASK_impl(int mask)
         bool old = interrupts_enabled.exchange( true );
         if (!old) {
             INTERRUPT_LOG("Re-enabling interrupts");
-            if (!pending_queue.empty())
+            if (deterministic)
+                interrupts_dispatch();
+            else if (!pending_queue.empty())
                 pthread_kill(pthread_self(), SIGUSR1);
         }
     } else {
@@ -68,10 +187,12 @@ void interrupt_signal_handler(int)
 {
     // We arrive here upon wakeup (SIGUSR1) or post-interrupt.
     INTERRUPT_LOG("CPU wakeup, int enabled=%d", interrupts_enabled?1:0);
-    if (interrupts_enabled)
+    simclock_cpu_active();
+    int line;
+    if (interrupts_enabled && pending_queue.try_dequeue(line))
     {
-        int line = pending_queue.dequeue();
-        interrupt(line);
+        interrupts_service(line);
+        in_flight--;
     }
 }
 
@@ -106,6 +227,16 @@ extern "C" void deinit_interrupts()
 extern "C" void init_interrupts()
 {
     interrupts_enabled = true;
+    in_flight = 0;
+
+    if (deterministic)
+    {
+        std::lock_guard<std::mutex> lock(det_mutex);
+        det_pending.clear();
+        running_priority = INT_MAX;
+        HLOG(TAG, "Using deterministic interrupt delivery");
+        return;
+    }
 
     hw_setup_signals(&interrupt_signal_handler);
 
@@ -118,6 +249,30 @@ extern "C" void init_interrupts()
 
 extern "C" void raise_interrupt(int line)
 {
+    if (deterministic)
+    {
+        if (line<0)
+            return;
+        std::lock_guard<std::mutex> lock(det_mutex);
+        in_flight++;
+        det_pending.insert(std::make_pair(line < MAX_INTERRUPT_LINES ? priorities[line] : 0, line));
+        det_cond.notify_all();
+        return;
+    }
+    if (line>=0)
+        in_flight++;
     interrupt_queue.enqueue(line);
 }
 
+extern "C" int interrupts_in_flight(void)
+{
+    return in_flight;
+}
+
+extern "C" int interrupt_pending(void)
+{
+    if (deterministic)
+        return interrupts_det_has_pending() ? 1 : 0;
+    return pending_queue.empty() ? 0 : 1;
+}
+
@@ -9,6 +9,17 @@ extern "C" {
 void init_interrupts(void);
 void deinit_interrupts(void);
 void raise_interrupt(int line);
+int interrupts_in_flight(void);
+int interrupt_pending(void);
+
+void interrupts_set_deterministic(int enable);
+int interrupts_is_deterministic(void);
+void interrupt_set_priority(int line, int priority);
+void interrupts_dispatch(void);
+void interrupts_wait(void);
+
+/* Services lines with handler instead of the vector table, NULL to restore it */
+void interrupts_set_handler(void (*handler)(int line));
 
 #ifdef __cplusplus
 }
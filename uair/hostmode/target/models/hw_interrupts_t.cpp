@@ -0,0 +1,112 @@
+#ifdef UNITTESTS
+
+#include <catch2/catch.hpp>
+#include <vector>
+#include "hw_interrupts.h"
+#include "hw_simclock.h"
+#include "cpu_registers.h"
+
+extern "C" {
+void HAL_NVIC_SetPriority(int irq, int preempt, int sub);
+void __disable_irq_impl();
+void __set_PRIMASK_impl(int mask);
+void __WFI();
+}
+
+#define LINE(irq) ((irq) + 16)
+
+// Entries as the IRQ number, exits as its complement
+static std::vector<int> serviced;
+static bool nest_from_rtc;
+
+static void record_line(int line)
+{
+    int irq = line - 16;
+
+    serviced.push_back(irq);
+    if (nest_from_rtc && irq == RTC_Alarm_IRQn) {
+        nest_from_rtc = false;
+        // A critical section in the handler, raised lines are serviced when it ends
+        __disable_irq_impl();
+        raise_interrupt(LINE(SUBGHZ_Radio_IRQn));
+        raise_interrupt(LINE(LPTIM1_IRQn));
+        __set_PRIMASK_impl(1);
+    }
+    serviced.push_back(~irq);
+}
+
+static void raise_rtc_then_lptim(void *)
+{
+    raise_interrupt(LINE(RTC_Alarm_IRQn));
+    raise_interrupt(LINE(LPTIM1_IRQn));
+}
+
+TEST_CASE("Deterministic interrupts are serviced by priority","[SIM][SIM/Interrupts]")
+{
+    serviced.clear();
+    nest_from_rtc = false;
+
+    interrupts_set_deterministic(1);
+    init_interrupts();
+    interrupts_set_handler(&record_line);
+
+    // As the BSP sets them: the preemption priority first, the sub-priority doesn't preempt
+    HAL_NVIC_SetPriority(RTC_Alarm_IRQn, 2, 0);
+    HAL_NVIC_SetPriority(LPTIM1_IRQn, 1, 0);
+    HAL_NVIC_SetPriority(SUBGHZ_Radio_IRQn, 2, 1);
+
+    SECTION("Raised while masked, serviced once PRIMASK is restored")
+    {
+        __disable_irq_impl();
+        raise_interrupt(LINE(RTC_Alarm_IRQn));
+        raise_interrupt(LINE(SUBGHZ_Radio_IRQn));
+        raise_interrupt(LINE(LPTIM1_IRQn));
+        CHECK( interrupts_in_flight() == 3 );
+        CHECK( serviced.empty() );
+
+        // Highest priority first, then in raise order
+        __set_PRIMASK_impl(1);
+        CHECK( serviced == std::vector<int>{ LPTIM1_IRQn, ~LPTIM1_IRQn,
+                                             RTC_Alarm_IRQn, ~RTC_Alarm_IRQn,
+                                             SUBGHZ_Radio_IRQn, ~SUBGHZ_Radio_IRQn } );
+        CHECK( interrupts_in_flight() == 0 );
+    }
+
+    SECTION("Raised while sleeping, serviced at WFI")
+    {
+        simclock_set_virtual(1);
+        simclock_init();
+        simclock_schedule_in(1000, &raise_rtc_then_lptim, NULL);
+
+        __WFI();
+        CHECK( simclock_now_us() == 1000 );
+        CHECK( serviced == std::vector<int>{ LPTIM1_IRQn, ~LPTIM1_IRQn,
+                                             RTC_Alarm_IRQn, ~RTC_Alarm_IRQn } );
+
+        simclock_deinit();
+        simclock_set_virtual(0);
+    }
+
+    SECTION("Only a higher priority preempts the running handler")
+    {
+        nest_from_rtc = true;
+        raise_interrupt(LINE(RTC_Alarm_IRQn));
+        CHECK( serviced.empty() );
+
+        interrupts_dispatch();
+        CHECK( serviced == std::vector<int>{ RTC_Alarm_IRQn,
+                                             LPTIM1_IRQn, ~LPTIM1_IRQn,
+                                             ~RTC_Alarm_IRQn,
+                                             SUBGHZ_Radio_IRQn, ~SUBGHZ_Radio_IRQn } );
+    }
+
+    HAL_NVIC_SetPriority(RTC_Alarm_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(LPTIM1_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(SUBGHZ_Radio_IRQn, 0, 0);
+
+    interrupts_set_handler(NULL);
+    deinit_interrupts();
+    interrupts_set_deterministic(0);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "hw_lptim.h"
 #include "hw_interrupts.h"
+#include "hw_simclock.h"
 #include <atomic>
 #include <cassert>
 #include <thread>
@@ -10,6 +11,9 @@ DECLARE_LOG_TAG(LPTIM)
 #define TAG "LPTIM"
 
 static unsigned int tick = 0;
+static unsigned int count_us = 0;
+static uint32_t clock_hz = 2000000; // PCLK in low-power run
+static std::atomic<simclock_event_t> lptim_event(SIMCLOCK_INVALID_EVENT);
 static std::atomic<uint16_t> counter;
 static std::atomic<uint16_t> period;
 static std::atomic<bool> lptim_int_enabled;
@@ -27,6 +31,17 @@ void lptim_engine_raise_interrupt()
     raise_interrupt(55);
 }
 
+static void lptim_underflow(void *)
+{
+    lptim_event = SIMCLOCK_INVALID_EVENT;
+    HLOG(TAG, "LPTim underflow int=%d period=%uus", lptim_int_enabled ? 1:0, period.load()*count_us);
+    // Stopped before the interrupt, its handler may start the next count
+    lptim_run = false;
+    if (lptim_int_enabled) {
+        lptim_engine_raise_interrupt();
+    }
+}
+
 void lptim_thread_runner(void)
 {
     uint32_t delta = get_speedup();
@@ -41,8 +56,8 @@ void lptim_thread_runner(void)
                 counter = period.load();
                 HLOG(TAG, "LPTim underflow int=%d period=%uus", lptim_int_enabled ? 1:0, counter.load()*tick);
                 if (lptim_int_enabled) {
-                    lptim_engine_raise_interrupt();
                     lptim_run = false; // stop.
+                    lptim_engine_raise_interrupt();
                 }
             } else {
                 if (counter>delta) {
@@ -55,9 +70,17 @@ void lptim_thread_runner(void)
     };
 };
 
+void lptim_engine_set_clock(uint32_t hz)
+{
+    clock_hz = hz;
+}
+
 void lptim_engine_init(uint32_t divider)
 {
-    tick = (divider/2) * RESOLUTION_DEGRADE;  // 2MHz
+    count_us = (uint32_t)(((uint64_t)divider * 1000000U) / clock_hz);
+    if (count_us == 0)
+        count_us = 1;
+    tick = count_us * RESOLUTION_DEGRADE;
 
     counter = 0xFFFF;
     period = 0;
@@ -65,6 +88,11 @@ void lptim_engine_init(uint32_t divider)
     lptim_run = false;
     lptim_exit = false;
 
+    if (simclock_is_virtual())
+    {
+        // Underflows are scheduled on the simulation clock
+        return;
+    }
 
     if (! lptim_thread.joinable())
     {
@@ -79,6 +107,8 @@ void lptim_engine_init(uint32_t divider)
 
 void lptim_engine_deinit(void)
 {
+    simclock_cancel(lptim_event.exchange(SIMCLOCK_INVALID_EVENT));
+
     if (lptim_thread.joinable())
     {
         lptim_run = false;
@@ -95,6 +125,16 @@ void lptim_engine_start_it(uint32_t Period)
     assert(lptim_run == false);
     lptim_int_enabled = true;
 
+    if (simclock_is_virtual()) {
+        if (Period==0)
+            Period=1;
+        period = Period;
+        counter = Period;
+        lptim_run = true;
+        lptim_event = simclock_schedule_in((simclock_time_t)Period * count_us, &lptim_underflow, NULL);
+        return;
+    }
+
     Period/=RESOLUTION_DEGRADE;
     if (Period==0)
         Period=get_speedup();
@@ -109,4 +149,5 @@ void lptim_engine_stop_it(void)
 {
     lptim_int_enabled = false;
     lptim_run = false;
+    simclock_cancel(lptim_event.exchange(SIMCLOCK_INVALID_EVENT));
 }
@@ -7,6 +7,7 @@
 extern "C" {
 #endif
 
+void lptim_engine_set_clock(uint32_t clock_hz);
 void lptim_engine_init(uint32_t divider);
 void lptim_engine_deinit(void);
 void lptim_engine_enable(void);
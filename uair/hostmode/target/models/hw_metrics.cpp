@@ -0,0 +1,327 @@
+#include "hw_metrics.h"
+#include "hw_simclock.h"
+#include "hw_snapshot.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cinttypes>
+#include <cstdlib>
+#include "hlog.h"
+
+DECLARE_LOG_TAG(METRICS)
+#define TAG "METRICS"
+
+#define METRICS_MAX_INTERRUPTS (128)
+#define METRICS_MAX_I2C_BUSES (3)
+#define METRICS_MAX_I2C_DEVICES (128)
+#define METRICS_MAX_LOG_ZONES (256)
+
+typedef std::chrono::steady_clock metrics_clock;
+
+static const char *radio_names[METRICS_RADIO_COUNT] = { "tx", "rx", "rx_timeout" };
+
+static std::atomic<uint64_t> interrupts[METRICS_MAX_INTERRUPTS];
+static std::atomic<uint64_t> i2c[METRICS_MAX_I2C_BUSES][METRICS_MAX_I2C_DEVICES];
+static std::atomic<uint64_t> radio[METRICS_RADIO_COUNT];
+static std::atomic<uint64_t> radio_airtime_us;
+
+// Open addressing on the zone pointer (zones are string literals). Lock-free,
+// since logging happens in interrupt handlers, which may be signal handlers.
+static std::atomic<const char*> log_zones[METRICS_MAX_LOG_ZONES];
+static std::atomic<uint64_t> log_lines[METRICS_MAX_LOG_ZONES];
+
+// Simulated and wall time accumulated over all clock runs
+static std::mutex clock_mutex;
+static bool clock_running = false;
+static metrics_clock::time_point clock_wall_start;
+static uint64_t total_sim_us = 0;
+static uint64_t total_wall_us = 0;
+
+static std::string summary_file;
+
+static std::string live_file;
+static unsigned live_period_ms = 0;
+static std::thread live_thread;
+static std::mutex live_mutex;
+static std::condition_variable live_cond;
+static bool live_exit = false;
+static bool live_append = false;
+
+struct metrics_totals
+{
+    uint64_t sim_us;
+    uint64_t wall_us;
+    uint64_t interrupts;
+    uint64_t i2c;
+    uint64_t radio;
+    uint64_t log;
+};
+
+void metrics_interrupt(int line)
+{
+    if (line >= 0 && line < METRICS_MAX_INTERRUPTS)
+        interrupts[line].fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics_i2c(unsigned bus, uint16_t address)
+{
+    if (bus >= 1 && bus <= METRICS_MAX_I2C_BUSES)
+        i2c[bus-1][(address>>1) & 0x7F].fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics_radio(metrics_radio_t event, uint32_t airtime_us)
+{
+    radio[event].fetch_add(1, std::memory_order_relaxed);
+    radio_airtime_us.fetch_add(airtime_us, std::memory_order_relaxed);
+}
+
+void metrics_log(const char *zone)
+{
+    unsigned slot = (reinterpret_cast<uintptr_t>(zone) >> 3) % METRICS_MAX_LOG_ZONES;
+
+    for (unsigned i=0; i<METRICS_MAX_LOG_ZONES; i++) {
+        const char *z = log_zones[slot].load(std::memory_order_acquire);
+
+        if ((z == nullptr) && log_zones[slot].compare_exchange_strong(z, zone))
+            z = zone;
+
+        if (z == zone) {
+            log_lines[slot].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        slot = (slot + 1) % METRICS_MAX_LOG_ZONES;
+    }
+}
+
+void metrics_clock_start(void)
+{
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    clock_running = true;
+    clock_wall_start = metrics_clock::now();
+}
+
+void metrics_clock_stop(void)
+{
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    if (!clock_running)
+        return;
+    clock_running = false;
+    total_sim_us += simclock_now_us();
+    total_wall_us += std::chrono::duration_cast<std::chrono::microseconds>(metrics_clock::now() - clock_wall_start).count();
+}
+
+static void metrics_get_time(uint64_t &sim_us, uint64_t &wall_us)
+{
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    sim_us = total_sim_us;
+    wall_us = total_wall_us;
+    if (clock_running) {
+        sim_us += simclock_now_us();
+        wall_us += std::chrono::duration_cast<std::chrono::microseconds>(metrics_clock::now() - clock_wall_start).count();
+    }
+}
+
+static double ratio(uint64_t num, uint64_t den)
+{
+    return den ? (double)num / (double)den : 0.0;
+}
+
+/* Writes all counters as one JSON object, on a single line */
+static metrics_totals metrics_write(FILE *f, const metrics_totals *previous)
+{
+    metrics_totals t = {};
+    const char *sep;
+
+    metrics_get_time(t.sim_us, t.wall_us);
+
+    fprintf(f, "{\"wall_s\":%.3f,\"sim_s\":%.3f,\"sim_per_wall\":%.2f",
+            t.wall_us / 1e6, t.sim_us / 1e6, ratio(t.sim_us, t.wall_us));
+
+    fprintf(f, ",\"interrupts\":{");
+    sep = "";
+    for (int i=0; i<METRICS_MAX_INTERRUPTS; i++) {
+        uint64_t v = interrupts[i];
+        if (v) {
+            fprintf(f, "%s\"%d\":%" PRIu64, sep, i, v);
+            sep = ",";
+            t.interrupts += v;
+        }
+    }
+
+    fprintf(f, "},\"i2c\":{");
+    sep = "";
+    for (int b=0; b<METRICS_MAX_I2C_BUSES; b++) {
+        for (int d=0; d<METRICS_MAX_I2C_DEVICES; d++) {
+            uint64_t v = i2c[b][d];
+            if (v) {
+                fprintf(f, "%s\"I2C%d/0x%02x\":%" PRIu64, sep, b+1, d, v);
+                sep = ",";
+                t.i2c += v;
+            }
+        }
+    }
+
+    fprintf(f, "},\"radio\":{");
+    for (int i=0; i<METRICS_RADIO_COUNT; i++) {
+        uint64_t v = radio[i];
+        fprintf(f, "\"%s\":%" PRIu64 ",", radio_names[i], v);
+        t.radio += v;
+    }
+    fprintf(f, "\"airtime_s\":%.3f}", radio_airtime_us / 1e6);
+
+    // Several sources may use the same zone name
+    std::map<std::string, uint64_t> zones;
+    for (int i=0; i<METRICS_MAX_LOG_ZONES; i++) {
+        const char *z = log_zones[i];
+        if (z)
+            zones[z] += log_lines[i];
+    }
+    fprintf(f, ",\"log\":{");
+    sep = "";
+    for (auto &z: zones) {
+        fprintf(f, "%s\"%s\":%" PRIu64, sep, z.first.c_str(), z.second);
+        sep = ",";
+        t.log += z.second;
+    }
+    fprintf(f, "}");
+
+    // Rates over the last period, for the live stream
+    if (previous) {
+        uint64_t wall = t.wall_us - previous->wall_us;
+        fprintf(f, ",\"rates\":{\"sim_per_wall\":%.2f,\"interrupts\":%.1f,\"i2c\":%.1f,\"radio\":%.1f,\"log\":%.1f}",
+                ratio(t.sim_us - previous->sim_us, wall),
+                ratio(t.interrupts - previous->interrupts, wall) * 1e6,
+                ratio(t.i2c - previous->i2c, wall) * 1e6,
+                ratio(t.radio - previous->radio, wall) * 1e6,
+                ratio(t.log - previous->log, wall) * 1e6);
+    }
+
+    fprintf(f, "}\n");
+    fflush(f);
+
+    return t;
+}
+
+void metrics_write_json(FILE *f)
+{
+    metrics_write(f, NULL);
+}
+
+void metrics_reset(void)
+{
+    for (auto &v: interrupts)
+        v = 0;
+    for (auto &bus: i2c)
+        for (auto &v: bus)
+            v = 0;
+    for (auto &v: radio)
+        v = 0;
+    radio_airtime_us = 0;
+    for (auto &v: log_lines)
+        v = 0;
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        total_sim_us = 0;
+        total_wall_us = 0;
+    }
+}
+
+static FILE *metrics_open(const std::string &filename, FILE *standard, const char *mode)
+{
+    if (filename == "-")
+        return standard;
+
+    FILE *f = fopen(filename.c_str(), mode);
+    if (NULL == f)
+        HERROR(TAG, "Cannot open %s", filename.c_str());
+    return f;
+}
+
+static void metrics_live_runner()
+{
+    // Restarted in snapshot copies, which append to the same stream
+    FILE *f = metrics_open(live_file, stderr, live_append ? "a" : "w");
+    if (NULL == f)
+        return;
+    live_append = true;
+
+    metrics_totals last = metrics_write(f, NULL);
+
+    std::unique_lock<std::mutex> lock(live_mutex);
+    while (!live_cond.wait_for(lock, std::chrono::milliseconds(live_period_ms), []{ return live_exit; })) {
+        lock.unlock();
+        last = metrics_write(f, &last);
+        lock.lock();
+    }
+
+    if (f != stderr)
+        fclose(f);
+}
+
+static int metrics_live_stop(void)
+{
+    if (!live_thread.joinable())
+        return 0;
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        live_exit = true;
+        live_cond.notify_all();
+    }
+    live_thread.join();
+    return 1;
+}
+
+static void metrics_live_start(void)
+{
+    live_exit = false;
+    live_thread = std::thread(metrics_live_runner);
+}
+
+static void metrics_at_exit(void)
+{
+    metrics_live_stop();
+
+    if (summary_file.empty())
+        return;
+
+    FILE *f = metrics_open(summary_file, stdout, "w");
+    if (NULL == f)
+        return;
+
+    metrics_write_json(f);
+
+    if (f != stdout)
+        fclose(f);
+}
+
+static void metrics_register_exit(void)
+{
+    static bool registered = false;
+    if (!registered) {
+        atexit(&metrics_at_exit);
+        registered = true;
+    }
+}
+
+void metrics_enable_summary(const char *filename)
+{
+    summary_file = filename;
+    metrics_register_exit();
+}
+
+void metrics_enable_live(const char *filename, unsigned period_ms)
+{
+    metrics_live_stop();
+
+    live_file = filename;
+    live_append = false;
+    live_period_ms = period_ms ? period_ms : 1000;
+
+    metrics_live_start();
+    snapshot_register_thread(&metrics_live_stop, &metrics_live_start);
+    metrics_register_exit();
+}
@@ -0,0 +1,50 @@
+#ifndef HW_METRICS_H__
+#define HW_METRICS_H__
+
+#include <inttypes.h>
+#include <stdio.h>
+
+/*
+ * Simulator metrics.
+ *
+ * Cheap counters bumped by the models: interrupts per line, I2C
+ * transactions per device, radio frames and log lines per zone, plus how
+ * much simulated time runs per wall-clock second. Written as a JSON summary
+ * at exit, and optionally streamed (one JSON object per line) while running,
+ * to see which model is the bottleneck in a slow soak test.
+ */
+
+typedef enum {
+    METRICS_RADIO_TX,
+    METRICS_RADIO_RX,
+    METRICS_RADIO_RX_TIMEOUT,
+    METRICS_RADIO_COUNT
+} metrics_radio_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Counters, callable from any thread (and from signal handlers) */
+void metrics_interrupt(int line);
+void metrics_i2c(unsigned bus, uint16_t address);
+void metrics_radio(metrics_radio_t event, uint32_t airtime_us);
+void metrics_log(const char *zone);
+
+/* Simulation clock runs, for the sim-time/real-time ratio */
+void metrics_clock_start(void);
+void metrics_clock_stop(void);
+
+/* Summary written at exit. "-" is stdout. */
+void metrics_enable_summary(const char *filename);
+/* Live stream, one line per period. "-" is stderr. */
+void metrics_enable_live(const char *filename, unsigned period_ms);
+
+void metrics_write_json(FILE *f);
+void metrics_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
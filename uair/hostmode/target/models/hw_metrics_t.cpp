@@ -0,0 +1,48 @@
+#ifdef UNITTESTS
+
+#include <catch2/catch.hpp>
+#include "hw_metrics.h"
+#include "hw_simclock.h"
+#include <cstdlib>
+#include <cstring>
+
+static void metrics_test_event(void *user)
+{
+    *static_cast<int*>(user) += 1;
+}
+
+static double metrics_test_field(const char *json, const char *name)
+{
+    const char *p = strstr(json, name);
+    REQUIRE( p != NULL );
+    return strtod(p + strlen(name), NULL);
+}
+
+TEST_CASE("Metrics account for simulated time","[SIM][SIM/Metrics]")
+{
+    int fired = 0;
+    char *json = NULL;
+    size_t json_size = 0;
+
+    metrics_reset();
+    simclock_set_virtual(1);
+    simclock_init();
+
+    simclock_schedule_in(5000000, &metrics_test_event, &fired);
+    REQUIRE( simclock_cpu_skip_to_next_event() == 1 );
+    CHECK( fired == 1 );
+
+    FILE *f = open_memstream(&json, &json_size);
+    REQUIRE( f != NULL );
+    metrics_write_json(f);
+    fclose(f);
+
+    simclock_deinit();
+    simclock_set_virtual(0);
+
+    CHECK( metrics_test_field(json, "\"sim_s\":") >= 5.0 );
+    CHECK( metrics_test_field(json, "\"wall_s\":") >= 0.0 );
+    free(json);
+}
+
+#endif
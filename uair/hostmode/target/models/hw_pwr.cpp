@@ -0,0 +1,82 @@
+#include "hw_pwr.h"
+#include "hw_simclock.h"
+#include <mutex>
+#include "hlog.h"
+
+DECLARE_LOG_TAG(PWR)
+#define TAG "PWR"
+
+// Time accounting for each power mode, in simulated time
+
+static const char *mode_names[PWR_MODE_COUNT] = { "RUN", "SLEEP", "STOP0", "STOP1", "STOP2" };
+
+static std::mutex pwr_mutex;
+static simclock_time_t mode_time[PWR_MODE_COUNT];
+static uint32_t mode_entries[PWR_MODE_COUNT];
+static simclock_time_t stats_start = 0;
+static simclock_time_t lpm_start = 0;
+static pwr_mode_t current_mode = PWR_MODE_RUN;
+
+void pwr_engine_enter_lpm(pwr_mode_t mode)
+{
+    {
+        std::lock_guard<std::mutex> lock(pwr_mutex);
+        current_mode = mode;
+        lpm_start = simclock_now_us();
+        mode_entries[mode]++;
+    }
+
+    // Idle-skip: nothing can happen until the next wakeup, so go there now.
+    simclock_cpu_skip_to_next_event();
+}
+
+void pwr_engine_exit_lpm(void)
+{
+    std::lock_guard<std::mutex> lock(pwr_mutex);
+
+    mode_time[current_mode] += simclock_now_us() - lpm_start;
+    current_mode = PWR_MODE_RUN;
+}
+
+uint64_t pwr_engine_get_time_us(pwr_mode_t mode)
+{
+    std::lock_guard<std::mutex> lock(pwr_mutex);
+
+    if (mode != PWR_MODE_RUN)
+        return mode_time[mode];
+
+    // Run time is whatever was not spent in low power
+    simclock_time_t total = simclock_now_us() - stats_start;
+    for (int i=PWR_MODE_SLEEP; i<PWR_MODE_COUNT; i++) {
+        total -= mode_time[i];
+    }
+    return total;
+}
+
+uint32_t pwr_engine_get_entries(pwr_mode_t mode)
+{
+    std::lock_guard<std::mutex> lock(pwr_mutex);
+    return mode_entries[mode];
+}
+
+void pwr_engine_reset_stats(void)
+{
+    std::lock_guard<std::mutex> lock(pwr_mutex);
+
+    for (int i=0; i<PWR_MODE_COUNT; i++) {
+        mode_time[i] = 0;
+        mode_entries[i] = 0;
+    }
+    stats_start = simclock_now_us();
+}
+
+void pwr_engine_dump_stats(void)
+{
+    for (int i=0; i<PWR_MODE_COUNT; i++) {
+        pwr_mode_t mode = (pwr_mode_t)i;
+        do_log(TAG, LEVEL_PROGRESS, "", "", __LINE__, "%-5s: %10" PRIu64 " ms, %u entries",
+               mode_names[i],
+               pwr_engine_get_time_us(mode) / 1000,
+               pwr_engine_get_entries(mode));
+    }
+}
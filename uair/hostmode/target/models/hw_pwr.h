@@ -0,0 +1,31 @@
+#ifndef HW_PWR_H__
+#define HW_PWR_H__
+
+#include <inttypes.h>
+
+typedef enum {
+    PWR_MODE_RUN,
+    PWR_MODE_SLEEP,
+    PWR_MODE_STOP0,
+    PWR_MODE_STOP1,
+    PWR_MODE_STOP2,
+    PWR_MODE_COUNT
+} pwr_mode_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void pwr_engine_enter_lpm(pwr_mode_t mode);
+void pwr_engine_exit_lpm(void);
+
+uint64_t pwr_engine_get_time_us(pwr_mode_t mode);
+uint32_t pwr_engine_get_entries(pwr_mode_t mode);
+void pwr_engine_reset_stats(void);
+void pwr_engine_dump_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
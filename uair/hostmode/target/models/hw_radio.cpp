@@ -2,10 +2,13 @@
 #include <stdlib.h>
 #include "hlog.h"
 #include "utilities.h"
-#include "cqueue.hpp"
-#include <thread>
-#include <vector>
+#include "cring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
 #include "hw_interrupts.h"
+#include "hw_simclock.h"
+#include "hw_metrics.h"
 #include "stm32wlxx_hal_subghz.h"
 #include <unistd.h>
 #include "cmac.h"
@@ -15,12 +18,10 @@ DECLARE_LOG_TAG(RADIO)
 #define TAG "RADIO"
 
 // Radio buffer seems to be... global.
-uint8_t radiobuffer[128];
+uint8_t radiobuffer[PAYLOAD_MAX_SIZE];
 
 extern "C" float get_speedup();
 
-static std::thread radio_processing_thread;
-
 const RadioLoRaBandwidths_t Bandwidths[] = { LORA_BW_125, LORA_BW_250, LORA_BW_500 };
 
 
@@ -35,6 +36,7 @@ typedef struct
     uint32_t datarate;
     uint8_t coderate;
     uint16_t preambleLen;
+    uint16_t symbTimeout;
     bool fixLen;
     bool crcOn;
     bool freqHopOn;
@@ -46,17 +48,6 @@ typedef struct
 
 static hwradio_t hwradio;
 
-struct radio_request_t
-{
-    enum {
-        RADIO_EXIT,
-        RADIO_TX,
-        RADIO_RX
-    } cmd;
-    uint32_t rxtimeout{0};
-    std::vector<uint8_t> txdata;
-} ;
-
 struct radio_response_t
 {
     enum {
@@ -64,19 +55,65 @@ struct radio_response_t
         RX_TIMEOUT,
         RX_COMPLETE
     } resp;
-    std::vector<uint8_t> rxdata;
-    int16_t rssi{0};
-    int8_t snr{0};
+    DownlinkPayload *downlink{nullptr};
 };
 
-static CQueue<radio_request_t> hw_radio_requests;
-static CQueue<radio_response_t> hw_radio_rx_queue;
+static CRingMPSC<radio_response_t, 16> hw_radio_responses;
 
-static CQueue<radio_response_t> hw_radio_responses;
+// Operation in progress. The radio does one thing at a time.
+// Whoever clears hw_radio_busy (completion or deinit) owns the payload.
+static std::atomic<bool> hw_radio_busy(false);
+static simclock_event_t hw_radio_pending_event = SIMCLOCK_INVALID_EVENT;
+static std::atomic<UplinkPayload*> hw_radio_pending_tx(nullptr);
+static std::atomic<DownlinkPayload*> hw_radio_pending_rx(nullptr);
 
+static uint32_t RadioGetLoRaBandwidthInHz( RadioLoRaBandwidths_t bw );
 
+static void hw_radio_complete(const radio_response_t &r)
+{
+    hw_radio_responses.enqueue(r);
+
+    raise_interrupt(66);
+}
 
-static void hw_radio_do_tx(const std::vector<uint8_t> &data)
+/* The frame reaches the network when the transmission ends */
+static void hw_radio_tx_done(void *)
+{
+    if (!hw_radio_busy.exchange(false))
+        return;
+
+    UplinkPayload *payload = hw_radio_pending_tx.exchange(nullptr);
+
+    metrics_radio(METRICS_RADIO_TX, payload->airtime() * 1000);
+
+    Network::Uplink( payload );
+
+    delete(payload);
+
+    radio_response_t r;
+    r.resp = radio_response_t::TX_COMPLETE;
+
+    hw_radio_complete(r);
+}
+
+static void hw_radio_rx_done(void *)
+{
+    radio_response_t r;
+
+    if (!hw_radio_busy.exchange(false))
+        return;
+
+    r.downlink = hw_radio_pending_rx.exchange(nullptr);
+    r.resp = (nullptr == r.downlink) ? radio_response_t::RX_TIMEOUT : radio_response_t::RX_COMPLETE;
+
+    HWARN(TAG,"Downlink completed, resp=%d", r.resp);
+
+    metrics_radio( (nullptr == r.downlink) ? METRICS_RADIO_RX_TIMEOUT : METRICS_RADIO_RX, 0 );
+
+    hw_radio_complete(r);
+}
+
+static void hw_radio_do_tx(const uint8_t *data, uint8_t size)
 {
     char frame[512];
 
@@ -86,99 +123,116 @@ static void hw_radio_do_tx(const std::vector<uint8_t> &data)
                                          hwradio.coderate,
                                          hwradio.preambleLen,
                                          hwradio.fixLen,
-                                         data.size(),
+                                         size,
                                          hwradio.crcOn );
 
 
     HLOG(TAG, "TX time on air: %u us", time*1000);
 
-    UplinkPayload *payload = new UplinkPayload(data, time);
+    UplinkPayload *payload = new UplinkPayload(data, size, time, hwradio.freq, hwradio.datarate);
 
     payload->print(frame, sizeof(frame));
 
     HWARN(TAG,"Transmitting frame: (%d) [%s]", payload->size(), frame);
 
-    usleep((time * 1000) / get_speedup() );
-
-    Network::Uplink( payload );
+    // Completion is an event on the simulation clock, in realtime and virtual time alike
+    hw_radio_pending_tx = payload;
+    hw_radio_busy = true;
+    hw_radio_pending_event = simclock_schedule_in( (simclock_time_t)time * 1000, &hw_radio_tx_done, NULL );
+}
 
-    radio_response_t r;
-    r.resp = radio_response_t::TX_COMPLETE;
+/* Without a preamble, the radio gives up after symbTimeout symbols */
+static simclock_time_t hw_radio_rx_window_us(uint32_t timeout)
+{
+    if ((hwradio.modem == MODEM_LORA) && (hwradio.symbTimeout > 0) &&
+        (hwradio.bandwidth < sizeof(Bandwidths)/sizeof(Bandwidths[0]))) {
+        uint32_t bw = RadioGetLoRaBandwidthInHz( Bandwidths[hwradio.bandwidth] );
+        return DIVC( ((simclock_time_t)hwradio.symbTimeout << hwradio.datarate) * 1000000ULL, bw );
+    }
+    return (simclock_time_t)timeout * 1000;
+}
 
-    hw_radio_responses.enqueue(r);
+static simclock_time_t hw_radio_rx_airtime_us(DownlinkPayload *downlink)
+{
+    return (simclock_time_t)hw_radio_time_on_air( hwradio.modem,
+                                                 hwradio.bandwidth,
+                                                 hwradio.datarate,
+                                                 hwradio.coderate,
+                                                 hwradio.preambleLen,
+                                                 hwradio.fixLen,
+                                                 downlink->size(),
+                                                 hwradio.crcOn ) * 1000;
+}
 
+// Realtime: a remote network may answer after the window opened, so keep
+// looking for a downlink until the RX timeout, as the radio thread used to.
+#define HW_RADIO_RX_POLL_US 1000
 
-    raise_interrupt(66);
-}
+static simclock_time_t hw_radio_rx_deadline_us = 0;
 
-static void hw_radio_do_rx(uint32_t timeout)
+static void hw_radio_rx_poll(void *)
 {
-    DownlinkPayload *downlink = Network::Downlink( timeout, get_speedup() );
+    if (!hw_radio_busy)
+        return;
 
-    radio_response_t r;
+    DownlinkPayload *downlink = Network::Downlink( 0, get_speedup() );
+    simclock_time_t now = simclock_now_us();
 
-    if (nullptr==downlink) {
-        r.resp = radio_response_t::RX_TIMEOUT;
+    if (nullptr != downlink) {
+        hw_radio_pending_rx = downlink;
+        hw_radio_pending_event = simclock_schedule_in( hw_radio_rx_airtime_us(downlink), &hw_radio_rx_done, NULL );
+    } else if (now >= hw_radio_rx_deadline_us) {
+        hw_radio_rx_done(NULL);
     } else {
-        r.resp = radio_response_t::RX_COMPLETE;
-        r.rxdata = downlink->data();
-        r.rssi = downlink->rssi();
-        r.snr = downlink->snr();
-
-        delete(downlink);
+        hw_radio_pending_event = simclock_schedule_in( std::min<simclock_time_t>(HW_RADIO_RX_POLL_US, hw_radio_rx_deadline_us - now),
+                                                       &hw_radio_rx_poll, NULL );
     }
-    HWARN(TAG,"Downlink completed, resp=%d", r.resp);
-
-    hw_radio_responses.enqueue(r);
-
-    raise_interrupt(66);
 }
 
-void hw_radio_thread_runner()
+static void hw_radio_do_rx(uint32_t timeout)
 {
-    radio_request_t r;
-    do {
-        r = hw_radio_requests.dequeue();
-        switch (r.cmd) {
-        case radio_request_t::RADIO_EXIT:
+    // In virtual time the network answered when the uplink ended, so any downlink is queued when the window opens
+    DownlinkPayload *downlink = Network::Downlink( 0, get_speedup() );
+
+    simclock_time_t duration;
+
+    if (nullptr==downlink) {
+        if (!simclock_is_virtual()) {
+            hw_radio_rx_deadline_us = simclock_now_us() + (simclock_time_t)timeout * 1000;
+            hw_radio_busy = true;
+            hw_radio_pending_event = simclock_schedule_in( HW_RADIO_RX_POLL_US, &hw_radio_rx_poll, NULL );
             return;
-        case radio_request_t::RADIO_TX:
-            hw_radio_do_tx(r.txdata);
-            break;
-        case radio_request_t::RADIO_RX:
-            hw_radio_do_rx(r.rxtimeout);
-            break;
-        default:
-            break;
         }
+        duration = hw_radio_rx_window_us(timeout);
+    } else {
+        duration = hw_radio_rx_airtime_us(downlink);
+    }
+
+    HLOG(TAG, "RX window %" PRIu64 " us to %" PRIu64 " us", simclock_now_us(), simclock_now_us() + duration);
 
-    } while (1);
+    hw_radio_pending_rx = downlink;
+    hw_radio_busy = true;
+    hw_radio_pending_event = simclock_schedule_in( duration, &hw_radio_rx_done, NULL );
 }
 
 void hw_radio_init( RadioEvents_t *events )
 {
     HLOG(TAG, "Called");
     hwradio.events = events;
-    if (!radio_processing_thread.joinable())
-    {
-        radio_processing_thread = std::thread(hw_radio_thread_runner);
-    }
 }
 
 void hw_radio_deinit()
 {
-    if (radio_processing_thread.joinable())
-    {
-        radio_request_t r;
-        r.cmd = radio_request_t::RADIO_EXIT;
-        r.rxtimeout = 0;
-        hw_radio_requests.enqueue(r);
+    radio_response_t r;
 
-        radio_processing_thread.join();
+    // Drop the operation in progress, and anything not yet delivered
+    if (hw_radio_busy.exchange(false)) {
+        simclock_cancel(hw_radio_pending_event);
+        delete(hw_radio_pending_tx.exchange(nullptr));
+        delete(hw_radio_pending_rx.exchange(nullptr));
     }
-    else
-    {
-        HWARN(TAG, "HW radio not running!");
+    while (hw_radio_responses.try_dequeue(r)) {
+        delete(r.downlink);
     }
 }
 
@@ -228,7 +282,7 @@ void  hw_radio_set_rx_config( RadioModems_t modem, uint32_t bandwidth,
     hwradio.freqHopOn = freqHopOn;
     hwradio.hopPeriod = hopPeriod;
     hwradio.iqInverted = iqInverted;
-    hwradio.timeout = symbTimeout; // TBD
+    hwradio.symbTimeout = symbTimeout;
     HLOG(TAG, "Called");
 }
 
@@ -429,10 +483,7 @@ uint32_t hw_radio_time_on_air( RadioModems_t modem, uint32_t bandwidth,
 
 void hw_radio_send ( uint8_t *buffer, uint8_t size )
 {
-    radio_request_t r;
-    r.cmd = radio_request_t::RADIO_TX;
-    r.txdata = std::vector<uint8_t>(buffer, buffer+size);
-    hw_radio_requests.enqueue(r);
+    hw_radio_do_tx(buffer, size);
     HLOG(TAG, "Called");
 }
 
@@ -448,10 +499,7 @@ void hw_radio_standby ( void )
 }
 void hw_radio_rx ( uint32_t timeout )
 {
-    radio_request_t r;
-    r.cmd = radio_request_t::RADIO_RX;
-    r.rxtimeout = timeout;
-    hw_radio_requests.enqueue(r);
+    hw_radio_do_rx(timeout);
     HLOG(TAG, "Called");
 }
 void hw_radio_start_cad ( void )
@@ -562,10 +610,11 @@ void HAL_SUBGHZ_IRQHandler(SUBGHZ_HandleTypeDef *)
         hwradio.events->TxDone();
         break;
     case radio_response_t::RX_COMPLETE:
-        Network::sprint_buffer(temp, r.rxdata.data(), r.rxdata.size());
+        Network::sprint_buffer(temp, r.downlink->data(), r.downlink->size());
         HWARN(TAG, "RxDone : [%s]", temp);
-        memcpy(radiobuffer, r.rxdata.data(), r.rxdata.size());
-        hwradio.events->RxDone( radiobuffer, r.rxdata.size(), r.rssi, r.snr);
+        memcpy(radiobuffer, r.downlink->data(), r.downlink->size());
+        hwradio.events->RxDone( radiobuffer, r.downlink->size(), r.downlink->rssi(), r.downlink->snr());
+        delete(r.downlink);
         break;
     case radio_response_t::RX_TIMEOUT:
         hwradio.events->RxTimeout();
@@ -1,9 +1,14 @@
 #include "system_linux.h"
 #include "hw_rtc.h"
 #include "hw_interrupts.h"
+#include "hw_simclock.h"
 #include "cqueue.hpp"
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
 #include <sys/signal.h>
 #include <unistd.h>
 #include <inttypes.h>
@@ -25,12 +30,90 @@ static volatile bool rtc_exit = false;
 static std::thread rtc_thread;
 static std::thread progress_thread;
 static CSignal<uint32_t, uint32_t> timerupdated;
+static bool rtc_initialized = false;
+
+// Virtual mode: counter is derived from the simulation clock
+static simclock_time_t rtc_base_us = 0;
+static std::atomic<simclock_event_t> alarma_event(SIMCLOCK_INVALID_EVENT);
+
+#define RTC_TICKS_PER_SECOND (1024ULL)
+
+static inline uint64_t rtc_us_to_ticks(simclock_time_t us)
+{
+    return (us * RTC_TICKS_PER_SECOND) / 1000000ULL;
+}
+
+static inline simclock_time_t rtc_ticks_to_us(uint64_t ticks)
+{
+    return ((ticks * 1000000ULL) + RTC_TICKS_PER_SECOND - 1) / RTC_TICKS_PER_SECOND;
+}
 
 CSignal<uint32_t, uint32_t> &rtc_timer_signal()
 {
     return timerupdated;
 }
 
+// Deadline subscribers, kept in a min-heap so that a tick advance only
+// costs a compare unless some deadline actually expired.
+
+struct rtc_deadline
+{
+    uint64_t ticks;
+    rtc_deadline_t id;
+    std::function<void(void)> callback;
+
+    bool operator>(const rtc_deadline &o) const
+    {
+        return (ticks > o.ticks) || ((ticks == o.ticks) && (id > o.id));
+    }
+};
+
+static std::mutex deadline_mutex;
+static std::priority_queue<rtc_deadline, std::vector<rtc_deadline>, std::greater<rtc_deadline> > deadlines;
+// Cancelled entries are dropped lazily from the heap. In virtual mode each deadline
+// also holds a clock event, so the clock doesn't stop at cancelled deadlines.
+static std::unordered_map<rtc_deadline_t, simclock_event_t> pending_deadlines;
+static rtc_deadline_t next_deadline_id = 1;
+static std::atomic<uint64_t> next_deadline_ticks(UINT64_MAX);
+
+static void rtc_deadlines_expire(uint64_t now_ticks)
+{
+    if (now_ticks < next_deadline_ticks)
+        return;
+
+    std::vector< std::function<void(void)> > expired;
+    std::vector<simclock_event_t> events;
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex);
+
+        while (!deadlines.empty() && deadlines.top().ticks <= now_ticks) {
+            const rtc_deadline &d = deadlines.top();
+            auto it = pending_deadlines.find(d.id);
+            if (it != pending_deadlines.end()) {
+                expired.push_back(d.callback);
+                events.push_back(it->second);
+                pending_deadlines.erase(it);
+            }
+            deadlines.pop();
+        }
+        next_deadline_ticks = deadlines.empty() ? UINT64_MAX : deadlines.top().ticks;
+    }
+
+    // Expired before the clock got there, e.g. set in the past
+    for (auto event: events) {
+        simclock_cancel(event);
+    }
+
+    for (auto &f: expired) {
+        f();
+    }
+}
+
+static void rtc_deadline_event(void *)
+{
+    // Nothing to do: reaching this time already expired the deadline
+}
+
 
 extern "C" float get_speedup();
 
@@ -44,11 +127,17 @@ uint32_t rtc_engine_get_ticks()
     return 0xFFFFFFFFF-counter;
 }
 
+static void rtc_engine_schedule_alarma();
+
 void rtc_engine_enable()
 {
     counter = 0xFFFFFFFF;
     alarma_enabled = false;
     rtc_run = true;
+    if (simclock_is_virtual()) {
+        rtc_base_us = simclock_now_us();
+        rtc_engine_schedule_alarma();
+    }
 }
 
 void rtc_engine_raise_alarma()
@@ -56,6 +145,47 @@ void rtc_engine_raise_alarma()
     raise_interrupt(58);
 }
 
+static void rtc_alarma_expired(void *)
+{
+    alarma_event = SIMCLOCK_INVALID_EVENT;
+    rtc_engine_raise_alarma();
+}
+
+static void rtc_engine_schedule_alarma()
+{
+    simclock_cancel(alarma_event.exchange(SIMCLOCK_INVALID_EVENT));
+
+    if (!alarma_enabled)
+        return;
+
+    uint64_t target = 0xFFFFFFFFULL - alarma;
+    uint64_t now = 0xFFFFFFFFULL - counter;
+
+    // Same as the threaded engine: an alarm in the past never matches
+    if (target < now)
+        return;
+
+    alarma_event = simclock_schedule_at(rtc_base_us + rtc_ticks_to_us(target), &rtc_alarma_expired, NULL);
+}
+
+static void rtc_clock_advanced(void *, simclock_time_t old_time, simclock_time_t new_time)
+{
+    uint64_t old_ticks = rtc_us_to_ticks(old_time - rtc_base_us);
+    uint64_t new_ticks = rtc_us_to_ticks(new_time - rtc_base_us);
+
+    if (new_ticks > 0xFFFFFFFFULL) {
+        // Trigger ssr
+        abort();
+    }
+
+    counter = 0xFFFFFFFF - new_ticks;
+
+    if (rtc_run && (new_ticks != old_ticks)) {
+        timerupdated.emit(old_ticks, new_ticks);
+        rtc_deadlines_expire(new_ticks);
+    }
+}
+
 
 uint32_t rtc_engine_get_second_counter()
 {
@@ -101,6 +231,7 @@ void rtc_thread_runner(void)
             }
 
             timerupdated.emit(0xFFFFFFFF-old, 0xFFFFFFFF-counter);
+            rtc_deadlines_expire(0xFFFFFFFF-counter);
 
             if (old==0) {
                 // Trigger ssr
@@ -116,7 +247,7 @@ void rtc_thread_runner(void)
 
 void rtc_engine_init()
 {
-    if (rtc_thread.joinable())
+    if (rtc_initialized)
     {
         HERROR(TAG, "RTC engine already started!");
         abort();
@@ -127,8 +258,25 @@ void rtc_engine_init()
     alarma_enabled = false;
     rtc_run = true;
     rtc_exit = false;
+    rtc_base_us = 0;
+    alarma_event = SIMCLOCK_INVALID_EVENT;
+
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex);
+        deadlines = decltype(deadlines)();
+        pending_deadlines.clear();
+        next_deadline_ticks = UINT64_MAX;
+    }
 
-    rtc_thread = std::thread(rtc_thread_runner);
+    // The RTC is the root clock of the simulation
+    simclock_init();
+
+    if (simclock_is_virtual()) {
+        simclock_add_listener(&rtc_clock_advanced, NULL);
+    } else {
+        rtc_thread = std::thread(rtc_thread_runner);
+    }
+    rtc_initialized = true;
 }
 
 void rtc_engine_set_alarm_a(uint32_t s_counter)
@@ -139,24 +287,58 @@ void rtc_engine_set_alarm_a(uint32_t s_counter)
            counter.load() - s_counter);
 #endif
     alarma_enabled = true;
+
+    if (simclock_is_virtual())
+        rtc_engine_schedule_alarma();
 }
 
 void rtc_engine_set_alarm_a_enable(int enabled)
 {
     alarma_enabled = enabled==0?false:true;
+
+    if (simclock_is_virtual())
+        rtc_engine_schedule_alarma();
+}
+
+static void rtc_deadlines_clear()
+{
+    std::vector<simclock_event_t> events;
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex);
+
+        for (auto &p: pending_deadlines)
+            events.push_back(p.second);
+        deadlines = decltype(deadlines)();
+        pending_deadlines.clear();
+        next_deadline_ticks = UINT64_MAX;
+    }
+
+    for (auto event: events)
+        simclock_cancel(event);
 }
 
 void rtc_engine_deinit()
 {
-    if (rtc_thread.joinable())
+    if (rtc_initialized)
     {
         rtc_exit = true;
-        rtc_thread.join();
 
+        if (rtc_thread.joinable())
+        {
+            rtc_thread.join();
+        }
         if (progress_thread.joinable())
         {
             progress_thread.join();
         }
+        if (simclock_is_virtual())
+        {
+            simclock_remove_listener(&rtc_clock_advanced, NULL);
+        }
+        simclock_cancel(alarma_event.exchange(SIMCLOCK_INVALID_EVENT));
+        rtc_deadlines_clear();
+        simclock_deinit();
+        rtc_initialized = false;
     }
 }
 
@@ -167,3 +349,44 @@ void rtc_enable_progress()
         progress_thread = std::thread(progress_thread_runner);
     }
 }
+
+rtc_deadline_t rtc_timer_at(uint64_t ticks, std::function<void(void)> callback)
+{
+    rtc_deadline_t id;
+    simclock_event_t event = SIMCLOCK_INVALID_EVENT;
+
+    if (simclock_is_virtual()) {
+        // Make sure the clock stops there, even if the device sleeps past it
+        event = simclock_schedule_at(rtc_base_us + rtc_ticks_to_us(ticks), &rtc_deadline_event, NULL);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex);
+
+        id = next_deadline_id++;
+        deadlines.push( rtc_deadline{ ticks, id, callback } );
+        pending_deadlines[id] = event;
+        next_deadline_ticks = deadlines.top().ticks;
+    }
+
+    // Already in the past
+    rtc_deadlines_expire(0xFFFFFFFF - counter);
+
+    return id;
+}
+
+void rtc_timer_cancel(rtc_deadline_t deadline)
+{
+    simclock_event_t event = SIMCLOCK_INVALID_EVENT;
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex);
+
+        auto it = pending_deadlines.find(deadline);
+        if (it == pending_deadlines.end())
+            return;
+        event = it->second;
+        pending_deadlines.erase(it);
+    }
+
+    simclock_cancel(event);
+}
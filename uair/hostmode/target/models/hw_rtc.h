@@ -5,8 +5,16 @@
 
 #ifdef __cplusplus
 #include "csignal.hpp"
+#include <functional>
 
+/* Emitted on every tick advance. Prefer rtc_timer_at() for deadlines. */
 CSignal<uint32_t, uint32_t> &rtc_timer_signal();
+
+typedef uint32_t rtc_deadline_t;
+
+/* Call back once the tick counter reaches ticks. */
+rtc_deadline_t rtc_timer_at(uint64_t ticks, std::function<void(void)> callback);
+void rtc_timer_cancel(rtc_deadline_t deadline);
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,36 @@
+#ifdef UNITTESTS
+
+#include <catch2/catch.hpp>
+#include "hw_rtc.h"
+#include "hw_simclock.h"
+
+TEST_CASE("Cancelled RTC deadlines don't stop the clock","[SIM][SIM/RTC]")
+{
+    int cancelled = 0;
+    int fired = 0;
+
+    simclock_set_virtual(1);
+    rtc_engine_init();
+
+    rtc_deadline_t deadline = rtc_timer_at(1024, [&cancelled]() { cancelled++; });
+    rtc_timer_at(2048, [&fired]() { fired++; });
+    rtc_timer_cancel(deadline);
+
+    REQUIRE( simclock_cpu_skip_to_next_event() == 1 );
+    CHECK( simclock_now_us() == 2000000 );
+    CHECK( rtc_engine_get_ticks() == 2048 );
+    CHECK( fired == 1 );
+    CHECK( cancelled == 0 );
+
+    // Nothing left once the engine is stopped
+    rtc_timer_at(4096, [&fired]() { fired++; });
+    rtc_engine_deinit();
+    simclock_init();
+    CHECK( simclock_cpu_skip_to_next_event() == 0 );
+    simclock_deinit();
+
+    simclock_set_virtual(0);
+    CHECK( fired == 1 );
+}
+
+#endif
@@ -0,0 +1,391 @@
+#include "hw_simclock.h"
+#include "hw_interrupts.h"
+#include "hw_snapshot.h"
+#include "hw_metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <cstdlib>
+#include <signal.h>
+#include "hlog.h"
+
+DECLARE_LOG_TAG(SIMCLOCK)
+#define TAG "SIMCLOCK"
+
+// Time advanced by each RTC polling iteration in virtual mode. One RTC tick.
+#define SIMCLOCK_SPIN_QUANTUM_US (977U)
+
+#define SIMCLOCK_MAX_LISTENERS (8)
+
+extern "C" float get_speedup();
+
+struct simclock_entry
+{
+    simclock_event_handler_t handler;
+    void *user;
+};
+
+struct simclock_listener
+{
+    simclock_listener_t listener;
+    void *user;
+};
+
+// Events are ordered by time, then by creation order, so that dispatch is deterministic.
+typedef std::pair<simclock_time_t, simclock_event_t> simclock_key;
+
+static std::map<simclock_key, simclock_entry> events;
+static std::unordered_map<simclock_event_t, simclock_time_t> event_times;
+static simclock_listener listeners[SIMCLOCK_MAX_LISTENERS];
+
+static std::mutex clock_mutex;
+static std::condition_variable clock_cond;
+static std::thread clock_thread;
+
+static std::atomic<simclock_time_t> now(0);
+static std::atomic<bool> cpu_idle(false);
+static bool virtual_time = false;
+static uint32_t seed = 1;
+static bool clock_exit = false;
+static simclock_event_t next_event_id = 1;
+static std::chrono::steady_clock::time_point realtime_start;
+
+/*
+ * Interrupts are delivered to the CPU thread as SIGUSR1, and interrupt handlers
+ * may reschedule events. Keep the signal blocked while the CPU thread holds
+ * the clock lock, otherwise a handler could try to take it again.
+ */
+class simclock_signal_guard
+{
+public:
+    simclock_signal_guard()
+    {
+        sigset_t s;
+        sigemptyset(&s);
+        sigaddset(&s, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &s, &m_old);
+    }
+    ~simclock_signal_guard()
+    {
+        pthread_sigmask(SIG_SETMASK, &m_old, NULL);
+    }
+private:
+    sigset_t m_old;
+};
+
+static simclock_time_t simclock_realtime_now_us()
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - realtime_start);
+
+    return (simclock_time_t)(elapsed.count() * get_speedup());
+}
+
+static bool simclock_can_advance()
+{
+    // Read interrupts in flight first: they are released only after the CPU was marked active.
+    if (interrupts_in_flight() != 0)
+        return false;
+    return cpu_idle && !events.empty();
+}
+
+static void simclock_notify_listeners(simclock_time_t old_time, simclock_time_t new_time)
+{
+    simclock_listener copy[SIMCLOCK_MAX_LISTENERS];
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        std::copy(std::begin(listeners), std::end(listeners), std::begin(copy));
+    }
+    for (auto &l: copy) {
+        if (l.listener)
+            l.listener(l.user, old_time, new_time);
+    }
+}
+
+/* Called with the lock held. The lock is released while running handlers and listeners. */
+static void simclock_dispatch_first(std::unique_lock<std::mutex> &lock)
+{
+    auto it = events.begin();
+    simclock_time_t when = it->first.first;
+    simclock_entry entry = it->second;
+
+    event_times.erase(it->first.second);
+    events.erase(it);
+
+    simclock_time_t old_time = now;
+
+    if (virtual_time && when > old_time)
+        now = when;
+
+    lock.unlock();
+
+    if (virtual_time && when > old_time)
+        simclock_notify_listeners(old_time, when);
+
+    entry.handler(entry.user);
+
+    lock.lock();
+}
+
+static void simclock_thread_runner()
+{
+    std::unique_lock<std::mutex> lock(clock_mutex);
+
+    while (!clock_exit) {
+        if (virtual_time) {
+            if (simclock_can_advance()) {
+                simclock_dispatch_first(lock);
+            } else {
+                clock_cond.wait(lock);
+            }
+        } else {
+            if (events.empty()) {
+                clock_cond.wait(lock);
+            } else if (events.begin()->first.first <= simclock_realtime_now_us()) {
+                simclock_dispatch_first(lock);
+            } else {
+                auto delta = (events.begin()->first.first - simclock_realtime_now_us()) / get_speedup();
+                clock_cond.wait_for(lock, std::chrono::microseconds((uint64_t)delta));
+            }
+        }
+    }
+}
+
+/* Snapshots: stop and restart the engine thread, keeping all events */
+static int simclock_thread_stop(void)
+{
+    if (!clock_thread.joinable())
+        return 0;
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        clock_exit = true;
+        clock_cond.notify_all();
+    }
+    clock_thread.join();
+    return 1;
+}
+
+static void simclock_thread_start(void)
+{
+    clock_exit = false;
+    clock_thread = std::thread(simclock_thread_runner);
+}
+
+void simclock_set_virtual(int enable)
+{
+    if (clock_thread.joinable() && ((enable != 0) != virtual_time)) {
+        HERROR(TAG, "Cannot change time mode while running");
+        abort();
+    }
+    virtual_time = enable != 0;
+}
+
+int simclock_is_virtual(void)
+{
+    return virtual_time ? 1 : 0;
+}
+
+void simclock_set_seed(uint32_t s)
+{
+    seed = s;
+}
+
+uint32_t simclock_get_seed(void)
+{
+    return seed;
+}
+
+void simclock_init(void)
+{
+    if (clock_thread.joinable()) {
+        HERROR(TAG, "Simulation clock already started!");
+        abort();
+    }
+
+    events.clear();
+    event_times.clear();
+    now = 0;
+    cpu_idle = false;
+    clock_exit = false;
+    realtime_start = std::chrono::steady_clock::now();
+
+    // All model randomness comes from random(), so a run is reproducible from its seed
+    srandom(seed);
+
+    HLOG(TAG, "Starting %s clock, seed %u", virtual_time ? "virtual" : "realtime", seed);
+
+    simclock_thread_start();
+    snapshot_register_thread(&simclock_thread_stop, &simclock_thread_start);
+
+    metrics_clock_start();
+}
+
+void simclock_deinit(void)
+{
+    metrics_clock_stop();
+
+    if (clock_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(clock_mutex);
+            clock_exit = true;
+            clock_cond.notify_all();
+        }
+        clock_thread.join();
+    }
+    events.clear();
+    event_times.clear();
+}
+
+simclock_time_t simclock_now_us(void)
+{
+    if (virtual_time)
+        return now;
+    return simclock_realtime_now_us();
+}
+
+simclock_event_t simclock_schedule_at(simclock_time_t when, simclock_event_handler_t handler, void *user)
+{
+    simclock_signal_guard guard;
+    std::lock_guard<std::mutex> lock(clock_mutex);
+
+    simclock_event_t id = next_event_id++;
+    if (id == SIMCLOCK_INVALID_EVENT)
+        id = next_event_id++;
+
+    if (virtual_time && when < now)
+        when = now;
+
+    events[ simclock_key(when, id) ] = simclock_entry{ handler, user };
+    event_times[id] = when;
+
+    clock_cond.notify_all();
+
+    return id;
+}
+
+simclock_event_t simclock_schedule_in(simclock_time_t delay, simclock_event_handler_t handler, void *user)
+{
+    return simclock_schedule_at(simclock_now_us() + delay, handler, user);
+}
+
+int simclock_cancel(simclock_event_t event)
+{
+    simclock_signal_guard guard;
+    std::lock_guard<std::mutex> lock(clock_mutex);
+
+    auto it = event_times.find(event);
+    if (it == event_times.end())
+        return 0;
+
+    events.erase(simclock_key(it->second, event));
+    event_times.erase(it);
+
+    return 1;
+}
+
+int simclock_add_listener(simclock_listener_t listener, void *user)
+{
+    simclock_signal_guard guard;
+    std::lock_guard<std::mutex> lock(clock_mutex);
+
+    for (auto &l: listeners) {
+        if (l.listener == NULL) {
+            l.listener = listener;
+            l.user = user;
+            return 0;
+        }
+    }
+    HERROR(TAG, "Too many clock listeners");
+    return -1;
+}
+
+void simclock_remove_listener(simclock_listener_t listener, void *user)
+{
+    simclock_signal_guard guard;
+    std::lock_guard<std::mutex> lock(clock_mutex);
+
+    for (auto &l: listeners) {
+        if (l.listener == listener && l.user == user) {
+            l.listener = NULL;
+            l.user = NULL;
+        }
+    }
+}
+
+void simclock_cpu_idle(void)
+{
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    cpu_idle = true;
+    clock_cond.notify_all();
+}
+
+void simclock_cpu_active(void)
+{
+    cpu_idle = false;
+}
+
+void simclock_cpu_spin(void)
+{
+    if (!virtual_time)
+        return;
+
+    simclock_signal_guard guard;
+    std::unique_lock<std::mutex> lock(clock_mutex);
+
+    simclock_time_t target = now + SIMCLOCK_SPIN_QUANTUM_US;
+
+    // Dispatch whatever falls within this quantum, but stop as soon as an
+    // interrupt is raised so that the CPU sees it at the right time.
+    while (!events.empty() && events.begin()->first.first <= target) {
+        simclock_dispatch_first(lock);
+        if (interrupts_in_flight() != 0)
+            return;
+    }
+
+    simclock_time_t old_time = now;
+    now = target;
+    lock.unlock();
+
+    simclock_notify_listeners(old_time, target);
+}
+
+/*
+ * Low-power entry: jump straight to the earliest armed wakeup from the CPU
+ * thread, instead of handing over to the clock thread. Returns 1 if an event
+ * was dispatched.
+ */
+int simclock_cpu_skip_to_next_event(void)
+{
+    if (!virtual_time)
+        return 0;
+
+    simclock_signal_guard guard;
+    std::unique_lock<std::mutex> lock(clock_mutex);
+
+    if (events.empty() || interrupts_in_flight() != 0)
+        return 0;
+
+    simclock_dispatch_first(lock);
+
+    return 1;
+}
+
+void simclock_gettimeofday(struct timeval *tv)
+{
+    if (!virtual_time) {
+        gettimeofday(tv, NULL);
+        return;
+    }
+    simclock_time_t t = now;
+    tv->tv_sec = t / 1000000U;
+    tv->tv_usec = t % 1000000U;
+}
+
+float simclock_time_scale(void)
+{
+    return virtual_time ? 1.0F : get_speedup();
+}
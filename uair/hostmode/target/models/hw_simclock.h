@@ -0,0 +1,64 @@
+#ifndef HW_SIMCLOCK_H__
+#define HW_SIMCLOCK_H__
+
+#include <inttypes.h>
+#include <sys/time.h>
+
+/*
+ * Simulation clock.
+ *
+ * In realtime mode (default) the simulated time follows the host clock,
+ * scaled by the configured speedup, and the models keep their own threads.
+ *
+ * In virtual mode the clock owns a single virtual time base. Models schedule
+ * their alarms (RTC Alarm A, LPTIM underflow, radio completion, IWDG expiry)
+ * as events, and whenever the CPU is idle (WFI) with no interrupts in flight
+ * the clock jumps straight to the earliest pending event. No host sleeping
+ * is involved.
+ */
+
+typedef uint64_t simclock_time_t;   /* Microseconds */
+typedef uint32_t simclock_event_t;
+
+#define SIMCLOCK_INVALID_EVENT (0U)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*simclock_event_handler_t)(void *user);
+typedef void (*simclock_listener_t)(void *user, simclock_time_t old_time, simclock_time_t new_time);
+
+/* Must be called before simclock_init() */
+void simclock_set_virtual(int enable);
+int simclock_is_virtual(void);
+void simclock_set_seed(uint32_t seed);
+uint32_t simclock_get_seed(void);
+
+void simclock_init(void);
+void simclock_deinit(void);
+
+simclock_time_t simclock_now_us(void);
+
+simclock_event_t simclock_schedule_at(simclock_time_t when, simclock_event_handler_t handler, void *user);
+simclock_event_t simclock_schedule_in(simclock_time_t delay, simclock_event_handler_t handler, void *user);
+int simclock_cancel(simclock_event_t event);
+
+int simclock_add_listener(simclock_listener_t listener, void *user);
+void simclock_remove_listener(simclock_listener_t listener, void *user);
+
+/* CPU state, as seen by the clock */
+void simclock_cpu_idle(void);
+void simclock_cpu_active(void); /* Async-signal safe */
+void simclock_cpu_spin(void);
+int simclock_cpu_skip_to_next_event(void);
+
+/* Time helpers for models */
+void simclock_gettimeofday(struct timeval *tv);
+float simclock_time_scale(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,264 @@
+#include "hw_snapshot.h"
+#include "hw_interrupts.h"
+#include "hw_simclock.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include "hlog.h"
+
+DECLARE_LOG_TAG(SNAPSHOT)
+#define TAG "SNAPSHOT"
+
+#define SNAPSHOT_CPU_STACK_SIZE (8U*1024U*1024U)
+#define SNAPSHOT_MAX_THREADS (8)
+
+struct snapshot_thread
+{
+    snapshot_thread_stop_t stop;
+    snapshot_thread_start_t start;
+    bool stopped;
+};
+
+static snapshot_thread threads[SNAPSHOT_MAX_THREADS];
+static unsigned thread_count = 0;
+
+static void *cpu_stack = NULL;
+static pthread_t cpu_thread;
+static bool cpu_thread_running = false;
+static void (*cpu_entry)(void) = NULL;
+
+// CPU parked at WFI. In a copy, the CPU resumes from here on a new thread.
+static ucontext_t cpu_context;
+// Where the CPU returns to, in a copy, once the firmware exits
+static ucontext_t adopter_context;
+static volatile int cpu_resumed = 0;
+
+static std::atomic<bool> park_requested(false);
+static std::mutex park_mutex;
+static std::condition_variable park_cond;
+static bool parked = false;
+static bool frozen = false;
+static bool copy = false;
+
+static void *snapshot_cpu_runner(void *)
+{
+    cpu_entry();
+
+    // In a copy this stack was inherited from the original thread
+    if (copy)
+        setcontext(&adopter_context);
+
+    return NULL;
+}
+
+static void *snapshot_cpu_adopter(void *)
+{
+    volatile bool returned = false;
+
+    getcontext(&adopter_context);
+
+    if (!returned) {
+        returned = true;
+        setcontext(&cpu_context);
+    }
+    return NULL;
+}
+
+void snapshot_cpu_start(void (*entry)(void))
+{
+    pthread_attr_t attr;
+
+    if (cpu_stack == NULL) {
+        cpu_stack = mmap(NULL, SNAPSHOT_CPU_STACK_SIZE, PROT_READ|PROT_WRITE,
+                         MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+        if (cpu_stack == MAP_FAILED) {
+            HERROR(TAG, "Cannot allocate CPU stack");
+            abort();
+        }
+    }
+
+    cpu_entry = entry;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, cpu_stack, SNAPSHOT_CPU_STACK_SIZE);
+
+    if (pthread_create(&cpu_thread, &attr, snapshot_cpu_runner, NULL) != 0) {
+        HERROR(TAG, "Cannot start CPU thread");
+        abort();
+    }
+    pthread_attr_destroy(&attr);
+
+    cpu_thread_running = true;
+}
+
+void snapshot_cpu_join(void)
+{
+    if (cpu_thread_running) {
+        pthread_join(cpu_thread, NULL);
+        cpu_thread_running = false;
+    }
+}
+
+int snapshot_cpu_running(void)
+{
+    return cpu_thread_running ? 1 : 0;
+}
+
+void snapshot_cpu_idle_point(void)
+{
+    if (!park_requested)
+        return;
+
+    cpu_resumed = 0;
+
+    getcontext(&cpu_context);
+
+    if (cpu_resumed) {
+        // Running in a copy
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(park_mutex);
+    parked = true;
+    park_cond.notify_all();
+    park_cond.wait(lock, []{ return !park_requested; });
+    parked = false;
+}
+
+void snapshot_cpu_pause(void)
+{
+    park_requested = true;
+}
+
+void snapshot_cpu_resume(void)
+{
+    if (frozen)
+        return;
+
+    std::lock_guard<std::mutex> lock(park_mutex);
+    park_requested = false;
+    park_cond.notify_all();
+}
+
+void snapshot_register_thread(snapshot_thread_stop_t stop, snapshot_thread_start_t start)
+{
+    for (unsigned i=0; i<thread_count; i++) {
+        if (threads[i].stop == stop)
+            return;
+    }
+    if (thread_count == SNAPSHOT_MAX_THREADS) {
+        HERROR(TAG, "Too many model threads");
+        abort();
+    }
+    threads[thread_count].stop = stop;
+    threads[thread_count].start = start;
+    threads[thread_count].stopped = false;
+    thread_count++;
+}
+
+static void snapshot_restart_threads(void)
+{
+    for (unsigned i=0; i<thread_count; i++) {
+        if (threads[i].stopped) {
+            threads[i].start();
+            threads[i].stopped = false;
+        }
+    }
+}
+
+int snapshot_freeze(void)
+{
+    if (frozen)
+        return 0;
+
+    if (!simclock_is_virtual() || !interrupts_is_deterministic() || !cpu_thread_running) {
+        HERROR(TAG, "Snapshots need a running device in virtual time with deterministic interrupts");
+        return -1;
+    }
+
+    // The CPU may already be held, at a known point, by snapshot_cpu_pause()
+    {
+        std::unique_lock<std::mutex> lock(park_mutex);
+        park_requested = true;
+        park_cond.wait(lock, []{ return parked; });
+    }
+
+    // No thread may be blocked on a lock or condition when we fork
+    for (unsigned i=0; i<thread_count; i++) {
+        threads[i].stopped = threads[i].stop() != 0;
+    }
+
+    frozen = true;
+
+    HLOG(TAG, "Device frozen at %" PRIu64 " us", simclock_now_us());
+
+    return 0;
+}
+
+void snapshot_thaw(void)
+{
+    if (!frozen)
+        return;
+
+    snapshot_restart_threads();
+
+    frozen = false;
+
+    std::lock_guard<std::mutex> lock(park_mutex);
+    park_requested = false;
+    park_cond.notify_all();
+}
+
+int snapshot_is_frozen(void)
+{
+    return frozen ? 1 : 0;
+}
+
+int snapshot_is_copy(void)
+{
+    return copy ? 1 : 0;
+}
+
+pid_t snapshot_fork(void)
+{
+    if (!frozen) {
+        HERROR(TAG, "Device is not frozen");
+        return -1;
+    }
+
+    fflush(NULL);
+
+    pid_t pid = fork();
+
+    if (pid != 0)
+        return pid;
+
+    // The parked CPU thread did not survive the fork, so nobody waits on these
+    new (&park_mutex) std::mutex();
+    new (&park_cond) std::condition_variable();
+
+    copy = true;
+    frozen = false;
+    parked = false;
+    park_requested = false;
+
+    snapshot_restart_threads();
+
+    cpu_resumed = 1;
+
+    if (pthread_create(&cpu_thread, NULL, snapshot_cpu_adopter, NULL) != 0) {
+        HERROR(TAG, "Cannot resume CPU thread");
+        abort();
+    }
+    cpu_thread_running = true;
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef HW_SNAPSHOT_H__
+#define HW_SNAPSHOT_H__
+
+#include <sys/types.h>
+
+/*
+ * Device snapshots.
+ *
+ * A snapshot is the whole simulated device frozen in this process: firmware
+ * RAM, the CPU stack, the flash image, model state and all timers. Freezing
+ * parks the CPU thread at its next WFI and stops the model threads.
+ * snapshot_fork() then forks a running copy of the frozen device, which is
+ * as cheap as fork() itself. The frozen original is left untouched, so it can
+ * be forked any number of times.
+ *
+ * Only supported in virtual time with deterministic interrupts, where the
+ * CPU thread is the only one that runs firmware code.
+ */
+
+typedef int (*snapshot_thread_stop_t)(void);   /* Returns non-zero if the thread was running */
+typedef void (*snapshot_thread_start_t)(void);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CPU thread. It runs on a stack owned by the simulator, so that it survives fork() */
+void snapshot_cpu_start(void (*entry)(void));
+void snapshot_cpu_join(void);
+int snapshot_cpu_running(void);
+
+/* Called by the CPU thread when it goes idle (WFI) */
+void snapshot_cpu_idle_point(void);
+
+/* Hold the CPU at its next WFI, or let it run again. Safe from any thread. */
+void snapshot_cpu_pause(void);
+void snapshot_cpu_resume(void);
+
+/* Model threads must be stopped while frozen, and restarted in each copy */
+void snapshot_register_thread(snapshot_thread_stop_t stop, snapshot_thread_start_t start);
+
+int snapshot_freeze(void);
+void snapshot_thaw(void);
+int snapshot_is_frozen(void);
+int snapshot_is_copy(void);
+
+/* Returns 0 in the copy, the copy pid in the caller, or -1 on error */
+pid_t snapshot_fork(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,26 +1,72 @@
 #include "models/network/network.hpp"
 #include "models/network/crypto.hpp"
 #include "hlog.h"
-#include "cqueue.hpp"
+#include "models/hw_simclock.h"
+#include "cring.hpp"
 #include "lorawan.hpp"
+#include <map>
+#include <unordered_map>
+#include <unistd.h>
+#include <errno.h>
+#include <cinttypes>
 
 DECLARE_LOG_TAG(LORA_NETWORK)
 #define TAG "LORA_NETWORK"
 
+// One uplink in flight per radio, and the downlink queue plus the frame being received
+#define UPLINK_POOL_SIZE (4)
+#define DOWNLINK_POOL_SIZE (16 + 4)
+
+static PayloadPool<UplinkPayload, UPLINK_POOL_SIZE> uplink_pool;
+static PayloadPool<DownlinkPayload, DOWNLINK_POOL_SIZE> downlink_pool;
+
+void *UplinkPayload::operator new(size_t size)
+{
+    return uplink_pool.alloc();
+}
+
+void UplinkPayload::operator delete(void *p)
+{
+    uplink_pool.release(p);
+}
+
+void *DownlinkPayload::operator new(size_t size)
+{
+    return downlink_pool.alloc();
+}
+
+void DownlinkPayload::operator delete(void *p)
+{
+    downlink_pool.release(p);
+}
+
 
 namespace Network
 {
     static const uint8_t appkey[] = { 0x9B, 0x45, 0x27, 0xBA, 0x42, 0x28, 0xF4, 0x3C, 0xB9, 0x30, 0x0F, 0xCF, 0xD5, 0xDE, 0x5C, 0xA6 };
     static uint32_t netid = 0xfade3e;
-    static uint32_t devaddr = 0xe3ab7c23;
+    static uint32_t devaddr_base = 0xe3ab7c23;
     static uint8_t mcroot[16];
     static uint8_t mcke[16];
-    static uint8_t nwk_s[16];
-    static uint8_t app_s[16];
-    bool joined = false;
 
-    static CQueue<DownlinkPayload*> downlink_queue;
+    // One session per DevEUI, so that a single network can serve a fleet
+    struct Session
+    {
+        uint64_t deveui;
+        uint32_t devaddr;
+        uint8_t nwk_s[16];
+        uint8_t app_s[16];
+        bool joined;
+        uint32_t downlink_counter;
+    };
+
+    static std::map<uint64_t, Session> sessions;
+    static std::unordered_map<uint32_t, Session*> sessions_by_addr;
+    static Session *current = nullptr; // Last device that joined
+
+    static CRingMPSC<DownlinkPayload*, 16> downlink_queue;
     static NetworkInterface *interface = nullptr;
+    static int remote_fd = -1;
 
     bool setinterface(NetworkInterface*i)
     {
@@ -39,12 +85,24 @@ namespace Network
 
     bool devicejoined()
     {
-        return joined;
+        return (nullptr != current) && current->joined;
     }
 
     void unjoin()
     {
-        joined = false;
+        for (auto &i: sessions) {
+            i.second.joined = false;
+        }
+    }
+
+    unsigned joineddevices()
+    {
+        unsigned count = 0;
+        for (auto &i: sessions) {
+            if (i.second.joined)
+                count++;
+        }
+        return count;
     }
 
     static int16_t get_rssi()
@@ -77,9 +135,19 @@ namespace Network
         return netid;
     }
 
-    uint32_t get_dev_addr()
+    static Session *get_session(uint64_t deveui)
     {
-        return devaddr;
+        auto it = sessions.find(deveui);
+        if (it != sessions.end())
+            return &it->second;
+
+        Session &s = sessions[deveui];
+        s.deveui = deveui;
+        s.devaddr = devaddr_base + (sessions.size() - 1);
+        s.joined = false;
+        s.downlink_counter = 0;
+        sessions_by_addr[s.devaddr] = &s;
+        return &s;
     }
 
     uint8_t get_dl_setting()
@@ -87,7 +155,7 @@ namespace Network
         return 0;
     }
 
-    static void prepare_accept_request(const uint8_t *dev_nonce)
+    static void prepare_accept_request(Session *session, const uint8_t *dev_nonce)
     {
         uint8_t acceptreq[1+12+4];
         uint8_t encrypted[1+12+4];
@@ -97,7 +165,7 @@ namespace Network
 
         uint32_t nonce = random();
         uint32_t netid = get_net_id();
-        uint32_t devaddr = get_dev_addr();
+        uint32_t devaddr = session->devaddr;
         uint8_t dlsettings = get_dl_setting();
         uint8_t rxdelay = 0;
 
@@ -166,15 +234,17 @@ namespace Network
         sprint_buffer(temp, mcke, 16);
         HWARN(TAG, "Storing MC KE key as [%s]", temp);
 
-        derive_session_key_10x(0x02, appkey, &acceptreq[1], &acceptreq[4], dev_nonce, app_s);
-        sprint_buffer(temp, app_s, 16);
+        derive_session_key_10x(0x02, appkey, &acceptreq[1], &acceptreq[4], dev_nonce, session->app_s);
+        sprint_buffer(temp, session->app_s, 16);
         HWARN(TAG, "Storing APP_S key as [%s]", temp);
 
-        derive_session_key_10x(0x01, appkey,  &acceptreq[1], &acceptreq[4], dev_nonce, nwk_s);
-        sprint_buffer(temp, nwk_s, 16);
+        derive_session_key_10x(0x01, appkey,  &acceptreq[1], &acceptreq[4], dev_nonce, session->nwk_s);
+        sprint_buffer(temp, session->nwk_s, 16);
         HWARN(TAG, "Storing NWK_S key as [%s]", temp);
 
-        joined = true;
+        session->joined = true;
+        session->downlink_counter = 0;
+        current = session;
     }
 
 
@@ -187,8 +257,8 @@ namespace Network
             return;
 #if 0
         const uint8_t *appeui = &data[1];
-        const uint8_t *deveui = &data[1+8];
 #endif
+        const uint8_t *deveui = &data[1+8];
 
         const uint8_t *nonce = &data[1+8+8];
         const uint8_t *micptr = &data[1+8+8+2];
@@ -206,32 +276,33 @@ namespace Network
             return;
         }
 
-        HWARN(TAG, "Join request from device");
+        uint64_t eui = 0;
+        for (int i=7; i>=0; i--) {
+            eui = (eui<<8) | deveui[i];
+        }
+
+        HWARN(TAG, "Join request from device %016" PRIx64, eui);
         if (nullptr==interface || interface->handleJoin())
         {
-            prepare_accept_request(nonce);
+            prepare_accept_request(get_session(eui), nonce);
         }
     }
 
 
 
-    static uint32_t downlink_counter = 0;
-
-    uint32_t get_downlink_frame_counter()
-    {
-        return downlink_counter++;
-    }
-
-
     void send_user_downlink(uint8_t fport, const uint8_t *data, size_t len)
     {
         uint8_t packet[128];
 
-        if (!joined) {
+        if (!devicejoined()) {
             HERROR(TAG,"Cannot queue downlink if device has not joined!");
             return;
         }
 
+        uint32_t devaddr = current->devaddr;
+        const uint8_t *app_s = current->app_s;
+        const uint8_t *nwk_s = current->nwk_s;
+
         packet[0] = (0x5)<<5;
         packet[1] = devaddr;
         packet[2] = devaddr>>8;
@@ -239,7 +310,7 @@ namespace Network
         packet[4] = devaddr>>24;
         packet[5] = 0x80; // Fcntrl
 
-        uint32_t counter = get_downlink_frame_counter();
+        uint32_t counter = current->downlink_counter++;
 
         packet[6] = counter;
         packet[7] = counter>>8;
@@ -326,6 +397,17 @@ namespace Network
          98 B2 93 CA 8A C4 BD 1F
          AF E5 B3 1A]
          */
+        uint32_t addr = addrptr[0] | ((uint32_t)addrptr[1]<<8) | ((uint32_t)addrptr[2]<<16) | (uint32_t)addrptr[3]<<24;
+
+        auto session = sessions_by_addr.find(addr);
+        if (session == sessions_by_addr.end())
+        {
+            HERROR(TAG,"Uplink from unknown device %08x, dropping", addr);
+            return;
+        }
+        const uint8_t *nwk_s = session->second->nwk_s;
+        const uint8_t *app_s = session->second->app_s;
+
         bblk[0] = 0x49;
         bblk[6] = data[1]; // devaddr[0]
         bblk[7] = data[2]; // devaddr[1]
@@ -368,9 +450,6 @@ namespace Network
         uint32_t framecounter = ((uint32_t)data[7]<<8) | data[6];
         int16_t size = datalen - 8 - 5;
 
-        uint32_t addr = addrptr[0] | ((uint32_t)addrptr[1]<<8) | ((uint32_t)addrptr[2]<<16) | (uint32_t)addrptr[3]<<24;
-
-
         sprint_buffer(temp, app_s, 16);
         HWARN(TAG,"Using address=0x%08x framecounter=0x%08x key=[%s]", addr, framecounter, temp );
 
@@ -436,9 +515,102 @@ namespace Network
         }
     }
 
+    static bool remote_write(const void *data, size_t size)
+    {
+        const uint8_t *ptr = static_cast<const uint8_t*>(data);
+        while (size) {
+            ssize_t r = write(remote_fd, ptr, size);
+            if (r<0 && errno==EINTR)
+                continue;
+            if (r<=0)
+                return false;
+            ptr += r;
+            size -= r;
+        }
+        return true;
+    }
+
+    static bool remote_read(void *data, size_t size)
+    {
+        uint8_t *ptr = static_cast<uint8_t*>(data);
+        while (size) {
+            ssize_t r = read(remote_fd, ptr, size);
+            if (r<0 && errno==EINTR)
+                continue;
+            if (r<=0)
+                return false;
+            ptr += r;
+            size -= r;
+        }
+        return true;
+    }
+
+    /* The frame goes to the shared network, which answers with at most one downlink */
+    static void remote_uplink(UplinkPayload *payload)
+    {
+        RemoteFrame f;
+        uint8_t data[256];
+
+        f.type = RemoteFrame::UPLINK;
+        f.size = payload->size();
+        f.freq = payload->freq();
+        f.datarate = payload->datarate();
+        f.airtime_us = payload->airtime() * 1000;
+        f.time_us = simclock_now_us() - f.airtime_us;
+
+        if (!remote_write(&f, sizeof(f)) || !remote_write(payload->data(), f.size)) {
+            HERROR(TAG, "Lost connection to network");
+            abort();
+        }
+
+        if (!remote_read(&f, sizeof(f)) || (f.type != RemoteFrame::DOWNLINK) ||
+            (f.size > sizeof(data)) || !remote_read(data, f.size)) {
+            HERROR(TAG, "Lost connection to network");
+            abort();
+        }
+
+        if (f.size) {
+            downlink_queue.enqueue( new DownlinkPayload(data, f.size, f.rssi, f.snr) );
+        }
+    }
+
+    void setremote(int fd)
+    {
+        remote_fd = fd;
+    }
+
+    void reset()
+    {
+        DownlinkPayload *p;
+
+        sessions.clear();
+        sessions_by_addr.clear();
+        current = nullptr;
+
+        while (downlink_queue.try_dequeue(p)) {
+            delete(p);
+        }
+    }
+
     void Uplink(UplinkPayload *payload)
     {
-        process_radio_data( payload->data().data(), payload->size() );
+        if (remote_fd >= 0) {
+            remote_uplink(payload);
+            return;
+        }
+        process_radio_data( payload->data(), payload->size() );
+    }
+
+    DownlinkPayload *Process(UplinkPayload *payload)
+    {
+        DownlinkPayload *p = nullptr;
+
+        process_radio_data( payload->data(), payload->size() );
+
+        if (downlink_queue.try_dequeue(p))
+            return p;
+
+        return nullptr;
     }
 
     DownlinkPayload *Downlink(const uint32_t timeout_ms, const float speedup)
@@ -449,7 +621,8 @@ namespace Network
         if (downlink_queue.timed_dequeue(realtimeout, p))
             return p;
 
-        HWARN(TAG ,"No downlink available");
+        if (timeout_ms > 0)
+            HWARN(TAG ,"No downlink available");
         return nullptr;
     }
 
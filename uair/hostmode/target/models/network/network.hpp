@@ -13,6 +13,30 @@ namespace Network
     bool devicejoined();
     void unjoin();
 
+    /* Fleet simulation: devices run in worker processes and reach one shared network over a pipe */
+    struct RemoteFrame
+    {
+        enum {
+            UPLINK,
+            DOWNLINK
+        };
+        uint8_t type;
+        int8_t snr;
+        int16_t rssi;
+        uint16_t size;
+        uint32_t freq;
+        uint32_t datarate;
+        uint32_t airtime_us;
+        uint64_t time_us;   /* Start of transmission, device time */
+    };
+
+    void setremote(int fd);
+    void reset();
+    unsigned joineddevices();
+
+    /* Network side of a remote uplink. Returns the downlink to send back, if any */
+    DownlinkPayload *Process(UplinkPayload *);
+
     /* Private */
     void Uplink(UplinkPayload *);
     DownlinkPayload *Downlink(const uint32_t timeout_ms, const float speedup);
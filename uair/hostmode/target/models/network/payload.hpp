@@ -2,31 +2,85 @@
 #define NETWORK_PAYLOAD_H__
 
 #include <vector>
+#include <mutex>
+#include <new>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cstdio>
 
 typedef std::vector<uint8_t> payload_data_t;
 
+// Largest LoRa PHY payload
+#define PAYLOAD_MAX_SIZE (255U)
+
 class Payload
 {
 public:
-    Payload(const payload_data_t &data): m_data(data) {}
-    Payload(const uint8_t *data, size_t size): m_data(data, data+size) {}
+    Payload(const payload_data_t &data): Payload(data.data(), data.size()) {}
+    Payload(const uint8_t *data, size_t size): m_size(size > PAYLOAD_MAX_SIZE ? PAYLOAD_MAX_SIZE : size)
+    {
+        memcpy(m_data, data, m_size);
+    }
 
-    payload_data_t::size_type size()  const  { return m_data.size(); }
+    size_t size()  const  { return m_size; }
     void print(char *target, size_t maxsize)
     {
         char *ptr = &target[0];
-        for (auto c: m_data) {
+        *ptr = '\0';
+        for (size_t i=0; i<m_size && (ptr + 4) < (target + maxsize); i++) {
             if (ptr!=&target[0])
                 *ptr++=' ';
-            ptr += sprintf(ptr, "%02X",c);
+            ptr += sprintf(ptr, "%02X",m_data[i]);
         }
     };
-    const payload_data_t &data() const { return m_data; }
+    const uint8_t *data() const { return m_data; }
+private:
+    uint8_t m_data[PAYLOAD_MAX_SIZE];
+    size_t m_size;
+};
+
+/*
+ * Fixed pool of payload objects, so that the radio path does not hit the heap
+ * for every frame. Falls back to the heap if the pool runs dry.
+ */
+template<typename T, unsigned N>
+class PayloadPool
+{
+public:
+    PayloadPool(): m_nfree(N)
+    {
+        for (unsigned i=0; i<N; i++)
+            m_free[i] = N - 1 - i;
+    }
+
+    void *alloc()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_nfree)
+                return m_storage[ m_free[--m_nfree] ];
+        }
+        return ::operator new(sizeof(T));
+    }
+
+    void release(void *p)
+    {
+        uint8_t *ptr = static_cast<uint8_t*>(p);
+
+        if (ptr < &m_storage[0][0] || ptr >= &m_storage[N][0]) {
+            ::operator delete(p);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_free[m_nfree++] = (ptr - &m_storage[0][0]) / sizeof(T);
+    }
 private:
-    payload_data_t m_data;
+    alignas(T) uint8_t m_storage[N][sizeof(T)];
+    unsigned m_free[N];
+    unsigned m_nfree;
+    std::mutex m_lock;
 };
 
 class DownlinkPayload: public Payload
@@ -39,6 +93,10 @@ public:
 
     int16_t rssi() const { return m_rssi; }
     int8_t snr() const { return m_snr; }
+
+    /* Pooled, see network.cpp */
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
 private:
     int16_t m_rssi;
     int8_t m_snr;
@@ -48,11 +106,21 @@ private:
 class UplinkPayload: public Payload
 {
 public:
-    UplinkPayload(const uint8_t *data, size_t size, uint32_t packet_airtime): Payload(data,size), m_airtime(packet_airtime) {}
-    UplinkPayload(const payload_data_t &payload, uint32_t packet_airtime): Payload(payload), m_airtime(packet_airtime) {}
+    UplinkPayload(const uint8_t *data, size_t size, uint32_t packet_airtime, uint32_t freq=0, uint32_t datarate=0):
+        Payload(data,size), m_airtime(packet_airtime), m_freq(freq), m_datarate(datarate) {}
+    UplinkPayload(const payload_data_t &payload, uint32_t packet_airtime, uint32_t freq=0, uint32_t datarate=0):
+        Payload(payload), m_airtime(packet_airtime), m_freq(freq), m_datarate(datarate) {}
     uint32_t airtime() const { return m_airtime; }
+    uint32_t freq() const { return m_freq; }
+    uint32_t datarate() const { return m_datarate; }
+
+    /* Pooled, see network.cpp */
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
 private:
     uint32_t m_airtime;
+    uint32_t m_freq;
+    uint32_t m_datarate;
 };
 
 #endif
@@ -10,7 +10,6 @@ DECLARE_LOG_TAG(SHTC3)
 
 #define SHTC3_WAKEUP_TIME_US (240)
 
-extern float get_speedup();
 
 struct shtc3_model
 {
@@ -40,7 +39,7 @@ static bool shtc3_is_sleeping(struct shtc3_model *m)
     if (m->sleeping)
         return true;
 
-    if (time_elapsed_since_exceeds_us(&m->wakeup_start, SHTC3_WAKEUP_TIME_US/get_speedup()))
+    if (time_elapsed_since_exceeds_us(&m->wakeup_start, SHTC3_WAKEUP_TIME_US/simclock_time_scale()))
         return false;
 
     return true;
@@ -54,7 +53,7 @@ static bool shtc3_is_measuring( struct shtc3_model *model )
     if (model->measurement_delay<0)
         return false;
 
-    if (time_elapsed_since_exceeds_us(&model->measurement_start, model->measurement_delay/get_speedup()))
+    if (time_elapsed_since_exceeds_us(&model->measurement_start, model->measurement_delay/simclock_time_scale()))
         return false;
 
     return true;
@@ -127,7 +126,7 @@ i2c_status_t shtc3_master_transmit(void *data, const uint8_t *pData, uint16_t Si
 
         m->sleeping = false;
         m->measurement_delay = -1;
-        gettimeofday(&m->wakeup_start, NULL);
+        simclock_gettimeofday(&m->wakeup_start);
 
         break;
 
@@ -191,7 +190,7 @@ i2c_status_t shtc3_master_transmit(void *data, const uint8_t *pData, uint16_t Si
 
             shtc3_put_u16_u16(m, m->temp, m->hum);
 
-            gettimeofday(&m->measurement_start, NULL);
+            simclock_gettimeofday(&m->measurement_start);
             m->measurement_delay = 12100; // 12.1ms
         }
         break;
@@ -271,7 +270,7 @@ void shtc3_powerup(struct shtc3_model *m)
 {
     HWARN(TAG, "Powered up");
     m->powered = true;
-    gettimeofday(&m->wakeup_start, NULL);
+    simclock_gettimeofday(&m->wakeup_start);
 }
 
 void shtc3_set_temperature(struct shtc3_model *m, float temp_c)
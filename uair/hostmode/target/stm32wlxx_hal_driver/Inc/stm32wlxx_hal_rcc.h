@@ -130,7 +130,8 @@ typedef struct
 #define RCC_STOP_WAKEUPCLOCK_MSI (1)
 
 #define RCC_LPTIM1CLKSOURCE_PCLK1 (0)
-#define RCC_PERIPHCLK_LPTIM1 (0)
+#define RCC_LPTIM1CLKSOURCE_LSE (1)
+#define RCC_PERIPHCLK_LPTIM1 (1<<0) /* Only LPTIM1 clock selection is modelled */
 #define RCC_PERIPHCLK_RTC (0)
 #define RCC_PERIPHCLK_I2C1 (0)
 #define RCC_PERIPHCLK_USART2 (0)
@@ -5,9 +5,16 @@
 
 // Host-mode
 
+// Unique device number, overridable so that fleet simulations get distinct DevEUIs
+#ifdef __cplusplus
+extern "C" uint32_t board_udn;
+#else
+extern uint32_t board_udn;
+#endif
+
 static inline uint32_t LL_FLASH_GetUDN()
 {
-    return 0xDEADBEEF;
+    return board_udn;
 }
 
 static inline uint32_t LL_FLASH_GetDeviceID()
@@ -4,6 +4,7 @@
 #include <sys/time.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include "models/hw_simclock.h"
 
 static inline int timeval_subtract (struct timeval *result, const struct timeval *x, const struct timeval *y_const)
 {
@@ -50,7 +51,7 @@ static inline bool time_elapsed_since_exceeds_us(const struct timeval *start, un
     struct timeval delta;
     struct timeval max;
 
-    gettimeofday(&now, NULL);
+    simclock_gettimeofday(&now);
     max.tv_sec = 0;
     max.tv_usec = us;
     timeval_normalise( &max );
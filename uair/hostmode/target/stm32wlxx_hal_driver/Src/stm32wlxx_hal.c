@@ -1,6 +1,7 @@
 #include "stm32wlxx_hal.h"
 #include "cmsis_compiler.h"
 #include <stdlib.h>
+#include "models/hw_interrupts.h"
 
 #define MAX_IRQ 64
 static uint32_t ticks;
@@ -9,8 +10,8 @@ struct irqdef
 {
     int enabled;
     int pending;
-    int group;
-    int prio;
+    int preempt;
+    int sub;
 };
 
 static struct irqdef irqdef[MAX_IRQ] = {0};
@@ -25,10 +26,13 @@ void HAL_NVIC_EnableIRQ(int irq)
     irqdef[irq].enabled = 0;
 }
 
-void HAL_NVIC_SetPriority(int irq,int group,int prio)
+void HAL_NVIC_SetPriority(int irq,int preempt,int sub)
 {
-    irqdef[irq].group = group;
-    irqdef[irq].group = prio;
+    irqdef[irq].preempt = preempt;
+    irqdef[irq].sub = sub;
+    // Only the preemption priority decides which line runs first and which preempts.
+    // Lines include the 16 core exceptions.
+    interrupt_set_priority(irq + 16, preempt);
 }
 
 __WEAK uint32_t HAL_GetTick(void)
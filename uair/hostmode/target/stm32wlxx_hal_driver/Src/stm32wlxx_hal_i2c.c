@@ -1,5 +1,9 @@
 #include "stm32wlxx_hal.h"
+#include "cmsis_compiler.h"
 #include "stm32wlxx_hal_i2c_pvt.h"
+#include "models/hw_metrics.h"
+#include "models/hw_interrupts.h"
+#include "models/hw_simclock.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -7,6 +11,8 @@
 DECLARE_LOG_TAG(HAL_I2C)
 #define TAG "HAL_I2C"
 
+static void i2c_cancel_transfer(I2C_HandleTypeDef *hi2c);
+
 void i2c_set_error_mode( I2C_TypeDef *bus, uint8_t device, i2c_error_mode_t error_mode, uint32_t error_code)
 {
     struct i2c_device *d = &bus->i2c_devices[(device>>1)&0x7F];
@@ -27,6 +33,9 @@ static struct i2c_device *find_i2c_device(I2C_TypeDef *i2c, uint16_t address)
         HERROR(TAG, "Attempting to access unknown I2C device at address %d (0x%02x)", address, address);
         abort();
     }
+
+    metrics_i2c( (i2c == I2C1) ? 1 : (i2c == I2C2) ? 2 : 3, address );
+
     return d;
 }
 
@@ -42,12 +51,15 @@ HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
 {
     hi2c->Instance->mode = hi2c->Mode;
     hi2c->Instance->init = true;
+    hi2c->State = HAL_I2C_STATE_READY;
     HLOG(TAG, "I2C bus initialized mode %d", hi2c->Mode);
     return HAL_OK;
 }
 
 HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
 {
+    i2c_cancel_transfer(hi2c);
+    hi2c->State = HAL_I2C_STATE_RESET;
     hi2c->Instance->init = false;
     HLOG(TAG, "I2C bus de-initialized");
     return HAL_OK;
@@ -182,4 +194,197 @@ HAL_StatusTypeDef HAL_I2CEx_ConfigDigitalFilter(I2C_HandleTypeDef *hi2c, uint32_
     return HAL_OK;
 }
 
+/*
+ * Interrupt mode. The device model is accessed when the transfer starts, but
+ * completion (or error) is only reported by the event (or error) interrupt
+ * once the bytes would have gone through the bus, as on the real controller.
+ */
+
+#define I2C_BIT_TIME_US (10U)   /* 100kHz */
+
+typedef enum {
+    I2C_XFER_MASTER_TX,
+    I2C_XFER_MASTER_RX,
+    I2C_XFER_MEM_TX,
+    I2C_XFER_MEM_RX
+} i2c_xfer_t;
+
+static struct i2c_pending_xfer
+{
+    I2C_HandleTypeDef *hi2c;
+    i2c_xfer_t xfer;
+    simclock_event_t event;
+} i2c_pending[3];
+
+static struct i2c_pending_xfer *i2c_get_pending(I2C_TypeDef *instance)
+{
+    return &i2c_pending[(instance == I2C1) ? 0 : (instance == I2C2) ? 1 : 2];
+}
+
+static int i2c_ev_line(I2C_TypeDef *instance)
+{
+    IRQn_Type irq = (instance == I2C1) ? I2C1_EV_IRQn : (instance == I2C2) ? I2C2_EV_IRQn : I2C3_EV_IRQn;
+    return (int)irq + 16; // Lines include the 16 core exceptions
+}
+
+static void i2c_transfer_done(void *user)
+{
+    I2C_HandleTypeDef *hi2c = (I2C_HandleTypeDef*)user;
+    struct i2c_pending_xfer *p = i2c_get_pending(hi2c->Instance);
+
+    p->event = SIMCLOCK_INVALID_EVENT;
+
+    // The error line follows the event line in the vector table
+    raise_interrupt(i2c_ev_line(hi2c->Instance) + (hi2c->ErrorCode != HAL_I2C_ERROR_NONE ? 1 : 0));
+}
+
+static void i2c_cancel_transfer(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_pending_xfer *p = i2c_get_pending(hi2c->Instance);
+
+    if (p->hi2c == hi2c && p->event != SIMCLOCK_INVALID_EVENT) {
+        simclock_cancel(p->event);
+        p->event = SIMCLOCK_INVALID_EVENT;
+    }
+    p->hi2c = NULL;
+    hi2c->State = HAL_I2C_STATE_READY;
+}
+
+static HAL_StatusTypeDef i2c_start_transfer(I2C_HandleTypeDef *hi2c, i2c_xfer_t xfer, uint16_t DevAddress,
+                                            uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+    struct i2c_pending_xfer *p;
+    struct i2c_device *dev;
+    HAL_StatusTypeDef r;
+    unsigned bytes = 1 + Size;
 
+    assert(hi2c->Instance->init);
+
+    if (hi2c->State != HAL_I2C_STATE_READY)
+        return HAL_BUSY;
+
+    dev = find_i2c_device(hi2c->Instance, DevAddress);
+
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+
+    r = i2c_precheck_error_mode(hi2c, dev);
+    if (r == HAL_BUSY)
+        return r;
+
+    if (r == HAL_OK) {
+        switch (xfer) {
+        case I2C_XFER_MASTER_TX:
+            r = dev->ops->master_transmit(dev->data, pData, Size);
+            break;
+        case I2C_XFER_MASTER_RX:
+            r = dev->ops->master_receive(dev->data, pData, Size);
+            break;
+        case I2C_XFER_MEM_TX:
+            r = dev->ops->master_mem_write(dev->data, MemAddress, MemAddSize, pData, Size);
+            bytes += MemAddSize;
+            break;
+        case I2C_XFER_MEM_RX:
+            r = dev->ops->master_mem_read(dev->data, MemAddress, MemAddSize, pData, Size);
+            bytes += MemAddSize + 1; // Repeated start
+            break;
+        }
+        r = i2c_postcheck_error_mode(r, hi2c, dev);
+    }
+
+    if (r != HAL_OK && hi2c->ErrorCode == HAL_I2C_ERROR_NONE)
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+
+    hi2c->State = (xfer == I2C_XFER_MASTER_RX || xfer == I2C_XFER_MEM_RX) ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+    hi2c->pBuffPtr = pData;
+    hi2c->XferSize = Size;
+
+    p = i2c_get_pending(hi2c->Instance);
+    p->hi2c = hi2c;
+    p->xfer = xfer;
+    // 9 clocks per byte, plus start and stop
+    p->event = simclock_schedule_in((simclock_time_t)((bytes * 9U) + 2U) * I2C_BIT_TIME_US, &i2c_transfer_done, hi2c);
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                             uint16_t Size)
+{
+    return i2c_start_transfer(hi2c, I2C_XFER_MASTER_TX, DevAddress, 0, 0, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                            uint16_t Size)
+{
+    return i2c_start_transfer(hi2c, I2C_XFER_MASTER_RX, DevAddress, 0, 0, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+    return i2c_start_transfer(hi2c, I2C_XFER_MEM_TX, DevAddress, MemAddress, MemAddSize, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                      uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+    return i2c_start_transfer(hi2c, I2C_XFER_MEM_RX, DevAddress, MemAddress, MemAddSize, pData, Size);
+}
+
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_pending_xfer *p = i2c_get_pending(hi2c->Instance);
+
+    if (p->hi2c != hi2c)
+        return; // Cancelled
+
+    p->hi2c = NULL;
+    hi2c->State = HAL_I2C_STATE_READY;
+
+    switch (p->xfer) {
+    case I2C_XFER_MASTER_TX:
+        HAL_I2C_MasterTxCpltCallback(hi2c);
+        break;
+    case I2C_XFER_MASTER_RX:
+        HAL_I2C_MasterRxCpltCallback(hi2c);
+        break;
+    case I2C_XFER_MEM_TX:
+        HAL_I2C_MemTxCpltCallback(hi2c);
+        break;
+    case I2C_XFER_MEM_RX:
+        HAL_I2C_MemRxCpltCallback(hi2c);
+        break;
+    }
+}
+
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_pending_xfer *p = i2c_get_pending(hi2c->Instance);
+
+    if (p->hi2c != hi2c)
+        return;
+
+    p->hi2c = NULL;
+    hi2c->State = HAL_I2C_STATE_READY;
+    HAL_I2C_ErrorCallback(hi2c);
+}
+
+__WEAK void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+}
+
+__WEAK void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+}
+
+__WEAK void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+}
+
+__WEAK void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+}
+
+__WEAK void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+}
@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include "models/hw_simclock.h"
 
 DECLARE_LOG_TAG(HAL_IWDG)
 #define TAG "HAL_IWDG"
@@ -13,14 +14,41 @@ static pthread_t iwdg_thread;
 static bool iwdg_thread_initialized = false;
 static volatile bool iwdg_exit = false;
 
+/* Virtual time: expiry is a single event, rescheduled on every refresh */
+static simclock_event_t iwdg_event = SIMCLOCK_INVALID_EVENT;
+static simclock_time_t iwdg_deadline = 0;
+
 void __attribute__((weak)) watchdog_timeout();
 
+static simclock_time_t iwdg_count_us(IWDG_HandleTypeDef *hiwdg)
+{
+    return (1000000U/LSI_VALUE) * (4U << hiwdg->Instance->prescaler);
+}
+
+static void iwdg_expired(void *user)
+{
+    iwdg_event = SIMCLOCK_INVALID_EVENT;
+    watchdog_timeout();
+}
+
+static void iwdg_schedule(IWDG_HandleTypeDef *hiwdg)
+{
+    simclock_cancel(iwdg_event);
+    iwdg_deadline = simclock_now_us() + ((simclock_time_t)hiwdg->Instance->counter + 1U) * iwdg_count_us(hiwdg);
+    iwdg_event = simclock_schedule_at(iwdg_deadline, &iwdg_expired, hiwdg);
+}
+
 void iwdg_deinit()
 {
     iwdg_exit = true;
     void *ret;
     if (iwdg_thread_initialized) {
-        pthread_join(iwdg_thread, &ret);
+        if (simclock_is_virtual()) {
+            simclock_cancel(iwdg_event);
+            iwdg_event = SIMCLOCK_INVALID_EVENT;
+        } else {
+            pthread_join(iwdg_thread, &ret);
+        }
         iwdg_thread_initialized = false;
     }
 }
@@ -53,7 +81,11 @@ HAL_StatusTypeDef HAL_IWDG_Init(IWDG_HandleTypeDef *hiwdg)
 
         HLOG(TAG, "Initializing IWDG, LSI_VALUE %lu", LSI_VALUE);
 
-        if (pthread_create(&iwdg_thread, NULL, iwdg_thread_runner, hiwdg)==0) {
+        if (simclock_is_virtual()) {
+            iwdg_schedule(hiwdg);
+            iwdg_thread_initialized = true;
+            r = HAL_OK;
+        } else if (pthread_create(&iwdg_thread, NULL, iwdg_thread_runner, hiwdg)==0) {
             iwdg_thread_initialized = true;
 
             r = HAL_OK;
@@ -67,8 +99,16 @@ HAL_StatusTypeDef HAL_IWDG_Refresh(IWDG_HandleTypeDef *hiwdg)
     /* Return function status */
     uint16_t oldcounter = hiwdg->Instance->counter;
 
+    if (simclock_is_virtual()) {
+        oldcounter = (iwdg_deadline - simclock_now_us()) / iwdg_count_us(hiwdg);
+    }
+
     hiwdg->Instance->counter = hiwdg->Instance->period;
 
+    if (simclock_is_virtual()) {
+        iwdg_schedule(hiwdg);
+    }
+
     HLOG(TAG, "Watchdog kick: %d ms remaining", oldcounter * 4 * (4U<<hiwdg->Instance->prescaler));
 
     return HAL_OK;
@@ -10,6 +10,9 @@ HAL_StatusTypeDef HAL_LPTIM_Init(LPTIM_HandleTypeDef *hlptim)
 {
     assert ( hlptim->Init.Clock.Source == LPTIM_CLOCKSOURCE_APBCLOCK_LPOSC );
 
+    // Selects the kernel clock
+    HAL_LPTIM_MspInit(hlptim);
+
     //UAIR_BSP_lptim.Init.Clock.Prescaler = LPTIM_PRESCALER_DIV32; // 1.333333us per tick @ 24Mhz, 16us @ 2Mhz
     lptim_engine_init( 1U<< hlptim->Init.Clock.Prescaler );
 
@@ -19,6 +22,7 @@ HAL_StatusTypeDef HAL_LPTIM_Init(LPTIM_HandleTypeDef *hlptim)
 HAL_StatusTypeDef HAL_LPTIM_DeInit(LPTIM_HandleTypeDef *hlptim)
 {
     lptim_engine_deinit();
+    HAL_LPTIM_MspDeInit(hlptim);
 
     return HAL_OK;
 }
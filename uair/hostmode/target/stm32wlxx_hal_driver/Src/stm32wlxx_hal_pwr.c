@@ -1,5 +1,6 @@
 #include "stm32wlxx_hal.h"
 #include "cmsis_compiler.h"
+#include "models/hw_pwr.h"
 
 void              HAL_PWR_EnableBkUpAccess(void)
 {
@@ -11,7 +12,9 @@ void              HAL_PWR_DisableBkUpAccess(void)
 
 void              HAL_PWR_EnterSLEEPMode(uint32_t Regulator, uint8_t SLEEPEntry)
 {
+    pwr_engine_enter_lpm(PWR_MODE_SLEEP);
     __WFI();
+    pwr_engine_exit_lpm();
 }
 
 void              HAL_PWREx_EnableLowPowerRunMode(void)
@@ -29,11 +32,16 @@ void              HAL_PWREx_EnterSTOP0Mode(uint8_t STOPEntry)
 
 void              HAL_PWREx_EnterSTOP1Mode(uint8_t STOPEntry)
 {
+    pwr_engine_enter_lpm(PWR_MODE_STOP1);
+    __WFI();
+    pwr_engine_exit_lpm();
 }
 
 void              HAL_PWREx_EnterSTOP2Mode(uint8_t STOPEntry)
 {
+    pwr_engine_enter_lpm(PWR_MODE_STOP2);
     __WFI();
+    pwr_engine_exit_lpm();
 }
 
 void              HAL_PWREx_EnterSHUTDOWNMode(void)
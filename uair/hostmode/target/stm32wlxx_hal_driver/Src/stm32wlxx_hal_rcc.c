@@ -1,4 +1,5 @@
 #include "stm32wlxx_hal_rcc.h"
+#include "models/hw_lptim.h"
 
 #define PERIPH_I2C1 (0)
 #define PERIPH_I2C2 (1)
@@ -103,6 +104,9 @@ void LL_RCC_LSE_SetDriveCapability(uint32_t drive) {
 
 HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(const RCC_PeriphCLKInitTypeDef *d)
 {
+    if (d->PeriphClockSelection & RCC_PERIPHCLK_LPTIM1) {
+        lptim_engine_set_clock(d->Lptim1ClockSelection == RCC_LPTIM1CLKSOURCE_LSE ? 32768U : 2000000U);
+    }
     return HAL_OK;
 }
 
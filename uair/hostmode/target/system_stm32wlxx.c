@@ -9,20 +9,50 @@
 #include <pthread.h>
 #include <unistd.h>
 #include "stm32wl55xx_protos.h"
+#include "models/hw_simclock.h"
+#include "models/hw_interrupts.h"
+#include "models/hw_metrics.h"
 
 void __NOP()
 {
 }
 
+/* RTC polling waits (UAIR_RTC_DelayMs) must see time passing in virtual mode */
+void rtc_poll_wait(void)
+{
+    simclock_cpu_spin();
+    interrupts_dispatch();
+}
+
 void __WFI()
 {
-    /*int signal;
-    sigset_t s;
+    sigset_t s, old, wait;
+
+    if (interrupts_is_deterministic()) {
+        interrupts_wait();
+        return;
+    }
+
+    if (!simclock_is_virtual()) {
+        pause();
+        return;
+    }
+
+    // Block the wakeup signal so that it cannot be lost between
+    // the pending check and the suspend.
     sigemptyset(&s);
     sigaddset(&s, SIGUSR1 );
-    sigwait(&s, &signal);
-    */
-    pause();
+    pthread_sigmask(SIG_BLOCK, &s, &old);
+
+    // As in hardware, WFI does not sleep if an interrupt is already pending
+    if (!interrupt_pending()) {
+        simclock_cpu_idle();
+        wait = old;
+        sigdelset(&wait, SIGUSR1);
+        sigsuspend(&wait);
+        simclock_cpu_active();
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
 }
 
 void __disable_irq()
@@ -152,6 +182,7 @@ static const interrupt_handler interrupt_handlers[] =
 void interrupt(int line)
 {
     interrupt_handler h  = interrupt_handlers[line];
+    metrics_interrupt(line);
     h();
 }
 
@@ -0,0 +1,321 @@
+#include "uAirFleet.hpp"
+
+#ifdef UNITTESTS
+
+#include "hlog.h"
+#include "models/network/network.hpp"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define TAG "FLEET"
+
+// Base for per-device unique numbers, which end up in the DevEUI
+#define FLEET_UDN_BASE (0xF1EE0000U)
+
+extern "C" uint32_t board_udn;
+
+static bool fleet_read(int fd, void *data, size_t size)
+{
+    uint8_t *ptr = static_cast<uint8_t*>(data);
+    while (size) {
+        ssize_t r = read(fd, ptr, size);
+        if (r<0 && errno==EINTR)
+            continue;
+        if (r<=0)
+            return false;
+        ptr += r;
+        size -= r;
+    }
+    return true;
+}
+
+static bool fleet_write(int fd, const void *data, size_t size)
+{
+    const uint8_t *ptr = static_cast<const uint8_t*>(data);
+    while (size) {
+        ssize_t r = write(fd, ptr, size);
+        if (r<0 && errno==EINTR)
+            continue;
+        if (r<=0)
+            return false;
+        ptr += r;
+        size -= r;
+    }
+    return true;
+}
+
+uAirFleet::uAirFleet(const uAirFleetConfig &config): m_config(config)
+{
+    if (m_config.jobs == 0)
+        m_config.jobs = std::max(1U, std::thread::hardware_concurrency());
+
+    if (m_config.boot_spread > m_config.duration)
+        m_config.boot_spread = m_config.duration;
+
+    // Boot offsets depend only on the seed, so a fleet run is reproducible
+    std::mt19937_64 gen(m_config.seed);
+    uint64_t spread_us = std::chrono::microseconds(m_config.boot_spread).count();
+
+    for (unsigned i=0; i<m_config.devices; i++) {
+        m_boot_us.push_back( spread_us ? gen() % spread_us : 0 );
+    }
+}
+
+bool uAirFleet::spawn(unsigned index, Worker &w)
+{
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        HERROR(TAG, "Cannot create socket pair: %s", strerror(errno));
+        return false;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        HERROR(TAG, "Cannot fork: %s", strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        board_udn = FLEET_UDN_BASE + index;
+
+        Network::reset();
+        Network::setremote(fds[1]);
+
+        {
+            char name[64];
+            sprintf(name, "UAIR_FLEET_%04u", index);
+
+            uAirTestController device(name);
+
+            if (m_config.scenario)
+                m_config.scenario(device, index);
+
+            device.startApplicationVirtualTime(m_config.seed + index);
+
+            uint64_t run_us = std::chrono::microseconds(m_config.duration).count() - m_boot_us[index];
+            device.waitFor(std::chrono::microseconds(run_us));
+        }
+
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    w.index = index;
+    w.pid = pid;
+    w.fd = fds[0];
+
+    return true;
+}
+
+/* Handle one frame from a worker. Returns false once the worker is gone. */
+bool uAirFleet::serve(Worker &w)
+{
+    Network::RemoteFrame f;
+    uint8_t data[256];
+
+    if (!fleet_read(w.fd, &f, sizeof(f)))
+        return false;
+
+    if ((f.type != Network::RemoteFrame::UPLINK) || (f.size > sizeof(data)) || !fleet_read(w.fd, data, f.size)) {
+        HERROR(TAG, "Device %u: malformed frame", w.index);
+        return false;
+    }
+
+    uAirFleetFrame frame;
+    frame.device = w.index;
+    frame.mhdr = f.size ? data[0] : 0;
+    frame.start_us = m_boot_us[w.index] + f.time_us;
+    frame.airtime_us = f.airtime_us;
+    frame.freq = f.freq;
+    frame.datarate = f.datarate;
+    frame.size = f.size;
+    frame.collided = false;
+    m_report.uplinks.push_back(frame);
+
+    UplinkPayload uplink(data, f.size, f.airtime_us / 1000, f.freq, f.datarate);
+    DownlinkPayload *downlink = Network::Process(&uplink);
+
+    f.type = Network::RemoteFrame::DOWNLINK;
+    f.size = 0;
+
+    if (nullptr != downlink) {
+        f.size = downlink->size();
+        f.rssi = downlink->rssi();
+        f.snr = downlink->snr();
+    }
+
+    bool ok = fleet_write(w.fd, &f, sizeof(f)) &&
+        ((nullptr == downlink) || fleet_write(w.fd, downlink->data(), f.size));
+
+    delete(downlink);
+
+    return ok;
+}
+
+void uAirFleet::finish(Worker &w)
+{
+    int status = 0;
+
+    close(w.fd);
+
+    while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        HERROR(TAG, "Device %u failed (status 0x%x)", w.index, status);
+        m_report.failed++;
+    }
+}
+
+bool uAirFleet::run()
+{
+    std::vector<Worker> workers;
+    std::vector<struct pollfd> pfds;
+    unsigned next = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    m_report = uAirFleetReport();
+    m_report.devices = m_config.devices;
+    m_report.duration_s = std::chrono::duration<double>(m_config.duration).count();
+
+    Network::reset();
+
+    HLOG(TAG, "Running %u devices, %u at a time", m_config.devices, m_config.jobs);
+
+    while (next < m_config.devices || !workers.empty()) {
+
+        while (next < m_config.devices && workers.size() < m_config.jobs) {
+            Worker w;
+            if (!spawn(next, w)) {
+                m_report.failed++;
+            } else {
+                workers.push_back(w);
+            }
+            next++;
+        }
+
+        if (workers.empty())
+            continue;
+
+        pfds.resize(workers.size());
+        for (size_t i=0; i<workers.size(); i++) {
+            pfds[i].fd = workers[i].fd;
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+
+        if (poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            HERROR(TAG, "poll: %s", strerror(errno));
+            abort();
+        }
+
+        // Walk backwards so that finished workers can be removed in place
+        for (size_t i=workers.size(); i-- > 0;) {
+            if (pfds[i].revents == 0)
+                continue;
+            if (!serve(workers[i])) {
+                finish(workers[i]);
+                workers.erase(workers.begin() + i);
+            }
+        }
+    }
+
+    m_report.joined = Network::joineddevices();
+    m_report.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    analyse();
+
+    return m_report.failed == 0;
+}
+
+void uAirFleet::analyse()
+{
+    std::vector<uAirFleetFrame> &frames = m_report.uplinks;
+    std::vector<size_t> active;
+
+    std::sort(frames.begin(), frames.end(),
+              [](const uAirFleetFrame &a, const uAirFleetFrame &b) {
+                  return a.start_us < b.start_us;
+              });
+
+    m_report.airtime_s = 0;
+    m_report.max_concurrent = 0;
+    m_report.over_capacity = 0;
+
+    // Gateway occupancy, regardless of channel
+    for (size_t i=0; i<frames.size(); i++) {
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](size_t a) { return frames[a].start_us + frames[a].airtime_us <= frames[i].start_us; }),
+                     active.end());
+        if (active.size() >= m_config.gateway_demodulators)
+            m_report.over_capacity++;
+        active.push_back(i);
+        m_report.max_concurrent = std::max<unsigned>(m_report.max_concurrent, active.size());
+        m_report.airtime_s += frames[i].airtime_us / 1000000.0;
+    }
+
+    // Collisions: overlap on the same channel and datarate
+    std::map< std::pair<uint32_t,uint32_t>, std::vector<size_t> > channels;
+
+    for (size_t i=0; i<frames.size(); i++) {
+        std::vector<size_t> &ch = channels[ std::make_pair(frames[i].freq, frames[i].datarate) ];
+        ch.erase(std::remove_if(ch.begin(), ch.end(),
+                                [&](size_t a) { return frames[a].start_us + frames[a].airtime_us <= frames[i].start_us; }),
+                 ch.end());
+        if (!ch.empty()) {
+            frames[i].collided = true;
+            for (auto a: ch)
+                frames[a].collided = true;
+        }
+        ch.push_back(i);
+    }
+
+    m_report.collisions = std::count_if(frames.begin(), frames.end(), [](const uAirFleetFrame &f) { return f.collided; });
+}
+
+unsigned uAirFleetReport::countFrames(lora_message_type_t type) const
+{
+    return std::count_if(uplinks.begin(), uplinks.end(), [type](const uAirFleetFrame &f) { return (f.mhdr>>5) == type; });
+}
+
+void uAirFleetReport::dump(std::ostream &s) const
+{
+    std::map<uint32_t, double> per_channel;
+
+    for (auto &f: uplinks) {
+        per_channel[f.freq] += f.airtime_us / 1000000.0;
+    }
+
+    s << "Fleet: " << devices << " devices, " << failed << " failed, " << joined << " joined" << std::endl;
+    s << "  Uplinks:        " << uplinks.size() << " (" << countFrames(JOIN_REQUEST) << " join requests)" << std::endl;
+    s << "  Airtime:        " << airtime_s << " s over " << duration_s << " s" << std::endl;
+    for (auto &c: per_channel) {
+        s << "    " << c.first << " Hz: " << (100.0 * c.second / duration_s) << "% busy" << std::endl;
+    }
+    s << "  Collisions:     " << collisions << std::endl;
+    s << "  Max concurrent: " << max_concurrent << ", over capacity: " << over_capacity << std::endl;
+    s << "  Wall time:      " << wall_s << " s (" << (devices * duration_s / wall_s) << " device-s/s)" << std::endl;
+}
+
+#endif
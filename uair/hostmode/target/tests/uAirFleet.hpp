@@ -0,0 +1,101 @@
+#ifndef UAIR_FLEET_H__
+#define UAIR_FLEET_H__
+
+#ifdef UNITTESTS
+
+#include "uAirTestController.hpp"
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+/*
+ * Fleet simulation.
+ *
+ * The firmware and the models keep their state in globals, so each device
+ * runs in its own worker process, in virtual time. All workers send their
+ * radio frames to one shared network model hosted by the calling process,
+ * which also records them to compute gateway load and airtime.
+ *
+ * Device timelines are independent: each worker runs as fast as it can, and
+ * frames are placed on the fleet timeline using the device boot offset.
+ */
+
+struct uAirFleetConfig
+{
+    unsigned devices{1};
+    /* Concurrent workers, 0 for one per CPU core */
+    unsigned jobs{0};
+    /* Fleet observation window */
+    std::chrono::seconds duration{std::chrono::minutes(80)};
+    /* Devices power up uniformly within this window */
+    std::chrono::seconds boot_spread{std::chrono::minutes(5)};
+    uint32_t seed{1};
+    /* Frames a gateway can demodulate at once */
+    unsigned gateway_demodulators{8};
+    /* Per-device setup, run in the worker before the application starts */
+    std::function<void(uAirTestController &, unsigned index)> scenario;
+};
+
+struct uAirFleetFrame
+{
+    unsigned device;
+    uint8_t mhdr;
+    uint64_t start_us;   /* Fleet time */
+    uint32_t airtime_us;
+    uint32_t freq;
+    uint32_t datarate;
+    uint16_t size;
+    bool collided;
+};
+
+struct uAirFleetReport
+{
+    unsigned devices{0};
+    unsigned failed{0};          /* Workers that did not exit cleanly */
+    unsigned joined{0};
+    std::vector<uAirFleetFrame> uplinks;
+    unsigned collisions{0};      /* Frames overlapping another one on the same channel and datarate */
+    unsigned max_concurrent{0};
+    unsigned over_capacity{0};   /* Frames arriving while all demodulators were busy */
+    double airtime_s{0};
+    double duration_s{0};
+    double wall_s{0};
+
+    unsigned countFrames(lora_message_type_t type) const;
+    void dump(std::ostream &) const;
+};
+
+class uAirFleet
+{
+public:
+    explicit uAirFleet(const uAirFleetConfig &config);
+
+    /**
+     * @brief Run all devices to completion. Returns false if any worker failed.
+     */
+    bool run();
+
+    const uAirFleetReport &report() const { return m_report; }
+
+private:
+    struct Worker
+    {
+        unsigned index;
+        pid_t pid;
+        int fd;
+    };
+
+    bool spawn(unsigned index, Worker &w);
+    bool serve(Worker &w);
+    void finish(Worker &w);
+    void analyse();
+
+    uAirFleetConfig m_config;
+    uAirFleetReport m_report;
+    std::vector<uint64_t> m_boot_us;
+};
+
+#endif
+
+#endif
@@ -1,13 +1,23 @@
 #ifdef UNITTESTS
 
+// Needed for the test event listener
+#define CATCH_CONFIG_EXTERNAL_INTERFACES
 #include "uAirTestController.hpp"
 #include "hlog.h"
 #include <regex>
+#include <sys/wait.h>
+#include <errno.h>
 #include "hal_types.h"
+#include "models/hw_pwr.h"
+#include "models/hw_interrupts.h"
+#include "models/hw_snapshot.h"
 
 #define TAG "CONTROLLER"
 
-static std::thread app_thread;
+// Name of the snapshot currently frozen, if any
+static std::string snapshot_name;
+// Failed assertions, reported by a snapshot copy as its exit status
+static unsigned assertion_failures = 0;
 
 extern "C" {
     int app_main(int argc, char **argv);
@@ -25,20 +35,72 @@ static void start_app()
     app_main(0, NULL);
 }
 
-uAirTestController::uAirTestController(): m_logfile(NULL), m_joinpolicy(true), m_oaq_max(-1.0), m_sound_max(-1.0)
+static void discard_snapshot()
+{
+    if (!snapshot_is_frozen())
+        return;
+
+    HLOG(TAG, "Discarding snapshot '%s'", snapshot_name.c_str());
+
+    snapshot_thaw();
+    test_exit_main_loop();
+    snapshot_cpu_join();
+    test_BSP_deinit();
+
+    LoRaWAN::unjoinDevice();
+    simclock_set_virtual(0);
+    interrupts_set_deterministic(0);
+
+    snapshot_name.clear();
+}
+
+/* Counts failures for snapshot copies, and drops the snapshot when its test case ends */
+class uAirSnapshotListener: public Catch::TestEventListenerBase
+{
+public:
+    using TestEventListenerBase::TestEventListenerBase;
+
+    bool assertionEnded(Catch::AssertionStats const &stats) override
+    {
+        if (!stats.assertionResult.isOk())
+            assertion_failures++;
+        return true;
+    }
+
+    void testCaseEnded(Catch::TestCaseStats const &stats) override
+    {
+        discard_snapshot();
+        TestEventListenerBase::testCaseEnded(stats);
+    }
+};
+
+CATCH_REGISTER_LISTENER(uAirSnapshotListener)
+
+uAirTestController::uAirTestController(): m_logfile(NULL), m_joinpolicy(true), m_preparing_snapshot(false), m_oaq_max(-1.0), m_sound_max(-1.0)
 {
     LoRaWAN::setNetworkInterface(this);
     setTestName(Catch::getResultCapture().getCurrentTestName());
     openLogFiles();
 }
 
-void uAirTestController::setTestName(const std::string &s)
+uAirTestController::uAirTestController(const std::string &name): m_logfile(NULL), m_joinpolicy(true), m_preparing_snapshot(false), m_oaq_max(-1.0), m_sound_max(-1.0)
+{
+    LoRaWAN::setNetworkInterface(this);
+    m_testname = name;
+    openLogFiles();
+}
+
+std::string uAirTestController::fileNameForTest(const std::string &s)
 {
     std::regex spc("\\s+");
     std::regex slash("\\\\");
     std::string new_s = std::regex_replace(s, spc, "_");
-    new_s = std::string("UAIR_TEST_") + std::regex_replace(new_s, slash, "_");
-    m_testname = new_s;
+    return std::string("UAIR_TEST_") + std::regex_replace(new_s, slash, "_");
+}
+
+void uAirTestController::setTestName(const std::string &s)
+{
+    m_testname = fileNameForTest(s);
 }
 
 static void bsp_postinit_wrapper(void *user, HAL_StatusTypeDef r)
@@ -48,13 +110,17 @@ static void bsp_postinit_wrapper(void *user, HAL_StatusTypeDef r)
 
 void uAirTestController::startApplication( float speedup )
 {
-    if (!app_thread.joinable())
+    // Not starting from the snapshot, so it is of no use anymore
+    if (!m_preparing_snapshot)
+        discard_snapshot();
+
+    if (!snapshot_cpu_running())
     {
         set_speedup(speedup);
         HLOG(TAG,"Application using speedup %f", speedup);
         set_bsp_postinit_hook( &bsp_postinit_wrapper, this);
         m_bsp_init_cond.reset(false);
-        app_thread = std::thread(start_app);
+        snapshot_cpu_start(start_app);
 
         // Wait for BSP post init
         m_bsp_init_cond.wait(true);
@@ -63,13 +129,34 @@ void uAirTestController::startApplication( float speedup )
     }
 }
 
+void uAirTestController::startApplicationVirtualTime(uint32_t seed)
+{
+    if (!m_preparing_snapshot)
+        discard_snapshot();
+
+    if (!snapshot_cpu_running())
+    {
+        simclock_set_virtual(1);
+        simclock_set_seed(seed);
+        interrupts_set_deterministic(1);
+    }
+    startApplication(1.0F);
+}
+
 bool uAirTestController::stopApplication()
 {
-    if (app_thread.joinable())
+    if (snapshot_is_frozen())
+    {
+        HLOG(TAG, "Application is frozen in a snapshot");
+        return false;
+    }
+
+    if (snapshot_cpu_running())
     {
         test_exit_main_loop();
 
-        app_thread.join();
+        snapshot_cpu_join();
+        pwr_engine_dump_stats();
         HLOG(TAG, "De-initalizing BSP");
 
         test_BSP_deinit();
@@ -79,6 +166,52 @@ bool uAirTestController::stopApplication()
     return false;
 }
 
+bool uAirTestController::forkFromSnapshot(const std::string &name, std::function<void(void)> prepare)
+{
+    if (snapshot_is_frozen() && (snapshot_name != name))
+        discard_snapshot();
+
+    if (!snapshot_is_frozen())
+    {
+        HLOG(TAG, "Preparing snapshot '%s'", name.c_str());
+
+        m_preparing_snapshot = true;
+        prepare();
+        m_preparing_snapshot = false;
+
+        if (snapshot_freeze() != 0)
+        {
+            FAIL("Cannot freeze device for snapshot " << name);
+            return false;
+        }
+        snapshot_name = name;
+    }
+
+    pid_t pid = snapshot_fork();
+
+    if (pid == 0)
+    {
+        // The copy reports its own failures only
+        assertion_failures = 0;
+        HLOG(TAG, "Running from snapshot '%s'", name.c_str());
+        return true;
+    }
+
+    if (pid < 0)
+    {
+        FAIL("Cannot fork snapshot " << name << ": " << strerror(errno));
+        return false;
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+    INFO("Copy of snapshot " << name << " exited with status 0x" << std::hex << status);
+    CHECK( (WIFEXITED(status) && WEXITSTATUS(status) == 0) );
+
+    return false;
+}
+
 bool uAirTestController::deviceJoined()
 {
     return LoRaWAN::hasDeviceJoined();
@@ -210,12 +343,20 @@ uAirTestController::~uAirTestController()
     }
     m_timers.clear();
 
-    LoRaWAN::unjoinDevice();
+    if (snapshot_is_frozen()) {
+        // Kept for the next copy, dropped when the test case ends
+        HLOG(TAG, "Leaving device frozen in snapshot '%s'", snapshot_name.c_str());
+    } else {
+        LoRaWAN::unjoinDevice();
 
-    if (!stopApplication()) {
-        HLOG(TAG, "De-initalizing BSP");
-        test_BSP_deinit();
+        if (!stopApplication()) {
+            HLOG(TAG, "De-initalizing BSP");
+            test_BSP_deinit();
+        }
+        simclock_set_virtual(0);
+        interrupts_set_deterministic(0);
     }
+
     if (m_logfile) {
         set_host_log_file(stdout);
         uart2_set_filedes(stdout);
@@ -223,6 +364,11 @@ uAirTestController::~uAirTestController()
         m_logfile = NULL;
     }
     HLOG(TAG,"Controller shut down");
+
+    if (snapshot_is_copy()) {
+        fflush(NULL);
+        _exit(assertion_failures ? 1 : 0);
+    }
 }
 
 void uAirTestController::initBSPcore()
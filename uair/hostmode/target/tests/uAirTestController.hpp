@@ -12,6 +12,8 @@
 #include "csignal.hpp"
 #include "ccondition.hpp"
 #include "models/hw_rtc.h"
+#include "models/hw_simclock.h"
+#include "models/hw_snapshot.h"
 #include "models/OAQ.hpp"
 #include "hal_types.h"
 #include <ostream>
@@ -59,17 +61,58 @@ using namespace std::chrono_literals;
 struct uAirTestController: public NetworkInterface, public OAQInterface
 {
     uAirTestController();
+    /**
+     * @brief Controller with an explicit name, used for its log file.
+     */
+    explicit uAirTestController(const std::string &name);
     virtual ~uAirTestController();
 
     /**
      * @brief Start the uAir application for system tests
      */
     void startApplication(float speed=1.0F);
+    /**
+     * @brief Start the uAir application using virtual time.
+     *
+     * Simulated time jumps straight to the next pending timer whenever
+     * the device is idle, so runs are as fast as the host allows.
+     * Interrupts are delivered synchronously, so runs are reproducible.
+     *
+     * @param seed Seed for all simulator randomness.
+     */
+    void startApplicationVirtualTime(uint32_t seed=1);
     /**
      * @brief Stop uAir application for system tests
      */
     bool stopApplication();
 
+    /**
+     * @brief Run the rest of the test on a copy of a prepared device.
+     *
+     * The first call runs prepare(), which is expected to start the
+     * application in virtual time and bring it to some state (e.g. joined),
+     * and then freezes the whole device. Each call forks a copy of the frozen
+     * device, so tests sharing a long setup pay for it only once per test
+     * case.
+     *
+     * Returns true in the copy, which continues with the test. Returns false
+     * in the caller once the copy finished, after checking that it passed.
+     * Stimuli set up by prepare() (OAQ, sound level) must be set again in the
+     * copy.
+     *
+     * @code
+     * SECTION("joined") {
+     *     if (!forkFromSnapshot("joined", prepare))
+     *         return;
+     *     CHECK( deviceJoined() );
+     * }
+     * @endcode
+     *
+     * @param name Snapshot name. A different name rebuilds the snapshot.
+     * @param prepare Brings the device to the state to snapshot.
+     */
+    bool forkFromSnapshot(const std::string &name, std::function<void(void)> prepare);
+
     /**
      * @brief Check if device has joined
      */
@@ -110,25 +153,23 @@ struct uAirTestController: public NetworkInterface, public OAQInterface
         CCondition<bool> *elapsed = new CCondition<bool>(false);
 
         unsigned ticks = rtc_engine_get_ticks() + ((std::chrono::microseconds(duration).count() * 1024)/1000000);
+        bool hold = m_preparing_snapshot;
 
         do_log("CONTROLLER", LEVEL_PROGRESS, "","", __LINE__, "Run until %lu (from %lu, %lu)",
                ticks,
                rtc_engine_get_ticks(), std::chrono::microseconds(duration).count());
 
-        auto timer = rtc_timer_signal().connect(
-                                                [elapsed, ticks](uint32_t old_value,uint32_t new_value)->bool
-                                                {
-                                                    //printf("Ticks %d %d %d\n", old_value, new_value, ticks);
-                                                    if ((new_value >= ticks ) && ( old_value<ticks))
-                                                    {
-                                                        elapsed->set(true);
-                                                        return false;
-                                                    }
-                                                    return true;
-                                                }
-                                               );
+        // Deadline in the RTC timer heap, no per-tick callback
+        auto timer = rtc_timer_at(ticks, [elapsed, hold]() {
+            // While preparing a snapshot the device is held at each deadline, so it is frozen at a known time
+            if (hold)
+                snapshot_cpu_pause();
+            elapsed->set(true);
+        });
+        if (hold)
+            snapshot_cpu_resume();
         elapsed->wait( true );
-        timer.disconnect();
+        rtc_timer_cancel(timer);
         delete (elapsed);
 
 
@@ -160,6 +201,11 @@ struct uAirTestController: public NetworkInterface, public OAQInterface
     float getrand(float amplitude);
     const std::string &testname() const { return m_testname; }
 
+    /**
+     * @brief Base file name (logs, reports) used for a test case.
+     */
+    static std::string fileNameForTest(const std::string &testcase);
+
     void bspPostInit(HAL_StatusTypeDef status) {
         m_bsp_init_cond.set(true);
         m_bsp_init_signal.emit(status);
@@ -198,6 +244,7 @@ private:
     std::vector< CSignalID > m_timers;
     std::queue< LoRaUplinkMessage > m_uplink_messages;
     bool m_joinpolicy;
+    bool m_preparing_snapshot;
 
     /* OAQ */
     float m_oaq_base;
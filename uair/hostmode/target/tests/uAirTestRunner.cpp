@@ -0,0 +1,290 @@
+#include "uAirTestRunner.hpp"
+
+#ifdef UNITTESTS
+
+#include "uAirTestController.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct uAirTestJob
+{
+    std::string name;
+    std::string filename;
+    std::chrono::steady_clock::time_point start;
+    double seconds{0};
+    int status{0};
+};
+
+// Test names are matched as Catch test specs, so special characters must be escaped
+static std::string escape_test_spec(const std::string &name)
+{
+    std::string r;
+    for (auto c: name) {
+        if (c=='\\' || c==',' || c=='[' || c==']' || c=='*' || c=='"' || c=='~')
+            r += '\\';
+        r += c;
+    }
+    return r;
+}
+
+static std::string escape_xml(const std::string &s)
+{
+    std::string r;
+    for (auto c: s) {
+        switch (c) {
+        case '&': r += "&amp;"; break;
+        case '<': r += "&lt;"; break;
+        case '>': r += "&gt;"; break;
+        case '"': r += "&quot;"; break;
+        default: r += c; break;
+        }
+    }
+    return r;
+}
+
+// Command line options followed by a value, Catch's and main_hostmode.cc's
+static const std::set<std::string> value_options = {
+    "-o", "--out", "-r", "--reporter", "-n", "--name", "-w", "--warn", "-d", "--durations",
+    "-D", "--min-duration", "-f", "--input-file", "-c", "--section", "-v", "--verbosity",
+    "--order", "--rng-seed", "--use-colour", "--wait-for-keypress",
+    "--benchmark-samples", "--benchmark-resamples", "--benchmark-confidence-interval", "--benchmark-warmup-time",
+    "--jobs", "--metrics", "--metrics-live", "--trace", "--log"
+};
+
+// Options set per job, or that only apply to this process
+static const std::set<std::string> runner_options = {
+    "-o", "--out", "-r", "--reporter", "-d", "--durations", "-f", "--input-file",
+    "-#", "--filenames-as-tags", "--jobs", "--trace", "--metrics"
+};
+
+/* The options of this command line the jobs run with as well, test specs left out */
+static std::vector<std::string> job_options(int argc, char **argv, std::string &metrics)
+{
+    std::vector<std::string> options;
+
+    for (int i=1; i<argc; i++) {
+        std::string opt = argv[i];
+        std::string value;
+        bool has_value = false;
+
+        if (opt.size() < 2 || opt[0] != '-')
+            continue;
+
+        // Same as Clara, the value may be attached to the option
+        size_t delim = opt.find_first_of(" :=");
+        if (delim != std::string::npos) {
+            value = opt.substr(delim + 1);
+            opt = opt.substr(0, delim);
+            has_value = true;
+        } else if (value_options.count(opt) && (i + 1) < argc) {
+            value = argv[++i];
+            has_value = true;
+        }
+
+        if (opt == "--metrics") {
+            metrics = value;
+            continue;
+        }
+        if (runner_options.count(opt))
+            continue;
+
+        options.push_back(opt);
+        if (has_value)
+            options.push_back(value);
+    }
+    return options;
+}
+
+static pid_t start_job(const char *argv0, const std::vector<std::string> &options, const std::string &metrics, uAirTestJob &job)
+{
+    std::string spec = escape_test_spec(job.name);
+    std::string xml = job.filename + ".xml";
+    std::string out = job.filename + ".out";
+    // Jobs would overwrite each other's summary
+    std::string job_metrics = (metrics == "-") ? metrics : job.filename + ".metrics.json";
+
+    unlink(xml.c_str());
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+
+    if (pid != 0)
+        return pid;
+
+    int fd = open(out.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+
+    std::vector<const char*> args = { argv0 };
+    for (auto &o: options)
+        args.push_back(o.c_str());
+    if (!metrics.empty()) {
+        args.push_back("--metrics");
+        args.push_back(job_metrics.c_str());
+    }
+    for (auto a: { spec.c_str(), "-r", "junit", "-o", xml.c_str(), "-d", "yes" })
+        args.push_back(a);
+    args.push_back(NULL);
+
+#ifdef __linux__
+    execv("/proc/self/exe", (char * const *)args.data());
+#endif
+    execv(argv0, (char * const *)args.data());
+
+    fprintf(stderr, "Cannot execute %s: %s\n", argv0, strerror(errno));
+    _exit(127);
+}
+
+static bool job_passed(const uAirTestJob &job)
+{
+    return WIFEXITED(job.status) && WEXITSTATUS(job.status)==0;
+}
+
+static std::string job_result(const uAirTestJob &job)
+{
+    std::ostringstream s;
+
+    if (WIFSIGNALED(job.status)) {
+        s << "killed by signal " << WTERMSIG(job.status);
+    } else if (WIFEXITED(job.status) && WEXITSTATUS(job.status)!=0) {
+        s << WEXITSTATUS(job.status) << " failed assertion(s)";
+    }
+    return s.str();
+}
+
+/* Reuse the testsuite from the job report, or make one up if the process did not write it */
+static void write_junit_suite(std::ostream &o, const uAirTestJob &job)
+{
+    std::ifstream in(job.filename + ".xml");
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string xml = ss.str();
+
+    size_t begin = xml.find("<testsuite ");
+    size_t end = xml.rfind("</testsuite>");
+
+    if (in && begin != std::string::npos && end != std::string::npos && WIFEXITED(job.status)) {
+        o << xml.substr(begin, end + strlen("</testsuite>") - begin) << std::endl;
+        return;
+    }
+
+    o << "  <testsuite name=\"" << escape_xml(job.name) << "\" errors=\"1\" failures=\"0\" tests=\"1\" time=\"" << job.seconds << "\">" << std::endl;
+    o << "    <testcase classname=\"" << escape_xml(job.filename) << "\" name=\"" << escape_xml(job.name) << "\" time=\"" << job.seconds << "\">" << std::endl;
+    o << "      <error type=\"crash\" message=\"" << escape_xml(job_result(job)) << "\"/>" << std::endl;
+    o << "      <system-out>See " << escape_xml(job.filename) << ".out</system-out>" << std::endl;
+    o << "    </testcase>" << std::endl;
+    o << "  </testsuite>" << std::endl;
+}
+
+int uAirRunTestsParallel(Catch::Config &config, int argc, char **argv, unsigned jobs)
+{
+    std::string metrics;
+    std::vector<std::string> options = job_options(argc, argv, metrics);
+    std::vector<Catch::TestCase> tests = Catch::filterTests( Catch::getAllTestCasesSorted(config), config.testSpec(), config );
+    std::vector<uAirTestJob> results(tests.size());
+    std::map<pid_t, size_t> running;
+    size_t next = 0;
+
+    if (jobs == 0)
+        jobs = std::max(1U, std::thread::hardware_concurrency());
+
+    for (size_t i=0; i<tests.size(); i++) {
+        results[i].name = tests[i].name;
+        results[i].filename = uAirTestController::fileNameForTest(tests[i].name);
+    }
+
+    bool junit = config.getReporterName() == "junit";
+    std::ostream &console = (junit && config.getFilename().empty()) ? std::cerr : std::cout;
+
+    console << "Running " << tests.size() << " test cases, " << jobs << " at a time" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (next < results.size() || !running.empty()) {
+
+        while (next < results.size() && running.size() < jobs) {
+            results[next].start = std::chrono::steady_clock::now();
+            pid_t pid = start_job(argv[0], options, metrics, results[next]);
+            if (pid < 0) {
+                console << "Cannot fork: " << strerror(errno) << std::endl;
+                return 255;
+            }
+            running[pid] = next++;
+        }
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        auto it = running.find(pid);
+        if (it == running.end())
+            continue;
+
+        uAirTestJob &job = results[it->second];
+        running.erase(it);
+
+        job.status = status;
+        job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.start).count();
+
+        console << (job_passed(job) ? "[  PASSED  ] " : "[  FAILED  ] ") << job.name
+            << " (" << job.seconds << " s)";
+        if (!job_passed(job))
+            console << ": " << job_result(job) << ", see " << job.filename << ".out";
+        console << std::endl;
+    }
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double serial = 0;
+    unsigned failed = 0;
+
+    for (auto &job: results) {
+        serial += job.seconds;
+        if (!job_passed(job))
+            failed++;
+    }
+
+    console << "===============================================================================" << std::endl;
+    console << results.size() << " test cases: " << (results.size() - failed) << " passed, " << failed << " failed" << std::endl;
+    console << "Wall time " << wall << " s, sum of test times " << serial << " s";
+    if (wall > 0)
+        console << " (" << (serial / wall) << "x)";
+    console << std::endl;
+
+    if (junit) {
+        std::ofstream file;
+        if (!config.getFilename().empty())
+            file.open(config.getFilename());
+        std::ostream &o = config.getFilename().empty() ? std::cout : file;
+
+        o << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl;
+        o << "<testsuites tests=\"" << results.size() << "\" failures=\"" << failed << "\" time=\"" << wall << "\">" << std::endl;
+        for (auto &job: results) {
+            write_junit_suite(o, job);
+        }
+        o << "</testsuites>" << std::endl;
+    }
+
+    return std::min(failed, 255U);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef UAIR_TEST_RUNNER_H__
+#define UAIR_TEST_RUNNER_H__
+
+#ifdef UNITTESTS
+
+// Needed for Catch::Config
+#define CATCH_CONFIG_EXTERNAL_INTERFACES
+#include <catch2/catch.hpp>
+
+/**
+ * @brief Run the selected test cases in parallel, each one in its own process.
+ *
+ * The simulator keeps its state in globals, so test cases cannot share a
+ * process when running concurrently. Each test case re-executes this binary
+ * with only that test selected and the other options of the command line.
+ * Its JUnit report goes to UAIR_TEST_<name>.xml and its console output to
+ * UAIR_TEST_<name>.out, next to the log opened by the test controller. A
+ * --metrics summary goes to UAIR_TEST_<name>.metrics.json.
+ *
+ * Results are aggregated on the console, or into a single JUnit report when
+ * the JUnit reporter is selected.
+ *
+ * @param config Catch configuration, with the command line already applied.
+ * @param argc Argument count, as given to main().
+ * @param argv Command line, as given to main().
+ * @param jobs Concurrent processes, 0 for one per CPU core.
+ *
+ * @return Number of failed test cases, as Catch would return it.
+ */
+int uAirRunTestsParallel(Catch::Config &config, int argc, char **argv, unsigned jobs);
+
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Renders a binary log trace (see hlog_trace.h) as text.
+ *
+ *   hlog_decode [-z ZONE]... [-l debug|warn|error|progress] [-s] trace.bin
+ *
+ * -z keeps only the given zones, -l drops lines below a level and -s sorts
+ * lines from all threads by simulated time.
+ */
+#include "hlog_trace.h"
+#include "hlog_trace_decode.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const char *level_names[] = { "DEBUG", "WARN", "ERROR", "PROGRESS" };
+
+struct decoded_line
+{
+    uint64_t time_us;
+    std::string text;
+};
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-z zone]... [-l debug|warn|error|progress] [-s] trace.bin\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    std::set<std::string> zones;
+    int min_level = 0;
+    bool sort = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "z:l:sh")) != -1) {
+        switch (opt) {
+        case 'z':
+            zones.insert(optarg);
+            break;
+        case 'l':
+            min_level = -1;
+            for (unsigned i=0; i<sizeof(level_names)/sizeof(level_names[0]); i++) {
+                if (strcasecmp(optarg, level_names[i])==0)
+                    min_level = i;
+            }
+            if (min_level < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 's':
+            sort = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[optind], "rb");
+    if (NULL == f) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    std::vector<decoded_line> lines;
+
+    hlog_trace_decode_result_t result = hlog_trace_decode(f, [&](const hlog_trace_line &t) {
+        if (t.level < min_level)
+            return;
+        if (!zones.empty() && zones.find(t.zone)==zones.end())
+            return;
+
+        char prefix[512];
+        snprintf(prefix, sizeof(prefix), "[%10.6f] %-5s %-8s T%-2u %s:%u %s: ",
+                 t.time_us / 1e6,
+                 t.level < sizeof(level_names)/sizeof(level_names[0]) ? level_names[t.level] : "?",
+                 t.zone.c_str(), t.thread, t.file.c_str(), t.line, t.func.c_str());
+
+        decoded_line l { t.time_us, prefix + t.text };
+
+        if (sort) {
+            lines.push_back(std::move(l));
+        } else {
+            fputs(l.text.c_str(), stdout);
+            if (l.text.empty() || l.text.back() != '\n')
+                fputc('\n', stdout);
+        }
+    });
+
+    if (result == HLOG_TRACE_DECODE_BAD_HEADER) {
+        fprintf(stderr, "%s: not a version %u log trace\n", argv[optind], HLOG_TRACE_VERSION);
+        fclose(f);
+        return 1;
+    }
+    if (result == HLOG_TRACE_DECODE_UNKNOWN_RECORD)
+        fprintf(stderr, "%s: unknown record type\n", argv[optind]);
+
+    fclose(f);
+
+    std::stable_sort(lines.begin(), lines.end(), [](const decoded_line &a, const decoded_line &b) {
+        return a.time_us < b.time_us;
+    });
+
+    for (auto &l: lines) {
+        fputs(l.text.c_str(), stdout);
+        if (l.text.empty() || l.text.back() != '\n')
+            fputc('\n', stdout);
+    }
+
+    if (result != HLOG_TRACE_DECODE_OK)
+        fprintf(stderr, "%s: trace is truncated\n", argv[optind]);
+
+    return 0;
+}
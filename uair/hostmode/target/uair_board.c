@@ -8,6 +8,7 @@
 #include "models/vm3011.h"
 #include "models/hw_rtc.h"
 #include "models/hw_interrupts.h"
+#include "models/hw_pwr.h"
 #include "system_linux.h"
 
 
@@ -20,6 +21,8 @@ struct shtc3_model *shtc3;;
 struct zmod4510_model *zmod4510;
 struct vm3011_model *vm3011;
 
+uint32_t board_udn = 0xDEADBEEF;
+
 void i2c1_power_control_write(void *user, int val)
 {
     i2c1_power = !!val;
@@ -155,6 +158,14 @@ void bsp_preinit()
 
     rtc_engine_init();
 
+    pwr_engine_reset_stats();
 }
 
 
+
+void bsp_deinit()
+{
+    rtc_engine_deinit();
+
+    deinit_interrupts();
+}